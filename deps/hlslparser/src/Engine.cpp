@@ -1,11 +1,11 @@
 
-#define WIN32_LEAN_AND_MEAN
 #include "Engine.h"
 
 #include <stdio.h>  // vsnprintf
 #include <string.h> // strcmp, strcasecmp
 #include <stdlib.h>	// strtod, strtol
-#include <windows.h>
+
+#include "Log.h"
 
 namespace M4 {
 
@@ -84,18 +84,10 @@ void Log_Error(const char * format, ...) {
 }
 
 void Log_ErrorArgList(const char * format, va_list args) {
-    SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), FOREGROUND_RED);
-
-#if 1 // @@ Don't we need to do this?
-    va_list tmp;
-    va_copy(tmp, args);
-    vprintf( format, args );
-    va_end(tmp);
-#else
-    vprintf( format, args );
-#endif
-
-    SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE);
+    // Goes through fxdc's logger so parser errors are buffered, captured and colored like everything else.
+    std::string text = ::Log::FormatArgList(format, args);
+    while (!text.empty() && text.back() == '\n') text.pop_back();
+    ::Log::Write(eLogLevel::ERR, std::move(text));
 }
 
 
@@ -123,6 +115,17 @@ const char * StringPool::AddString(const char * string) {
     return dup;
 }
 
+const char * StringPool::AddString(const char * string, size_t length) {
+    for (int i = 0; i < stringArray.GetSize(); i++) {
+        if (strncmp(stringArray[i], string, length) == 0 && stringArray[i][length] == 0) return stringArray[i];
+    }
+    char * dup = (char *)malloc(length + 1);
+    memcpy(dup, string, length);
+    dup[length] = 0;
+    stringArray.PushBack(dup);
+    return dup;
+}
+
 // @@ From mprintf.cpp
 static char *mprintf_valist(int size, const char *fmt, va_list args) {
     ASSERT(size > 0);
@@ -181,6 +181,7 @@ struct StringPool {
     ~StringPool();
 
     const char * AddString(const char * string);
+    const char * AddString(const char * string, size_t length);
     const char * AddStringFormat(const char * fmt, ...);
     const char * AddStringFormatList(const char * fmt, va_list args);
     bool GetContainsString(const char * string) const;
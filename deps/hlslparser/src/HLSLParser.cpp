@@ -15,6 +15,10 @@
 
 #include <algorithm>
 #include <cctype>
+#include <iterator>
+#include <string.h>
+
+#include "Utils.h"
 
 namespace M4
 {
@@ -251,7 +255,7 @@ struct EffectState
     const EffectStateValue * values;
 };
 
-static const EffectState samplerStates[] = {
+static constexpr EffectState samplerStates[] = {
     {"Texture", 0, NULL},
     {"AddressU", 1, textureAddressingValues},
     {"AddressV", 2, textureAddressingValues},
@@ -266,7 +270,7 @@ static const EffectState samplerStates[] = {
     {"SRGBTexture", 11, booleanValues},    
 };
 
-static const EffectState effectStates[] = {
+static constexpr EffectState effectStates[] = {
     {"VertexShader", 0, NULL},
     {"PixelShader", 0, NULL},
     {"AlphaBlendEnable", 27, booleanValues},
@@ -368,7 +372,7 @@ static const EffectStateValue witnessWrapModeValues[] = {
     {NULL, 0}
 };
 
-static const EffectState pipelineStates[] = {
+static constexpr EffectState pipelineStates[] = {
     {"VertexShader", 0, NULL},
     {"PixelShader", 0, NULL},
 
@@ -391,6 +395,11 @@ static const EffectState pipelineStates[] = {
     {"AlphaTest", 0, booleanValues},       // This is really alpha to coverage.
 };
 
+// Case insensitive perfect hashes of the state names, built at compile time.
+static constexpr PerfectHashTable<std::size(samplerStates), true> samplerStateTable(samplerStates, &EffectState::name);
+static constexpr PerfectHashTable<std::size(effectStates), true> effectStateTable(effectStates, &EffectState::name);
+static constexpr PerfectHashTable<std::size(pipelineStates), true> pipelineStateTable(pipelineStates, &EffectState::name);
+
 
 
 struct BaseTypeDescription
@@ -1176,8 +1185,8 @@ static bool GetBinaryOpResultType(HLSLBinaryOp binaryOp, const HLSLType& type1,
 
 }
 
-HLSLParser::HLSLParser(Allocator* allocator, const char* fileName, const char* buffer, size_t length, const _D3DXMACRO* macros) :
-    m_tokenizer(fileName, buffer, length, macros),
+HLSLParser::HLSLParser(Allocator* allocator, const char* fileName, const char* buffer, size_t length) :
+    m_tokenizer(allocator, fileName, buffer, length),
     m_userTypes(allocator),
     m_variables(allocator),
     m_functions(allocator),
@@ -1296,7 +1305,13 @@ bool HLSLParser::AcceptString(const char*& value)
 {
     if(m_tokenizer.GetToken() == HLSLToken_StringLiteral)
     {
-        value = m_tree->AddString(m_tokenizer.GetString());
+        value = m_tree->AddStringLiteral(m_tokenizer.GetString(), m_tokenizer.GetTokenLength());
+        if (value == NULL)
+        {
+            // The rest of the declaration is fine, keep parsing it so it doesn't cause more errors.
+            m_tokenizer.Error("String literals can't contain a null character");
+            value = m_tree->AddString("");
+        }
         m_tokenizer.Next();
         return true;
     }
@@ -1653,6 +1668,7 @@ bool HLSLParser::ParseStatementOrBlock(HLSLStatement*& firstStatement, const HLS
 
 bool HLSLParser::ParseBlock(HLSLStatement*& firstStatement, const HLSLType& returnType)
 {
+    int depth = m_tokenizer.GetBraceDepth();
     HLSLStatement* lastStatement = NULL;
     while (!Accept('}'))
     {
@@ -1660,10 +1676,25 @@ bool HLSLParser::ParseBlock(HLSLStatement*& firstStatement, const HLSLType& retu
         {
             return false;
         }
+        int numVariables = m_variables.GetSize();
         HLSLStatement* statement = NULL;
+        // Errors the previous statement reported without failing have been
+        // output already, so start reporting again.
+        m_tokenizer.ClearError();
         if (!ParseStatement(statement, returnType))
         {
-            return false;
+            // Drop anything the failed statement declared or scoped and carry on
+            // with the next one so later errors in the block are reported too.
+            m_variables.Resize(numVariables);
+            if (!SkipToStatementBoundary(depth))
+            {
+                return false;
+            }
+            if (m_tokenizer.GetBraceDepth() < depth)
+            {
+                return true;
+            }
+            continue;
         }
         if (statement != NULL)
         {
@@ -2091,11 +2122,13 @@ bool HLSLParser::ParseDeclarationAssignment(HLSLDeclaration* declaration)
             const char* fileName = GetFileName();
             int         line = GetLineNumber();
 
-            if(Accept(HLSLToken_Asm))
+            if(m_tokenizer.GetToken() == HLSLToken_Asm)
             {
+                //the asm text is only valid until the next token so copy it out before moving on
                 HLSLShaderObjectExpression* shaderObj = m_tree->AddNode<HLSLShaderObjectExpression>(fileName, line);
-                shaderObj->source = m_tree->AddString(m_tokenizer.GetString());
+                shaderObj->source = m_tree->AddString(m_tokenizer.GetString(), m_tokenizer.GetTokenLength());
                 declaration->assignment = shaderObj;
+                m_tokenizer.Next();
             }
             else
             {
@@ -2869,6 +2902,7 @@ bool HLSLParser::ParseSamplerState(HLSLExpression*& expression)
         return false;
     }
 
+    int depth = m_tokenizer.GetBraceDepth();
     HLSLStateAssignment* lastStateAssignment = NULL;
 
     // Parse state assignments.
@@ -2880,9 +2914,14 @@ bool HLSLParser::ParseSamplerState(HLSLExpression*& expression)
         }
 
         HLSLStateAssignment* stateAssignment = NULL;
+        m_tokenizer.ClearError();
         if (!ParseStateAssignment(stateAssignment, /*isSamplerState=*/true, /*isPipeline=*/false))
         {
-            return false;
+            if (!SkipToStatementBoundary(depth))
+            {
+                return false;
+            }
+            continue;
         }
         ASSERT(stateAssignment != NULL);
         if (lastStateAssignment == NULL)
@@ -2923,9 +2962,10 @@ bool HLSLParser::ParseTechnique(HLSLStatement*& statement)
 
     m_techniques.PushBack(technique);
 
+    int depth = m_tokenizer.GetBraceDepth();
     HLSLPass* lastPass = NULL;
 
-    // Parse state assignments.
+    // Parse passes.
     while (!Accept('}'))
     {
         if (CheckForUnexpectedEndOfStream('}'))
@@ -2934,9 +2974,14 @@ bool HLSLParser::ParseTechnique(HLSLStatement*& statement)
         }
 
         HLSLPass* pass = NULL;
+        m_tokenizer.ClearError();
         if (!ParsePass(pass))
         {
-            return false;
+            if (!SkipToStatementBoundary(depth))
+            {
+                return false;
+            }
+            continue;
         }
         ASSERT(pass != NULL);
         if (lastPass == NULL)
@@ -2976,6 +3021,7 @@ bool HLSLParser::ParsePass(HLSLPass*& pass)
     pass = m_tree->AddNode<HLSLPass>(fileName, line);
     pass->name = passName;
 
+    int depth = m_tokenizer.GetBraceDepth();
     HLSLStateAssignment* lastStateAssignment = NULL;
 
     // Parse state assignments.
@@ -2987,9 +3033,14 @@ bool HLSLParser::ParsePass(HLSLPass*& pass)
         }
 
         HLSLStateAssignment* stateAssignment = NULL;
+        m_tokenizer.ClearError();
         if (!ParseStateAssignment(stateAssignment, /*isSamplerState=*/false, /*isPipelineState=*/false))
         {
-            return false;
+            if (!SkipToStatementBoundary(depth))
+            {
+                return false;
+            }
+            continue;
         }
         ASSERT(stateAssignment != NULL);
         if (lastStateAssignment == NULL)
@@ -3025,6 +3076,7 @@ bool HLSLParser::ParsePipeline(HLSLStatement*& statement)
     HLSLPipeline* pipeline = m_tree->AddNode<HLSLPipeline>(GetFileName(), GetLineNumber());
     pipeline->name = pipelineName;
 
+    int depth = m_tokenizer.GetBraceDepth();
     HLSLStateAssignment* lastStateAssignment = NULL;
 
     // Parse state assignments.
@@ -3036,9 +3088,14 @@ bool HLSLParser::ParsePipeline(HLSLStatement*& statement)
         }
 
         HLSLStateAssignment* stateAssignment = NULL;
+        m_tokenizer.ClearError();
         if (!ParseStateAssignment(stateAssignment, /*isSamplerState=*/false, /*isPipeline=*/true))
         {
-            return false;
+            if (!SkipToStatementBoundary(depth))
+            {
+                return false;
+            }
+            continue;
         }
         ASSERT(stateAssignment != NULL);
         if (lastStateAssignment == NULL)
@@ -3060,31 +3117,20 @@ bool HLSLParser::ParsePipeline(HLSLStatement*& statement)
 
 const EffectState* GetEffectState(const char* name, bool isSamplerState, bool isPipeline)
 {
-    const EffectState* validStates = effectStates;
-    int count = sizeof(effectStates)/sizeof(effectStates[0]);
-    
-    if (isPipeline)
-    {
-        validStates = pipelineStates;
-        count = sizeof(pipelineStates) / sizeof(pipelineStates[0]);
-    }
-
     if (isSamplerState)
     {
-        validStates = samplerStates;
-        count = sizeof(samplerStates)/sizeof(samplerStates[0]);
+        size_t index = samplerStateTable.Find(name);
+        return index != samplerStateTable.NOT_FOUND ? &samplerStates[index] : NULL;
     }
 
-    // Case insensitive comparison.
-    for (int i = 0; i < count; i++)
+    if (isPipeline)
     {
-        if (String_EqualNoCase(name, validStates[i].name)) 
-        {
-            return &validStates[i];
-        }
+        size_t index = pipelineStateTable.Find(name);
+        return index != pipelineStateTable.NOT_FOUND ? &pipelineStates[index] : NULL;
     }
 
-    return NULL;
+    size_t index = effectStateTable.Find(name);
+    return index != effectStateTable.NOT_FOUND ? &effectStates[index] : NULL;
 }
 
 static const EffectStateValue* GetStateValue(const char* name, const EffectState* state)
@@ -3497,10 +3543,17 @@ bool HLSLParser::Parse(HLSLTree* tree)
 
     while (!Accept(HLSLToken_EndOfStream))
     {
+        int numVariables = m_variables.GetSize();
         HLSLStatement* statement = NULL;
+        m_tokenizer.ClearError();
         if (!ParseTopLevel(statement))
         {
-            return false;
+            // Forget any scopes or globals the failed declaration left behind and
+            // resume at the next declaration.
+            m_variables.Resize(numVariables);
+            m_numGlobals = numVariables;
+            SkipToStatementBoundary(0);
+            continue;
         }
         if (statement != NULL)
         {   
@@ -3516,7 +3569,59 @@ bool HLSLParser::Parse(HLSLTree* tree)
             while (lastStatement->nextStatement) lastStatement = lastStatement->nextStatement;
         }
     }
-    return true;
+
+    int numDiagnostics = m_tokenizer.GetDiagnosticCount();
+    for (int i = 0; i < numDiagnostics; ++i)
+    {
+        const HLSLDiagnostic& diagnostic = m_tokenizer.GetDiagnostic(i);
+        Log_Error("%s(%d,%d) : %s\n", diagnostic.fileName, diagnostic.line, diagnostic.column, diagnostic.message);
+    }
+    if (numDiagnostics >= HLSLTokenizer::s_maxDiagnostics)
+    {
+        Log_Error("Too many errors, stopping.\n");
+    }
+    if (numDiagnostics > 0)
+    {
+        Log_Error("%d error(s)\n", numDiagnostics);
+    }
+
+    return !m_tokenizer.HasErrors();
+}
+
+bool HLSLParser::SkipToStatementBoundary(int depth)
+{
+    // Make sure whatever made the caller give up gets reported.
+    char what[HLSLTokenizer::s_maxIdentifier];
+    m_tokenizer.GetTokenName(what);
+    m_tokenizer.Error("Syntax error: unexpected '%s'", what);
+
+    while (m_tokenizer.GetToken() != HLSLToken_EndOfStream && m_tokenizer.GetBraceDepth() >= depth)
+    {
+        int token      = m_tokenizer.GetToken();
+        int tokenDepth = m_tokenizer.GetBraceDepth();
+
+        // Leave the brace closing the enclosing block for the caller.
+        if (token == '}' && tokenDepth == depth && depth > 0)
+        {
+            break;
+        }
+
+        m_tokenizer.Next();
+
+        if (token == ';' && tokenDepth == depth)
+        {
+            break;
+        }
+        if (token == '}' && tokenDepth == depth + 1)
+        {
+            // Struct and cbuffer declarations end with "};".
+            Accept(';');
+            break;
+        }
+    }
+
+    m_tokenizer.ClearError();
+    return m_tokenizer.GetToken() != HLSLToken_EndOfStream;
 }
 
 bool HLSLParser::AcceptTypeModifier(int& flags)
@@ -18,7 +18,6 @@
 #include "HLSLTree.h"
 
 class Effect;
-struct _D3DXMACRO;
 
 namespace M4
 {
@@ -27,10 +26,10 @@ struct EffectState;
 
 class HLSLParser
 {
-    friend class Effect;
+    friend class ::Effect;
 public:
 
-    HLSLParser(Allocator* allocator, const char* fileName, const char* buffer, size_t length, const _D3DXMACRO* macros);
+    HLSLParser(Allocator* allocator, const char* fileName, const char* buffer, size_t length);
 
     bool Parse(HLSLTree* tree);
 
@@ -99,6 +98,13 @@ private:
 
     bool CheckForUnexpectedEndOfStream(int endToken);
 
+    /**
+     * Error recovery. Reports the current token if nothing has been reported yet, then skips
+     * past the end of the statement or declaration at the specified brace depth. Returns false
+     * if the end of the stream was reached.
+     */
+    bool SkipToStatementBoundary(int depth);
+
     const HLSLStruct* FindUserDefinedType(const char* name) const;
 
     void BeginScope();
@@ -4,8 +4,7 @@
 
 #include "HLSLTokenizer.h"
 
-#include "dx9/d3dx9.h"
-#include <fstream>
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -125,29 +124,40 @@ static bool GetIsNumberSeparator(char c)
     return c == 0 || isspace(c) || GetIsSymbol(c);
 }
 
-HLSLTokenizer::HLSLTokenizer(const char* fileName, const char* buffer, size_t length, const _D3DXMACRO* macros)
+HLSLTokenizer::HLSLTokenizer(Allocator* allocator, const char* fileName, const char* buffer, size_t length)
 {
-    ID3DXBuffer* sourceBuffer;
-    ID3DXBuffer* errorBuffer;
-    D3DXPreprocessShaderFromFileA(fileName, macros, nullptr, &sourceBuffer, &errorBuffer);
-    if(errorBuffer)
-    {
-        Log_Error((char*)errorBuffer->GetBufferPointer());
-        m_error = true;
+    m_allocator         = allocator;
+    m_fileName          = fileName;
+    m_source            = NULL;
+    m_buffer            = NULL;
+    m_bufferEnd         = NULL;
+    m_tokenStart        = NULL;
+    m_lineNumber        = 1;
+    m_tokenLineNumber   = 1;
+    m_braceDepth        = 0;
+    m_error             = false;
+    m_fatal             = false;
+    m_diagnostics       = NULL;
+    m_numDiagnostics    = 0;
+    m_token             = HLSLToken_EndOfStream;
+    m_tokenText         = "";
+    m_tokenLength       = 0;
+    m_terminator        = NULL;
+    m_terminatorChar    = 0;
+    m_lineDirectiveFileName[0] = 0;
+
+    if(!buffer)
+    {
+        m_fatal = true;
         return;
     }
 
-    m_sValueLength = 10000;
-    m_sValue = new char[m_sValueLength];
-    memset(m_sValue, 0, m_sValueLength);
-
-    m_source            = strdup((char*)sourceBuffer->GetBufferPointer());
+    // Token text is terminated in place, so work on a private copy of the source.
+    m_source            = (char*)malloc(length + 1);
+    memcpy(m_source, buffer, length);
+    m_source[length]    = 0;
     m_buffer            = m_source;
     m_bufferEnd         = m_buffer + strlen(m_buffer);
-    m_fileName          = fileName;
-    m_lineNumber        = 1;
-    m_tokenLineNumber   = 1;
-    m_error             = false;
 
     Next();
 }
@@ -156,31 +166,56 @@ HLSLTokenizer::~HLSLTokenizer()
 {
     if(m_source)
     {
-        delete[] m_source;
+        free((void*)m_source);
         m_source = nullptr;
     }
 
-    if(m_sValue)
+    if(m_diagnostics)
     {
-        delete[] m_sValue;
-        m_sValue = nullptr;
-        m_sValueLength = 0;
+        for(int i = 0; i < m_numDiagnostics; i++)
+        {
+            m_allocator->Delete((char*)m_diagnostics[i].fileName);
+            m_allocator->Delete((char*)m_diagnostics[i].message);
+        }
+        m_allocator->Delete(m_diagnostics);
+        m_diagnostics = nullptr;
     }
 }
 
 void HLSLTokenizer::Next()
 {
-	while( SkipWhitespace() || SkipComment() || ScanLineDirective() || SkipPragmaDirective())
+    // Put back the character the previous token's text was terminated over.
+    if (m_terminator != NULL)
+    {
+        *m_terminator = m_terminatorChar;
+        m_terminator = NULL;
+    }
+    m_tokenText = "";
+    m_tokenLength = 0;
+
+    // Track the nesting of the token we're leaving so the parser can find the
+    // end of the enclosing statement or declaration when recovering from an error.
+    if (m_token == '{')
+    {
+        ++m_braceDepth;
+    }
+    else if (m_token == '}' && m_braceDepth > 0)
     {
+        --m_braceDepth;
     }
 
-    if (m_error)
+    if (m_fatal)
     {
         m_token = HLSLToken_EndOfStream;
         return;
     }
 
+	while( SkipWhitespace() || SkipComment() || ScanLineDirective() || SkipPragmaDirective())
+    {
+    }
+
     m_tokenLineNumber = m_lineNumber;
+    m_tokenStart = m_buffer;
 
     if (m_buffer >= m_bufferEnd || *m_buffer == '\0')
     {
@@ -276,27 +311,28 @@ void HLSLTokenizer::Next()
         return;
     }
 
-    if(m_buffer[0] == '"' && m_buffer[-1] != '\\')
+    if(m_buffer[0] == '"')
     {
         m_buffer++;
-        while(m_buffer < m_bufferEnd && m_buffer[0] != 0)
+        while(m_buffer < m_bufferEnd && m_buffer[0] != 0 && m_buffer[0] != '"')
         {
-            if(m_buffer[0] == '"' && m_buffer[-1] != '\\')
-                break;
+            //escape sequences are kept as they are and only expanded if the parser keeps the string
+            if(m_buffer[0] == '\\' && m_buffer + 1 < m_bufferEnd)
+                ++m_buffer;
+            else if(m_buffer[0] == '\n')
+                ++m_lineNumber;
             ++m_buffer;
         }
 
-        m_token = HLSLToken_StringLiteral;
-
-        size_t length = m_buffer - (start + 1);
-        if(m_sValueLength < length)
+        if(m_buffer >= m_bufferEnd || m_buffer[0] != '"')
         {
-            delete[] m_sValue;
-            m_sValueLength = length + 1;
-            m_sValue = new char[m_sValueLength];
+            Error("Syntax error: unterminated string literal");
+            m_token = HLSLToken_EndOfStream;
+            return;
         }
-        memcpy(m_sValue, (start + 1), length);
-        m_sValue[length] = 0;
+
+        m_token = HLSLToken_StringLiteral;
+        SetTokenText(start + 1, m_buffer);
         m_buffer++;
 
         return;
@@ -308,20 +344,12 @@ void HLSLTokenizer::Next()
         ++m_buffer;
     }
 
-    size_t length = m_buffer - start;
-    memcpy(m_identifier, start, length);
-    m_identifier[length] = 0;
-    
-    if(length > s_maxIdentifier)
-    {
-        Error("Identifier name is too long! longest allowed identifier length is %d.", s_maxIdentifier);
-        return;
-    }
+    SetTokenText(start, m_buffer);
 
     const int numReservedWords = sizeof(_reservedWords) / sizeof(const char*);
     for (int i = 0; i < numReservedWords; ++i)
     {
-        if (strcmp(_reservedWords[i], m_identifier) == 0)
+        if (strcmp(_reservedWords[i], m_tokenText) == 0)
         {
             m_token = (HLSLToken)(256 + i);
             if(m_token == HLSLToken_Asm)
@@ -653,20 +681,29 @@ void HLSLTokenizer::ScanAssemblyBlock()
             m_lineNumber++;
     }
 
-    size_t length = m_buffer - (start + 1);
-    if(m_sValueLength < length)
+    if(m_buffer >= m_bufferEnd || m_buffer[0] != '}')
     {
-        delete[] m_sValue;
-        m_sValueLength = length + 1;
-        m_sValue = new char[m_sValueLength];
+        Error("Syntax error: expected '}' at the end of asm block");
+        return;
     }
-    memcpy(m_sValue, (start + 1), length);
-    m_sValue[length] = 0;
 
-    Next();
+    //skip the character following the opening brace
+    SetTokenText(m_buffer > start ? start + 1 : start, m_buffer);
+
+    //the braces enclosing the block are part of the asm token
+    m_buffer++;
     m_token = HLSLToken_Asm;
 }
 
+void HLSLTokenizer::SetTokenText(const char* start, const char* end)
+{
+    m_tokenText         = start;
+    m_tokenLength       = end - start;
+    m_terminator        = m_source + (end - m_source);
+    m_terminatorChar    = *m_terminator;
+    *m_terminator       = 0;
+}
+
 int HLSLTokenizer::GetToken() const
 {
     return m_token;
@@ -684,12 +721,17 @@ int HLSLTokenizer::GetInt() const
 
 const char* HLSLTokenizer::GetString() const
 {
-    return m_sValue;
+    return m_tokenText;
 }
 
 const char* HLSLTokenizer::GetIdentifier() const
 {
-    return m_identifier;
+    return m_tokenText;
+}
+
+size_t HLSLTokenizer::GetTokenLength() const
+{
+    return m_tokenLength;
 }
 
 int HLSLTokenizer::GetLineNumber() const
@@ -697,6 +739,11 @@ int HLSLTokenizer::GetLineNumber() const
     return m_tokenLineNumber;
 }
 
+int HLSLTokenizer::GetBraceDepth() const
+{
+    return m_braceDepth;
+}
+
 const char* HLSLTokenizer::GetFileName() const
 {
     return m_fileName;
@@ -706,22 +753,71 @@ void HLSLTokenizer::Error(const char* format, ...)
 {
     // It's not always convenient to stop executing when an error occurs,
     // so just track once we've hit an error and stop reporting them until
-    // we successfully bail out of execution.
-    if (m_error)
+    // the parser has skipped to the next statement or declaration.
+    if (m_error || m_fatal)
     {
         return;
     }
     m_error = true;
 
-
     char buffer[1024];
     va_list args;
     va_start(args, format);
     int result = vsnprintf(buffer, sizeof(buffer) - 1, format, args);
     va_end(args);
+    buffer[sizeof(buffer) - 1] = 0;
+
+    if (m_diagnostics == NULL)
+    {
+        m_diagnostics = m_allocator->New<HLSLDiagnostic>(s_maxDiagnostics);
+    }
+
+    // Errors are usually reported near the current token. Before the first
+    // token has been scanned fall back to the current position.
+    const char* position = m_tokenStart ? m_tokenStart : m_buffer;
+    int column = 1;
+    if (position != NULL)
+    {
+        for (const char* c = position; c > m_source && c[-1] != '\n'; --c)
+        {
+            ++column;
+        }
+    }
+
+    const char* fileName = m_lineDirectiveFileName[0] ? m_lineDirectiveFileName : m_fileName;
 
-    Log_Error("%s(%d) : %s\n", m_lineDirectiveFileName, m_lineNumber, buffer);
-} 
+    HLSLDiagnostic& diagnostic = m_diagnostics[m_numDiagnostics++];
+    diagnostic.fileName = strcpy(m_allocator->New<char>(strlen(fileName) + 1), fileName);
+    diagnostic.message  = strcpy(m_allocator->New<char>(strlen(buffer) + 1), buffer);
+    diagnostic.line     = position == m_tokenStart ? m_tokenLineNumber : m_lineNumber;
+    diagnostic.column   = column;
+
+    if (m_numDiagnostics == s_maxDiagnostics)
+    {
+        m_fatal = true;
+        m_token = HLSLToken_EndOfStream;
+    }
+}
+
+void HLSLTokenizer::ClearError()
+{
+    m_error = false;
+}
+
+bool HLSLTokenizer::HasErrors() const
+{
+    return m_numDiagnostics > 0 || m_fatal;
+}
+
+int HLSLTokenizer::GetDiagnosticCount() const
+{
+    return m_numDiagnostics;
+}
+
+const HLSLDiagnostic& HLSLTokenizer::GetDiagnostic(int index) const
+{
+    return m_diagnostics[index];
+}
 
 void HLSLTokenizer::GetTokenName(char buffer[s_maxIdentifier]) const
 {
@@ -735,7 +831,7 @@ void HLSLTokenizer::GetTokenName(char buffer[s_maxIdentifier]) const
     }
     else if (m_token == HLSLToken_Identifier)
     {
-        strcpy(buffer, m_identifier);
+        snprintf(buffer, s_maxIdentifier, "%s", m_tokenText);
     }
     else
     {
@@ -1,11 +1,22 @@
 #ifndef HLSL_TOKENIZER_H
 #define HLSL_TOKENIZER_H
 
-struct _D3DXMACRO;
+#include <stddef.h>
 
 namespace M4
 {
 
+class Allocator;
+
+/** A single error reported while tokenizing or parsing. */
+struct HLSLDiagnostic
+{
+    const char*     fileName;
+    int             line;
+    int             column;
+    const char*     message;
+};
+
 /** In addition to the values in this enum, all of the ASCII characters are
 valid tokens. */
 enum HLSLToken
@@ -127,8 +138,11 @@ public:
     /// Maximum string length of an identifier.
     static const int s_maxIdentifier = 255 + 1;
 
-    /** The file name is only used for error reporting. */
-    HLSLTokenizer(const char* fileName, const char* buffer, size_t length, const _D3DXMACRO* macros);
+    /// Number of errors after which tokenizing stops.
+    static const int s_maxDiagnostics = 100;
+
+    /** The buffer has to be preprocessed already. The file name is only used for error reporting. */
+    HLSLTokenizer(Allocator* allocator, const char* fileName, const char* buffer, size_t length);
     ~HLSLTokenizer();
 
     /** Advances to the next token in the stream. */
@@ -141,24 +155,42 @@ public:
     float GetFloat() const;
     int   GetInt() const;
 
+    /** Returns the raw text of the current string literal or asm block, without the
+    enclosing quotes or braces and with escape sequences left as they are. */
     const char* GetString() const;
 
     /** Returns the identifier for the current token. */
     const char* GetIdentifier() const;
 
+    /** Returns the length of the current identifier, string literal or asm block. */
+    size_t GetTokenLength() const;
+
     /** Returns the line number where the current token began. */
     int GetLineNumber() const;
 
+    /** Returns the number of unclosed '{' preceding the current token. */
+    int GetBraceDepth() const;
+
     /** Returns the file name where the current token began. */
     const char* GetFileName() const;
 
     /** Gets a human readable text description of the current token. */
     void GetTokenName(char buffer[s_maxIdentifier]) const;
 
-    /** Reports an error using printf style formatting. The current line number
-    is included. Only the first error reported will be output. */
+    /** Reports an error using printf style formatting. The file, line and column
+    of the current token are recorded with it. Further errors are ignored until
+    ClearError is called, so that one mistake doesn't produce a cascade. */
     void Error(const char* format, ...);
 
+    /** Called by the parser once it has skipped past the erroneous input. */
+    void ClearError();
+
+    /** Returns true if any error was reported or the source could not be read. */
+    bool HasErrors() const;
+
+    int GetDiagnosticCount() const;
+    const HLSLDiagnostic& GetDiagnostic(int index) const;
+
     /** Gets a human readable text description of the specified token. */
     static void GetTokenName(int token, char buffer[s_maxIdentifier]);
 
@@ -176,21 +208,33 @@ private:
     //ugly hack for reading shader object assignement because i dont wanna parse assembly
     void ScanAssemblyBlock();
 
+    /** Makes the token text a view of [start, end) in the source buffer. The character
+    at end is overwritten with a terminator until the next call to Next. */
+    void SetTokenText(const char* start, const char* end);
+
 private:
 
+    Allocator*          m_allocator;
     const char*         m_fileName;
-    const char*         m_source;
+    char*               m_source;
     const char*         m_buffer;
     const char*         m_bufferEnd;
+    const char*         m_tokenStart;
     int                 m_lineNumber;
+    int                 m_braceDepth;
     bool                m_error;
+    bool                m_fatal;
+
+    HLSLDiagnostic*     m_diagnostics;
+    int                 m_numDiagnostics;
 
     HLSLToken           m_token;
     float               m_fValue;
     int                 m_iValue;
-    char*               m_sValue;
-    size_t              m_sValueLength;
-    char                m_identifier[s_maxIdentifier];
+    const char*         m_tokenText;
+    size_t              m_tokenLength;
+    char*               m_terminator;
+    char                m_terminatorChar;
     char                m_lineDirectiveFileName[s_maxIdentifier];
     int                 m_tokenLineNumber;
 
@@ -3,6 +3,10 @@
 
 #include "HLSLTree.h"
 
+#include <ctype.h>
+#include <math.h>
+#include <string.h>
+
 namespace M4
 {
 
@@ -137,6 +141,60 @@ const char* HLSLTree::AddString(const char* string)
     return m_stringPool.AddString(string);
 }
 
+const char* HLSLTree::AddString(const char* string, size_t length)
+{
+    return m_stringPool.AddString(string, length);
+}
+
+const char* HLSLTree::AddStringLiteral(const char* string, size_t length)
+{
+    if (memchr(string, '\\', length) == NULL)
+    {
+        return m_stringPool.AddString(string, length);
+    }
+
+    char* literal = m_allocator->New<char>(length + 1);
+    size_t literalLength = 0;
+    for (size_t i = 0; i < length; ++i)
+    {
+        char c = string[i];
+        if (c == '\\' && i + 1 < length)
+        {
+            c = string[++i];
+            switch (c)
+            {
+            case 'n': c = '\n'; break;
+            case 't': c = '\t'; break;
+            case 'r': c = '\r'; break;
+            case '0': c = '\0'; break;
+            case 'x':
+                {
+                    // Up to two hex digits, the way the effect writer escapes control characters.
+                    int value = 0;
+                    int digits = 0;
+                    while (digits < 2 && i + 1 < length && isxdigit((unsigned char)string[i + 1]))
+                    {
+                        char digit = string[++i];
+                        value = value * 16 + (isdigit((unsigned char)digit) ? digit - '0' : (tolower((unsigned char)digit) - 'a' + 10));
+                        ++digits;
+                    }
+                    if (digits > 0)
+                    {
+                        c = (char)value;
+                    }
+                }
+                break;
+            }
+        }
+        literal[literalLength++] = c;
+    }
+
+    // Pooled strings end at their first null character, one in the middle would cut the literal short.
+    const char* result = memchr(literal, '\0', literalLength) == NULL ? m_stringPool.AddString(literal, literalLength) : NULL;
+    m_allocator->Delete(literal);
+    return result;
+}
+
 const char* HLSLTree::AddStringFormat(const char* format, ...)
 {
     va_list args;
@@ -906,8 +906,13 @@ public:
 
     /** Adds a string to the string pool used by the tree. */
     const char* AddString(const char* string);
+    const char* AddString(const char* string, size_t length);
     const char* AddStringFormat(const char* string, ...);
 
+    /** Adds the raw text of a string literal to the string pool, expanding any escape sequences. Returns NULL if an escape
+        sequence expands to a null character. */
+    const char* AddStringLiteral(const char* string, size_t length);
+
     /** Returns true if the string is contained within the tree. */
     bool GetContainsString(const char* string) const;
 
@@ -0,0 +1,58 @@
+#include "Effect.h"
+#include "FileStream.h"
+#include "Log.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+//whatever Effect::Validate accepts has to decode without reading past the buffer, so the validator and both decoders
+//get every input. the loaded effects are saved back to memory as well, which has to give the same bytes for both
+static std::vector<uint8_t> Save(const Effect& effect)
+{
+    std::vector<uint8_t> data;
+    OFileStream file("fuzz.fxc", data);
+    if(!effect.Save(file, effect.GetFormat()))
+        data.clear();
+    return data;
+}
+
+//touches every entry of a lazily loaded effect, backwards so later entries are decoded before the earlier ones
+static void LoadAll(const Effect& effect)
+{
+    for(uint32_t i = effect.GetTechniqueCount(); i-- > 0; )
+        effect.GetTechniqueAt(i);
+    for(uint32_t i = effect.GetParameterCount(); i-- > 0; )
+        effect.GetParameterAt(i);
+    for(uint32_t i = effect.GetGlobalParameterCount(); i-- > 0; )
+        effect.GetGlobalParameterAt(i);
+    for(uint32_t i = effect.GetVertexProgramCount(); i-- > 0; )
+        effect.GetVertexProgramAt(i);
+    for(uint32_t i = effect.GetPixelProgramCount(); i-- > 0; )
+        effect.GetPixelProgramAt(i);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    //the decoders log what they find wrong, which would only slow the fuzzer down
+    Log::Capture capture;
+
+    size_t errorOffset = 0;
+    eEffectLoadError::Enum error = Effect::Validate(data, size, &errorOffset);
+    if(error != eEffectLoadError::NONE && errorOffset > size)
+        abort();
+
+    Effect full("fuzz.fxc", data, size, eEffectLoadMode::FULL);
+    Effect lazy("fuzz.fxc", data, size, eEffectLoadMode::LAZY);
+    if(full.GetLoadError() != error || lazy.GetLoadError() != error)
+        abort();
+    if(error != eEffectLoadError::NONE)
+        return 0;
+
+    LoadAll(lazy);
+    if(Save(full) != Save(lazy))
+        abort();
+
+    return 0;
+}
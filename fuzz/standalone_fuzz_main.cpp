@@ -0,0 +1,53 @@
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+//stands in for libFuzzer when the compiler doesn't have it. runs every file named on the command line, or every file in a
+//named folder, through the fuzz target once, so the seed corpus and crash reproducers can be replayed with any compiler
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+static bool Run(const std::filesystem::path& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if(!file.good() || !file.is_open())
+    {
+        printf("unable to open \"%s\"\n", path.string().c_str());
+        return false;
+    }
+
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    LLVMFuzzerTestOneInput(data.data(), data.size());
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    uint32_t runCount = 0;
+    for(int i = 1; i < argc; i++)
+    {
+        std::filesystem::path path = argv[i];
+        if(std::filesystem::is_directory(path))
+        {
+            for(const auto& entry : std::filesystem::recursive_directory_iterator(path))
+            {
+                if(!entry.is_regular_file())
+                    continue;
+                if(!Run(entry.path()))
+                    return 1;
+                runCount++;
+            }
+        }
+        else
+        {
+            if(!Run(path))
+                return 1;
+            runCount++;
+        }
+    }
+
+    printf("ran %u inputs\n", runCount);
+    return 0;
+}
@@ -0,0 +1,320 @@
+#include "BakedEffect.h"
+#include "RenderStatePool.h"
+#include "Log.h"
+
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+//strings are pooled so names shared between parameters, programs and annotations are stored once
+class BakeStringPool
+{
+public:
+    uint32_t Add(const char* str)
+    {
+        if(!str || !*str)
+            return 0;
+
+        auto it = mOffsets.find(str);
+        if(it != mOffsets.end())
+            return it->second;
+
+        uint32_t offset = (uint32_t)mData.size();
+        mData.insert(mData.end(), str, str + strlen(str) + 1);
+        mOffsets.emplace(str, offset);
+        return offset;
+    }
+
+    //block offset of a string added before, base is where the pool starts in the block
+    uint32_t Get(const char* str, uint32_t base) const
+    {
+        if(!str || !*str)
+            return 0;
+
+        return base + mOffsets.at(str);
+    }
+
+    const std::vector<char>& GetData() const
+    {
+        return mData;
+    }
+
+private:
+    std::vector<char> mData;
+    std::unordered_map<std::string_view, uint32_t> mOffsets;
+};
+
+static inline uint64_t Align(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+//bytes of a parameter's value, matching what Parameter::Load allocates
+static inline uint32_t GetValueSize(const Parameter& param, uint32_t size, const void* value)
+{
+    if(!value)
+        return 0;
+
+    if(param.GetType() == Parameter::eType::TEXTURE)
+        return 4 * size;
+
+    return param.GetTotalSize();
+}
+
+bool BakedEffect::Bake(const Effect& effect)
+{
+    Clear();
+
+    //count everything first so the block can be allocated once
+    BakeStringPool strings;
+    uint64_t programParamCount = 0;
+    uint64_t bytecodeSize = 0;
+    uint64_t annotationCount = 0;
+    uint64_t valueSize = 0;
+    uint64_t passCount = 0;
+    RenderStatePool renderStatePool;
+    std::vector<uint32_t> passBlocks;
+
+    auto countProgram = [&](const GpuProgram& program)
+    {
+        programParamCount += program.mParams.GetCount();
+        bytecodeSize += Align(program.mShaderData.GetCapacity(), 4);
+    };
+
+    auto countParameter = [&](const Parameter& param)
+    {
+        strings.Add(param.GetName());
+        strings.Add(param.GetSemantic());
+        for(uint16_t i = 0; i < param.mAnnotationCount; i++)
+        {
+            const Annotation& annotation = param.mAnnotations[i];
+            strings.Add(annotation.mName.Get());
+            if(annotation.mType == eAnnotationType::STRING)
+                strings.Add(annotation.mValue.AsString);
+        }
+
+        annotationCount += param.mAnnotationCount;
+        valueSize += Align(GetValueSize(param, param.mSize, param.mValue.AsVoid), 16);
+    };
+
+    for(uint32_t i = 0; i < effect.GetVertexProgramCount(); i++)
+        countProgram(*effect.GetVertexProgramAt(i));
+    for(uint32_t i = 0; i < effect.GetPixelProgramCount(); i++)
+        countProgram(*effect.GetPixelProgramAt(i));
+    for(uint32_t i = 0; i < effect.GetGlobalParameterCount(); i++)
+        countParameter(*effect.GetGlobalParameterAt(i));
+    for(uint32_t i = 0; i < effect.GetParameterCount(); i++)
+        countParameter(*effect.GetParameterAt(i));
+    for(uint32_t i = 0; i < effect.GetTechniqueCount(); i++)
+    {
+        const EffectTechnique& technique = *effect.GetTechniqueAt(i);
+        strings.Add(technique.GetName());
+
+        passCount += technique.mPasses.GetCount();
+        for(const EffectPass& pass : technique.mPasses)
+            passBlocks.push_back(renderStatePool.Add(pass.mRenderStates));
+    }
+
+    //the block index has to fit the pass record
+    if(renderStatePool.GetBlockCount() > UINT16_MAX + 1)
+    {
+        Log::Error("\"%s\" has too many render state blocks to bake (%u)", effect.GetFilePath(), renderStatePool.GetBlockCount());
+        return false;
+    }
+
+    //header, fixed stride records, then the 16 byte aligned values, bytecode and strings
+    Header header {};
+    header.Magic = MAGIC;
+    uint64_t offset = sizeof(Header);
+
+    auto placeRange = [&](Range& range, uint64_t count, uint64_t stride)
+    {
+        range.Offset = (uint32_t)offset;
+        range.Count = (uint32_t)count;
+        offset += count * stride;
+    };
+
+    placeRange(header.VertexPrograms, effect.GetVertexProgramCount(), sizeof(ProgramRecord));
+    placeRange(header.PixelPrograms, effect.GetPixelProgramCount(), sizeof(ProgramRecord));
+    placeRange(header.GlobalParameters, effect.GetGlobalParameterCount(), sizeof(ParameterRecord));
+    placeRange(header.Parameters, effect.GetParameterCount(), sizeof(ParameterRecord));
+    placeRange(header.Techniques, effect.GetTechniqueCount(), sizeof(TechniqueRecord));
+    placeRange(header.RenderStateBlocks, renderStatePool.GetBlockCount(), sizeof(Range));
+
+    Range programParams, annotations, passes, renderStates;
+    placeRange(programParams, programParamCount, sizeof(ProgramParamRecord));
+    placeRange(annotations, annotationCount, sizeof(AnnotationRecord));
+    placeRange(passes, passCount, sizeof(PassRecord));
+    placeRange(renderStates, renderStatePool.GetStates().size(), sizeof(RenderState));
+
+    uint64_t valueOffset = Align(offset, 16);
+    uint64_t bytecodeOffset = valueOffset + valueSize;
+    uint64_t stringOffset = bytecodeOffset + bytecodeSize;
+    uint64_t totalSize = stringOffset + strings.GetData().size();
+    if(totalSize > UINT32_MAX)
+    {
+        Log::Error("\"%s\" is too large to bake (%llu bytes)", effect.GetFilePath(), (unsigned long long)totalSize);
+        return false;
+    }
+
+    header.Size = (uint32_t)totalSize;
+    mSize = (uint32_t)totalSize;
+    mData = new uint8_t[mSize];
+    memset(mData, 0, mSize);
+    memcpy(mData, &header, sizeof(Header));
+    if(!strings.GetData().empty())
+        memcpy(mData + stringOffset, strings.GetData().data(), strings.GetData().size());
+    if(renderStates.Count)
+        memcpy(mData + renderStates.Offset, renderStatePool.GetStates().data(), renderStates.Count * sizeof(RenderState));
+
+    Range* renderStateBlocks = (Range*)(mData + header.RenderStateBlocks.Offset);
+    for(uint32_t i = 0; i < header.RenderStateBlocks.Count; i++)
+    {
+        const RenderStatePool::Block& block = renderStatePool.GetBlock(i);
+        renderStateBlocks[i] = {renderStates.Offset + block.Offset * (uint32_t)sizeof(RenderState), block.Count};
+    }
+
+    //fill the records, every cursor walks its own section
+    uint32_t stringBase = (uint32_t)stringOffset;
+    uint32_t nextProgramParam = programParams.Offset;
+    uint32_t nextAnnotation = annotations.Offset;
+    uint32_t nextPass = passes.Offset;
+    uint32_t nextPassBlock = 0;
+    uint32_t nextValue = (uint32_t)valueOffset;
+    uint32_t nextBytecode = (uint32_t)bytecodeOffset;
+
+    auto bakeProgram = [&](const GpuProgram& program, ProgramRecord& record)
+    {
+        record.NameHash = program.mNameHash;
+        record.Params = {nextProgramParam, program.mParams.GetCount()};
+        for(const GpuProgram::Param& param : program.mParams)
+        {
+            ProgramParamRecord& paramRecord = *(ProgramParamRecord*)(mData + nextProgramParam);
+            paramRecord.Type = param.mType;
+            paramRecord.Unknown = param.mUnknown;
+            paramRecord.RegisterIndex = param.mRegisterIndex;
+            paramRecord.NameHash = param.mName.GetHash();
+            nextProgramParam += sizeof(ProgramParamRecord);
+        }
+
+        record.BytecodeSize = program.mShaderData.GetCapacity();
+        if(record.BytecodeSize)
+        {
+            record.Bytecode = nextBytecode;
+            memcpy(mData + nextBytecode, &program.mShaderData[0], record.BytecodeSize);
+            nextBytecode += (uint32_t)Align(record.BytecodeSize, 4);
+        }
+    };
+
+    auto bakeParameter = [&](const Parameter& param, ParameterRecord& record)
+    {
+        record.Type = param.mType;
+        record.Count = param.mCount;
+        record.Size = param.mSize;
+        record.AnnotationCount = param.mAnnotationCount;
+        record.Name = strings.Get(param.GetName(), stringBase);
+        record.Semantic = strings.Get(param.GetSemantic(), stringBase);
+        record.NameHash = param.GetNameHash();
+        record.SemanticHash = param.GetSemanticHash();
+
+        record.Annotations = nextAnnotation;
+        for(uint16_t i = 0; i < param.mAnnotationCount; i++)
+        {
+            const Annotation& annotation = param.mAnnotations[i];
+            AnnotationRecord& annotationRecord = *(AnnotationRecord*)(mData + nextAnnotation);
+            annotationRecord.Name = strings.Get(annotation.mName.Get(), stringBase);
+            annotationRecord.Type = annotation.mType;
+            if(annotation.mType == eAnnotationType::STRING)
+                annotationRecord.Value = strings.Get(annotation.mValue.AsString, stringBase);
+            else
+                annotationRecord.Value = (uint32_t)annotation.mValue.AsInt;
+            nextAnnotation += sizeof(AnnotationRecord);
+        }
+
+        record.ValueSize = GetValueSize(param, param.mSize, param.mValue.AsVoid);
+        if(record.ValueSize)
+        {
+            record.Value = nextValue;
+            memcpy(mData + nextValue, param.mValue.AsVoid, record.ValueSize);
+            nextValue += (uint32_t)Align(record.ValueSize, 16);
+        }
+    };
+
+    ProgramRecord* vertexPrograms = (ProgramRecord*)(mData + header.VertexPrograms.Offset);
+    for(uint32_t i = 0; i < header.VertexPrograms.Count; i++)
+        bakeProgram(*effect.GetVertexProgramAt(i), vertexPrograms[i]);
+
+    ProgramRecord* pixelPrograms = (ProgramRecord*)(mData + header.PixelPrograms.Offset);
+    for(uint32_t i = 0; i < header.PixelPrograms.Count; i++)
+        bakeProgram(*effect.GetPixelProgramAt(i), pixelPrograms[i]);
+
+    ParameterRecord* globalParameters = (ParameterRecord*)(mData + header.GlobalParameters.Offset);
+    for(uint32_t i = 0; i < header.GlobalParameters.Count; i++)
+        bakeParameter(*effect.GetGlobalParameterAt(i), globalParameters[i]);
+
+    ParameterRecord* parameters = (ParameterRecord*)(mData + header.Parameters.Offset);
+    for(uint32_t i = 0; i < header.Parameters.Count; i++)
+        bakeParameter(*effect.GetParameterAt(i), parameters[i]);
+
+    TechniqueRecord* techniques = (TechniqueRecord*)(mData + header.Techniques.Offset);
+    for(uint32_t i = 0; i < header.Techniques.Count; i++)
+    {
+        const EffectTechnique& technique = *effect.GetTechniqueAt(i);
+        TechniqueRecord& record = techniques[i];
+        record.Name = strings.Get(technique.GetName(), stringBase);
+        record.NameHash = technique.GetNameHash();
+        record.Passes = {nextPass, technique.mPasses.GetCount()};
+
+        for(const EffectPass& pass : technique.mPasses)
+        {
+            PassRecord& passRecord = *(PassRecord*)(mData + nextPass);
+            passRecord.VertexProgramIndex = pass.mVertexProgramIndex;
+            passRecord.PixelProgramIndex = pass.mPixelProgramIndex;
+            passRecord.RenderStateBlock = (uint16_t)passBlocks[nextPassBlock];
+            passRecord.RenderStates = renderStateBlocks[passBlocks[nextPassBlock]];
+
+            nextPass += sizeof(PassRecord);
+            nextPassBlock++;
+        }
+    }
+
+    assert(nextProgramParam == programParams.Offset + programParams.Count * sizeof(ProgramParamRecord));
+    assert(nextPassBlock == passBlocks.size());
+    assert(nextValue == bytecodeOffset && nextBytecode == stringOffset);
+    return true;
+}
+
+void BakedEffect::Clear()
+{
+    if(mData)
+    {
+        delete[] mData;
+        mData = nullptr;
+    }
+
+    mSize = 0;
+}
+
+const BakedEffect::ParameterRecord* BakedEffect::FindParameterByHash(uint32_t hash) const
+{
+    for(uint32_t i = 0; i < GetParameterCount(); i++)
+    {
+        const ParameterRecord& param = GetParameterAt(i);
+        if(param.NameHash == hash || param.SemanticHash == hash)
+            return &param;
+    }
+
+    return nullptr;
+}
+
+const BakedEffect::ParameterRecord* BakedEffect::FindGlobalParameterByHash(uint32_t hash) const
+{
+    for(uint32_t i = 0; i < GetGlobalParameterCount(); i++)
+    {
+        const ParameterRecord& param = GetGlobalParameterAt(i);
+        if(param.NameHash == hash || param.SemanticHash == hash)
+            return &param;
+    }
+
+    return nullptr;
+}
@@ -0,0 +1,208 @@
+#pragma once
+#include "Effect.h"
+
+#include <cstdint>
+
+//a loaded Effect flattened into a single allocation. records have a fixed stride and point at their strings, values, bytecode
+//and child records with 32 bit offsets from the start of the block, so the block can be copied or kept resident as is.
+//offset 0 is the header, a string offset of 0 means the string is empty.
+//render states are baked in canonical order and pooled, passes that end up with the same states share one block.
+class BakedEffect
+{
+public:
+    struct Range
+    {
+        uint32_t Offset;
+        uint32_t Count;
+    };
+
+    struct Header
+    {
+        uint32_t Magic;
+        uint32_t Size;
+        Range VertexPrograms;
+        Range PixelPrograms;
+        Range GlobalParameters;
+        Range Parameters;
+        Range Techniques;
+        //Range records, one per distinct render state block
+        Range RenderStateBlocks;
+    };
+
+    struct ProgramParamRecord
+    {
+        Parameter::eType::Enum Type;
+        uint8_t Unknown;
+        uint16_t RegisterIndex;
+        uint32_t NameHash;
+    };
+
+    struct ProgramRecord
+    {
+        uint32_t NameHash;
+        Range Params;
+        uint32_t Bytecode;
+        uint32_t BytecodeSize;
+    };
+
+    struct AnnotationRecord
+    {
+        uint32_t Name;
+        eAnnotationType::Enum Type;
+        //the int or float itself, string offset for strings
+        uint32_t Value;
+    };
+
+    struct ParameterRecord
+    {
+        Parameter::eType::Enum Type;
+        uint8_t Padding;
+        uint16_t Count;
+        uint32_t Size;
+        uint32_t AnnotationCount;
+        uint32_t Name;
+        uint32_t Semantic;
+        uint32_t NameHash;
+        uint32_t SemanticHash;
+        uint32_t Annotations;
+        uint32_t Value;
+        uint32_t ValueSize;
+    };
+
+    struct PassRecord
+    {
+        uint16_t VertexProgramIndex;
+        uint16_t PixelProgramIndex;
+        //passes with the same block set the same states, sorting draws by it avoids redundant state changes
+        uint16_t RenderStateBlock;
+        uint16_t Padding;
+        //the states of that block
+        Range RenderStates;
+    };
+
+    struct TechniqueRecord
+    {
+        uint32_t Name;
+        uint32_t NameHash;
+        Range Passes;
+    };
+
+    static constexpr uint32_t MAGIC = (uint32_t)'bxgr';
+
+    BakedEffect() : mData(nullptr), mSize(0)
+    {}
+
+    ~BakedEffect()
+    {
+        Clear();
+    }
+
+    BakedEffect(const BakedEffect&) = delete;
+    BakedEffect& operator=(const BakedEffect&) = delete;
+
+    //returns false if the effect doesn't fit in 32 bit offsets
+    bool Bake(const Effect& effect);
+    void Clear();
+
+    const uint8_t* GetData() const
+    {
+        return mData;
+    }
+    uint32_t GetSize() const
+    {
+        return mSize;
+    }
+
+    uint32_t GetVertexProgramCount() const
+    {
+        return mData ? GetHeader().VertexPrograms.Count : 0;
+    }
+    const ProgramRecord& GetVertexProgramAt(uint32_t index) const
+    {
+        return GetRecord<ProgramRecord>(GetHeader().VertexPrograms, index);
+    }
+
+    uint32_t GetPixelProgramCount() const
+    {
+        return mData ? GetHeader().PixelPrograms.Count : 0;
+    }
+    const ProgramRecord& GetPixelProgramAt(uint32_t index) const
+    {
+        return GetRecord<ProgramRecord>(GetHeader().PixelPrograms, index);
+    }
+
+    uint32_t GetGlobalParameterCount() const
+    {
+        return mData ? GetHeader().GlobalParameters.Count : 0;
+    }
+    const ParameterRecord& GetGlobalParameterAt(uint32_t index) const
+    {
+        return GetRecord<ParameterRecord>(GetHeader().GlobalParameters, index);
+    }
+
+    uint32_t GetParameterCount() const
+    {
+        return mData ? GetHeader().Parameters.Count : 0;
+    }
+    const ParameterRecord& GetParameterAt(uint32_t index) const
+    {
+        return GetRecord<ParameterRecord>(GetHeader().Parameters, index);
+    }
+
+    uint32_t GetTechniqueCount() const
+    {
+        return mData ? GetHeader().Techniques.Count : 0;
+    }
+    const TechniqueRecord& GetTechniqueAt(uint32_t index) const
+    {
+        return GetRecord<TechniqueRecord>(GetHeader().Techniques, index);
+    }
+
+    uint32_t GetRenderStateBlockCount() const
+    {
+        return mData ? GetHeader().RenderStateBlocks.Count : 0;
+    }
+    const Range& GetRenderStateBlockAt(uint32_t index) const
+    {
+        return GetRecord<Range>(GetHeader().RenderStateBlocks, index);
+    }
+
+    //name or semantic hash, like Effect::FindParameterByHash
+    const ParameterRecord* FindParameterByHash(uint32_t hash) const;
+    const ParameterRecord* FindGlobalParameterByHash(uint32_t hash) const;
+
+    //child records of a record above
+    template<typename T>
+    const T& GetRecord(const Range& range, uint32_t index) const
+    {
+        assert(index < range.Count);
+        return ((const T*)(mData + range.Offset))[index];
+    }
+
+    const char* GetString(uint32_t offset) const
+    {
+        return offset ? (const char*)mData + offset : "";
+    }
+
+    const void* GetBlob(uint32_t offset) const
+    {
+        return offset ? mData + offset : nullptr;
+    }
+
+private:
+    const Header& GetHeader() const
+    {
+        return *(const Header*)mData;
+    }
+
+    uint8_t* mData;
+    uint32_t mSize;
+};
+
+ASSERT_SIZE(BakedEffect::Header, 0x38);
+ASSERT_SIZE(BakedEffect::ProgramParamRecord, 0x8);
+ASSERT_SIZE(BakedEffect::ProgramRecord, 0x14);
+ASSERT_SIZE(BakedEffect::AnnotationRecord, 0xC);
+ASSERT_SIZE(BakedEffect::ParameterRecord, 0x28);
+ASSERT_SIZE(BakedEffect::PassRecord, 0x10);
+ASSERT_SIZE(BakedEffect::TechniqueRecord, 0x10);
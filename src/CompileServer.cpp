@@ -0,0 +1,387 @@
+#include "CompileServer.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <afunix.h>
+#include <io.h>
+
+using Socket = SOCKET;
+#define CLOSE_SOCKET closesocket
+#define DUP _dup
+#define DUP2 _dup2
+#define CLOSE_FILE _close
+#define FILENO _fileno
+#define SEND_FLAGS 0
+#else
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using Socket = int;
+static constexpr Socket INVALID_SOCKET = -1;
+#define CLOSE_SOCKET close
+#define DUP dup
+#define DUP2 dup2
+#define CLOSE_FILE close
+#define FILENO fileno
+//a client that goes away mid reply shouldn't take the server down with it
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+#endif
+
+#include "Log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//every message is a dword count followed by that many length prefixed strings.
+//a request holds the client's working directory then the arguments, the reply holds the output then the exit code as text
+static constexpr uint32_t PROTOCOL_MAGIC = (uint32_t)'fxds';
+static constexpr uint32_t MAX_STRING_COUNT = 4096;
+static constexpr uint32_t MAX_STRING_LENGTH = 64 << 20;
+//a client that stops sending or reading is dropped after this long instead of holding on to its connection for good
+static constexpr uint32_t CLIENT_TIMEOUT_SECONDS = 30;
+//connections past this many are closed right away, each one waiting for its turn keeps a thread
+static constexpr uint32_t MAX_CLIENT_COUNT = 64;
+
+static bool SendAll(Socket socket, const void* data, size_t size)
+{
+    const char* bytes = (const char*)data;
+    while(size)
+    {
+        int sent = send(socket, bytes, (int)std::min<size_t>(size, 1 << 20), SEND_FLAGS);
+        if(sent <= 0)
+            return false;
+
+        bytes += sent;
+        size -= sent;
+    }
+
+    return true;
+}
+
+static bool ReceiveAll(Socket socket, void* data, size_t size)
+{
+    char* bytes = (char*)data;
+    while(size)
+    {
+        int received = recv(socket, bytes, (int)std::min<size_t>(size, 1 << 20), 0);
+        if(received <= 0)
+            return false;
+
+        bytes += received;
+        size -= received;
+    }
+
+    return true;
+}
+
+static bool SendStrings(Socket socket, const std::vector<std::string>& strings)
+{
+    uint32_t header[2] = {PROTOCOL_MAGIC, (uint32_t)strings.size()};
+    if(!SendAll(socket, header, sizeof(header)))
+        return false;
+
+    for(const std::string& string : strings)
+    {
+        uint32_t length = (uint32_t)string.size();
+        if(!SendAll(socket, &length, sizeof(length)) || !SendAll(socket, string.data(), length))
+            return false;
+    }
+
+    return true;
+}
+
+static bool ReceiveStrings(Socket socket, std::vector<std::string>& strings)
+{
+    uint32_t header[2];
+    if(!ReceiveAll(socket, header, sizeof(header)) || header[0] != PROTOCOL_MAGIC || header[1] > MAX_STRING_COUNT)
+        return false;
+
+    strings.resize(header[1]);
+    for(std::string& string : strings)
+    {
+        uint32_t length;
+        if(!ReceiveAll(socket, &length, sizeof(length)) || length > MAX_STRING_LENGTH)
+            return false;
+
+        string.resize(length);
+        if(length && !ReceiveAll(socket, string.data(), length))
+            return false;
+    }
+
+    return true;
+}
+
+static bool InitSockets()
+{
+#ifdef _WIN32
+    WSADATA data;
+    return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+#else
+    return true;
+#endif
+}
+
+static void SetTimeouts(Socket socket)
+{
+#ifdef _WIN32
+    DWORD timeout = CLIENT_TIMEOUT_SECONDS * 1000;
+#else
+    timeval timeout = {CLIENT_TIMEOUT_SECONDS, 0};
+#endif
+    setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+    setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
+}
+
+static bool IsSocketFile(const char* path)
+{
+#ifdef _WIN32
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA(path, &data);
+    if(find == INVALID_HANDLE_VALUE)
+        return false;
+
+    FindClose(find);
+    return (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) && data.dwReserved0 == IO_REPARSE_TAG_AF_UNIX;
+#else
+    struct stat info;
+    return lstat(path, &info) == 0 && S_ISSOCK(info.st_mode);
+#endif
+}
+
+static bool MakeAddress(const char* socketPath, sockaddr_un& address)
+{
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(strlen(socketPath) >= sizeof(address.sun_path))
+    {
+        Log::Error("socket path \"%s\" is too long", socketPath);
+        return false;
+    }
+
+    strcpy(address.sun_path, socketPath);
+    return true;
+}
+
+//points stdout at a temporary file for the length of a job so everything it prints, Log and printf alike, can be sent back
+class OutputCapture
+{
+public:
+    OutputCapture() : mFile(tmpfile()), mSavedStdout(-1)
+    {
+        if(!mFile)
+            return;
+
+        fflush(stdout);
+        mSavedStdout = DUP(FILENO(stdout));
+        DUP2(FILENO(mFile), FILENO(stdout));
+    }
+
+    ~OutputCapture()
+    {
+        Restore();
+        if(mFile)
+            fclose(mFile);
+    }
+
+    std::string Finish()
+    {
+        Restore();
+        if(!mFile)
+            return {};
+
+        std::string output;
+        fseek(mFile, 0, SEEK_END);
+        output.resize(ftell(mFile));
+        fseek(mFile, 0, SEEK_SET);
+        output.resize(fread(output.data(), 1, output.size(), mFile));
+        return output;
+    }
+
+private:
+    void Restore()
+    {
+        if(mSavedStdout == -1)
+            return;
+
+        fflush(stdout);
+        DUP2(mSavedStdout, FILENO(stdout));
+        CLOSE_FILE(mSavedStdout);
+        mSavedStdout = -1;
+    }
+
+    FILE* mFile;
+    int mSavedStdout;
+};
+
+//jobs change the working directory and capture stdout, both shared by the whole process, so they run one at a time under
+//jobMutex. the request is received before taking it, a client that connects and stalls only holds up itself
+static void ServeJob(Socket client, const CompileServer::JobFunc& job, std::mutex& jobMutex)
+{
+    std::vector<std::string> request;
+    bool received = ReceiveStrings(client, request) && !request.empty();
+
+    std::unique_lock lock(jobMutex);
+    if(!received)
+    {
+        Log::Warn("dropped a malformed job");
+        return;
+    }
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    std::error_code error;
+    std::filesystem::path serverFolder = std::filesystem::current_path(error);
+
+    std::vector<CString> args;
+    std::string commandLine;
+    for(size_t i = 1; i < request.size(); i++)
+    {
+        args.emplace_back(request[i].c_str());
+        commandLine += i > 1 ? " " + request[i] : request[i];
+    }
+
+    int32_t exitCode = 1;
+    std::string output;
+    {
+        OutputCapture capture;
+        std::filesystem::current_path(request[0], error);
+        if(error)
+            Log::Error("unable to enter the client's working directory \"%s\"", request[0].c_str());
+        else
+            exitCode = job(args);
+
+        output = capture.Finish();
+    }
+    std::filesystem::current_path(serverFolder, error);
+    lock.unlock();
+
+    bool sent = SendStrings(client, {output, std::to_string(exitCode)});
+
+    lock.lock();
+    if(!sent)
+        Log::Warn("the client went away before the result of \"%s\" was sent", commandLine.c_str());
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1);
+    Log::Info("%s (exit code %d, took %lldms)", commandLine.c_str(), exitCode, ms.count());
+}
+
+bool CompileServer::Run(const char* socketPath, const JobFunc& job)
+{
+    sockaddr_un address;
+    if(!InitSockets() || !MakeAddress(socketPath, address))
+        return false;
+
+    //a server that didn't shut down cleanly leaves its socket file behind, anything else at the path is left alone
+    std::error_code error;
+    if(IsSocketFile(socketPath))
+    {
+        std::filesystem::remove(socketPath, error);
+    }
+    else if(std::filesystem::exists(socketPath, error))
+    {
+        Log::Error("\"%s\" already exists and isn't a socket", socketPath);
+        return false;
+    }
+
+    Socket server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(server == INVALID_SOCKET)
+    {
+        Log::Error("unable to create a socket");
+        return false;
+    }
+
+    if(bind(server, (const sockaddr*)&address, sizeof(address)) != 0 || listen(server, 16) != 0)
+    {
+        Log::Error("unable to listen on \"%s\"", socketPath);
+        CLOSE_SOCKET(server);
+        return false;
+    }
+
+    //shared with the client threads, which are detached
+    struct State
+    {
+        std::mutex JobMutex;
+        std::atomic<uint32_t> ClientCount = 0;
+    };
+    std::shared_ptr<State> state = std::make_shared<State>();
+
+    Log::Info("compile server listening on \"%s\"", socketPath);
+    while(true)
+    {
+        Socket client = accept(server, nullptr, nullptr);
+        if(client == INVALID_SOCKET)
+        {
+            //running out of file descriptors doesn't go away by trying again right away
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            continue;
+        }
+
+        if(state->ClientCount >= MAX_CLIENT_COUNT)
+        {
+            CLOSE_SOCKET(client);
+            continue;
+        }
+
+        SetTimeouts(client);
+        state->ClientCount++;
+        std::thread([client, &job, state]()
+        {
+            ServeJob(client, job, state->JobMutex);
+            CLOSE_SOCKET(client);
+            state->ClientCount--;
+        }).detach();
+    }
+}
+
+bool CompileServer::Forward(const char* socketPath, std::span<const CString> args, int32_t& exitCode)
+{
+    sockaddr_un address;
+    if(!InitSockets() || !MakeAddress(socketPath, address))
+        return false;
+
+    Socket server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(server == INVALID_SOCKET || connect(server, (const sockaddr*)&address, sizeof(address)) != 0)
+    {
+        Log::Error("no compile server is listening on \"%s\"", socketPath);
+        if(server != INVALID_SOCKET)
+            CLOSE_SOCKET(server);
+        return false;
+    }
+
+    std::error_code error;
+    std::vector<std::string> request;
+    request.push_back(std::filesystem::current_path(error).string());
+    for(const CString& arg : args)
+        request.push_back(arg.Get());
+
+    //no timeouts here, the reply only comes once every job queued before this one is done
+    std::vector<std::string> reply;
+    bool result = SendStrings(server, request) && ReceiveStrings(server, reply) && reply.size() == 2;
+    CLOSE_SOCKET(server);
+
+    if(!result)
+    {
+        Log::Error("the compile server on \"%s\" didn't answer", socketPath);
+        return false;
+    }
+
+    fwrite(reply[0].data(), 1, reply[0].size(), stdout);
+    exitCode = atoi(reply[1].c_str());
+    return true;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "CString.h"
+
+#include <cstdint>
+#include <functional>
+#include <span>
+
+//keeps one fxdc process and its compiler backend warm between jobs. a job is a command line sent over a unix domain socket,
+//jobs run one at a time in the working directory of the client that sent them and the client gets back everything the job printed.
+//every connection is received on its own thread so a client that stalls is dropped after a timeout without holding up the others.
+//what stays warm is the backend and the results it has cached in memory, parsed headers and parser arenas are made per job
+//because the preprocessor inlines headers before parsing and the hlslparser allocator can't be reset
+class CompileServer
+{
+public:
+    //runs a command line and returns its exit code
+    using JobFunc = std::function<int32_t(std::span<CString> args)>;
+
+    //serves jobs until the process is stopped, returns false if the socket can't be set up
+    static bool Run(const char* socketPath, const JobFunc& job);
+
+    //sends a command line to the server listening on socketPath and prints what the job printed.
+    //returns false if no server answered
+    static bool Forward(const char* socketPath, std::span<const CString> args, int32_t& exitCode);
+};
@@ -0,0 +1,837 @@
+#include "CompilerBackend.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include "dx9/d3dx9.h"
+
+static void TakeBuffer(ID3DXBuffer* buffer, CString& string)
+{
+    if(!buffer)
+        return;
+
+    CString text = {(uint32_t)buffer->GetBufferSize() + 1};
+    memcpy(text.Get(), buffer->GetBufferPointer(), buffer->GetBufferSize());
+    string = text;
+    buffer->Release();
+}
+
+static void TakeBuffer(ID3DXBuffer* buffer, ShaderBytecode& bytecode)
+{
+    if(!buffer)
+        return;
+
+    bytecode = {(uint32_t)buffer->GetBufferSize()};
+    memcpy(&bytecode[0], buffer->GetBufferPointer(), buffer->GetBufferSize());
+    buffer->Release();
+}
+
+//d3dx hands the include callback the data of the including file rather than its name
+class D3DXIncludeAdapter : public ID3DXInclude
+{
+public:
+    D3DXIncludeAdapter(ShaderIncludeHandler& handler, const char* fileName) : mHandler(handler), mFileName(fileName)
+    {}
+
+    STDMETHOD(Open)(D3DXINCLUDE_TYPE includeType, LPCSTR fileName, LPCVOID parentData, LPCVOID* data, UINT* size) override
+    {
+        auto parent = mNames.find(parentData);
+        const char* parentName = parent != mNames.end() ? parent->second.c_str() : mFileName;
+
+        const char* fileData = nullptr;
+        size_t fileSize = 0;
+        if(!mHandler.Open(includeType == D3DXINC_SYSTEM, fileName, parentName, fileData, fileSize))
+            return E_FAIL;
+
+        mNames[fileData] = fileName;
+        *data = fileData;
+        *size = (UINT)fileSize;
+        return S_OK;
+    }
+
+    STDMETHOD(Close)(LPCVOID data) override
+    {
+        mNames.erase(data);
+        mHandler.Close((const char*)data);
+        return S_OK;
+    }
+
+private:
+    ShaderIncludeHandler& mHandler;
+    const char* mFileName;
+    std::unordered_map<LPCVOID, std::string> mNames;
+};
+
+class D3DXCompilerBackend : public CompilerBackend
+{
+public:
+    D3DXCompilerBackend()
+    {
+        LoadLibraryW(L"D3DCompiler_43.dll");
+    }
+
+    const char* GetName() const override
+    {
+        return "d3dx";
+    }
+
+    bool Preprocess(const char* filePath, const ShaderMacro* macros, CString& source, CString& messages) override
+    {
+        ID3DXBuffer* sourceBuffer = nullptr;
+        ID3DXBuffer* errorBuffer = nullptr;
+        HRESULT hr = D3DXPreprocessShaderFromFileA(filePath, (const D3DXMACRO*)macros, nullptr, &sourceBuffer, &errorBuffer);
+        TakeBuffer(errorBuffer, messages);
+        TakeBuffer(sourceBuffer, source);
+
+        return SUCCEEDED(hr) && source.Get();
+    }
+
+    bool PreprocessSource(const char* fileName, const char* data, size_t length, const ShaderMacro* macros, ShaderIncludeHandler* includes,
+                          CString& source, CString& messages) override
+    {
+        std::unique_ptr<D3DXIncludeAdapter> adapter;
+        if(includes)
+            adapter = std::make_unique<D3DXIncludeAdapter>(*includes, fileName);
+
+        ID3DXBuffer* sourceBuffer = nullptr;
+        ID3DXBuffer* errorBuffer = nullptr;
+        HRESULT hr = D3DXPreprocessShader(data, (UINT)length, (const D3DXMACRO*)macros, adapter.get(), &sourceBuffer, &errorBuffer);
+        TakeBuffer(errorBuffer, messages);
+        TakeBuffer(sourceBuffer, source);
+
+        return SUCCEEDED(hr) && source.Get();
+    }
+
+    bool Compile(const char* source, size_t length, const char* entryPoint, const char* profile, uint32_t flags, ShaderBytecode& bytecode, CString& messages) override
+    {
+        ID3DXBuffer* shaderBuffer = nullptr;
+        ID3DXBuffer* errorBuffer = nullptr;
+        HRESULT hr = D3DXCompileShader(source, (UINT)length, nullptr, nullptr, entryPoint, profile, flags, &shaderBuffer, &errorBuffer, nullptr);
+        TakeBuffer(errorBuffer, messages);
+        TakeBuffer(shaderBuffer, bytecode);
+
+        return SUCCEEDED(hr);
+    }
+
+    bool Assemble(const char* source, size_t length, ShaderBytecode& bytecode, CString& messages) override
+    {
+        ID3DXBuffer* shaderBuffer = nullptr;
+        ID3DXBuffer* errorBuffer = nullptr;
+        HRESULT hr = D3DXAssembleShader(source, (UINT)length, nullptr, nullptr, 0, &shaderBuffer, &errorBuffer);
+        TakeBuffer(errorBuffer, messages);
+        TakeBuffer(shaderBuffer, bytecode);
+
+        return SUCCEEDED(hr);
+    }
+
+    bool Disassemble(const ShaderBytecode& bytecode, CString& disassembly) override
+    {
+        if(!bytecode.GetCapacity())
+            return false;
+
+        ID3DXBuffer* disasmBuffer = nullptr;
+        HRESULT hr = D3DXDisassembleShader((const DWORD*)&bytecode[0], FALSE, nullptr, &disasmBuffer);
+        TakeBuffer(disasmBuffer, disassembly);
+
+        return SUCCEEDED(hr);
+    }
+};
+#endif //_WIN32
+
+
+//FNV-1a over every input that affects the result of a call
+class CacheKey
+{
+public:
+    CacheKey(const char* operation) : mHash(0xCBF29CE484222325ull)
+    {
+        Add(operation);
+    }
+
+    void Add(const void* data, size_t size)
+    {
+        const uint8_t* bytes = (const uint8_t*)data;
+        for(size_t i = 0; i < size; i++)
+        {
+            mHash ^= bytes[i];
+            mHash *= 0x100000001B3ull;
+        }
+    }
+
+    void Add(const char* string)
+    {
+        //include the terminator so consecutive strings can't run into each other
+        if(!string)
+            string = "";
+        Add(string, strlen(string) + 1);
+    }
+
+    void Add(uint32_t value)
+    {
+        Add(&value, sizeof(value));
+    }
+
+    void Add(const ShaderMacro* macros)
+    {
+        for(; macros && macros->Name; macros++)
+        {
+            Add(macros->Name);
+            Add(macros->Definition);
+        }
+    }
+
+    uint64_t Get() const
+    {
+        return mHash;
+    }
+
+private:
+    uint64_t mHash;
+};
+
+//serves results recorded in a cache folder, one file per call keyed by a hash of its inputs.
+//when given a recorder every call is forwarded to it and its result is written to the cache instead.
+//files are keyed by their path relative to the folder that holds the cache, with forward slashes and in lower case, so a
+//recording replays from any working directory, on any os and after the tree is moved along with its cache
+class ReplayCompilerBackend : public CompilerBackend
+{
+public:
+    //the folder is made absolute so it stays the same when the working directory changes
+    ReplayCompilerBackend(const char* cacheFolder, std::unique_ptr<CompilerBackend> recorder) : mCacheFolder(std::filesystem::absolute(cacheFolder).lexically_normal()),
+                                                                                               mRecorder(std::move(recorder))
+    {
+        //a trailing separator leaves an empty file name
+        if(!mCacheFolder.has_filename())
+            mCacheFolder = mCacheFolder.parent_path();
+        mRoot = NormalizePath(mCacheFolder.parent_path().string());
+
+        if(mRecorder)
+        {
+            std::error_code error;
+            std::filesystem::create_directories(mCacheFolder, error);
+        }
+    }
+
+    const char* GetName() const override
+    {
+        return mRecorder ? "record" : "replay";
+    }
+
+    bool Preprocess(const char* filePath, const ShaderMacro* macros, CString& source, CString& messages) override
+    {
+        //includes aren't part of the key, so a recording has to be redone when only an included file changes
+        std::ifstream file(filePath, std::ios::binary);
+        if(!file.good() || !file.is_open())
+        {
+            messages = CString("unable to open file ", filePath);
+            return false;
+        }
+        std::vector<char> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        CacheKey key("preprocess");
+        key.Add(GetPathKey(filePath).c_str());
+        key.Add(contents.data(), contents.size());
+        key.Add(macros);
+
+        return ProcessText(key, filePath, source, messages, [&]()
+        {
+            return mRecorder->Preprocess(filePath, macros, source, messages);
+        });
+    }
+
+    bool PreprocessSource(const char* fileName, const char* data, size_t length, const ShaderMacro* macros, ShaderIncludeHandler* includes,
+                          CString& source, CString& messages) override
+    {
+        //same as files, what the include handler serves isn't part of the key
+        CacheKey key("preprocess source");
+        key.Add(NormalizePath(fileName).c_str());
+        key.Add(data, length);
+        key.Add(macros);
+
+        return ProcessText(key, fileName, source, messages, [&]()
+        {
+            return mRecorder->PreprocessSource(fileName, data, length, macros, includes, source, messages);
+        });
+    }
+
+    bool Compile(const char* source, size_t length, const char* entryPoint, const char* profile, uint32_t flags, ShaderBytecode& bytecode, CString& messages) override
+    {
+        CacheKey key("compile");
+        key.Add(source, length);
+        key.Add(entryPoint);
+        key.Add(profile);
+        key.Add(flags);
+
+        return ProcessBytecode(key, entryPoint && entryPoint[0] ? entryPoint : profile, bytecode, messages, [&]()
+        {
+            return mRecorder->Compile(source, length, entryPoint, profile, flags, bytecode, messages);
+        });
+    }
+
+    bool Assemble(const char* source, size_t length, ShaderBytecode& bytecode, CString& messages) override
+    {
+        CacheKey key("assemble");
+        key.Add(source, length);
+
+        return ProcessBytecode(key, "asm shader", bytecode, messages, [&]()
+        {
+            return mRecorder->Assemble(source, length, bytecode, messages);
+        });
+    }
+
+    bool Disassemble(const ShaderBytecode& bytecode, CString& disassembly) override
+    {
+        CacheKey key("disassemble");
+        AddBytecode(key, bytecode);
+
+        std::vector<uint8_t> data;
+        CString messages;
+        bool result;
+        if(mRecorder)
+        {
+            result = mRecorder->Disassemble(bytecode, disassembly);
+            AppendString(data, disassembly);
+            WriteEntry(key, result, data, messages);
+        }
+        else
+        {
+            result = ReadEntry(key, "disassembly", data, messages);
+            disassembly = ReadString(data);
+            if(!result && messages.Get())
+                Log::Error("%s", messages.Get());
+        }
+
+        return result;
+    }
+
+private:
+    //forward slashes and lower case, the spelling every os agrees on
+    static std::string NormalizePath(std::string path)
+    {
+        std::replace(path.begin(), path.end(), '\\', '/');
+        std::transform(path.begin(), path.end(), path.begin(), [](char c) { return (char)tolower((uint8_t)c); });
+        return path;
+    }
+
+    //files outside the folder that holds the cache keep their absolute path
+    std::string GetPathKey(const char* filePath) const
+    {
+        std::filesystem::path path = NormalizePath(std::filesystem::absolute(NormalizePath(filePath)).string());
+        path = path.lexically_normal();
+
+        std::filesystem::path relative = path.lexically_relative(mRoot);
+        if(relative.empty() || *relative.begin() == "..")
+            return path.generic_string();
+        return relative.generic_string();
+    }
+
+    template<typename RecordFunc>
+    bool ProcessText(const CacheKey& key, const char* description, CString& text, CString& messages, RecordFunc record)
+    {
+        std::vector<uint8_t> data;
+        bool result;
+        if(mRecorder)
+        {
+            result = record();
+            AppendString(data, text);
+            WriteEntry(key, result, data, messages);
+        }
+        else
+        {
+            result = ReadEntry(key, description, data, messages);
+            text = ReadString(data);
+        }
+
+        return result && text.Get();
+    }
+
+    template<typename RecordFunc>
+    bool ProcessBytecode(const CacheKey& key, const char* description, ShaderBytecode& bytecode, CString& messages, RecordFunc record)
+    {
+        std::vector<uint8_t> data;
+        if(mRecorder)
+        {
+            bool result = record();
+            if(result && bytecode.GetCapacity())
+                data.assign(&bytecode[0], &bytecode[0] + bytecode.GetCapacity());
+            WriteEntry(key, result, data, messages);
+            return result;
+        }
+
+        bool result = ReadEntry(key, description, data, messages);
+        if(result && !data.empty())
+        {
+            bytecode = {(uint32_t)data.size()};
+            memcpy(&bytecode[0], data.data(), data.size());
+        }
+
+        return result;
+    }
+
+    static void AddBytecode(CacheKey& key, const ShaderBytecode& bytecode)
+    {
+        if(bytecode.GetCapacity())
+            key.Add(&bytecode[0], bytecode.GetCapacity());
+    }
+
+    static void AppendString(std::vector<uint8_t>& data, const CString& string)
+    {
+        if(string.Get())
+            data.insert(data.end(), string.Get(), string.Get() + string.Length());
+        data.push_back(0);
+    }
+
+    static CString ReadString(const std::vector<uint8_t>& data)
+    {
+        if(data.empty())
+            return {};
+
+        CString string = {(uint32_t)data.size() + 1};
+        memcpy(string.Get(), data.data(), data.size());
+        return string;
+    }
+
+    std::filesystem::path GetEntryPath(const CacheKey& key) const
+    {
+        char fileName[32];
+        snprintf(fileName, sizeof(fileName), "%016llx.fxr", (unsigned long long)key.Get());
+        return mCacheFolder / fileName;
+    }
+
+    //entry layout: dword result, dword data size, data, dword messages size, messages.
+    //written next to the entry under a name of its own and renamed into place, so jobs recording the same call at once or a
+    //crash mid write never leave a truncated entry behind for replay to serve
+    void WriteEntry(const CacheKey& key, bool result, const std::vector<uint8_t>& data, const CString& messages) const
+    {
+        static thread_local std::mt19937_64 sRandom(std::random_device{}());
+        std::filesystem::path path = GetEntryPath(key);
+        std::filesystem::path staging = path;
+        staging += "." + std::to_string(sRandom()) + ".tmp";
+
+        {
+            std::ofstream file(staging, std::ios::binary | std::ios::trunc);
+            if(!file.good() || !file.is_open())
+            {
+                Log::Warn("unable to write to compiler cache \"%s\"", mCacheFolder.string().c_str());
+                return;
+            }
+
+            uint32_t resultDword = result ? 1 : 0;
+            uint32_t dataSize = (uint32_t)data.size();
+            uint32_t messagesSize = messages.Length();
+            file.write((const char*)&resultDword, sizeof(resultDword));
+            file.write((const char*)&dataSize, sizeof(dataSize));
+            file.write((const char*)data.data(), dataSize);
+            file.write((const char*)&messagesSize, sizeof(messagesSize));
+            if(messagesSize)
+                file.write(messages.Get(), messagesSize);
+
+            file.close();
+            if(file.fail())
+            {
+                Log::Warn("unable to write to compiler cache \"%s\"", mCacheFolder.string().c_str());
+                std::error_code error;
+                std::filesystem::remove(staging, error);
+                return;
+            }
+        }
+
+        std::error_code error;
+        std::filesystem::rename(staging, path, error);
+        if(error)
+        {
+            Log::Warn("unable to write to compiler cache \"%s\"", mCacheFolder.string().c_str());
+            std::filesystem::remove(staging, error);
+        }
+    }
+
+    bool ReadEntry(const CacheKey& key, const char* description, std::vector<uint8_t>& data, CString& messages) const
+    {
+        std::ifstream file(GetEntryPath(key), std::ios::binary);
+        if(!file.good() || !file.is_open())
+        {
+            messages = CString(CString("no recorded result for ", description), " in the compiler cache, rerun with /Backend record");
+            return false;
+        }
+
+        uint32_t resultDword = 0;
+        uint32_t dataSize = 0;
+        file.read((char*)&resultDword, sizeof(resultDword));
+        file.read((char*)&dataSize, sizeof(dataSize));
+        data.resize(dataSize);
+        file.read((char*)data.data(), dataSize);
+
+        uint32_t messagesSize = 0;
+        file.read((char*)&messagesSize, sizeof(messagesSize));
+        if(messagesSize)
+        {
+            CString text = {messagesSize + 1};
+            file.read(text.Get(), messagesSize);
+            messages = text;
+        }
+
+        if(!file.good())
+        {
+            messages = CString("corrupt compiler cache entry for ", description);
+            return false;
+        }
+
+        return resultDword != 0;
+    }
+
+    std::filesystem::path mCacheFolder;
+    //the folder paths are keyed relative to, normalized
+    std::filesystem::path mRoot;
+    std::unique_ptr<CompilerBackend> mRecorder;
+};
+
+
+//keeps every result of the backend it wraps in memory for as long as the process runs, so a compile server doesn't redo
+//work for the headers and shaders that come up job after job. a preprocessed file is only reused while neither it nor
+//any file named in the #line directives of its output was written to since
+class MemoryCacheCompilerBackend : public CompilerBackend
+{
+public:
+    MemoryCacheCompilerBackend(std::unique_ptr<CompilerBackend> backend) : mBackend(std::move(backend))
+    {}
+
+    const char* GetName() const override
+    {
+        return mBackend->GetName();
+    }
+
+    bool Preprocess(const char* filePath, const ShaderMacro* macros, CString& source, CString& messages) override
+    {
+        //jobs can come from different folders
+        std::error_code error;
+        std::filesystem::path absolutePath = std::filesystem::absolute(filePath, error);
+
+        CacheKey key("preprocess");
+        key.Add(absolutePath.string().c_str());
+        key.Add(macros);
+
+        Entry entry;
+        if(FindEntry(key, entry) && !IsStale(entry))
+            return TakeEntry(entry, source, messages);
+
+        entry.Result = mBackend->Preprocess(filePath, macros, source, messages);
+        entry.Messages = messages.Get() ? messages.Get() : "";
+        if(source.Get())
+            entry.Data.assign(source.Get(), source.Get() + source.Length() + 1);
+
+        //without a write time for every file it came from there's no telling when it changed, so it isn't kept
+        if(AddDependency(entry, absolutePath) && AddIncludes(entry, absolutePath.parent_path()))
+            AddEntry(key, entry);
+
+        return entry.Result && source.Get();
+    }
+
+    //there's no telling when what an include handler serves changes, so these aren't kept
+    bool PreprocessSource(const char* fileName, const char* data, size_t length, const ShaderMacro* macros, ShaderIncludeHandler* includes,
+                          CString& source, CString& messages) override
+    {
+        return mBackend->PreprocessSource(fileName, data, length, macros, includes, source, messages);
+    }
+
+    bool Compile(const char* source, size_t length, const char* entryPoint, const char* profile, uint32_t flags, ShaderBytecode& bytecode, CString& messages) override
+    {
+        CacheKey key("compile");
+        key.Add(source, length);
+        key.Add(entryPoint);
+        key.Add(profile);
+        key.Add(flags);
+
+        return ProcessBytecode(key, bytecode, messages, [&]()
+        {
+            return mBackend->Compile(source, length, entryPoint, profile, flags, bytecode, messages);
+        });
+    }
+
+    bool Assemble(const char* source, size_t length, ShaderBytecode& bytecode, CString& messages) override
+    {
+        CacheKey key("assemble");
+        key.Add(source, length);
+
+        return ProcessBytecode(key, bytecode, messages, [&]()
+        {
+            return mBackend->Assemble(source, length, bytecode, messages);
+        });
+    }
+
+    bool Disassemble(const ShaderBytecode& bytecode, CString& disassembly) override
+    {
+        CacheKey key("disassemble");
+        if(bytecode.GetCapacity())
+            key.Add(&bytecode[0], bytecode.GetCapacity());
+
+        Entry entry;
+        CString messages;
+        if(FindEntry(key, entry))
+            return TakeEntry(entry, disassembly, messages);
+
+        entry.Result = mBackend->Disassemble(bytecode, disassembly);
+        if(disassembly.Get())
+            entry.Data.assign(disassembly.Get(), disassembly.Get() + disassembly.Length() + 1);
+        AddEntry(key, entry);
+
+        return entry.Result;
+    }
+
+private:
+    struct Dependency
+    {
+        std::filesystem::path Path;
+        std::filesystem::file_time_type WriteTime;
+    };
+
+    struct Entry
+    {
+        bool Result;
+        std::vector<uint8_t> Data;
+        std::string Messages;
+        std::vector<Dependency> Dependencies;
+    };
+
+    //the cache is dropped as a whole past this many entries, a long running server would grow without bound otherwise
+    static constexpr size_t MAX_ENTRY_COUNT = 1 << 16;
+
+    template<typename CallFunc>
+    bool ProcessBytecode(const CacheKey& key, ShaderBytecode& bytecode, CString& messages, CallFunc call)
+    {
+        Entry entry;
+        if(FindEntry(key, entry))
+        {
+            if(!entry.Data.empty())
+            {
+                bytecode = {(uint32_t)entry.Data.size()};
+                memcpy(&bytecode[0], entry.Data.data(), entry.Data.size());
+            }
+            if(!entry.Messages.empty())
+                messages = entry.Messages.c_str();
+            return entry.Result;
+        }
+
+        entry.Result = call();
+        entry.Messages = messages.Get() ? messages.Get() : "";
+        if(entry.Result && bytecode.GetCapacity())
+            entry.Data.assign(&bytecode[0], &bytecode[0] + bytecode.GetCapacity());
+        AddEntry(key, entry);
+
+        return entry.Result;
+    }
+
+    //text results are stored with their terminator
+    static bool TakeEntry(const Entry& entry, CString& text, CString& messages)
+    {
+        if(!entry.Data.empty())
+            text = (const char*)entry.Data.data();
+        if(!entry.Messages.empty())
+            messages = entry.Messages.c_str();
+        return entry.Result && text.Get();
+    }
+
+    static bool AddDependency(Entry& entry, const std::filesystem::path& path)
+    {
+        std::error_code error;
+        std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(path, error);
+        if(error)
+            return false;
+
+        entry.Dependencies.push_back({path, writeTime});
+        return true;
+    }
+
+    //files named by #line directives, relative ones are looked up next to the preprocessed file first
+    static bool AddIncludes(Entry& entry, const std::filesystem::path& folder)
+    {
+        if(entry.Data.empty())
+            return true;
+
+        const char* line = (const char*)entry.Data.data();
+        while(line)
+        {
+            const char* lineEnd = strchr(line, '\n');
+            const char* directive = line;
+            line = lineEnd ? lineEnd + 1 : nullptr;
+
+            while(*directive == ' ' || *directive == '\t')
+                directive++;
+            if(strncmp(directive, "#line", 5) != 0)
+                continue;
+
+            const char* begin = strchr(directive, '"');
+            if(!begin || (lineEnd && begin > lineEnd))
+                continue;
+            const char* end = strchr(begin + 1, '"');
+            if(!end || (lineEnd && end > lineEnd))
+                continue;
+
+            std::filesystem::path path(std::string(begin + 1, end));
+            std::error_code error;
+            if(path.is_relative() && std::filesystem::exists(folder / path, error))
+                path = folder / path;
+            path = std::filesystem::absolute(path, error);
+
+            bool known = std::any_of(entry.Dependencies.begin(), entry.Dependencies.end(), [&](const Dependency& dependency)
+            {
+                return dependency.Path == path;
+            });
+            if(!known && !AddDependency(entry, path))
+                return false;
+        }
+
+        return true;
+    }
+
+    static bool IsStale(const Entry& entry)
+    {
+        for(const Dependency& dependency : entry.Dependencies)
+        {
+            std::error_code error;
+            if(std::filesystem::last_write_time(dependency.Path, error) != dependency.WriteTime || error)
+                return true;
+        }
+
+        return false;
+    }
+
+    bool FindEntry(const CacheKey& key, Entry& entry)
+    {
+        std::lock_guard lock(mMutex);
+        auto it = mEntries.find(key.Get());
+        if(it == mEntries.end())
+            return false;
+
+        entry = it->second;
+        return true;
+    }
+
+    void AddEntry(const CacheKey& key, const Entry& entry)
+    {
+        std::lock_guard lock(mMutex);
+        if(mEntries.size() >= MAX_ENTRY_COUNT)
+            mEntries.clear();
+        mEntries[key.Get()] = entry;
+    }
+
+    std::unique_ptr<CompilerBackend> mBackend;
+    std::unordered_map<uint64_t, Entry> mEntries;
+    std::mutex mMutex;
+};
+
+
+static std::unique_ptr<CompilerBackend> sCompilerBackend;
+//setting the backend isn't meant to race with using it, only the first use on several threads at once is
+static std::mutex sCompilerBackendMutex;
+static std::once_flag sDefaultCompilerBackendFlag;
+
+static std::string sCompilerBackendName;
+static std::string sCompilerBackendCacheFolder;
+static bool sCompilerMemoryCache = false;
+
+static std::unique_ptr<CompilerBackend> CreateCompilerBackend(const char* name, const char* cacheFolder)
+{
+    if(strcmp(name, "replay") == 0 || strcmp(name, "record") == 0)
+    {
+        if(!cacheFolder)
+        {
+            Log::Error("the %s compiler backend needs a cache folder", name);
+            return nullptr;
+        }
+
+        std::unique_ptr<CompilerBackend> recorder;
+        if(strcmp(name, "record") == 0)
+        {
+        #ifdef _WIN32
+            recorder = std::make_unique<D3DXCompilerBackend>();
+        #else
+            Log::Error("recording needs the d3dx compiler backend which is only available on windows");
+            return nullptr;
+        #endif
+        }
+
+        return std::make_unique<ReplayCompilerBackend>(cacheFolder, std::move(recorder));
+    }
+    else if(strcmp(name, "d3dx") == 0)
+    {
+    #ifdef _WIN32
+        return std::make_unique<D3DXCompilerBackend>();
+    #else
+        Log::Error("the d3dx compiler backend is only available on windows");
+        return nullptr;
+    #endif
+    }
+
+    Log::Error("unknown compiler backend \"%s\"", name);
+    return nullptr;
+}
+
+bool SetCompilerBackend(const char* name, const char* cacheFolder)
+{
+    std::lock_guard lock(sCompilerBackendMutex);
+    std::string absoluteCacheFolder = cacheFolder ? std::filesystem::absolute(cacheFolder).string() : "";
+
+    //asking for the backend that's already set keeps it and everything it has cached
+    if(sCompilerBackend && sCompilerBackendName == name && sCompilerBackendCacheFolder == absoluteCacheFolder)
+        return true;
+
+    std::unique_ptr<CompilerBackend> backend = CreateCompilerBackend(name, cacheFolder);
+    if(!backend)
+        return false;
+
+    if(sCompilerMemoryCache)
+        backend = std::make_unique<MemoryCacheCompilerBackend>(std::move(backend));
+
+    sCompilerBackend = std::move(backend);
+    sCompilerBackendName = name;
+    sCompilerBackendCacheFolder = absoluteCacheFolder;
+    return true;
+}
+
+void SetRecordingCompilerBackend(std::unique_ptr<CompilerBackend> recorder, const char* cacheFolder)
+{
+    std::lock_guard lock(sCompilerBackendMutex);
+    //named after the recorder so asking for record later doesn't keep it
+    sCompilerBackendName = recorder->GetName();
+    sCompilerBackendCacheFolder = std::filesystem::absolute(cacheFolder).string();
+    sCompilerBackend = std::make_unique<ReplayCompilerBackend>(cacheFolder, std::move(recorder));
+}
+
+void EnableCompilerMemoryCache()
+{
+    std::lock_guard lock(sCompilerBackendMutex);
+    sCompilerMemoryCache = true;
+}
+
+//the default is picked once, whichever thread gets here first creates it while the others wait
+CompilerBackend& GetCompilerBackend()
+{
+    std::call_once(sDefaultCompilerBackendFlag, []()
+    {
+        {
+            std::lock_guard lock(sCompilerBackendMutex);
+            if(sCompilerBackend)
+                return;
+        }
+
+    #ifdef _WIN32
+        SetCompilerBackend("d3dx", nullptr);
+    #else
+        SetCompilerBackend("replay", "fxdc_cache");
+    #endif
+    });
+
+    return *sCompilerBackend;
+}
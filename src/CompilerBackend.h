@@ -0,0 +1,95 @@
+#pragma once
+#include "rage/Array.h"
+#include "CString.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+
+//same layout as D3DXMACRO so a null terminated array of these can be handed straight to d3dx
+struct ShaderMacro
+{
+    const char* Name;
+    const char* Definition;
+};
+
+//same values as the D3DXSHADER_ flags
+struct eShaderFlags
+{
+    enum Enum : uint32_t
+    {
+        DEBUG_INFO             = 1 << 0,
+        SKIP_OPTIMIZATION      = 1 << 2,
+        PACK_MATRIX_ROW_MAJOR  = 1 << 3,
+        PACK_MATRIX_COL_MAJOR  = 1 << 4,
+        PARTIAL_PRECISION      = 1 << 5,
+        AVOID_FLOW_CONTROL     = 1 << 9,
+        PREFER_FLOW_CONTROL    = 1 << 10,
+        IEEE_STRICTNESS        = 1 << 13,
+    };
+};
+
+//opens the files named by #include lines when preprocessing source that's already in memory
+class ShaderIncludeHandler
+{
+public:
+    virtual ~ShaderIncludeHandler() = default;
+
+    //system is true for #include <name>. parentName is the file holding the #include, the name given to PreprocessSource
+    //for the source itself. data has to stay valid until Close is called with it
+    virtual bool Open(bool system, const char* name, const char* parentName, const char*& data, size_t& size) = 0;
+    virtual void Close(const char* data) = 0;
+};
+
+using ShaderBytecode = rage::atArray<uint8_t, uint32_t>;
+
+class ShaderConstant
+{
+public:
+    ShaderConstant() : mName(), mRegisterSet(0), mRegisterIndex(0), mRegisterCount(0), mClass(0), mType(0), mRows(1), mColumns(1), mElements(1)
+    {}
+
+    CString mName;
+    //D3DXREGISTER_SET
+    uint8_t mRegisterSet;
+    uint16_t mRegisterIndex;
+    uint16_t mRegisterCount;
+    //D3DXPARAMETER_CLASS and D3DXPARAMETER_TYPE
+    uint8_t mClass;
+    uint8_t mType;
+    uint8_t mRows;
+    uint8_t mColumns;
+    uint16_t mElements;
+};
+
+//everything fxdc needs from a shader compiler. bytecode is stored the same way GpuProgram stores it, sized by its capacity.
+//messages receive the compiler output, which can hold warnings even when the call succeeds.
+class CompilerBackend
+{
+public:
+    virtual ~CompilerBackend() = default;
+
+    virtual const char* GetName() const = 0;
+
+    //macros is terminated by an entry with a null name
+    virtual bool Preprocess(const char* filePath, const ShaderMacro* macros, CString& source, CString& messages) = 0;
+    //same as Preprocess for source that isn't in a file. fileName is only used in messages and #line directives.
+    //without an include handler every #include fails
+    virtual bool PreprocessSource(const char* fileName, const char* data, size_t length, const ShaderMacro* macros, ShaderIncludeHandler* includes,
+                                  CString& source, CString& messages) = 0;
+    //an empty entry point and the fx_2_0 profile only validates the effect and returns no bytecode
+    virtual bool Compile(const char* source, size_t length, const char* entryPoint, const char* profile, uint32_t flags, ShaderBytecode& bytecode, CString& messages) = 0;
+    virtual bool Assemble(const char* source, size_t length, ShaderBytecode& bytecode, CString& messages) = 0;
+    virtual bool Disassemble(const ShaderBytecode& bytecode, CString& disassembly) = 0;
+};
+
+//name is one of "d3dx", "replay" or "record". replay and record need a cache folder.
+//d3dx is only available on windows. replay serves results recorded by record and works anywhere.
+//setting the backend that's already set keeps it as it is.
+bool SetCompilerBackend(const char* name, const char* cacheFolder);
+CompilerBackend& GetCompilerBackend();
+//makes the backend record what recorder answers to cacheFolder, the way record does with d3dx. for tools that make up the
+//compiler results themselves so their inputs can be replayed anywhere
+void SetRecordingCompilerBackend(std::unique_ptr<CompilerBackend> recorder, const char* cacheFolder);
+//backends set from now on keep every result in memory as well, for processes that serve many compiles
+void EnableCompilerMemoryCache();
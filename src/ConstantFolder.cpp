@@ -0,0 +1,668 @@
+#include "ConstantFolder.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdarg>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace M4;
+
+template<typename T>
+static uint32_t Compare(HLSLBinaryOp op, T x, T y)
+{
+    switch(op)
+    {
+        case HLSLBinaryOp_Less:         return x < y;
+        case HLSLBinaryOp_Greater:      return x > y;
+        case HLSLBinaryOp_LessEqual:    return x <= y;
+        case HLSLBinaryOp_GreaterEqual: return x >= y;
+        case HLSLBinaryOp_Equal:        return x == y;
+        default:                        return x != y;
+    }
+}
+
+bool ConstantFolder::FoldInitializer(const HLSLDeclaration& declaration, uint32_t count, uint32_t componentCount, uint32_t stride, uint8_t* dst)
+{
+    Shape shape;
+    if(!GetShape(declaration.type.baseType, shape))
+        return Error(&declaration, "only numbers can be initialized");
+
+    Output output {dst, stride, componentCount, shape.Kind, true, 0, 0, count * componentCount};
+    if(declaration.type.array)
+        return EmitList(declaration.assignment, &declaration, output);
+
+    Value value;
+    if(!Evaluate(declaration.assignment, value))
+        return false;
+    if(!Reshape(value, shape.Rows, shape.Columns) || value.GetCount() != componentCount)
+        return Error(declaration.assignment, "a value with %u components can't initialize \"%s\"", value.GetCount(), declaration.name);
+
+    for(uint32_t i = 0; i < componentCount; i++)
+        Push(output, value.Components[i], value.Kind);
+    return true;
+}
+
+bool ConstantFolder::GetShape(HLSLBaseType type, Shape& shape)
+{
+    //                                  1  2  3  4 2x2 3x3 4x4 4x3 4x2
+    static constexpr uint8_t sRows[]    {1, 1, 1, 1, 2,  3,  4,  4,  4};
+    static constexpr uint8_t sColumns[] {1, 2, 3, 4, 2,  3,  4,  3,  2};
+
+    if(type >= HLSLBaseType_Float && type <= HLSLBaseType_Half4x2)
+    {
+        uint32_t index = (type - HLSLBaseType_Float) % std::size(sRows);
+        shape = {eKind::FLOAT, sRows[index], sColumns[index]};
+    }
+    else if(type >= HLSLBaseType_Bool && type <= HLSLBaseType_Bool4)
+        shape = {eKind::BOOL, 1, (uint8_t)(type - HLSLBaseType_Bool + 1)};
+    else if(type >= HLSLBaseType_Int && type <= HLSLBaseType_Int4)
+        shape = {eKind::INT, 1, (uint8_t)(type - HLSLBaseType_Int + 1)};
+    else if(type >= HLSLBaseType_Uint && type <= HLSLBaseType_Uint4)
+        shape = {eKind::UINT, 1, (uint8_t)(type - HLSLBaseType_Uint + 1)};
+    else
+        return false;
+
+    return true;
+}
+
+void ConstantFolder::GetLiteral(const HLSLLiteralExpression* literal, uint32_t& bits, eKind::Enum& kind)
+{
+    switch(literal->expressionType.baseType)
+    {
+        case HLSLBaseType_Bool:
+            bits = literal->bValue ? 1 : 0;
+            kind = eKind::BOOL;
+        break;
+
+        case HLSLBaseType_Int:
+            bits = (uint32_t)literal->iValue;
+            kind = eKind::INT;
+        break;
+
+        default:
+            bits = std::bit_cast<uint32_t>(literal->fValue);
+            kind = eKind::FLOAT;
+        break;
+    }
+}
+
+uint32_t ConstantFolder::ConvertComponent(uint32_t bits, eKind::Enum from, eKind::Enum to)
+{
+    if(from == to)
+        return bits;
+
+    switch(from)
+    {
+        case eKind::FLOAT:
+        {
+            //out of range values saturate instead of being undefined
+            float value = std::bit_cast<float>(bits);
+            if(to == eKind::BOOL)
+                return value != 0.0f;
+            if(to == eKind::UINT)
+            {
+                if(!(value > 0.0f))
+                    return 0;
+                return value >= 4294967296.0f ? UINT32_MAX : (uint32_t)value;
+            }
+
+            if(value != value)
+                return 0;
+            if(value <= -2147483648.0f)
+                return (uint32_t)INT32_MIN;
+            return value >= 2147483648.0f ? (uint32_t)INT32_MAX : (uint32_t)(int32_t)value;
+        }
+
+        case eKind::INT:
+            if(to == eKind::FLOAT)
+                return std::bit_cast<uint32_t>((float)(int32_t)bits);
+            return to == eKind::BOOL ? bits != 0 : bits;
+
+        case eKind::UINT:
+            if(to == eKind::FLOAT)
+                return std::bit_cast<uint32_t>((float)bits);
+            return to == eKind::BOOL ? bits != 0 : bits;
+
+        default:
+            return to == eKind::FLOAT ? std::bit_cast<uint32_t>(bits ? 1.0f : 0.0f) : bits;
+    }
+}
+
+void ConstantFolder::Convert(Value& value, eKind::Enum kind)
+{
+    if(value.Kind == kind)
+        return;
+
+    for(uint32_t i = 0; i < value.GetCount(); i++)
+        value.Components[i] = ConvertComponent(value.Components[i], value.Kind, kind);
+    value.Kind = kind;
+}
+
+bool ConstantFolder::Reshape(Value& value, uint32_t rows, uint32_t columns)
+{
+    if(value.Rows == rows && value.Columns == columns)
+        return true;
+
+    if(value.GetCount() == 1)
+    {
+        std::fill_n(value.Components + 1, rows * columns - 1, value.Components[0]);
+    }
+    else
+    {
+        if(value.Rows < rows || value.Columns < columns)
+            return false;
+
+        //rows only move towards the start so they can be copied in place
+        for(uint32_t row = 0; row < rows; row++)
+            memmove(value.Components + row * columns, value.Components + row * value.Columns, columns * sizeof(uint32_t));
+    }
+
+    value.Rows = rows;
+    value.Columns = columns;
+    return true;
+}
+
+void ConstantFolder::Push(Output& output, uint32_t bits, eKind::Enum kind)
+{
+    bits = ConvertComponent(bits, kind, output.Kind);
+    if(output.StoreFloats)
+        bits = ConvertComponent(bits, output.Kind, eKind::FLOAT);
+
+    memcpy(output.Dst + output.Component * sizeof(uint32_t), &bits, sizeof(uint32_t));
+    if(++output.Component == output.ComponentCount)
+    {
+        output.Component = 0;
+        output.Dst += output.Stride;
+    }
+    output.Written++;
+}
+
+bool ConstantFolder::Emit(const HLSLExpression* expression, Output& output)
+{
+    if(expression->nodeType == HLSLNodeType_LiteralExpression)
+    {
+        if(output.Written == output.Total)
+            return Error(expression, "too many values, %u expected", output.Total);
+
+        uint32_t bits;
+        eKind::Enum kind;
+        GetLiteral((const HLSLLiteralExpression*)expression, bits, kind);
+        Push(output, bits, kind);
+        return true;
+    }
+
+    //the arguments of a constructor of the output's kind go straight to the output. a single argument could be a scalar
+    //that fills the whole constructor, and other kinds would convert twice, so those are evaluated first
+    const HLSLConstructorExpression* constructor = (const HLSLConstructorExpression*)expression;
+    Shape shape;
+    if(expression->nodeType == HLSLNodeType_ConstructorExpression && GetShape(constructor->type.baseType, shape) &&
+       shape.Kind == output.Kind && constructor->argument && constructor->argument->nextExpression)
+    {
+        uint32_t start = output.Written;
+        for(auto argument = constructor->argument; argument; argument = argument->nextExpression)
+        {
+            if(!Emit(argument, output))
+                return false;
+        }
+
+        uint32_t count = shape.Rows * shape.Columns;
+        if(output.Written - start != count)
+            return Error(expression, "constructor takes %u values, got %u", count, output.Written - start);
+        return true;
+    }
+
+    Value value;
+    if(!Evaluate(expression, value))
+        return false;
+    if(output.Written + value.GetCount() > output.Total)
+        return Error(expression, "too many values, %u expected", output.Total);
+
+    for(uint32_t i = 0; i < value.GetCount(); i++)
+        Push(output, value.Components[i], value.Kind);
+    return true;
+}
+
+bool ConstantFolder::EmitList(const HLSLExpression* list, const HLSLNode* node, Output& output)
+{
+    for(auto expression = list; expression; expression = expression->nextExpression)
+    {
+        if(!Emit(expression, output))
+            return false;
+    }
+
+    if(output.Written != output.Total)
+        return Error(node, "initializer has %u values, %u expected", output.Written, output.Total);
+    return true;
+}
+
+bool ConstantFolder::Evaluate(const HLSLExpression* expression, Value& value)
+{
+    switch(expression->nodeType)
+    {
+        case HLSLNodeType_LiteralExpression:
+            GetLiteral((const HLSLLiteralExpression*)expression, value.Components[0], value.Kind);
+            value.Rows = 1;
+            value.Columns = 1;
+            return true;
+
+        case HLSLNodeType_BinaryExpression:
+            return EvaluateBinary((const HLSLBinaryExpression*)expression, value);
+
+        case HLSLNodeType_UnaryExpression:
+            return EvaluateUnary((const HLSLUnaryExpression*)expression, value);
+
+        case HLSLNodeType_ConditionalExpression:
+            return EvaluateConditional((const HLSLConditionalExpression*)expression, value);
+
+        case HLSLNodeType_ConstructorExpression:
+            return EvaluateConstructor((const HLSLConstructorExpression*)expression, value);
+
+        case HLSLNodeType_CastingExpression:
+            return EvaluateCast((const HLSLCastingExpression*)expression, value);
+
+        case HLSLNodeType_IdentifierExpression:
+            return EvaluateIdentifier((const HLSLIdentifierExpression*)expression, value);
+
+        case HLSLNodeType_ArrayAccess:
+            return EvaluateArrayElement((const HLSLArrayAccess*)expression, value);
+
+        case HLSLNodeType_MemberAccess:
+        {
+            const HLSLMemberAccess* member = (const HLSLMemberAccess*)expression;
+            if(member->swizzle)
+                return EvaluateSwizzle(member, value);
+            return Error(expression, "member \"%s\" isn't a constant", member->field);
+        }
+
+        case HLSLNodeType_FunctionCall:
+            return Error(expression, "call to \"%s\" isn't a constant expression", ((const HLSLFunctionCall*)expression)->function->name);
+
+        default:
+            return Error(expression, "expression isn't constant");
+    }
+}
+
+bool ConstantFolder::EvaluateBinary(const HLSLBinaryExpression* expression, Value& value)
+{
+    HLSLBinaryOp op = expression->binaryOp;
+    if(op >= HLSLBinaryOp_Assign)
+        return Error(expression, "assignment isn't a constant expression");
+
+    Value other;
+    if(!Evaluate(expression->expression1, value) || !Evaluate(expression->expression2, other))
+        return false;
+
+    //a scalar is used for every component of the other side, otherwise both sides are cut to the smaller one
+    uint32_t rows, columns;
+    if(value.GetCount() == 1)
+    {
+        rows = other.Rows;
+        columns = other.Columns;
+    }
+    else if(other.GetCount() == 1)
+    {
+        rows = value.Rows;
+        columns = value.Columns;
+    }
+    else
+    {
+        rows = std::min(value.Rows, other.Rows);
+        columns = std::min(value.Columns, other.Columns);
+    }
+    Reshape(value, rows, columns);
+    Reshape(other, rows, columns);
+
+    bool bitwise = op == HLSLBinaryOp_BitAnd || op == HLSLBinaryOp_BitOr || op == HLSLBinaryOp_BitXor;
+    eKind::Enum kind;
+    if(op == HLSLBinaryOp_And || op == HLSLBinaryOp_Or)
+        kind = eKind::BOOL;
+    else if(value.Kind == eKind::FLOAT || other.Kind == eKind::FLOAT)
+        kind = eKind::FLOAT;
+    else if(value.Kind == eKind::UINT || other.Kind == eKind::UINT)
+        kind = eKind::UINT;
+    else
+        kind = eKind::INT;
+
+    if(bitwise && kind == eKind::FLOAT)
+        return Error(expression, "bitwise operators only take integers");
+
+    Convert(value, kind);
+    Convert(other, kind);
+
+    bool compare = IsCompareOp(op);
+    for(uint32_t i = 0; i < value.GetCount(); i++)
+    {
+        uint32_t& x = value.Components[i];
+        uint32_t y = other.Components[i];
+
+        if(compare)
+        {
+            if(kind == eKind::FLOAT)
+                x = Compare(op, std::bit_cast<float>(x), std::bit_cast<float>(y));
+            else if(kind == eKind::INT)
+                x = Compare(op, (int32_t)x, (int32_t)y);
+            else
+                x = Compare(op, x, y);
+        }
+        else if(kind == eKind::BOOL)
+        {
+            x = op == HLSLBinaryOp_And ? (x && y) : (x || y);
+        }
+        else if(kind == eKind::FLOAT)
+        {
+            float fx = std::bit_cast<float>(x);
+            float fy = std::bit_cast<float>(y);
+            switch(op)
+            {
+                case HLSLBinaryOp_Add: fx += fy; break;
+                case HLSLBinaryOp_Sub: fx -= fy; break;
+                case HLSLBinaryOp_Mul: fx *= fy; break;
+                case HLSLBinaryOp_Div: fx /= fy; break;
+                default:               fx = std::fmod(fx, fy); break;
+            }
+            x = std::bit_cast<uint32_t>(fx);
+        }
+        else
+        {
+            //integers wrap around, done on the unsigned bits so overflowing isn't undefined
+            switch(op)
+            {
+                case HLSLBinaryOp_Add:    x += y; break;
+                case HLSLBinaryOp_Sub:    x -= y; break;
+                case HLSLBinaryOp_Mul:    x *= y; break;
+                case HLSLBinaryOp_BitAnd: x &= y; break;
+                case HLSLBinaryOp_BitOr:  x |= y; break;
+                case HLSLBinaryOp_BitXor: x ^= y; break;
+
+                default:
+                    if(y == 0)
+                        return Error(expression, "division by zero");
+
+                    if(kind == eKind::UINT)
+                        x = op == HLSLBinaryOp_Div ? x / y : x % y;
+                    else if((int32_t)y == -1)
+                        x = op == HLSLBinaryOp_Div ? 0 - x : 0;
+                    else
+                        x = (uint32_t)(op == HLSLBinaryOp_Div ? (int32_t)x / (int32_t)y : (int32_t)x % (int32_t)y);
+                break;
+            }
+        }
+    }
+
+    if(compare)
+        value.Kind = eKind::BOOL;
+    return true;
+}
+
+bool ConstantFolder::EvaluateUnary(const HLSLUnaryExpression* expression, Value& value)
+{
+    HLSLUnaryOp op = expression->unaryOp;
+    if(op != HLSLUnaryOp_Negative && op != HLSLUnaryOp_Positive && op != HLSLUnaryOp_Not && op != HLSLUnaryOp_BitNot)
+        return Error(expression, "increment and decrement aren't constant expressions");
+
+    if(!Evaluate(expression->expression, value))
+        return false;
+
+    if(op == HLSLUnaryOp_Not)
+    {
+        Convert(value, eKind::BOOL);
+        for(uint32_t i = 0; i < value.GetCount(); i++)
+            value.Components[i] = !value.Components[i];
+        return true;
+    }
+
+    if(op == HLSLUnaryOp_BitNot && value.Kind == eKind::FLOAT)
+        return Error(expression, "bitwise operators only take integers");
+
+    //bools do math as ints
+    if(value.Kind == eKind::BOOL)
+        Convert(value, eKind::INT);
+
+    for(uint32_t i = 0; i < value.GetCount(); i++)
+    {
+        uint32_t& x = value.Components[i];
+        if(op == HLSLUnaryOp_BitNot)
+            x = ~x;
+        else if(op == HLSLUnaryOp_Negative)
+            x = value.Kind == eKind::FLOAT ? std::bit_cast<uint32_t>(-std::bit_cast<float>(x)) : 0 - x;
+    }
+
+    return true;
+}
+
+bool ConstantFolder::EvaluateConditional(const HLSLConditionalExpression* expression, Value& value)
+{
+    //the result has the type of the first choice
+    Shape shape;
+    if(!GetShape(expression->expressionType.baseType, shape))
+        return Error(expression, "only numbers can be chosen between");
+
+    Value condition;
+    if(!Evaluate(expression->condition, condition))
+        return false;
+    Convert(condition, eKind::BOOL);
+
+    if(condition.GetCount() == 1)
+    {
+        const HLSLExpression* choice = condition.Components[0] ? expression->trueExpression : expression->falseExpression;
+        if(!Evaluate(choice, value))
+            return false;
+
+        Convert(value, shape.Kind);
+        if(!Reshape(value, shape.Rows, shape.Columns))
+            return Error(choice, "a value with %u components can't be converted to %u", value.GetCount(), shape.Rows * shape.Columns);
+        return true;
+    }
+
+    //a vector condition picks every component on its own
+    Value other;
+    if(!Evaluate(expression->trueExpression, value) || !Evaluate(expression->falseExpression, other))
+        return false;
+
+    Convert(value, shape.Kind);
+    Convert(other, shape.Kind);
+    if(!Reshape(value, condition.Rows, condition.Columns) || !Reshape(other, condition.Rows, condition.Columns))
+        return Error(expression, "the choices don't have as many components as the condition");
+
+    for(uint32_t i = 0; i < value.GetCount(); i++)
+    {
+        if(!condition.Components[i])
+            value.Components[i] = other.Components[i];
+    }
+
+    return true;
+}
+
+bool ConstantFolder::EvaluateConstructor(const HLSLConstructorExpression* expression, Value& value)
+{
+    Shape shape;
+    if(!GetShape(expression->type.baseType, shape))
+        return Error(expression, "only numbers can be constructed in an initializer");
+
+    uint32_t count = shape.Rows * shape.Columns;
+    uint32_t written = 0;
+    for(auto argument = expression->argument; argument; argument = argument->nextExpression)
+    {
+        Value part;
+        if(!Evaluate(argument, part))
+            return false;
+        if(written + part.GetCount() > count)
+            return Error(expression, "constructor takes %u values, got more", count);
+
+        Convert(part, shape.Kind);
+        memcpy(value.Components + written, part.Components, part.GetCount() * sizeof(uint32_t));
+        written += part.GetCount();
+    }
+
+    if(written != count && written != 1)
+        return Error(expression, "constructor takes %u values, got %u", count, written);
+
+    //a single scalar fills the whole type
+    value.Kind = shape.Kind;
+    value.Rows = written == count ? shape.Rows : 1;
+    value.Columns = written == count ? shape.Columns : 1;
+    Reshape(value, shape.Rows, shape.Columns);
+    return true;
+}
+
+bool ConstantFolder::EvaluateCast(const HLSLCastingExpression* expression, Value& value)
+{
+    Shape shape;
+    if(!GetShape(expression->type.baseType, shape))
+        return Error(expression, "only casts to numbers are constant expressions");
+
+    if(!Evaluate(expression->expression, value))
+        return false;
+
+    Convert(value, shape.Kind);
+    if(!Reshape(value, shape.Rows, shape.Columns))
+        return Error(expression, "a value with %u components can't be cast to %u", value.GetCount(), shape.Rows * shape.Columns);
+
+    return true;
+}
+
+bool ConstantFolder::EvaluateSwizzle(const HLSLMemberAccess* expression, Value& value)
+{
+    if(!Evaluate(expression->object, value))
+        return false;
+    if(value.Rows != 1)
+        return Error(expression, "matrix swizzles aren't supported in initializers");
+
+    uint32_t components[4];
+    uint32_t count = 0;
+    for(const char* c = expression->field; *c; c++)
+    {
+        const char* names = "xyzw";
+        const char* name = strchr(names, *c);
+        if(!name)
+        {
+            names = "rgba";
+            name = strchr(names, *c);
+        }
+
+        uint32_t component = name ? (uint32_t)(name - names) : 4;
+        if(component >= value.Columns || count == 4)
+            return Error(expression, "invalid swizzle \"%s\"", expression->field);
+        components[count++] = value.Components[component];
+    }
+
+    memcpy(value.Components, components, count * sizeof(uint32_t));
+    value.Columns = count;
+    return true;
+}
+
+bool ConstantFolder::EvaluateIdentifier(const HLSLIdentifierExpression* expression, Value& value)
+{
+    const HLSLDeclaration* declaration = FindConstant(expression);
+    if(!declaration)
+        return false;
+    if(declaration->type.array)
+        return Error(expression, "array \"%s\" has to be indexed", expression->name);
+
+    Shape shape;
+    if(!GetShape(declaration->type.baseType, shape))
+        return Error(expression, "\"%s\" isn't a number", expression->name);
+
+    mDepth++;
+    bool result = Evaluate(declaration->assignment, value);
+    mDepth--;
+    if(!result)
+        return false;
+
+    Convert(value, shape.Kind);
+    if(!Reshape(value, shape.Rows, shape.Columns))
+        return Error(declaration->assignment, "a value with %u components can't initialize \"%s\"", value.GetCount(), declaration->name);
+
+    return true;
+}
+
+bool ConstantFolder::EvaluateArrayElement(const HLSLArrayAccess* expression, Value& value)
+{
+    if(expression->array->nodeType != HLSLNodeType_IdentifierExpression)
+        return Error(expression, "only const arrays can be indexed in an initializer");
+
+    const HLSLIdentifierExpression* identifier = (const HLSLIdentifierExpression*)expression->array;
+    const HLSLDeclaration* declaration = FindConstant(identifier);
+    if(!declaration)
+        return false;
+    if(!declaration->type.array)
+        return Error(expression, "\"%s\" isn't an array", identifier->name);
+
+    Shape shape;
+    if(!GetShape(declaration->type.baseType, shape))
+        return Error(expression, "\"%s\" isn't an array of numbers", identifier->name);
+
+    const HLSLExpression* arraySize = declaration->type.arraySize;
+    if(!arraySize || arraySize->nodeType != HLSLNodeType_LiteralExpression)
+        return Error(declaration, "array size must be a literal.");
+
+    int32_t size = ((const HLSLLiteralExpression*)arraySize)->iValue;
+    if(size < 1 || size > UINT16_MAX)
+        return Error(declaration, "array size must be between 1 and %u.", UINT16_MAX);
+
+    Value index;
+    if(!Evaluate(expression->index, index))
+        return false;
+    if(index.GetCount() != 1)
+        return Error(expression->index, "array index must be a scalar");
+
+    Convert(index, eKind::INT);
+    int32_t element = (int32_t)index.Components[0];
+    if(element < 0 || element >= size)
+        return Error(expression->index, "index %d is out of the bounds of \"%s\"", element, identifier->name);
+
+    //folds the whole array, only the element that's read is kept
+    uint32_t count = shape.Rows * shape.Columns;
+    std::vector<uint32_t> elements((size_t)size * count);
+    Output output {(uint8_t*)elements.data(), count * (uint32_t)sizeof(uint32_t), count, shape.Kind, false, 0, 0, (uint32_t)size * count};
+
+    mDepth++;
+    bool result = EmitList(declaration->assignment, declaration, output);
+    mDepth--;
+    if(!result)
+        return false;
+
+    value.Kind = shape.Kind;
+    value.Rows = shape.Rows;
+    value.Columns = shape.Columns;
+    memcpy(value.Components, &elements[(size_t)element * count], count * sizeof(uint32_t));
+    return true;
+}
+
+const HLSLDeclaration* ConstantFolder::FindConstant(const HLSLIdentifierExpression* identifier)
+{
+    if(mDepth == MAX_DEPTH)
+    {
+        Error(identifier, "constants read each other more than %u deep", MAX_DEPTH);
+        return nullptr;
+    }
+
+    const HLSLDeclaration* declaration = mTree.FindGlobalDeclaration(identifier->name);
+    if(!declaration || !(declaration->type.flags & HLSLTypeFlag_Const))
+    {
+        Error(identifier, "\"%s\" isn't a constant", identifier->name);
+        return nullptr;
+    }
+    if(!declaration->assignment)
+    {
+        Error(identifier, "constant \"%s\" has no value", identifier->name);
+        return nullptr;
+    }
+
+    return declaration;
+}
+
+bool ConstantFolder::Error(const HLSLNode* node, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    std::string message = Log::FormatArgList(format, args);
+    va_end(args);
+
+    Log::Error("%s(%d) : %s", node->fileName, node->line, message.c_str());
+    return false;
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include "hlslparser/src/HLSLTree.h"
+
+#include <cstdint>
+
+//folds the initializers of effect parameters into their values. the whole initializer list is walked once and every value
+//is written straight to its place in the parameter's buffer, so a large lookup table costs one pass over its expressions.
+//literals, constructors, casts, swizzles, arithmetic, comparisons, ?: and reads from const globals and const arrays are
+//folded the way hlsl evaluates them. anything else is reported at the expression that can't be folded
+class ConstantFolder
+{
+public:
+    ConstantFolder(M4::HLSLTree& tree) : mTree(tree), mDepth(0)
+    {}
+
+    //writes count elements of componentCount floats, stride bytes apart, converted to the type of the declaration first.
+    //arrays take a list with count * componentCount values in total, split across the elements in order.
+    //a single scalar fills every component of a vector or matrix. dst has to be zeroed so the padding stays zero
+    bool FoldInitializer(const M4::HLSLDeclaration& declaration, uint32_t count, uint32_t componentCount, uint32_t stride, uint8_t* dst);
+
+private:
+    struct eKind
+    {
+        enum Enum : uint8_t
+        {
+            FLOAT,
+            INT,
+            UINT,
+            BOOL,
+        };
+    };
+
+    struct Shape
+    {
+        eKind::Enum Kind;
+        uint8_t Rows;
+        uint8_t Columns;
+    };
+
+    static constexpr uint32_t MAX_COMPONENTS = 16;
+    //how many constants can be read through each other, stops constants that end up reading themselves
+    static constexpr uint32_t MAX_DEPTH = 64;
+
+    //components are stored as the bits of their kind, matrices row by row
+    struct Value
+    {
+        eKind::Enum Kind;
+        uint32_t Rows;
+        uint32_t Columns;
+        uint32_t Components[MAX_COMPONENTS];
+
+        uint32_t GetCount() const
+        {
+            return Rows * Columns;
+        }
+    };
+
+    //where the next folded component goes
+    struct Output
+    {
+        uint8_t* Dst;
+        uint32_t Stride;
+        uint32_t ComponentCount;
+        //components are converted to this kind
+        eKind::Enum Kind;
+        //and then stored as floats, like parameter values are
+        bool StoreFloats;
+        //component of the current element
+        uint32_t Component;
+        uint32_t Written;
+        uint32_t Total;
+    };
+
+    //false for types that aren't numbers
+    static bool GetShape(M4::HLSLBaseType type, Shape& shape);
+    static void GetLiteral(const M4::HLSLLiteralExpression* literal, uint32_t& bits, eKind::Enum& kind);
+    static uint32_t ConvertComponent(uint32_t bits, eKind::Enum from, eKind::Enum to);
+    static void Convert(Value& value, eKind::Enum kind);
+    //a scalar fills the new shape, anything else keeps its top left corner. false if the value is too small
+    static bool Reshape(Value& value, uint32_t rows, uint32_t columns);
+
+    static void Push(Output& output, uint32_t bits, eKind::Enum kind);
+    //appends the components of expression to the output
+    bool Emit(const M4::HLSLExpression* expression, Output& output);
+    //folds a whole initializer list of the type into output
+    bool EmitList(const M4::HLSLExpression* list, const M4::HLSLNode* node, Output& output);
+
+    bool Evaluate(const M4::HLSLExpression* expression, Value& value);
+    bool EvaluateBinary(const M4::HLSLBinaryExpression* expression, Value& value);
+    bool EvaluateUnary(const M4::HLSLUnaryExpression* expression, Value& value);
+    bool EvaluateConditional(const M4::HLSLConditionalExpression* expression, Value& value);
+    bool EvaluateConstructor(const M4::HLSLConstructorExpression* expression, Value& value);
+    bool EvaluateCast(const M4::HLSLCastingExpression* expression, Value& value);
+    bool EvaluateSwizzle(const M4::HLSLMemberAccess* expression, Value& value);
+    bool EvaluateIdentifier(const M4::HLSLIdentifierExpression* expression, Value& value);
+    bool EvaluateArrayElement(const M4::HLSLArrayAccess* expression, Value& value);
+
+    //the global an identifier names, if it's a const with an initializer
+    const M4::HLSLDeclaration* FindConstant(const M4::HLSLIdentifierExpression* identifier);
+    //logs the message at node and returns false
+    static bool Error(const M4::HLSLNode* node, const char* format, ...);
+
+    M4::HLSLTree& mTree;
+    uint32_t mDepth;
+};
@@ -0,0 +1,111 @@
+#include "ConstantTable.h"
+#include "rage/StringHash.h"
+
+#include <cstring>
+
+//D3DXSHADER_CONSTANTTABLE
+struct ConstantTableHeader
+{
+    uint32_t Size;
+    uint32_t Creator;
+    uint32_t Version;
+    uint32_t Constants;
+    uint32_t ConstantInfo;
+    uint32_t Flags;
+    uint32_t Target;
+};
+ASSERT_SIZE(ConstantTableHeader, 0x1C);
+
+static constexpr uint32_t COMMENT_OPCODE = 0xFFFE;
+static constexpr uint32_t CTAB_FOURCC = 'C' | ('T' << 8) | ('A' << 16) | ('B' << 24);
+
+//true if offset points at a string terminated inside the table
+static inline bool IsValidString(const uint8_t* table, uint32_t size, uint32_t offset)
+{
+    return offset < size && memchr(table + offset, '\0', size - offset);
+}
+
+bool ConstantTable::Init(const uint8_t* bytecode, uint32_t size)
+{
+    *this = {};
+
+    //the compiler puts the table in a comment right after the version token, other comments may come first
+    const uint32_t* tokens = (const uint32_t*)bytecode;
+    uint32_t tokenCount = size / sizeof(uint32_t);
+    const uint8_t* table = nullptr;
+    uint32_t tableSize = 0;
+    for(uint32_t i = 1; i < tokenCount && (tokens[i] & 0xFFFF) == COMMENT_OPCODE; )
+    {
+        uint32_t commentLength = (tokens[i] >> 16) & 0x7FFF;
+        if(commentLength > tokenCount - i - 1)
+            return false;
+
+        if(commentLength && tokens[i + 1] == CTAB_FOURCC)
+        {
+            table = (const uint8_t*)&tokens[i + 2];
+            tableSize = (commentLength - 1) * sizeof(uint32_t);
+            break;
+        }
+
+        i += commentLength + 1;
+    }
+
+    if(!table || tableSize < sizeof(ConstantTableHeader))
+        return false;
+
+    const ConstantTableHeader& header = *(const ConstantTableHeader*)table;
+    if(header.Size != sizeof(ConstantTableHeader) || header.ConstantInfo > tableSize || (header.ConstantInfo & 3) ||
+       header.Constants > (tableSize - header.ConstantInfo) / sizeof(ConstantInfo))
+        return false;
+
+    const ConstantInfo* constants = (const ConstantInfo*)(table + header.ConstantInfo);
+    for(uint32_t i = 0; i < header.Constants; i++)
+    {
+        const ConstantInfo& constant = constants[i];
+        if(!IsValidString(table, tableSize, constant.Name))
+            return false;
+        if(constant.TypeInfo && (constant.TypeInfo > tableSize - sizeof(TypeInfo) || (constant.TypeInfo & 1)))
+            return false;
+    }
+
+    mTable = table;
+    mSize = tableSize;
+    mConstants = constants;
+    mConstantCount = header.Constants;
+    return true;
+}
+
+const ConstantTable::TypeInfo* ConstantTable::GetConstantType(uint32_t index) const
+{
+    uint32_t offset = mConstants[index].TypeInfo;
+    return offset ? (const TypeInfo*)(mTable + offset) : nullptr;
+}
+
+int32_t ConstantTable::FindConstant(uint32_t nameHash) const
+{
+    for(uint32_t i = 0; i < mConstantCount; i++)
+    {
+        if(rage::atStringHash(GetConstantName(i)) == nameHash)
+            return (int32_t)i;
+    }
+
+    return -1;
+}
+
+const char* ConstantTable::GetCreator() const
+{
+    if(!mTable)
+        return "";
+
+    uint32_t offset = ((const ConstantTableHeader*)mTable)->Creator;
+    return IsValidString(mTable, mSize, offset) ? GetString(offset) : "";
+}
+
+const char* ConstantTable::GetTarget() const
+{
+    if(!mTable)
+        return "";
+
+    uint32_t offset = ((const ConstantTableHeader*)mTable)->Target;
+    return IsValidString(mTable, mSize, offset) ? GetString(offset) : "";
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include "CompilerBackend.h"
+
+#include <cstdint>
+
+//read only view of the CTAB comment compiled shaders carry. nothing is copied, names and infos point into the bytecode
+//so the table is only valid as long as the bytecode it was created from.
+class ConstantTable
+{
+public:
+    //D3DXSHADER_CONSTANTINFO
+    struct ConstantInfo
+    {
+        uint32_t Name;
+        uint16_t RegisterSet;
+        uint16_t RegisterIndex;
+        uint16_t RegisterCount;
+        uint16_t Reserved;
+        uint32_t TypeInfo;
+        uint32_t DefaultValue;
+    };
+
+    //D3DXSHADER_TYPEINFO
+    struct TypeInfo
+    {
+        uint16_t Class;
+        uint16_t Type;
+        uint16_t Rows;
+        uint16_t Columns;
+        uint16_t Elements;
+        uint16_t StructMembers;
+        uint32_t StructMemberInfo;
+    };
+
+    ConstantTable() : mTable(nullptr), mSize(0), mConstants(nullptr), mConstantCount(0)
+    {}
+
+    //returns false if the shader has no constant table or it points outside of the comment that holds it
+    bool Init(const uint8_t* bytecode, uint32_t size);
+    bool Init(const ShaderBytecode& bytecode)
+    {
+        return bytecode.GetCapacity() && Init(&bytecode[0], bytecode.GetCapacity());
+    }
+
+    uint32_t GetConstantCount() const
+    {
+        return mConstantCount;
+    }
+
+    const ConstantInfo& GetConstant(uint32_t index) const
+    {
+        return mConstants[index];
+    }
+
+    const char* GetConstantName(uint32_t index) const
+    {
+        return GetString(mConstants[index].Name);
+    }
+
+    //null if the constant has no type info
+    const TypeInfo* GetConstantType(uint32_t index) const;
+
+    //returns the index of the constant or -1
+    int32_t FindConstant(uint32_t nameHash) const;
+
+    const char* GetCreator() const;
+    const char* GetTarget() const;
+
+private:
+    const char* GetString(uint32_t offset) const
+    {
+        return offset < mSize ? (const char*)mTable + offset : "";
+    }
+
+    const uint8_t* mTable;
+    uint32_t mSize;
+    const ConstantInfo* mConstants;
+    uint32_t mConstantCount;
+};
+
+ASSERT_SIZE(ConstantTable::ConstantInfo, 0x14);
+ASSERT_SIZE(ConstantTable::TypeInfo, 0x10);
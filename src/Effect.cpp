@@ -2,122 +2,1031 @@
 #include "Effect.h"
 #include "rage/StringHash.h"
 #include "Log.h"
+#include "ShaderAssembler.h"
+#include "ConstantTable.h"
+#include "ShaderStats.h"
+#include "RenderStatePool.h"
+#include "ConstantFolder.h"
 
+#include <atomic>
 #include <filesystem>
 #include <cassert>
+#include <cstdarg>
 #include <set>
+#include <string>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define PARAMETER_VALUES_SSE2
+#endif
 
 static constexpr uint8_t sParamTypeSizeFactor[] {0, 1, 1, 1, 1, 1, 0, 1, 3, 4, 0, 0, 0, 0, 0, 0};
 
-static inline void WriteString(OFileStream& file, const CString& str)
+//parameter values are packed in the file and every element takes whole registers in memory. these convert all elements of
+//a parameter in one go. when the strides match, like for vectors and matrices, it's a single copy. float, float2 and float3
+//elements move a register at a time, masking off whatever of the 16 bytes isn't part of the element.
+//dst has to be zeroed so the padding stays zero
+static void ExpandParameterValues(uint8_t* dst, uint32_t dstStride, const uint8_t* src, uint32_t srcStride, uint32_t count)
 {
-    uint8_t strLen = (uint8_t)str.Length() + 1;
-    file.WriteByte(&strLen);
-    file.Write(str.Get(), strLen);
+    if(srcStride == dstStride)
+    {
+        memcpy(dst, src, (size_t)srcStride * count);
+        return;
+    }
+
+    uint32_t i = 0;
+#ifdef PARAMETER_VALUES_SSE2
+    if(dstStride == 16 && srcStride < 16)
+    {
+        static const __m128i sMasks[] {_mm_setr_epi32(0, 0, 0, 0), _mm_setr_epi32(-1, 0, 0, 0), _mm_setr_epi32(-1, -1, 0, 0), _mm_setr_epi32(-1, -1, -1, 0)};
+        const __m128i mask = sMasks[srcStride / 4];
+
+        //every load reads past its element, the last few are left to the loop below so src is never read past its end
+        size_t srcSize = (size_t)srcStride * count;
+        for(; (size_t)i * srcStride + 16 <= srcSize; i++)
+        {
+            __m128i value = _mm_loadu_si128((const __m128i*)(src + (size_t)i * srcStride));
+            _mm_storeu_si128((__m128i*)(dst + (size_t)i * 16), _mm_and_si128(value, mask));
+        }
+    }
+#endif
+
+    for(; i < count; i++)
+        memcpy(dst + (size_t)i * dstStride, src + (size_t)i * srcStride, srcStride);
 }
 
-static inline CString ReadString(IFileStream& file)
+//the other way around, dstStride is the smaller one
+static void CompactParameterValues(uint8_t* dst, uint32_t dstStride, const uint8_t* src, uint32_t srcStride, uint32_t count)
 {
-    uint8_t strLen;
-    file.ReadByte(&strLen);
-    CString str = {(uint32_t)strLen};
-    file.Read(str.Get(), strLen);
+    if(srcStride == dstStride)
+    {
+        memcpy(dst, src, (size_t)srcStride * count);
+        return;
+    }
+
+    uint32_t i = 0;
+#ifdef PARAMETER_VALUES_SSE2
+    if(srcStride == 16 && dstStride < 16)
+    {
+        //every store writes past its element and the next one overwrites it, the last few are left to the loop below
+        size_t dstSize = (size_t)dstStride * count;
+        for(; (size_t)i * dstStride + 16 <= dstSize; i++)
+            _mm_storeu_si128((__m128i*)(dst + (size_t)i * dstStride), _mm_loadu_si128((const __m128i*)(src + (size_t)i * 16)));
+    }
+#endif
 
-    return str;
+    for(; i < count; i++)
+        memcpy(dst + (size_t)i * dstStride, src + (size_t)i * srcStride, dstStride);
 }
 
-Effect::Effect(IFileStream& file)
+//constant table type of an asm shader parameter, using the register layout the compiler picks for these types.
+//false if the parameter takes more registers than the table can count
+static bool SetShaderConstantType(ShaderConstant& constant, const Parameter& param)
 {
-    mFilePath = file.GetFilePath();
+    //D3DXREGISTER_SET, D3DXPARAMETER_CLASS and D3DXPARAMETER_TYPE values
+    constant.mRegisterSet = 2;
+    constant.mClass = 0;
+    constant.mType = 3;
+    constant.mRows = 1;
+    constant.mColumns = 1;
+    constant.mElements = std::max<uint16_t>(param.GetCount(), 1);
+
+    uint16_t registersPerElement = 1;
+    switch(param.GetType())
+    {
+        case Parameter::eType::INT:
+            constant.mType = 2;
+            break;
+        case Parameter::eType::VECTOR2:
+        case Parameter::eType::VECTOR3:
+        case Parameter::eType::VECTOR4:
+            constant.mClass = 1;
+            constant.mColumns = (uint8_t)(param.GetType() - Parameter::eType::VECTOR2 + 2);
+            break;
+        case Parameter::eType::TEXTURE:
+            constant.mRegisterSet = 3;
+            constant.mClass = 4;
+            constant.mType = 10;
+            break;
+        case Parameter::eType::BOOL:
+            constant.mRegisterSet = 0;
+            constant.mType = 1;
+            break;
+        case Parameter::eType::MATRIX4X3:
+        case Parameter::eType::MATRIX4X4:
+            constant.mClass = 3;
+            constant.mRows = 4;
+            constant.mColumns = param.GetType() == Parameter::eType::MATRIX4X3 ? 3 : 4;
+            registersPerElement = constant.mColumns;
+            break;
+        default:
+            break;
+    }
 
-    uint32_t magic;
-    file.ReadDword(&magic);
-    if(magic != MAGIC)
+    uint32_t registerCount = registersPerElement * constant.mElements;
+    if(registerCount > UINT16_MAX)
+        return false;
+
+    constant.mRegisterCount = (uint16_t)registerCount;
+    return true;
+}
+
+//sections and bytecode of the extended format start at multiples of this, values and render states at multiples of 4
+static constexpr uint32_t EXTENDED_ALIGNMENT = 16;
+
+//what the classic format can store, anything past these used to be silently truncated
+static constexpr uint32_t CLASSIC_MAX_COUNT = UINT8_MAX;
+static constexpr uint32_t CLASSIC_MAX_SHADER_SIZE = UINT16_MAX;
+
+struct eEffectSection
+{
+    enum Enum : uint32_t
     {
-        Log::Error("\"%s\" is not an effect file.", file.GetFilePath());
+        VERTEX_PROGRAMS, PIXEL_PROGRAMS, GLOBAL_PARAMETERS, PARAMETERS, TECHNIQUES, COUNT
+    };
+};
+
+//the extended header is followed by SectionCount entries. readers skip sections they don't know
+struct ExtendedHeader
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t SectionCount;
+    uint32_t Reserved;
+};
+
+struct ExtendedSection
+{
+    eEffectSection::Enum Type;
+    uint32_t Count;
+    uint32_t Offset;
+    uint32_t Size;
+};
+
+ASSERT_SIZE(ExtendedHeader, 0x10);
+ASSERT_SIZE(ExtendedSection, 0x10);
+
+static inline size_t Align(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+//counts and string lengths are a byte in the classic format and a dword in the extended one
+static inline void WriteCount(OFileStream& file, eEffectFormat::Enum format, uint32_t count)
+{
+    if(format == eEffectFormat::EXTENDED)
+        file.WriteDword(&count);
+    else
+        file.WriteByte(&count);
+}
+
+static inline uint32_t ReadCount(IFileStream& file, eEffectFormat::Enum format)
+{
+    uint32_t count = 0;
+    if(format == eEffectFormat::EXTENDED)
+        file.ReadDword(&count);
+    else
+        file.ReadByte(&count);
+
+    return count;
+}
+
+//the extended format pads from the start of the file, the classic one is packed
+static inline void WritePadding(OFileStream& file, eEffectFormat::Enum format, size_t alignment)
+{
+    if(format != eEffectFormat::EXTENDED)
+        return;
+
+    static constexpr uint8_t sZeros[EXTENDED_ALIGNMENT] {};
+    size_t position = file.Tell();
+    file.Write(sZeros, Align(position, alignment) - position);
+}
+
+static inline void SkipPadding(IFileStream& file, eEffectFormat::Enum format, size_t alignment)
+{
+    if(format != eEffectFormat::EXTENDED)
         return;
+
+    size_t position = file.Tell();
+    file.Seek(Align(position, alignment) - position);
+}
+
+static inline void WriteString(OFileStream& file, eEffectFormat::Enum format, const char* str, size_t length)
+{
+    uint32_t strLen = (uint32_t)length + 1;
+    WriteCount(file, format, strLen);
+    file.Write(str, strLen);
+}
+
+static inline void WriteString(OFileStream& file, eEffectFormat::Enum format, const CString& str)
+{
+    WriteString(file, format, str.Get(), str.Length());
+}
+
+static inline void WriteString(OFileStream& file, eEffectFormat::Enum format, const InternedString& str)
+{
+    WriteString(file, format, str.Get(), str.Length());
+}
+
+//names and semantics repeat across effects, they go straight into the interner instead of getting a CString each
+static inline InternedString ReadInternedString(IFileStream& file, eEffectFormat::Enum format)
+{
+    uint32_t strLen = ReadCount(file, format);
+    if(strLen <= UINT8_MAX)
+    {
+        char str[UINT8_MAX + 1];
+        file.Read(str, strLen);
+        str[strLen] = '\0';
+        return str;
+    }
+
+    //only extended files have longer ones
+    std::string str(strLen, '\0');
+    file.Read(str.data(), strLen);
+    return str.c_str();
+}
+
+static inline void SkipString(IFileStream& file, eEffectFormat::Enum format)
+{
+    uint32_t strLen = ReadCount(file, format);
+    file.Seek(strLen);
+}
+
+//the inverse of the escapes HLSLTree::AddStringLiteral expands, so a string read back from the .fx is the one written
+static std::string EscapeString(const char* str)
+{
+    std::string escaped;
+    for(const char* c = str; *c; c++)
+    {
+        switch(*c)
+        {
+            case '"':  escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\t': escaped += "\\t"; break;
+            case '\r': escaped += "\\r"; break;
+
+            default:
+                if((uint8_t)*c < 0x20 || *c == 0x7F)
+                {
+                    char hex[8];
+                    snprintf(hex, sizeof(hex), "\\x%02X", (uint8_t)*c);
+                    escaped += hex;
+                }
+                else
+                    escaped += *c;
+            break;
+        }
+    }
+
+    return escaped;
+}
+
+//decodes count entries, or only records where each one starts if offsets is set
+template<typename T, typename CounterT>
+static void LoadEntries(IFileStream& file, eEffectFormat::Enum format, uint32_t count, rage::atArray<T, CounterT>& entries, rage::atArray<uint32_t>* offsets)
+{
+    entries = rage::atArray<T, CounterT>((CounterT)count);
+    if(offsets)
+        *offsets = rage::atArray<uint32_t>((uint16_t)count);
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        if(offsets)
+        {
+            offsets->Append() = (uint32_t)file.Tell();
+            entries.Append();
+            T::Skip(file, format);
+        }
+        else
+        {
+            entries.Append().Load(file, format);
+        }
+    }
+}
+
+//walks a file the way the Load functions do and stops at the first field that's out of bounds or that they couldn't handle
+class EffectValidator
+{
+public:
+    EffectValidator(const uint8_t* data, size_t size) : mData(data), mSize(size), mPosition(0), mFormat(eEffectFormat::CLASSIC),
+        mError(eEffectLoadError::NONE), mErrorOffset(0)
+    {}
+
+    bool ValidateEffect()
+    {
+        uint32_t magic;
+        if(!Dword(magic))
+            return false;
+
+        if(magic == Effect::MAGIC_EXTENDED)
+        {
+            mFormat = eEffectFormat::EXTENDED;
+            if(!ValidateSections())
+                return false;
+        }
+        else if(magic == Effect::MAGIC)
+        {
+            //the classic sections follow each other, each one starting with its count
+            for(uint32_t i = 0; i < eEffectSection::COUNT; i++)
+            {
+                uint32_t count;
+                if(!Count(count) || !ValidateEntries((eEffectSection::Enum)i, count))
+                    return false;
+            }
+        }
+        else
+        {
+            return Fail(eEffectLoadError::BAD_MAGIC, 0);
+        }
+
+        //programs come first in the file, their parameters can only be checked once every parameter has been seen.
+        //Save and SaveToFx look each one up by name or semantic
+        std::sort(mParameterHashes.begin(), mParameterHashes.end());
+        for(size_t offset : mProgramParamNames)
+        {
+            uint32_t hash = rage::atStringHash((const char*)mData + offset + LengthSize());
+            if(!std::binary_search(mParameterHashes.begin(), mParameterHashes.end(), hash))
+                return Fail(eEffectLoadError::UNDECLARED_PARAMETER, offset);
+        }
+
+        return true;
+    }
+
+    eEffectFormat::Enum GetFormat() const
+    {
+        return mFormat;
+    }
+    eEffectLoadError::Enum GetError() const
+    {
+        return mError;
+    }
+    size_t GetErrorOffset() const
+    {
+        return mErrorOffset;
+    }
+
+private:
+    bool ValidateSections()
+    {
+        size_t versionOffset = mPosition;
+        uint32_t version, sectionCount;
+        if(!Dword(version) || !Dword(sectionCount) || !Skip(sizeof(uint32_t)))
+            return false;
+        if(version != Effect::EXTENDED_VERSION)
+            return Fail(eEffectLoadError::BAD_VERSION, versionOffset);
+
+        size_t tableOffset = mPosition;
+        if(sectionCount > (mSize - mPosition) / sizeof(ExtendedSection))
+            return Fail(eEffectLoadError::TRUNCATED, mPosition);
+
+        bool seen[eEffectSection::COUNT] {};
+        for(uint32_t i = 0; i < sectionCount; i++)
+        {
+            size_t sectionOffset = tableOffset + i * sizeof(ExtendedSection);
+            ExtendedSection section;
+            memcpy(&section, mData + sectionOffset, sizeof(section));
+            if(section.Type >= eEffectSection::COUNT)
+                continue;
+
+            if(seen[section.Type] || section.Offset % EXTENDED_ALIGNMENT || section.Offset > mSize || section.Size > mSize - section.Offset)
+                return Fail(eEffectLoadError::BAD_SECTION, sectionOffset);
+            seen[section.Type] = true;
+            if(section.Count > UINT16_MAX)
+                return Fail(eEffectLoadError::TOO_MANY_ENTRIES, sectionOffset);
+
+            //entries can't run past the end of their section
+            size_t fileSize = mSize;
+            mPosition = section.Offset;
+            mSize = (size_t)section.Offset + section.Size;
+            bool valid = ValidateEntries(section.Type, section.Count);
+            mSize = fileSize;
+            if(!valid)
+                return false;
+        }
+
+        return true;
+    }
+
+    bool ValidateEntries(eEffectSection::Enum type, uint32_t count)
+    {
+        for(uint32_t i = 0; i < count; i++)
+        {
+            bool valid = false;
+            switch(type)
+            {
+                case eEffectSection::VERTEX_PROGRAMS:
+                case eEffectSection::PIXEL_PROGRAMS:
+                    valid = ValidateProgram();
+                break;
+                case eEffectSection::GLOBAL_PARAMETERS:
+                case eEffectSection::PARAMETERS:
+                    valid = ValidateParameter();
+                break;
+                case eEffectSection::TECHNIQUES:
+                    valid = ValidateTechnique();
+                break;
+                default:
+                break;
+            }
+
+            if(!valid)
+                return false;
+        }
+
+        return true;
+    }
+
+    bool ValidateProgram()
+    {
+        uint32_t paramCount;
+        if(!Count(paramCount))
+            return false;
+
+        for(uint32_t i = 0; i < paramCount; i++)
+        {
+            size_t typeOffset = mPosition;
+            uint8_t type;
+            if(!Byte(type))
+                return false;
+            if(type >= Parameter::eType::COUNT)
+                return Fail(eEffectLoadError::BAD_PARAMETER_TYPE, typeOffset);
+
+            //unknown and register index
+            if(!Skip(sizeof(uint8_t) + sizeof(uint16_t)))
+                return false;
+
+            mProgramParamNames.push_back(mPosition);
+            if(!String())
+                return false;
+        }
+
+        //the classic format has a word for the size and another for the compressed size, the extended one aligns the bytecode
+        size_t sizeOffset = mPosition;
+        uint32_t shaderSize;
+        if(mFormat == eEffectFormat::EXTENDED)
+        {
+            if(!Dword(shaderSize) || !Padding(EXTENDED_ALIGNMENT))
+                return false;
+        }
+        else
+        {
+            uint16_t classicSize;
+            if(!Word(classicSize) || !Skip(sizeof(uint16_t)))
+                return false;
+            shaderSize = classicSize;
+        }
+        if(shaderSize & 3)
+            return Fail(eEffectLoadError::BAD_SHADER_SIZE, sizeOffset);
+
+        return Skip(shaderSize);
+    }
+
+    bool ValidateParameter()
+    {
+        size_t typeOffset = mPosition;
+        uint8_t type;
+        uint32_t count;
+        if(!Byte(type) || !Count(count))
+            return false;
+        if(type >= Parameter::eType::COUNT)
+            return Fail(eEffectLoadError::BAD_PARAMETER_TYPE, typeOffset);
+        if(!count && type != Parameter::eType::TEXTURE)
+            count = 1;
+
+        for(uint32_t i = 0; i < 2; i++)
+        {
+            //name, then semantic
+            size_t stringOffset = mPosition;
+            if(!String())
+                return false;
+            mParameterHashes.push_back(rage::atStringHash((const char*)mData + stringOffset + LengthSize()));
+        }
+
+        uint32_t annotationCount;
+        if(!Count(annotationCount))
+            return false;
+        for(uint32_t i = 0; i < annotationCount; i++)
+        {
+            if(!String())
+                return false;
+
+            size_t annotationTypeOffset = mPosition;
+            uint8_t annotationType;
+            if(!Byte(annotationType))
+                return false;
+            if(annotationType >= eAnnotationType::COUNT)
+                return Fail(eEffectLoadError::BAD_ANNOTATION_TYPE, annotationTypeOffset);
+
+            if(annotationType == eAnnotationType::STRING ? !String() : !Skip(sizeof(uint32_t)))
+                return false;
+        }
+
+        size_t sizeOffset = mPosition;
+        uint32_t size;
+        if(!Count(size, UINT32_MAX / 4))
+            return false;
+        if(!size)
+            return true;
+        if(!Padding(sizeof(uint32_t)))
+            return false;
+
+        if(type == Parameter::eType::TEXTURE)
+        {
+            //SaveToFx writes count entries on top of the states
+            if(count)
+                return Fail(eEffectLoadError::BAD_PARAMETER_SIZE, sizeOffset);
+
+            size_t statesOffset = mPosition;
+            if(!Skip(4 * (size_t)size))
+                return false;
+
+            //SaveToFx looks up each state by its type
+            for(size_t i = 0; i < (4 * (size_t)size) / sizeof(SamplerState); i++)
+            {
+                uint32_t stateType;
+                memcpy(&stateType, mData + statesOffset + i * sizeof(SamplerState), sizeof(stateType));
+                if(stateType >= eSamplerStateType::COUNT)
+                    return Fail(eEffectLoadError::BAD_SAMPLER_STATE, statesOffset + i * sizeof(SamplerState));
+            }
+
+            return true;
+        }
+
+        //Load copies count elements of size / count dwords into slots of 4 * sParamTypeSizeFactor dwords
+        if(size / count > 4 * sParamTypeSizeFactor[type])
+            return Fail(eEffectLoadError::BAD_PARAMETER_SIZE, sizeOffset);
+
+        return Skip((size_t)count * (size / count) * 4);
+    }
+
+    bool ValidateTechnique()
+    {
+        if(!String())
+            return false;
+
+        uint32_t passCount;
+        if(!Count(passCount))
+            return false;
+        for(uint32_t i = 0; i < passCount; i++)
+        {
+            //vertex and pixel program index
+            size_t indexSize = mFormat == eEffectFormat::EXTENDED ? sizeof(uint16_t) : sizeof(uint8_t);
+            uint32_t stateCount;
+            if(!Skip(2 * indexSize) || !Count(stateCount) || !Padding(sizeof(uint32_t)))
+                return false;
+
+            size_t statesOffset = mPosition;
+            if(!Skip(stateCount * (sizeof(uint32_t) + sizeof(uint32_t))))
+                return false;
+
+            for(uint32_t j = 0; j < stateCount; j++)
+            {
+                uint32_t state;
+                memcpy(&state, mData + statesOffset + j * sizeof(RenderState), sizeof(state));
+                if(state >= eRenderStateType::COUNT)
+                    return Fail(eEffectLoadError::BAD_RENDER_STATE, statesOffset + j * sizeof(RenderState));
+            }
+        }
+
+        return true;
+    }
+
+    bool Fail(eEffectLoadError::Enum error, size_t offset)
+    {
+        mError = error;
+        mErrorOffset = offset;
+        return false;
+    }
+
+    bool Skip(size_t count)
+    {
+        if(count > mSize - mPosition)
+            return Fail(eEffectLoadError::TRUNCATED, mPosition);
+
+        mPosition += count;
+        return true;
+    }
+
+    bool Padding(size_t alignment)
+    {
+        if(mFormat != eEffectFormat::EXTENDED)
+            return true;
+
+        return Skip(Align(mPosition, alignment) - mPosition);
+    }
+
+    bool Byte(uint8_t& value)
+    {
+        if(!Skip(sizeof(uint8_t)))
+            return false;
+
+        value = mData[mPosition - sizeof(uint8_t)];
+        return true;
+    }
+
+    bool Word(uint16_t& value)
+    {
+        if(!Skip(sizeof(uint16_t)))
+            return false;
+
+        memcpy(&value, mData + mPosition - sizeof(uint16_t), sizeof(uint16_t));
+        return true;
+    }
+
+    bool Dword(uint32_t& value)
+    {
+        if(!Skip(sizeof(uint32_t)))
+            return false;
+
+        memcpy(&value, mData + mPosition - sizeof(uint32_t), sizeof(uint32_t));
+        return true;
     }
 
-    uint8_t shaderCount;
-    file.ReadByte(&shaderCount);
-    mVertexPrograms = rage::atArray<VertexProgram>(shaderCount);
-    for(uint16_t i = 0; i < shaderCount; i++)
+    size_t LengthSize() const
     {
-        mVertexPrograms.Append().Load(file);
+        return mFormat == eEffectFormat::EXTENDED ? sizeof(uint32_t) : sizeof(uint8_t);
     }
 
-    file.ReadByte(&shaderCount);
-    mPixelPrograms = rage::atArray<PixelProgram>(shaderCount);
-    for(uint16_t i = 0; i < shaderCount; i++)
+    //a byte in the classic format and a dword in the extended one. the arrays the loaders fill have 16 bit counters
+    bool Count(uint32_t& value, uint32_t max = UINT16_MAX)
+    {
+        size_t offset = mPosition;
+        if(mFormat != eEffectFormat::EXTENDED)
+        {
+            uint8_t byte;
+            if(!Byte(byte))
+                return false;
+            value = byte;
+            return true;
+        }
+
+        if(!Dword(value))
+            return false;
+        if(value > max)
+            return Fail(eEffectLoadError::TOO_MANY_ENTRIES, offset);
+
+        return true;
+    }
+
+    //the length includes the terminator, so a string is at least one byte that ends in '\0'
+    bool String()
+    {
+        size_t offset = mPosition;
+        uint32_t length;
+        if(!Count(length, UINT32_MAX) || !Skip(length))
+            return false;
+        if(!length || mData[mPosition - 1] != '\0')
+            return Fail(eEffectLoadError::BAD_STRING, offset);
+
+        return true;
+    }
+
+    const uint8_t* mData;
+    size_t mSize;
+    size_t mPosition;
+    eEffectFormat::Enum mFormat;
+    eEffectLoadError::Enum mError;
+    size_t mErrorOffset;
+    std::vector<size_t> mProgramParamNames;
+    std::vector<uint32_t> mParameterHashes;
+};
+
+eEffectLoadError::Enum Effect::Validate(const uint8_t* data, size_t size, size_t* errorOffset)
+{
+    EffectValidator validator(data, size);
+    validator.ValidateEffect();
+
+    if(errorOffset)
+        *errorOffset = validator.GetErrorOffset();
+    return validator.GetError();
+}
+
+Effect::Effect(IFileStream& file, eEffectLoadMode::Enum mode) : mFormat(eEffectFormat::CLASSIC), mLoadError(eEffectLoadError::NONE), mLoadErrorOffset(0)
+{
+    mFilePath = file.GetFilePath();
+
+    //one read for the whole file. it's validated before anything is decoded, the loaders trust every count and size they read
+    mFileData.resize(file.GetSize());
+    file.Seek(0, eSeekDir::BEGGINING);
+    if(!mFileData.empty() && !file.Read(mFileData.data(), mFileData.size()))
     {
-        mPixelPrograms.Append().Load(file);
+        mLoadError = eEffectLoadError::READ_FAILED;
+        Log::Error("\"%s\" is not a valid effect file: %s at offset 0x%zX", mFilePath.Get(), eEffectLoadError::EnumToString(mLoadError), mLoadErrorOffset);
+        mFileData.clear();
+        return;
     }
 
-    uint8_t paramCount;
-    file.ReadByte(&paramCount);
-    mGlobalParameters = rage::atArray<Parameter>(paramCount);
-    for(uint8_t i = 0; i < paramCount; i++)
+    LoadFromMemory(mode);
+
+    //only lazy effects decode from the file later
+    if(mode == eEffectLoadMode::FULL)
+        std::vector<uint8_t>().swap(mFileData);
+}
+
+Effect::Effect(const char* filePath, const uint8_t* data, size_t size, eEffectLoadMode::Enum mode) : mFormat(eEffectFormat::CLASSIC), mLoadError(eEffectLoadError::NONE),
+                                                                                                  mLoadErrorOffset(0), mExternalData(data, size)
+{
+    mFilePath = filePath;
+    LoadFromMemory(mode);
+
+    if(mode == eEffectLoadMode::FULL)
+        mExternalData = {};
+}
+
+void Effect::LoadFromMemory(eEffectLoadMode::Enum mode)
+{
+    std::span<const uint8_t> data = GetFileData();
+    mLoadError = Validate(data.data(), data.size(), &mLoadErrorOffset);
+    if(mLoadError != eEffectLoadError::NONE)
     {
-        mGlobalParameters.Append().Load(file);
+        Log::Error("\"%s\" is not a valid effect file: %s at offset 0x%zX", mFilePath.Get(), eEffectLoadError::EnumToString(mLoadError), mLoadErrorOffset);
+        mFileData.clear();
+        mExternalData = {};
+        return;
     }
 
-    file.ReadByte(&paramCount);
-    mParameters = rage::atArray<Parameter>(paramCount);
-    for(uint8_t i = 0; i < paramCount; i++)
+    IFileStream memoryFile(mFilePath.Get(), data.data(), data.size());
+    Load(memoryFile, mode == eEffectLoadMode::LAZY);
+}
+
+void Effect::Load(IFileStream& file, bool lazy)
+{
+    //validated by the constructor
+    uint32_t magic;
+    file.ReadDword(&magic);
+    if(magic == MAGIC_EXTENDED)
     {
-        mParameters.Append().Load(file);
+        LoadExtended(file, lazy);
+        return;
     }
 
-    uint8_t techCount;
-    file.ReadByte(&techCount);
-    mTechniques = rage::atArray<EffectTechnique>(techCount);
-    for(uint8_t i = 0; i < techCount; i++)
+    mFormat = eEffectFormat::CLASSIC;
+
+    uint32_t count = ReadCount(file, mFormat);
+    LoadEntries(file, mFormat, count, mVertexPrograms, lazy ? &mVertexProgramOffsets : nullptr);
+
+    count = ReadCount(file, mFormat);
+    LoadEntries(file, mFormat, count, mPixelPrograms, lazy ? &mPixelProgramOffsets : nullptr);
+
+    count = ReadCount(file, mFormat);
+    LoadEntries(file, mFormat, count, mGlobalParameters, lazy ? &mGlobalParameterOffsets : nullptr);
+
+    count = ReadCount(file, mFormat);
+    LoadEntries(file, mFormat, count, mParameters, lazy ? &mParameterOffsets : nullptr);
+
+    count = ReadCount(file, mFormat);
+    LoadEntries(file, mFormat, count, mTechniques, lazy ? &mTechniqueOffsets : nullptr);
+}
+
+void Effect::LoadExtended(IFileStream& file, bool lazy)
+{
+    mFormat = eEffectFormat::EXTENDED;
+
+    ExtendedHeader header;
+    file.Seek(0, eSeekDir::BEGGINING);
+    file.Read(&header, sizeof(header));
+
+    for(uint32_t i = 0; i < header.SectionCount; i++)
     {
-        mTechniques.Append().Load(file);
+        ExtendedSection section;
+        file.Seek(sizeof(ExtendedHeader) + i * sizeof(ExtendedSection), eSeekDir::BEGGINING);
+        file.Read(&section, sizeof(section));
+        file.Seek(section.Offset, eSeekDir::BEGGINING);
+
+        switch(section.Type)
+        {
+            case eEffectSection::VERTEX_PROGRAMS:
+                LoadEntries(file, mFormat, section.Count, mVertexPrograms, lazy ? &mVertexProgramOffsets : nullptr);
+            break;
+            case eEffectSection::PIXEL_PROGRAMS:
+                LoadEntries(file, mFormat, section.Count, mPixelPrograms, lazy ? &mPixelProgramOffsets : nullptr);
+            break;
+            case eEffectSection::GLOBAL_PARAMETERS:
+                LoadEntries(file, mFormat, section.Count, mGlobalParameters, lazy ? &mGlobalParameterOffsets : nullptr);
+            break;
+            case eEffectSection::PARAMETERS:
+                LoadEntries(file, mFormat, section.Count, mParameters, lazy ? &mParameterOffsets : nullptr);
+            break;
+            case eEffectSection::TECHNIQUES:
+                LoadEntries(file, mFormat, section.Count, mTechniques, lazy ? &mTechniqueOffsets : nullptr);
+            break;
+
+            //newer sections
+            default:
+            break;
+        }
     }
 }
 
-bool Effect::Save(const std::filesystem::path& filePath) const
+template<typename T, typename CounterT>
+void Effect::LoadEntry(rage::atArray<T, CounterT>& entries, rage::atArray<uint32_t>& offsets, uint32_t index) const
+{
+    //the offset is cleared after the entry is decoded, so a thread that sees 0 also sees the whole entry
+    if(index >= offsets.GetCount() || !std::atomic_ref(offsets[index]).load(std::memory_order_acquire))
+        return;
+
+    std::lock_guard lock(mLazyMutex);
+    uint32_t offset = std::atomic_ref(offsets[index]).load(std::memory_order_relaxed);
+    if(!offset)
+        return;
+
+    std::span<const uint8_t> data = GetFileData();
+    IFileStream file(mFilePath.Get(), data.data(), data.size());
+    file.Seek(offset, eSeekDir::BEGGINING);
+    entries[index].Load(file, mFormat);
+    std::atomic_ref(offsets[index]).store(0, std::memory_order_release);
+}
+
+void Effect::LoadAllEntries() const
+{
+    for(uint32_t i = 0; i < mVertexProgramOffsets.GetCount(); i++)
+        LoadEntry(mVertexPrograms, mVertexProgramOffsets, i);
+    for(uint32_t i = 0; i < mPixelProgramOffsets.GetCount(); i++)
+        LoadEntry(mPixelPrograms, mPixelProgramOffsets, i);
+    for(uint32_t i = 0; i < mGlobalParameterOffsets.GetCount(); i++)
+        LoadEntry(mGlobalParameters, mGlobalParameterOffsets, i);
+    for(uint32_t i = 0; i < mParameterOffsets.GetCount(); i++)
+        LoadEntry(mParameters, mParameterOffsets, i);
+    for(uint32_t i = 0; i < mTechniqueOffsets.GetCount(); i++)
+        LoadEntry(mTechniques, mTechniqueOffsets, i);
+}
+
+bool Effect::Save(const std::filesystem::path& filePath, eEffectFormat::Enum format) const
 {
+    //before the file is created so a failed save doesn't leave an empty one
+    LoadAllEntries();
+    if(format == eEffectFormat::CLASSIC && !FitsClassicFormat(filePath.string().c_str()))
+        return false;
+
     OFileStream file(filePath.string().c_str());
     if(!file.Open())
         return false;
 
-    file.WriteDword(&Effect::MAGIC);
+    return Save(file, format);
+}
+
+bool Effect::Save(OFileStream& file, eEffectFormat::Enum format) const
+{
+    LoadAllEntries();
+
+    if(format == eEffectFormat::CLASSIC && !FitsClassicFormat(file.GetFilePath()))
+        return false;
+
+    auto getCount = [this](uint32_t section) -> uint32_t
+    {
+        switch(section)
+        {
+            case eEffectSection::VERTEX_PROGRAMS:   return mVertexPrograms.GetCount();
+            case eEffectSection::PIXEL_PROGRAMS:    return mPixelPrograms.GetCount();
+            case eEffectSection::GLOBAL_PARAMETERS: return mGlobalParameters.GetCount();
+            case eEffectSection::PARAMETERS:        return mParameters.GetCount();
+            case eEffectSection::TECHNIQUES:        return mTechniques.GetCount();
+            default:                                return 0;
+        }
+    };
+
+    auto saveEntries = [&](uint32_t section)
+    {
+        for(uint32_t i = 0; i < getCount(section); i++)
+        {
+            switch(section)
+            {
+                case eEffectSection::VERTEX_PROGRAMS:   mVertexPrograms[i].Save(file, *this, format); break;
+                case eEffectSection::PIXEL_PROGRAMS:    mPixelPrograms[i].Save(file, *this, format); break;
+                case eEffectSection::GLOBAL_PARAMETERS: mGlobalParameters[i].Save(file, format); break;
+                case eEffectSection::PARAMETERS:        mParameters[i].Save(file, format); break;
+                case eEffectSection::TECHNIQUES:        mTechniques[i].Save(file, format); break;
+                default:                                break;
+            }
+        }
+    };
 
-    uint16_t shaderCount = mVertexPrograms.GetCount();
-    file.WriteByte(&shaderCount);
-    for(uint16_t i = 0; i < shaderCount; i++)
+    if(format == eEffectFormat::CLASSIC)
     {
-        mVertexPrograms[i].Save(file, *this);
+        file.WriteDword(&Effect::MAGIC);
+        for(uint32_t i = 0; i < eEffectSection::COUNT; i++)
+        {
+            WriteCount(file, format, getCount(i));
+            saveEntries(i);
+        }
+
+        return true;
     }
 
-    shaderCount = mPixelPrograms.GetCount();
-    file.WriteByte(&shaderCount);
-    for(uint16_t i = 0; i < shaderCount; i++)
+    //offsets are from the start of the stream like the alignment, the table is filled in once the sections are written
+    ExtendedHeader header {Effect::MAGIC_EXTENDED, Effect::EXTENDED_VERSION, eEffectSection::COUNT, 0};
+    file.Write(&header, sizeof(header));
+
+    ExtendedSection sections[eEffectSection::COUNT] {};
+    size_t tableOffset = file.Tell();
+    file.Write(sections, sizeof(sections));
+
+    for(uint32_t i = 0; i < eEffectSection::COUNT; i++)
     {
-        mPixelPrograms[i].Save(file, *this);
+        WritePadding(file, format, EXTENDED_ALIGNMENT);
+        size_t offset = file.Tell();
+        saveEntries(i);
+        sections[i] = {(eEffectSection::Enum)i, getCount(i), (uint32_t)offset, (uint32_t)(file.Tell() - offset)};
     }
 
-    uint16_t paramCount = mGlobalParameters.GetCount();
-    file.WriteByte(&paramCount);
-    for(uint16_t i = 0; i < paramCount; i++)
+    size_t end = file.Tell();
+    file.Seek(tableOffset, eSeekDir::BEGGINING);
+    file.Write(sections, sizeof(sections));
+    file.Seek(end, eSeekDir::BEGGINING);
+
+    return true;
+}
+
+static bool ClassicLimitError(const char* filePath, uint32_t value, uint32_t max, const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    std::string what = Log::FormatArgList(fmt, args);
+    va_end(args);
+
+    Log::Error("%s : %s is %u but the classic format stores at most %u, save it in the extended format instead", filePath, what.c_str(), value, max);
+    return false;
+}
+
+bool Effect::FitsClassicFormat(const char* filePath) const
+{
+    //strings are stored with their terminator
+    static constexpr uint32_t MAX_STRING_LENGTH = CLASSIC_MAX_COUNT - 1;
+
+    const rage::atArray<GpuProgram>* programs[] {&mVertexPrograms, &mPixelPrograms};
+    for(uint32_t i = 0; i < std::size(programs); i++)
     {
-        mGlobalParameters[i].Save(file);
+        const char* kind = i ? "pixel" : "vertex";
+        if(programs[i]->GetCount() > CLASSIC_MAX_COUNT)
+            return ClassicLimitError(filePath, programs[i]->GetCount(), CLASSIC_MAX_COUNT, "the number of %s programs", kind);
+
+        for(uint32_t j = 0; j < programs[i]->GetCount(); j++)
+        {
+            const GpuProgram& program = (*programs[i])[j];
+            if(program.mParams.GetCount() > CLASSIC_MAX_COUNT)
+                return ClassicLimitError(filePath, program.mParams.GetCount(), CLASSIC_MAX_COUNT, "the number of parameters of %s program %u", kind, j);
+            if(program.mShaderData.GetCapacity() > CLASSIC_MAX_SHADER_SIZE)
+                return ClassicLimitError(filePath, program.mShaderData.GetCapacity(), CLASSIC_MAX_SHADER_SIZE, "the bytecode size of %s program %u", kind, j);
+        }
     }
 
-    paramCount = mParameters.GetCount();
-    file.WriteByte(&paramCount);
-    for(uint8_t i = 0; i < paramCount; i++)
+    const rage::atArray<Parameter>* parameters[] {&mGlobalParameters, &mParameters};
+    for(uint32_t i = 0; i < std::size(parameters); i++)
     {
-        mParameters[i].Save(file);
+        if(parameters[i]->GetCount() > CLASSIC_MAX_COUNT)
+            return ClassicLimitError(filePath, parameters[i]->GetCount(), CLASSIC_MAX_COUNT, "the number of %sparameters", i ? "" : "global ");
+
+        for(const Parameter& param : *parameters[i])
+        {
+            const char* name = param.GetName();
+            if(param.mName.Length() > MAX_STRING_LENGTH)
+                return ClassicLimitError(filePath, param.mName.Length(), MAX_STRING_LENGTH, "the name length of parameter \"%.32s...\"", name);
+            if(param.mSemantic.Length() > MAX_STRING_LENGTH)
+                return ClassicLimitError(filePath, param.mSemantic.Length(), MAX_STRING_LENGTH, "the semantic length of parameter \"%s\"", name);
+            if(param.mCount > CLASSIC_MAX_COUNT)
+                return ClassicLimitError(filePath, param.mCount, CLASSIC_MAX_COUNT, "the array size of parameter \"%s\"", name);
+            if(param.mSize > CLASSIC_MAX_COUNT)
+                return ClassicLimitError(filePath, param.mSize, CLASSIC_MAX_COUNT, "the value size in dwords of parameter \"%s\"", name);
+            if(param.mAnnotationCount > CLASSIC_MAX_COUNT)
+                return ClassicLimitError(filePath, param.mAnnotationCount, CLASSIC_MAX_COUNT, "the number of annotations of parameter \"%s\"", name);
+
+            for(uint16_t j = 0; j < param.mAnnotationCount; j++)
+            {
+                const Annotation& annotation = param.mAnnotations[j];
+                if(annotation.mName.Length() > MAX_STRING_LENGTH)
+                    return ClassicLimitError(filePath, annotation.mName.Length(), MAX_STRING_LENGTH, "the name length of annotation %u of parameter \"%s\"", j, name);
+
+                uint32_t valueLength = annotation.mType == eAnnotationType::STRING ? (uint32_t)strlen(annotation.mValue.AsString) : 0;
+                if(valueLength > MAX_STRING_LENGTH)
+                    return ClassicLimitError(filePath, valueLength, MAX_STRING_LENGTH, "the length of annotation \"%s\" of parameter \"%s\"",
+                                             annotation.mName.Get(), name);
+            }
+        }
     }
 
-    uint16_t techCount = mTechniques.GetCount();
-    file.WriteByte(&techCount);
-    for(uint8_t i = 0; i < techCount; i++)
+    if(mTechniques.GetCount() > CLASSIC_MAX_COUNT)
+        return ClassicLimitError(filePath, mTechniques.GetCount(), CLASSIC_MAX_COUNT, "the number of techniques");
+
+    for(const EffectTechnique& technique : mTechniques)
     {
-        mTechniques[i].Save(file);
+        const char* name = technique.GetName();
+        if(technique.mName.Length() > MAX_STRING_LENGTH)
+            return ClassicLimitError(filePath, technique.mName.Length(), MAX_STRING_LENGTH, "the name length of technique \"%.32s...\"", name);
+        if(technique.mPasses.GetCount() > CLASSIC_MAX_COUNT)
+            return ClassicLimitError(filePath, technique.mPasses.GetCount(), CLASSIC_MAX_COUNT, "the number of passes of technique \"%s\"", name);
+
+        for(uint16_t i = 0; i < technique.mPasses.GetCount(); i++)
+        {
+            const EffectPass& pass = technique.mPasses[i];
+            if(pass.mVertexProgramIndex > CLASSIC_MAX_COUNT)
+                return ClassicLimitError(filePath, pass.mVertexProgramIndex, CLASSIC_MAX_COUNT, "the vertex program index of pass %u of technique \"%s\"", i, name);
+            if(pass.mPixelProgramIndex > CLASSIC_MAX_COUNT)
+                return ClassicLimitError(filePath, pass.mPixelProgramIndex, CLASSIC_MAX_COUNT, "the pixel program index of pass %u of technique \"%s\"", i, name);
+            if(pass.mRenderStates.GetCount() > CLASSIC_MAX_COUNT)
+                return ClassicLimitError(filePath, pass.mRenderStates.GetCount(), CLASSIC_MAX_COUNT, "the number of render states of pass %u of technique \"%s\"", i, name);
+        }
     }
 
     return true;
@@ -130,6 +1039,13 @@ bool Effect::SaveToFx(const std::filesystem::path& filePath) const
     if(!file.IsOpen())
         return false;
 
+    return SaveToFx(file);
+}
+
+bool Effect::SaveToFx(EffectWriter& file) const
+{
+    LoadAllEntries();
+
     file.WriteLine("//Globals");
     for(const Parameter& param : mGlobalParameters)
     {
@@ -222,48 +1138,77 @@ bool Effect::SaveToFx(const std::filesystem::path& filePath) const
     return true;
 }
 
-bool Effect::LoadFromFx(const HLSLParser& parser, DWORD shaderFlags, const D3DXMACRO* macros)
+bool Effect::LoadParametersFromFx(const HLSLParser& parser)
+{
+    bool result = true;
+    for(int i = 0; i < parser.m_variables.GetSize(); i++)
+    {
+        auto& var = parser.m_variables[i];
+        if(var.type.baseType == HLSLBaseType_Texture || var.type.baseType == HLSLBaseType_VertexShader || var.type.baseType == HLSLBaseType_PixelShader)
+            continue;
+
+        //a variable is declared before its initializer is parsed, one that failed to parse never made it into the tree
+        const HLSLDeclaration* declaration = parser.m_tree->FindGlobalDeclaration(var.name);
+        if(!declaration)
+            continue;
+
+        if(var.type.flags & HLSLTypeFlag_Shared)
+        {
+            if(!mGlobalParameters.Grow(64).LoadFromFx(*declaration, *parser.m_tree))
+                result = false;
+        }
+        else
+        {
+            if(!mParameters.Grow(64).LoadFromFx(*declaration, *parser.m_tree))
+                result = false;
+        }
+    }
+
+    return result;
+}
+
+bool Effect::LoadFromFx(const HLSLParser& parser, uint32_t shaderFlags)
 {
     mTechniques = {};
     mParameters = {};
     mGlobalParameters = {};
     mVertexPrograms = {};
     mPixelPrograms = {};
+    mTechniqueOffsets = {};
+    mParameterOffsets = {};
+    mGlobalParameterOffsets = {};
+    mVertexProgramOffsets = {};
+    mPixelProgramOffsets = {};
+    mFileData.clear();
+    mExternalData = {};
 
     mFilePath = parser.m_tokenizer.GetFileName();
 
-    ID3DXBuffer* shaderBuffer = nullptr;
-    ID3DXBuffer* errorBuffer = nullptr;
     //validate the shader with fxc first as it can give better error messages
-    if(FAILED(D3DXCompileShaderFromFileA(parser.m_tokenizer.GetFileName(), macros, nullptr, "", "fx_2_0", shaderFlags, &shaderBuffer, &errorBuffer, nullptr)))
+    const char* source = parser.m_tokenizer.GetPreProcessedSource();
+    ShaderBytecode effectData;
+    CString messages;
+    if(!GetCompilerBackend().Compile(source, strlen(source), "", "fx_2_0", shaderFlags, effectData, messages))
     {
-        if(errorBuffer && errorBuffer->GetBufferSize())
-            Log::Error((char*)errorBuffer->GetBufferPointer());
+        if(messages.Length())
+            Log::Error("%s", messages.Get());
         else
-            Log::Error("Failed to compile effect \"%s\"", mFilePath);
+            Log::Error("Failed to compile effect \"%s\"", mFilePath.Get());
         return false;
     }
 
-    for(int i = 0; i < parser.m_variables.GetSize(); i++)
-    {
-        auto& var = parser.m_variables[i];
-        if(var.type.baseType == HLSLBaseType_Texture || var.type.baseType == HLSLBaseType_VertexShader || var.type.baseType == HLSLBaseType_PixelShader)
-            continue;
-
-        if(var.type.flags & HLSLTypeFlag_Shared)
-        {
-            if(!mGlobalParameters.Grow(64).LoadFromFx(*parser.m_tree->FindGlobalDeclaration(var.name), *parser.m_tree))
-                return false;
-        }
-        else
-        {
-            if(!mParameters.Grow(64).LoadFromFx(*parser.m_tree->FindGlobalDeclaration(var.name), *parser.m_tree))
-                return false;
-        }
-    }
+    //keep going after a failure so every broken parameter, program and technique gets reported in one run
+    bool result = LoadParametersFromFx(parser);
 
     //find all shader functions
-    std::set<std::pair<uint32_t, const HLSLFunction*>> shaderFunctions;
+    //in order of first use so the output doesn't depend on where the parser allocated the functions
+    std::vector<std::pair<uint32_t, const HLSLFunction*>> shaderFunctions;
+    auto addShaderFunction = [&shaderFunctions](uint32_t type, const HLSLFunction* function)
+    {
+        std::pair<uint32_t, const HLSLFunction*> entry = {type, function};
+        if(std::find(shaderFunctions.begin(), shaderFunctions.end(), entry) == shaderFunctions.end())
+            shaderFunctions.push_back(entry);
+    };
     for(int i = 0; i < parser.m_techniques.GetSize(); i++)
     {
         for(auto pass = parser.m_techniques[i]->passes; pass; pass = pass->nextPass)
@@ -274,13 +1219,13 @@ bool Effect::LoadFromFx(const HLSLParser& parser, DWORD shaderFlags, const D3DXM
                 {
                     const HLSLFunction* function = parser.FindFunction(assignement->sValue);
                     if(function)
-                        shaderFunctions.emplace(0, function);
+                        addShaderFunction(0, function);
                 }
                 else if(strcmp(assignement->stateName, "PixelShader") == 0)
                 {
                     const HLSLFunction* function = parser.FindFunction(assignement->sValue);
                     if(function)
-                        shaderFunctions.emplace(1, function);
+                        addShaderFunction(1, function);
                 }
             }
         }
@@ -291,12 +1236,12 @@ bool Effect::LoadFromFx(const HLSLParser& parser, DWORD shaderFlags, const D3DXM
         if(function.first == 0)
         {
             if(!mVertexPrograms.Grow(16).LoadFromFunction(*function.second, parser.m_tokenizer.GetPreProcessedSource(), "vs_3_0", *this, shaderFlags))
-                return false;
+                result = false;
         }
         else
         {
             if(!mPixelPrograms.Grow(16).LoadFromFunction(*function.second, parser.m_tokenizer.GetPreProcessedSource(), "ps_3_0",  *this, shaderFlags))
-                return false;
+                result = false;
         }
     }
     for(int i = 0; i < parser.m_variables.GetSize(); i++)
@@ -307,12 +1252,12 @@ bool Effect::LoadFromFx(const HLSLParser& parser, DWORD shaderFlags, const D3DXM
         if(var.type.baseType == HLSLBaseType_VertexShader)
         {
             if(!mVertexPrograms.Grow(16).LoadFromAssembly(decl, *this))
-                return false;
+                result = false;
         }
         else if(var.type.baseType == HLSLBaseType_PixelShader)
         {
             if(!mPixelPrograms.Grow(16).LoadFromAssembly(decl, *this))
-                return false;
+                result = false;
         }
     }
 
@@ -321,10 +1266,10 @@ bool Effect::LoadFromFx(const HLSLParser& parser, DWORD shaderFlags, const D3DXM
     {
         auto technique = parser.m_techniques[i];
         if(!mTechniques.Append().LoadFromFx(technique, *this))
-            return false;
+            result = false;
     }
 
-    return true;
+    return result;
 }
 
 const Parameter* Effect::FindParameterByName(const char* name) const
@@ -336,7 +1281,8 @@ const Parameter* Effect::FindParameterByHash(uint32_t hash) const
 {
     for(uint16_t i = 0; i < mParameters.GetCount(); i++)
     {
-        if(mParameters[i].mNameHash == hash || mParameters[i].mSemanticHash == hash)
+        LoadEntry(mParameters, mParameterOffsets, i);
+        if(mParameters[i].GetNameHash() == hash || mParameters[i].GetSemanticHash() == hash)
             return &mParameters[i];
     }
 
@@ -352,7 +1298,8 @@ const Parameter* Effect::FindGlobalParameterByHash(uint32_t hash) const
 {
     for(uint16_t i = 0; i < mGlobalParameters.GetCount(); i++)
     {
-        if(mGlobalParameters[i].mNameHash == hash || mGlobalParameters[i].mSemanticHash == hash)
+        LoadEntry(mGlobalParameters, mGlobalParameterOffsets, i);
+        if(mGlobalParameters[i].GetNameHash() == hash || mGlobalParameters[i].GetSemanticHash() == hash)
             return &mGlobalParameters[i];
     }
 
@@ -362,9 +1309,63 @@ const Parameter* Effect::FindGlobalParameterByHash(uint32_t hash) const
 const Parameter* Effect::GetParameterAt(uint32_t index) const
 {
     assert(index >= 0 && index < mParameters.GetCount());
+    LoadEntry(mParameters, mParameterOffsets, index);
     return &mParameters[index];
 }
 
+uint32_t Effect::GetParameterCount() const
+{
+    return mParameters.GetCount();
+}
+
+const Parameter* Effect::GetGlobalParameterAt(uint32_t index) const
+{
+    assert(index < mGlobalParameters.GetCount());
+    LoadEntry(mGlobalParameters, mGlobalParameterOffsets, index);
+    return &mGlobalParameters[index];
+}
+
+uint32_t Effect::GetGlobalParameterCount() const
+{
+    return mGlobalParameters.GetCount();
+}
+
+const EffectTechnique* Effect::GetTechniqueAt(uint32_t index) const
+{
+    assert(index < mTechniques.GetCount());
+    LoadEntry(mTechniques, mTechniqueOffsets, index);
+    return &mTechniques[index];
+}
+
+uint32_t Effect::GetTechniqueCount() const
+{
+    return mTechniques.GetCount();
+}
+
+const VertexProgram* Effect::GetVertexProgramAt(uint32_t index) const
+{
+    assert(index < mVertexPrograms.GetCount());
+    LoadEntry(mVertexPrograms, mVertexProgramOffsets, index);
+    return &mVertexPrograms[index];
+}
+
+uint32_t Effect::GetVertexProgramCount() const
+{
+    return mVertexPrograms.GetCount();
+}
+
+const PixelProgram* Effect::GetPixelProgramAt(uint32_t index) const
+{
+    assert(index < mPixelPrograms.GetCount());
+    LoadEntry(mPixelPrograms, mPixelProgramOffsets, index);
+    return &mPixelPrograms[index];
+}
+
+uint32_t Effect::GetPixelProgramCount() const
+{
+    return mPixelPrograms.GetCount();
+}
+
 uint32_t Effect::GetShaderIndex(const char* name) const
 {
     return GetShaderIndex(rage::atStringHash(name));
@@ -383,16 +1384,18 @@ uint32_t Effect::GetShaderIndex(uint32_t hash) const
         if(mPixelPrograms[i].mNameHash == hash)
             return i;
     }
+
+    return UINT32_MAX;
 }
 
 CString Effect::GetVertexShaderDisassembly(uint32_t index) const
 {
-    return mVertexPrograms[index].GetDisassembly();
+    return GetVertexProgramAt(index)->GetDisassembly();
 }
 
 CString Effect::GetPixelShaderDisassembly(uint32_t index) const
 {
-    return mPixelPrograms[index].GetDisassembly();
+    return GetPixelProgramAt(index)->GetDisassembly();
 }
 
 const char* Effect::GetFilePath() const
@@ -400,6 +1403,117 @@ const char* Effect::GetFilePath() const
     return mFilePath.Get();
 }
 
+//keeps the parameters a program binds by name or semantic. strings can't be bound and are kept as they are only there for the game
+static void PruneParametersOfType(rage::atArray<Parameter>& parameters, const std::set<uint32_t>& boundHashes, const char* kind, uint32_t& removedCount)
+{
+    rage::atArray<Parameter> kept(parameters.GetCount());
+    for(const Parameter& param : parameters)
+    {
+        if(param.GetType() != Parameter::eType::STRING && !boundHashes.contains(param.GetNameHash()) && !boundHashes.contains(param.GetSemanticHash()))
+        {
+            Log::Info("    removed %s \"%s\"", kind, param.GetName());
+            removedCount++;
+            continue;
+        }
+
+        kept.Append() = param;
+    }
+    parameters = kept;
+}
+
+void Effect::Prune()
+{
+    LoadAllEntries();
+    mTechniqueOffsets = {};
+    mParameterOffsets = {};
+    mGlobalParameterOffsets = {};
+    mVertexProgramOffsets = {};
+    mPixelProgramOffsets = {};
+    mFileData.clear();
+    mExternalData = {};
+
+    std::vector<uint8_t> data;
+    OFileStream before(mFilePath.Get(), data);
+    Save(before);
+    size_t sizeBefore = data.size();
+
+    Log::Info("pruning effect \"%s\"", mFilePath.Get());
+
+    //keeps the programs of one kind that a pass uses and points the passes at their new indices.
+    //programs go first so parameters only the removed programs used go with them
+    uint32_t programCount = 0;
+    auto pruneProgramsOfType = [&](rage::atArray<GpuProgram>& programs, bool pixel)
+    {
+        std::vector<int32_t> remap(programs.GetCount(), -1);
+        for(EffectTechnique& technique : mTechniques)
+        {
+            for(EffectPass& pass : technique.mPasses)
+            {
+                uint16_t index = pixel ? pass.mPixelProgramIndex : pass.mVertexProgramIndex;
+                if(index < remap.size())
+                    remap[index] = 0;
+            }
+        }
+
+        rage::atArray<GpuProgram> kept(programs.GetCount());
+        for(uint16_t i = 0; i < programs.GetCount(); i++)
+        {
+            if(remap[i] == -1)
+            {
+                Log::Info("    removed %s %u", pixel ? "PixelShader" : "VertexShader", i);
+                programCount++;
+                continue;
+            }
+
+            remap[i] = kept.GetCount();
+            kept.Append() = programs[i];
+        }
+        programs = kept;
+
+        for(EffectTechnique& technique : mTechniques)
+        {
+            for(EffectPass& pass : technique.mPasses)
+            {
+                uint16_t& index = pixel ? pass.mPixelProgramIndex : pass.mVertexProgramIndex;
+                if(index < remap.size())
+                    index = (uint16_t)remap[index];
+            }
+        }
+    };
+    pruneProgramsOfType(mVertexPrograms, false);
+    pruneProgramsOfType(mPixelPrograms, true);
+
+    std::set<uint32_t> boundHashes;
+    for(const rage::atArray<GpuProgram>* programs : {&mVertexPrograms, &mPixelPrograms})
+    {
+        for(const GpuProgram& program : *programs)
+        {
+            for(const GpuProgram::Param& param : program.mParams)
+                boundHashes.insert(param.mName.GetHash());
+        }
+    }
+
+    uint32_t parameterCount = 0;
+    PruneParametersOfType(mGlobalParameters, boundHashes, "shared parameter", parameterCount);
+    PruneParametersOfType(mParameters, boundHashes, "parameter", parameterCount);
+
+    data.clear();
+    OFileStream after(mFilePath.Get(), data);
+    Save(after);
+
+    Log::Info("removed %u programs and %u parameters, saved %zu bytes", programCount, parameterCount, sizeBefore - data.size());
+}
+
+void Effect::CanonicalizeRenderStates()
+{
+    LoadAllEntries();
+    for(EffectTechnique& technique : mTechniques)
+    {
+        for(EffectPass& pass : technique.mPasses)
+            pass.CanonicalizeRenderStates();
+    }
+}
+
 void Effect::SaveProgramParametersToFx(EffectWriter& file, const GpuProgram& program) const
 {
     file.WriteLine("<");
@@ -409,18 +1523,18 @@ void Effect::SaveProgramParametersToFx(EffectWriter& file, const GpuProgram& pro
     for(auto& param : program.mParams)
     {
         const Parameter* fxParam;
-        fxParam = FindParameterByHash(param.mNameHash);
+        fxParam = FindParameterByHash(param.mName.GetHash());
         if(!fxParam)
-            fxParam = FindGlobalParameterByHash(param.mNameHash);
-        longestNameLen = max(longestNameLen, strlen(fxParam->GetName()));
+            fxParam = FindGlobalParameterByHash(param.mName.GetHash());
+        longestNameLen = std::max(longestNameLen, strlen(fxParam->GetName()));
     }
 
     for(auto& param : program.mParams)
     {
         const Parameter* fxParam;
-        fxParam = FindParameterByHash(param.mNameHash);
+        fxParam = FindParameterByHash(param.mName.GetHash());
         if(!fxParam)
-            fxParam = FindGlobalParameterByHash(param.mNameHash);
+            fxParam = FindGlobalParameterByHash(param.mName.GetHash());
         file.WriteIndented("string %s ", fxParam->GetName());
         for(size_t i = 0; i < longestNameLen - strlen(fxParam->GetName()); i++)
             file.Write(" ");
@@ -446,72 +1560,94 @@ GpuProgram& GpuProgram::operator=(const GpuProgram& rhs)
     return *this;
 }
 
-void GpuProgram::Save(OFileStream& file, const Effect& effect) const
+void GpuProgram::Save(OFileStream& file, const Effect& effect, eEffectFormat::Enum format) const
 {
     uint32_t paramCount = (uint32_t)mParams.GetCount();
-    file.WriteByte(&paramCount);
+    WriteCount(file, format, paramCount);
     if(paramCount)
     {
         for(uint32_t i = 0; i < paramCount; i++)
         {
-            mParams[i].Save(file, effect);
+            mParams[i].Save(file, effect, format);
         }
     }
 
-    uint16_t shaderSize = mShaderData.GetCapacity();
-    file.WriteWord(&shaderSize);
-    file.WriteWord(&shaderSize);
+    uint32_t shaderSize = mShaderData.GetCapacity();
+    if(format == eEffectFormat::EXTENDED)
+    {
+        file.WriteDword(&shaderSize);
+        WritePadding(file, format, EXTENDED_ALIGNMENT);
+    }
+    else
+    {
+        file.WriteWord(&shaderSize);
+        file.WriteWord(&shaderSize);
+    }
 
     if(shaderSize)
         file.Write(&mShaderData[0], shaderSize);
 }
 
-void GpuProgram::Load(IFileStream& file)
+void GpuProgram::Load(IFileStream& file, eEffectFormat::Enum format)
 {
-    uint8_t paramCount;
-    file.ReadByte(&paramCount);
+    uint32_t paramCount = ReadCount(file, format);
     if(paramCount)
     {
         mParams = {(uint16_t)paramCount};
         for(uint32_t i = 0; i < paramCount; i++)
         {
-            mParams.Append().Load(file);
+            mParams.Append().Load(file, format);
         }
     }
 
-    uint16_t shaderSize;
-    file.ReadWord(&shaderSize);
-    //compressed size. only supported by vertex shaders and not used by any of the game's shaders so i ignore it
-    file.Seek(sizeof(uint16_t));
+    uint32_t shaderSize = 0;
+    if(format == eEffectFormat::EXTENDED)
+    {
+        file.ReadDword(&shaderSize);
+        SkipPadding(file, format, EXTENDED_ALIGNMENT);
+    }
+    else
+    {
+        file.ReadWord(&shaderSize);
+        //compressed size. only supported by vertex shaders and not used by any of the game's shaders so i ignore it
+        file.Seek(sizeof(uint16_t));
+    }
 
     if(shaderSize)
     {
         mShaderData = {shaderSize};
         file.Read(&mShaderData[0], shaderSize);
     }
-}
 
-bool GpuProgram::LoadFromAssembly(const HLSLDeclaration& declaration, const class Effect& effect)
-{
-    if(!declaration.assignment)
-        return true;
+    //the game binds parameters to the registers stored above, check them against the shader's own constant table.
+    //shaders assembled from asm have no table to check against
+    ConstantTable constantTable;
+    if(!constantTable.Init(mShaderData))
+        return;
 
-    const HLSLShaderObjectExpression& expr = (HLSLShaderObjectExpression&)*declaration.assignment;
-    ID3DXBuffer* shaderBuffer = nullptr;
-    ID3DXBuffer* errorBuffer = nullptr;
-    if(FAILED(D3DXAssembleShader(expr.source, strlen(expr.source), nullptr, nullptr, 0, &shaderBuffer, &errorBuffer)))
+    for(const Param& param : mParams)
     {
-        if(errorBuffer && errorBuffer->GetBufferSize())
-            Log::Error((char*)errorBuffer->GetBufferPointer());
-        else
-            Log::Error("Failed to compile shader \"%s\"", declaration.name);
-        return false;
+        int32_t index = constantTable.FindConstant(param.mName.GetHash());
+        if(index < 0)
+        {
+            Log::Warn("%s : shader parameter \"%s\" is missing from the shader's constant table", file.GetFilePath(), param.mName.Get());
+        }
+        else if(constantTable.GetConstant(index).RegisterIndex != param.mRegisterIndex)
+        {
+            Log::Warn("%s : shader parameter \"%s\" is bound to register %d but the shader uses register %d", file.GetFilePath(),
+                      constantTable.GetConstantName(index), param.mRegisterIndex, constantTable.GetConstant(index).RegisterIndex);
+        }
     }
+}
 
+bool GpuProgram::LoadFromAssembly(const HLSLDeclaration& declaration, const class Effect& effect)
+{
+    //null programs still need their name, passes look them up by it
     mNameHash = rage::atStringHash(declaration.name);
-    mShaderData = {shaderBuffer->GetBufferSize()};
-    memcpy(&mShaderData[0], shaderBuffer->GetBufferPointer(), (size_t)shaderBuffer->GetBufferSize());
+    if(!declaration.assignment)
+        return true;
 
+    rage::atArray<ShaderConstant> constants;
     for(HLSLAnnotation* annotation = declaration.annotations; annotation; annotation = annotation->nextAnnotation)
     {
         if(annotation->type != HLSLAnnotationType_String || memcmp(annotation->sValue, "parameter", sizeof("parameter") - 1) != 0)
@@ -532,10 +1668,10 @@ bool GpuProgram::LoadFromAssembly(const HLSLDeclaration& declaration, const clas
         }
 
         mParams.Grow(16);
-        mParams.Back().mNameHash = rage::atStringHash(annotation->name);
-        auto param = effect.FindParameterByHash(mParams.Back().mNameHash);
+        mParams.Back().mName = annotation->name;
+        auto param = effect.FindParameterByHash(mParams.Back().mName.GetHash());
         if(!param)
-            param = effect.FindGlobalParameterByHash(mParams.Back().mNameHash);
+            param = effect.FindGlobalParameterByHash(mParams.Back().mName.GetHash());
         if(!param)
         {
             Log::Error("%s(%d) : undeclared parameter \"%s\"", annotation->fileName, annotation->line, annotation->name);
@@ -543,52 +1679,84 @@ bool GpuProgram::LoadFromAssembly(const HLSLDeclaration& declaration, const clas
         }
         mParams.Back().mType = param->GetType();
         mParams.Back().mRegisterIndex = atoi(registerStrStart);
+
+        ShaderConstant& constant = constants.Grow(16);
+        constant.mName = annotation->name;
+        constant.mRegisterIndex = mParams.Back().mRegisterIndex;
+        if(!SetShaderConstantType(constant, *param))
+        {
+            Log::Error("%s(%d) : parameter \"%s\" takes more registers than a constant table can hold", annotation->fileName, annotation->line, annotation->name);
+            return false;
+        }
+    }
+
+    const HLSLShaderObjectExpression& expr = (HLSLShaderObjectExpression&)*declaration.assignment;
+    CString messages;
+    eAssembleResult::Enum result = ShaderAssembler::Assemble(expr.source, strlen(expr.source), constants, mShaderData, messages);
+    if(result == eAssembleResult::SYNTAX_ERROR)
+    {
+        Log::Error("%s(%d) : %s: asm %s", expr.fileName, expr.line, declaration.name, messages.Get());
+        return false;
+    }
+    else if(result == eAssembleResult::UNSUPPORTED)
+    {
+        //older shader models and instructions the native assembler doesn't know still go through the compiler
+        messages = CString();
+        if(!GetCompilerBackend().Assemble(expr.source, strlen(expr.source), mShaderData, messages))
+        {
+            if(messages.Length())
+                Log::Error("%s", messages.Get());
+            else
+                Log::Error("Failed to compile shader \"%s\"", declaration.name);
+            return false;
+        }
     }
 
     return true;
 }
 
-bool GpuProgram::LoadFromFunction(const HLSLFunction& function, const char* source, const char* profile, const class Effect& effect, DWORD shaderFlags)
+bool GpuProgram::LoadFromFunction(const HLSLFunction& function, const char* source, const char* profile, const class Effect& effect, uint32_t shaderFlags)
 {
-    ID3DXBuffer* shaderBuffer = nullptr;
-    ID3DXBuffer* errorBuffer = nullptr;
-    ID3DXConstantTable* ctable;
-    HRESULT hr = D3DXCompileShader(source, strlen(source), nullptr, nullptr, function.name, profile, shaderFlags, &shaderBuffer, &errorBuffer, &ctable);
-    if(FAILED(hr))
+    CompilerBackend& backend = GetCompilerBackend();
+
+    CString messages;
+    if(!backend.Compile(source, strlen(source), function.name, profile, shaderFlags, mShaderData, messages))
     {
-        if(errorBuffer && errorBuffer->GetBufferSize())
-            Log::Error((char*)errorBuffer->GetBufferPointer());
+        if(messages.Length())
+            Log::Error("%s", messages.Get());
         else
             Log::Error("Failed to compile effect \"%s\"", function.name);
         return false;
     }
-    else if(errorBuffer)
+    else if(messages.Length())
     {
-        SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), FOREGROUND_RED | FOREGROUND_GREEN);
-        Log::Info("%s, %s", function.name, (char*)errorBuffer->GetBufferPointer());
-        SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE);
+        Log::Warn("%s, %s", function.name, messages.Get());
     }
 
     mNameHash = rage::atStringHash(function.name);
-    mShaderData = {shaderBuffer->GetBufferSize()};
-    memcpy(&mShaderData[0], shaderBuffer->GetBufferPointer(), (size_t)shaderBuffer->GetBufferSize());
 
-    D3DXCONSTANTTABLE_DESC tableDesc {};
-    ctable->GetDesc(&tableDesc);
-    mParams = {(uint16_t)tableDesc.Constants};
-    for(uint32_t i = 0; i < tableDesc.Constants; i++)
+    ConstantTable constantTable;
+    if(!constantTable.Init(mShaderData))
     {
-        D3DXHANDLE constantHandle = ctable->GetConstant(0, i);
-        D3DXCONSTANT_DESC constantDesc {};
-        uint32_t constantCount = 1;
-        ctable->GetConstantDesc(constantHandle, &constantDesc, &constantCount);
+        Log::Error("Failed to read the constant table of \"%s\"", function.name);
+        return false;
+    }
 
+    mParams = {(uint16_t)constantTable.GetConstantCount()};
+    for(uint32_t i = 0; i < constantTable.GetConstantCount(); i++)
+    {
+        const char* name = constantTable.GetConstantName(i);
         mParams.Append();
-        mParams.Back().mNameHash = rage::atStringHash(constantDesc.Name);
-        mParams.Back().mRegisterIndex = constantDesc.RegisterIndex;
-        auto param = effect.FindParameterByHash(mParams.Back().mNameHash);
+        mParams.Back().mName = name;
+        mParams.Back().mRegisterIndex = constantTable.GetConstant(i).RegisterIndex;
+        auto param = effect.FindParameterByHash(mParams.Back().mName.GetHash());
         if(!param)
-            param = effect.FindGlobalParameterByHash(mParams.Back().mNameHash);
+            param = effect.FindGlobalParameterByHash(mParams.Back().mName.GetHash());
+        if(!param)
+        {
+            Log::Error("%s(%d) : \"%s\" uses undeclared parameter \"%s\"", function.fileName, function.line, function.name, name);
+            return false;
+        }
         mParams.Back().mType = param->GetType();
     }
 
@@ -600,42 +1768,71 @@ CString GpuProgram::GetDisassembly() const
     if(!mShaderData.GetCapacity())
         return "";
 
-    ID3DXBuffer* disasm;
-    D3DXDisassembleShader((DWORD*)&mShaderData[0], 0, nullptr, &disasm);
-    CString disassembly = (char*)disasm->GetBufferPointer();
-    disasm->Release();
+    CString disassembly;
+    if(!GetCompilerBackend().Disassemble(mShaderData, disassembly) || !disassembly.Get())
+        return "";
 
     return disassembly;
 }
 
+uint32_t GpuProgram::GetInstructionCount() const
+{
+    ShaderStats stats;
+    stats.Init(mShaderData);
+    return stats.Instructions;
+}
+
 
-void GpuProgram::Param::Save(OFileStream& file, const Effect& effect) const
+void GpuProgram::Param::Save(OFileStream& file, const Effect& effect, eEffectFormat::Enum format) const
 {
     file.WriteByte(&mType);
     file.WriteByte(&mUnknown);
     file.WriteWord(&mRegisterIndex);
 
-    auto param = effect.FindParameterByHash(mNameHash);
+    auto param = effect.FindParameterByHash(mName.GetHash());
     if(!param)
-        param = effect.FindGlobalParameterByHash(mNameHash);
+        param = effect.FindGlobalParameterByHash(mName.GetHash());
 
     CString name;
-    if(mNameHash == param->GetNameHash())
+    if(mName.GetHash() == param->GetNameHash())
         name = param->GetName();
     else
         name = param->GetSemantic();
 
-    WriteString(file, name);
+    WriteString(file, format, name);
+}
+
+void GpuProgram::Skip(IFileStream& file, eEffectFormat::Enum format)
+{
+    uint32_t paramCount = ReadCount(file, format);
+    for(uint32_t i = 0; i < paramCount; i++)
+    {
+        //type, unknown and register index, then the name
+        file.Seek(sizeof(uint8_t) + sizeof(uint8_t) + sizeof(uint16_t));
+        SkipString(file, format);
+    }
+
+    uint32_t shaderSize = 0;
+    if(format == eEffectFormat::EXTENDED)
+    {
+        file.ReadDword(&shaderSize);
+        SkipPadding(file, format, EXTENDED_ALIGNMENT);
+    }
+    else
+    {
+        file.ReadWord(&shaderSize);
+        file.Seek(sizeof(uint16_t));
+    }
+    file.Seek(shaderSize);
 }
 
-void GpuProgram::Param::Load(IFileStream& file)
+void GpuProgram::Param::Load(IFileStream& file, eEffectFormat::Enum format)
 {
     file.ReadByte(&mType);
     file.ReadByte(&mUnknown);
     file.ReadWord(&mRegisterIndex);
 
-    CString name = ReadString(file);
-    mNameHash = rage::atStringHash(name.Get());
+    mName = ReadInternedString(file, format);
 }
 
 
@@ -643,16 +1840,14 @@ Parameter& Parameter::operator=(const Parameter& rhs)
 {
     mType = rhs.mType;
     mCount = rhs.mCount;
-    mSize = rhs.mCount;
+    mSize = rhs.mSize;
     mAnnotationCount = rhs.mAnnotationCount;
 
     mName = rhs.mName;
-    mNameHash = rhs.mNameHash;
     mSemantic = rhs.mSemantic;
-    mSemanticHash = rhs.mSemanticHash;
 
     mAnnotations = new Annotation[mAnnotationCount];
-    for(uint8_t i = 0; i < mAnnotationCount; i++)
+    for(uint16_t i = 0; i < mAnnotationCount; i++)
     {
         mAnnotations[i] = rhs.mAnnotations[i];
     }
@@ -680,36 +1875,35 @@ uint32_t Parameter::GetTotalSize() const
     return mCount * 16 * sParamTypeSizeFactor[(uint32_t)mType];
 }
 
-void Parameter::Save(OFileStream& file) const
+void Parameter::Save(OFileStream& file, eEffectFormat::Enum format) const
 {
     file.WriteByte(&mType);
 
     if(mCount == 1 && mType != eType::TEXTURE)
-    {
-        uint8_t b = 0;
-        file.WriteByte(&b);
-    }
+        WriteCount(file, format, 0);
     else
-        file.WriteByte(&mCount);
+        WriteCount(file, format, mCount);
 
-    WriteString(file, mName);
-    WriteString(file, mSemantic);
+    WriteString(file, format, mName);
+    WriteString(file, format, mSemantic);
 
-    file.WriteByte(&mAnnotationCount);
+    WriteCount(file, format, mAnnotationCount);
 
     if(mAnnotationCount)
     {
-        for(uint8_t i = 0; i < mAnnotationCount; i++)
+        for(uint16_t i = 0; i < mAnnotationCount; i++)
         {
-            mAnnotations[i].Save(file);
+            mAnnotations[i].Save(file, format);
         }
     }
 
-    file.WriteByte(&mSize);
+    WriteCount(file, format, mSize);
 
     if(!mSize)
         return;
 
+    WritePadding(file, format, sizeof(uint32_t));
+
     if(mType == eType::TEXTURE)
     {
         file.Write(mValue.AsVoid, 4 * mSize);
@@ -718,49 +1912,51 @@ void Parameter::Save(OFileStream& file) const
     {
         uint32_t totalSize = 4 * mCount * sParamTypeSizeFactor[(uint8_t)mType];
 
-        uint32_t srcStride = (mSize / mCount) * 4;
-        uint32_t dstStride = (totalSize / mCount) * 4;
-        uint8_t* dst = (uint8_t*)mValue.AsVoid;
-
-        for(uint8_t i = 0; i < mCount; i++)
+        uint32_t fileStride = (mSize / mCount) * 4;
+        uint32_t registerStride = (totalSize / mCount) * 4;
+        if(fileStride == registerStride)
         {
-            file.Write(dst, srcStride);
-            dst += dstStride;
+            file.Write(mValue.AsVoid, (std::streamsize)fileStride * mCount);
+            return;
         }
+
+        std::vector<uint8_t> values((size_t)fileStride * mCount);
+        CompactParameterValues(values.data(), fileStride, (const uint8_t*)mValue.AsVoid, registerStride, mCount);
+        file.Write(values.data(), values.size());
     }
 }
 
-void Parameter::Load(IFileStream& file)
+void Parameter::Load(IFileStream& file, eEffectFormat::Enum format)
 {
     file.ReadByte(&mType);
-    file.ReadByte(&mCount);
+    mCount = (uint16_t)ReadCount(file, format);
 
     if(!mCount && mType != eType::TEXTURE)
     {
         mCount = 1;
     }
 
-    mName = ReadString(file);
-    mNameHash = rage::atStringHash(mName.Get());
-    mSemantic = ReadString(file);
-    mSemanticHash = rage::atStringHash(mSemantic.Get());
+    mName = ReadInternedString(file, format);
+    mSemantic = ReadInternedString(file, format);
 
-    file.ReadByte(&mAnnotationCount);
+    mAnnotationCount = (uint16_t)ReadCount(file, format);
 
     if(mAnnotationCount)
     {
         mAnnotations = new Annotation[mAnnotationCount];
-        for(uint8_t i = 0; i < mAnnotationCount; i++)
+        for(uint16_t i = 0; i < mAnnotationCount; i++)
         {
-            mAnnotations[i].Load(file);
+            mAnnotations[i].Load(file, format);
         }
     }
 
-    file.ReadByte(&mSize);
+    mSize = ReadCount(file, format);
 
     if(!mSize)
         return;
 
+    SkipPadding(file, format, sizeof(uint32_t));
+
     if(mType == eType::TEXTURE)
     {
         mValue.AsVoid = new uint8_t[4 * mSize];
@@ -772,16 +1968,50 @@ void Parameter::Load(IFileStream& file)
         mValue.AsVoid = new uint8_t[4 * totalSize];
         memset(mValue.AsVoid, 0, 4 * totalSize);
 
-        uint32_t srcStride = (mSize / mCount) * 4;
-        uint32_t dstStride = (totalSize / mCount) * 4;
-        uint8_t* dst = (uint8_t*)mValue.AsVoid;
+        uint32_t fileStride = (mSize / mCount) * 4;
+        uint32_t registerStride = (totalSize / mCount) * 4;
+        size_t fileSize = (size_t)fileStride * mCount;
 
-        for(uint8_t i = 0; i < mCount; i++)
+        //straight from the effect loaded in memory, only streams over a file need the copy
+        std::vector<uint8_t> values;
+        const uint8_t* src = file.ReadInPlace(fileSize);
+        if(!src)
         {
-            file.Read(dst, srcStride);
-            dst += dstStride;
+            values.resize(fileSize);
+            file.Read(values.data(), fileSize);
+            src = values.data();
         }
+
+        ExpandParameterValues((uint8_t*)mValue.AsVoid, registerStride, src, fileStride, mCount);
+    }
+}
+
+void Parameter::Skip(IFileStream& file, eEffectFormat::Enum format)
+{
+    eType::Enum type;
+    file.ReadByte(&type);
+    uint32_t count = ReadCount(file, format);
+    if(!count && type != eType::TEXTURE)
+        count = 1;
+
+    SkipString(file, format);
+    SkipString(file, format);
+
+    uint32_t annotationCount = ReadCount(file, format);
+    for(uint32_t i = 0; i < annotationCount; i++)
+    {
+        Annotation::Skip(file, format);
     }
+
+    uint32_t size = ReadCount(file, format);
+    if(!size)
+        return;
+
+    SkipPadding(file, format, sizeof(uint32_t));
+    if(type == eType::TEXTURE)
+        file.Seek(4 * (std::streamoff)size);
+    else
+        file.Seek(count * (size / count) * 4);
 }
 
 void Parameter::SaveToFx(EffectWriter& file, bool isGlobal) const
@@ -815,34 +2045,18 @@ void Parameter::SaveToFx(EffectWriter& file, bool isGlobal) const
         if(mAnnotationCount)
         {
             file.Write(" <");
-            for(uint8_t i = 0; i < mAnnotationCount; i++)
+            for(uint16_t i = 0; i < mAnnotationCount; i++)
             {
                 const auto& annotation = mAnnotations[i];
 
-                file.Write("%s %s = ", eAnnotationType::EnumToString(annotation.mType), annotation.mName);
+                file.Write("%s %s = ", eAnnotationType::EnumToString(annotation.mType), annotation.mName.Get());
 
                 if(annotation.mType == eAnnotationType::INT)
                     file.Write("%d;", annotation.mValue.AsInt);
                 else if(annotation.mType == eAnnotationType::FLOAT)
                     file.Write("%.9g;", annotation.mValue.AsFloat);
                 else
-                {
-                    //replaces " characters with \"
-                    CString newString(512);
-                    char* src = annotation.mValue.AsString; char* dst = newString.Get();
-                    while(*src)
-                    {
-                        if(*src == '"')
-                        {
-                            *dst++ = '\\'; *dst++ = '"';
-                        }
-                        else
-                            *dst++ = *src;
-
-                        src++;
-                    }
-                    file.Write("\"%s\";", newString.Get());
-                }
+                    file.Write("\"%s\";", EscapeString(annotation.mValue.AsString).c_str());
 
                 if(i != mAnnotationCount - 1)
                     file.Write(" ");
@@ -872,34 +2086,18 @@ void Parameter::SaveToFx(EffectWriter& file, bool isGlobal) const
         if(mAnnotationCount)
         {
             file.Write("<");
-            for(uint8_t i = 0; i < mAnnotationCount; i++)
+            for(uint16_t i = 0; i < mAnnotationCount; i++)
             {
                 const auto& annotation = mAnnotations[i];
 
-                file.WriteIndented("%s %s = ", eAnnotationType::EnumToString(annotation.mType), annotation.mName);
+                file.WriteIndented("%s %s = ", eAnnotationType::EnumToString(annotation.mType), annotation.mName.Get());
 
                 if(annotation.mType == eAnnotationType::INT)
                     file.Write("%d;", annotation.mValue.AsInt);
                 else if(annotation.mType == eAnnotationType::FLOAT)
                     file.Write("%.9g;", annotation.mValue.AsFloat);
                 else
-                {
-                    //replaces " characters with \"
-                    CString newString(256);
-                    char* src = annotation.mValue.AsString; char* dst = newString.Get();
-                    while(*src)
-                    {
-                        if(*src == '"')
-                        {
-                            *dst++ = '\\'; *dst++ = '"';
-                        }
-                        else
-                            *dst++ = *src;
-
-                        src++;
-                    }
-                    file.Write("\"%s\";", newString.Get());
-                }
+                    file.Write("\"%s\";", EscapeString(annotation.mValue.AsString).c_str());
 
                 if(i != mAnnotationCount - 1)
                     file.Write(" ");
@@ -927,17 +2125,18 @@ void Parameter::SaveToFx(EffectWriter& file, bool isGlobal) const
 
         bool samplerStatesWritten[eSamplerStateType::COUNT] {0};
 
-        for(uint8_t i = 0; i < paramCount; i++)
+        for(uint32_t i = 0; i < paramCount; i++)
         {
             bool skip = false;
             switch(mType)
             {
                 default:
-                    __debugbreak();
+                    DEBUG_BREAK();
                 break;
 
+                //ints and bools are kept as floats, like every other value that goes to a float register
                 case Parameter::eType::INT:
-                    file.WriteIndented("%d", *value.AsInt);
+                    file.WriteIndented("%d", (int)*value.AsFloat);
                 break;
 
                 case Parameter::eType::FLOAT:
@@ -979,7 +2178,7 @@ void Parameter::SaveToFx(EffectWriter& file, bool isGlobal) const
                     switch(samplerState->Type)
                     {
                         default:
-                            __debugbreak();
+                            DEBUG_BREAK();
                         break;
 
                         case eSamplerStateType::ADDRESSU:
@@ -1019,18 +2218,19 @@ void Parameter::SaveToFx(EffectWriter& file, bool isGlobal) const
                 break;
 
                 case Parameter::eType::BOOL:
-                    file.WriteIndented(*value.AsInt ? "true" : "false");
+                    file.WriteIndented(*value.AsFloat != 0.0f ? "true" : "false");
                 break;
 
                 case Parameter::eType::MATRIX4X3:
                 {
-                    rage::Matrix34 mtx = *value.AsMatrix34;
+                    //the value is 12 packed floats, Matrix34 pads its rows to 4 and would read past the end of it
+                    const float* mtx = value.AsFloat;
                     file.NewLine();
                     file.PushTab();
-                    file.WriteLineIndented("float4x3(%.9g, %.9g, %.9g,", mtx.a.x, mtx.a.y, mtx.a.z);
-                    file.WriteLineIndented("         %.9g, %.9g, %.9g,", mtx.b.x, mtx.b.y, mtx.b.z);
-                    file.WriteLineIndented("         %.9g, %.9g, %.9g,", mtx.c.x, mtx.c.y, mtx.c.z);
-                    file.WriteIndented    ("         %.9g, %.9g, %.9g)", mtx.d.x, mtx.d.y, mtx.d.z);
+                    file.WriteLineIndented("float4x3(%.9g, %.9g, %.9g,", mtx[0], mtx[1], mtx[2]);
+                    file.WriteLineIndented("         %.9g, %.9g, %.9g,", mtx[3], mtx[4], mtx[5]);
+                    file.WriteLineIndented("         %.9g, %.9g, %.9g,", mtx[6], mtx[7], mtx[8]);
+                    file.WriteIndented    ("         %.9g, %.9g, %.9g)", mtx[9], mtx[10], mtx[11]);
                     file.PopTab();
                 }
                 break;
@@ -1118,8 +2318,6 @@ bool Parameter::LoadFromFx(const HLSLDeclaration& declaration, HLSLTree& tree)
         mSemantic = textureName;
     else
         mSemantic = declaration.semantic ? declaration.semantic : declaration.name;
-    mNameHash = rage::atStringHash(mName.Get());
-    mSemanticHash = rage::atStringHash(mSemantic.Get());
 
     if(!declaration.type.array)
     {
@@ -1134,7 +2332,12 @@ bool Parameter::LoadFromFx(const HLSLDeclaration& declaration, HLSLTree& tree)
         }
 
         HLSLLiteralExpression* literalExpr = (HLSLLiteralExpression*)declaration.type.arraySize;
-        mCount = literalExpr->iValue;
+        if(literalExpr->iValue < 1 || literalExpr->iValue > UINT16_MAX)
+        {
+            Log::Error("%s(%d) : array size must be between 1 and %u.", declaration.fileName, declaration.line, UINT16_MAX);
+            return false;
+        }
+        mCount = (uint16_t)literalExpr->iValue;
     }
 
     if(declaration.annotations)
@@ -1144,7 +2347,7 @@ bool Parameter::LoadFromFx(const HLSLDeclaration& declaration, HLSLTree& tree)
 
         auto annotation = declaration.annotations;
         mAnnotations = new Annotation[mAnnotationCount];
-        for(uint8_t i = 0; i < mAnnotationCount; i++)
+        for(uint16_t i = 0; i < mAnnotationCount; i++)
         {
             mAnnotations[i].LoadFromFx(*annotation, tree);
             annotation = annotation->nextAnnotation;
@@ -1159,7 +2362,7 @@ bool Parameter::LoadFromFx(const HLSLDeclaration& declaration, HLSLTree& tree)
         HLSLSamplerState* hlslSamplerState = (HLSLSamplerState*)declaration.assignment;
         size_t numSamplerStates = hlslSamplerState->numStateAssignments - 1;
         mCount = 0;
-        mSize = (sizeof(SamplerState) * (uint8_t)numSamplerStates) / 4;
+        mSize = (sizeof(SamplerState) * (uint32_t)numSamplerStates) / 4;
 
         mValue.AsSamplerState = new SamplerState[numSamplerStates];
         memset(mValue.AsVoid, 0, mSize * 4);
@@ -1174,7 +2377,7 @@ bool Parameter::LoadFromFx(const HLSLDeclaration& declaration, HLSLTree& tree)
             switch(samplerState->Type)
             {
                 default:
-                    __debugbreak();
+                    DEBUG_BREAK();
                 break;
 
                 case eSamplerStateType::ADDRESSU:
@@ -1223,37 +2426,27 @@ bool Parameter::LoadFromFx(const HLSLDeclaration& declaration, HLSLTree& tree)
         mValue.AsVoid = new uint8_t[4 * totalSize];
         memset(mValue.AsVoid, 0, 4 * totalSize);
 
-        auto assignment = declaration.assignment;
-        uint32_t srcStride = numFloatsInTypes[mType] * 4;
-        uint32_t dstStride = (totalSize / mCount) * 4;
-        uint8_t* dst = (uint8_t*)mValue.AsVoid;
-
-        for(uint8_t i = 0; i < mCount; i++)
-        {
-            float value[4*4] {};
-            tree.GetExpressionValue(assignment, value);
-            assignment = assignment->nextExpression;
+        //strings have nowhere to keep a value
+        if(!totalSize)
+            return true;
 
-            memcpy(dst, value, srcStride);
-            dst += dstStride;
-        }
+        ConstantFolder folder(tree);
+        return folder.FoldInitializer(declaration, mCount, numFloatsInTypes[mType], (totalSize / mCount) * 4, (uint8_t*)mValue.AsVoid);
     }
 
     return true;
 }
 
 
-void Annotation::Save(OFileStream& file) const
+void Annotation::Save(OFileStream& file, eEffectFormat::Enum format) const
 {
-    WriteString(file, mName);
+    WriteString(file, format, mName);
 
     file.WriteByte(&mType);
 
     if(mType == eAnnotationType::STRING)
     {
-        auto nameLen = strlen(mValue.AsString) + 1;
-        file.WriteByte(&nameLen);
-        file.Write(mValue.AsString, nameLen);
+        WriteString(file, format, mValue.AsString, strlen(mValue.AsString));
     }
     else
     {
@@ -1261,9 +2454,9 @@ void Annotation::Save(OFileStream& file) const
     }
 }
 
-void Annotation::Load(IFileStream& file)
+void Annotation::Load(IFileStream& file, eEffectFormat::Enum format)
 {
-    mName = ReadString(file);
+    mName = ReadInternedString(file, format);
 
     uint8_t type;
     file.ReadByte(&type);
@@ -1271,8 +2464,7 @@ void Annotation::Load(IFileStream& file)
 
     if(mType == eAnnotationType::STRING)
     {
-        uint8_t nameLen;
-        file.ReadByte(&nameLen);
+        uint32_t nameLen = ReadCount(file, format);
         mValue.AsString = new char[nameLen];
         file.Read(mValue.AsString, nameLen);
     }
@@ -1282,6 +2474,18 @@ void Annotation::Load(IFileStream& file)
     }
 }
 
+void Annotation::Skip(IFileStream& file, eEffectFormat::Enum format)
+{
+    SkipString(file, format);
+
+    uint8_t type;
+    file.ReadByte(&type);
+    if(type == eAnnotationType::STRING)
+        SkipString(file, format);
+    else
+        file.Seek(sizeof(uint32_t));
+}
+
 void Annotation::LoadFromFx(const HLSLAnnotation& annotation, HLSLTree& tree)
 {
     mName = annotation.name;
@@ -1293,29 +2497,43 @@ void Annotation::LoadFromFx(const HLSLAnnotation& annotation, HLSLTree& tree)
 }
 
 
-void EffectTechnique::Save(OFileStream& file) const
+void EffectTechnique::Save(OFileStream& file, eEffectFormat::Enum format) const
 {
-    WriteString(file, mName);
+    WriteString(file, format, mName);
 
     uint16_t passCount = mPasses.GetCount();
-    file.WriteByte(&passCount);
-    for(uint8_t i = 0; i < passCount; i++)
+    WriteCount(file, format, passCount);
+    for(uint16_t i = 0; i < passCount; i++)
     {
-        mPasses[i].Save(file);
+        mPasses[i].Save(file, format);
     }
 }
 
-void EffectTechnique::Load(IFileStream& file)
+void EffectTechnique::Load(IFileStream& file, eEffectFormat::Enum format)
 {
-    mName = ReadString(file);
-    mNameHash = rage::atStringHash(mName.Get());
+    mName = ReadInternedString(file, format);
 
-    uint8_t passCount;
-    file.ReadByte(&passCount);
+    uint16_t passCount = (uint16_t)ReadCount(file, format);
     mPasses = rage::atArray<EffectPass>(passCount);
-    for(uint8_t i = 0; i < passCount; i++)
+    for(uint16_t i = 0; i < passCount; i++)
+    {
+        mPasses.Append().Load(file, format);
+    }
+}
+
+void EffectTechnique::Skip(IFileStream& file, eEffectFormat::Enum format)
+{
+    SkipString(file, format);
+
+    uint32_t passCount = ReadCount(file, format);
+    for(uint32_t i = 0; i < passCount; i++)
     {
-        mPasses.Append().Load(file);
+        //vertex and pixel program index, then the render states
+        file.Seek(format == eEffectFormat::EXTENDED ? 2 * sizeof(uint16_t) : 2 * sizeof(uint8_t));
+
+        uint32_t stateCount = ReadCount(file, format);
+        SkipPadding(file, format, sizeof(uint32_t));
+        file.Seek(stateCount * (sizeof(uint32_t) + sizeof(uint32_t)));
     }
 }
 
@@ -1336,7 +2554,6 @@ void EffectTechnique::SaveToFx(EffectWriter& file, const Effect& effect) const
 bool EffectTechnique::LoadFromFx(const HLSLTechnique* technique, const Effect& effect)
 {
     mName = technique->name;
-    mNameHash = rage::atStringHash(technique->name);
 
     mPasses = {(uint16_t)technique->numPasses};
     for(HLSLPass* pass = technique->passes; pass; pass = pass->nextPass)
@@ -1349,29 +2566,64 @@ bool EffectTechnique::LoadFromFx(const HLSLTechnique* technique, const Effect& e
 }
 
 
-void EffectPass::Save(OFileStream& file) const
+void EffectPass::CanonicalizeRenderStates()
+{
+    uint16_t count = mRenderStates.GetCount();
+    if(!count)
+        return;
+
+    uint16_t newCount = (uint16_t)RenderStatePool::Canonicalize(&mRenderStates[0], count);
+    if(newCount == count)
+        return;
+
+    rage::atArray<RenderState> states(newCount);
+    for(uint16_t i = 0; i < newCount; i++)
+        states.Append() = mRenderStates[i];
+    mRenderStates = states;
+}
+
+void EffectPass::Save(OFileStream& file, eEffectFormat::Enum format) const
 {
-    file.WriteByte(&mVertexProgramIndex);
-    file.WriteByte(&mPixelProgramIndex);
+    if(format == eEffectFormat::EXTENDED)
+    {
+        file.WriteWord(&mVertexProgramIndex);
+        file.WriteWord(&mPixelProgramIndex);
+    }
+    else
+    {
+        file.WriteByte(&mVertexProgramIndex);
+        file.WriteByte(&mPixelProgramIndex);
+    }
 
     uint16_t stateCount = mRenderStates.GetCount();
-    file.WriteByte(&stateCount);
-    for(uint8_t i = 0; i < stateCount; i++)
+    WriteCount(file, format, stateCount);
+    WritePadding(file, format, sizeof(uint32_t));
+    for(uint16_t i = 0; i < stateCount; i++)
     {
         file.WriteDword(&mRenderStates[i].State);
         file.WriteDword(&mRenderStates[i].Value);
     }
 }
 
-void EffectPass::Load(IFileStream& file)
+void EffectPass::Load(IFileStream& file, eEffectFormat::Enum format)
 {
-    file.ReadByte(&mVertexProgramIndex);
-    file.ReadByte(&mPixelProgramIndex);
+    mVertexProgramIndex = 0;
+    mPixelProgramIndex = 0;
+    if(format == eEffectFormat::EXTENDED)
+    {
+        file.ReadWord(&mVertexProgramIndex);
+        file.ReadWord(&mPixelProgramIndex);
+    }
+    else
+    {
+        file.ReadByte(&mVertexProgramIndex);
+        file.ReadByte(&mPixelProgramIndex);
+    }
 
-    uint8_t stateCount;
-    file.ReadByte(&stateCount);
+    uint16_t stateCount = (uint16_t)ReadCount(file, format);
+    SkipPadding(file, format, sizeof(uint32_t));
     mRenderStates = rage::atArray<RenderState>(stateCount);
-    for(uint8_t i = 0; i < stateCount; i++)
+    for(uint16_t i = 0; i < stateCount; i++)
     {
         RenderState& renderState = mRenderStates.Append();
         file.ReadDword(&renderState.State);
@@ -1414,6 +2666,8 @@ void EffectPass::SaveToFx(EffectWriter& file, const Effect& effect, uint16_t ind
 
             case eRenderStateType::SRCBLEND:
             case eRenderStateType::DESTBLEND:
+            case eRenderStateType::SRCBLENDALPHA:
+            case eRenderStateType::DESTBLENDALPHA:
                 file.Write(eBlendMode::EnumToString(value.SrcBlend));
             break;
 
@@ -1437,7 +2691,9 @@ void EffectPass::SaveToFx(EffectWriter& file, const Effect& effect, uint16_t ind
 
             case eRenderStateType::STENCILFAIL:
             case eRenderStateType::STENCILZFAIL:
+            case eRenderStateType::STENCILPASS:
             case eRenderStateType::CCW_STENCILFAIL:
+            case eRenderStateType::CCW_STENCILZFAIL:
             case eRenderStateType::CCW_STENCILPASS:
                 file.Write(eStencilOp::EnumToString(value.StencilFail));
             break;
@@ -1484,8 +2740,6 @@ void EffectPass::SaveToFx(EffectWriter& file, const Effect& effect, uint16_t ind
 
             case eRenderStateType::BLENDOP:
             case eRenderStateType::BLENDOPALPHA:
-            case eRenderStateType::SRCBLENDALPHA:
-            case eRenderStateType::DESTBLENDALPHA:
                 file.Write(eBlendOp::EnumToString(value.BlendOp));
             break;
 
@@ -1509,17 +2763,27 @@ void EffectPass::SaveToFx(EffectWriter& file, const Effect& effect, uint16_t ind
 
 bool EffectPass::LoadFromFx(const HLSLPass* pass, const Effect& effect)
 {
+    //a pass that doesn't set one of its programs uses the first one, same as what it unpacks to
+    mVertexProgramIndex = 0;
+    mPixelProgramIndex = 0;
     mRenderStates = {(uint16_t)pass->numStateAssignments};
     for(HLSLStateAssignment* stateAssign = pass->stateAssignments; stateAssign; stateAssign = stateAssign->nextStateAssignment)
     {
-        if(strcmp(stateAssign->stateName, "VertexShader") == 0)
-        {
-            mVertexProgramIndex = effect.GetShaderIndex(stateAssign->sValue);
-            continue;
-        }
-        else if(strcmp(stateAssign->stateName, "PixelShader") == 0)
+        bool isVertexProgram = strcmp(stateAssign->stateName, "VertexShader") == 0;
+        if(isVertexProgram || strcmp(stateAssign->stateName, "PixelShader") == 0)
         {
-            mPixelProgramIndex = effect.GetShaderIndex(stateAssign->sValue);
+            //"= NULL" in the pass itself, same as not setting it
+            if(!stateAssign->sValue)
+                continue;
+
+            uint32_t index = effect.GetShaderIndex(stateAssign->sValue);
+            if(index == UINT32_MAX)
+            {
+                Log::Error("%s(%d) : undeclared program \"%s\"", stateAssign->fileName, stateAssign->line, stateAssign->sValue);
+                return false;
+            }
+
+            (isVertexProgram ? mVertexProgramIndex : mPixelProgramIndex) = (uint16_t)index;
             continue;
         }
 
@@ -1557,7 +2821,9 @@ bool EffectPass::LoadFromFx(const HLSLPass* pass, const Effect& effect)
             case eRenderStateType::BLENDFACTOR:
             case eRenderStateType::STENCILFAIL:
             case eRenderStateType::STENCILZFAIL:
+            case eRenderStateType::STENCILPASS:
             case eRenderStateType::CCW_STENCILFAIL:
+            case eRenderStateType::CCW_STENCILZFAIL:
             case eRenderStateType::CCW_STENCILPASS:
             case eRenderStateType::STENCILREF:
             case eRenderStateType::COLORWRITEENABLE:
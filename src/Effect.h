@@ -3,14 +3,32 @@
 #include "rage/Array.h"
 #include "CString.h"
 #include "EffectWriter.h"
+#include "CompilerBackend.h"
+#include "StringInterner.h"
 #include "hlslparser/src/HLSLParser.h"
 
-#include "dx9/d3dx9.h"
+#include <mutex>
+#include <span>
+#include <vector>
 
 using namespace M4;
 
 class IFileStream;
 
+struct eEffectFormat
+{
+    enum Enum : uint8_t
+    {
+        //what the game reads. counts and string lengths are bytes and shaders are at most 64 KiB
+        CLASSIC,
+        //32 bit counts, sizes and string lengths behind a section table. sections and bytecode are 16 byte aligned and
+        //values and render states 4 byte aligned so a mapped file can be used in place. offsets and alignment count from
+        //the start of the stream it's saved to. the game can't read it
+        EXTENDED,
+        COUNT
+    };
+};
+
 struct eRenderStateType
 {
     enum Enum : uint32_t
@@ -23,7 +41,7 @@ struct eRenderStateType
 
     static const char* EnumToString(Enum type)
     {
-        if((size_t)type <= std::size(msNames))
+        if((size_t)type < std::size(msNames))
             return msNames[(uint32_t)type];
         else
             return "INVALID";
@@ -31,13 +49,8 @@ struct eRenderStateType
 
     static Enum StringToEnum(const char* string)
     {
-        for(size_t i = 0; i < std::size(msNames); i++)
-        {
-            if(strcmp(string, msNames[i]) == 0)
-                return (Enum)i;
-        }
-
-        return Enum::COUNT;
+        size_t index = msNameTable.Find(string);
+        return index < std::size(msNames) ? (Enum)index : Enum::COUNT;
     }
 
 private:
@@ -48,6 +61,7 @@ private:
                                             "DestBlendAlpha", "INVALID_28", "SlopeScaleDepthBias", "DepthBias", "BlendFactor", "INVALID_32", "INVALID_33", "INVALID_34",
                                             "TwoSideStencilMode", "CCW_StencilFail", "CCW_StencilZFail", "CCW_StencilPass",
                                             "CCWStencil_Func", "INVALID_40", "INVALID_41", "INVALID_42",};
+    static constexpr PerfectHashTable<std::size(msNames)> msNameTable {msNames};
 };
 
 struct eGrcBoolValue
@@ -59,7 +73,7 @@ struct eGrcBoolValue
 
     static const char* EnumToString(Enum type)
     {
-        if((size_t)type <= std::size(msNames))
+        if((size_t)type < std::size(msNames))
             return msNames[(uint32_t)type];
         else
             return "INVALID";
@@ -67,17 +81,13 @@ struct eGrcBoolValue
 
     static Enum StringToEnum(const char* string)
     {
-        for(size_t i = 0; i < std::size(msNames); i++)
-        {
-            if(strcmp(string, msNames[i]) == 0)
-                return (Enum)i;
-        }
-
-        return Enum::COUNT;
+        size_t index = msNameTable.Find(string);
+        return index < std::size(msNames) ? (Enum)index : Enum::COUNT;
     }
 
 private:
     static constexpr const char* msNames[] {"false", "true"};
+    static constexpr PerfectHashTable<std::size(msNames)> msNameTable {msNames};
 };
 
 struct eZBufferType
@@ -89,7 +99,7 @@ struct eZBufferType
 
     static const char* EnumToString(Enum type)
     {
-        if((size_t)type <= std::size(msNames))
+        if((size_t)type < std::size(msNames))
             return msNames[(uint32_t)type];
         else
             return "INVALID";
@@ -97,16 +107,12 @@ struct eZBufferType
 
     static Enum StringToEnum(const char* string)
     {
-        for(size_t i = 0; i < std::size(msNames); i++)
-        {
-            if(strcmp(string, msNames[i]) == 0)
-                return (Enum)i;
-        }
-
-        return Enum::COUNT;
+        size_t index = msNameTable.Find(string);
+        return index < std::size(msNames) ? (Enum)index : Enum::COUNT;
     }
 
 private: static constexpr const char* msNames[] {"false", "true", "USEW"};
+    static constexpr PerfectHashTable<std::size(msNames)> msNameTable {msNames};
 };
 
 struct eFillMode
@@ -200,15 +206,32 @@ class EffectPass
 {
 public:
     friend class Effect;
+    friend class BakedEffect;
+
+    uint16_t GetVertexProgramIndex() const
+    {
+        return mVertexProgramIndex;
+    }
+    uint16_t GetPixelProgramIndex() const
+    {
+        return mPixelProgramIndex;
+    }
+    const rage::atArray<RenderState>& GetRenderStates() const
+    {
+        return mRenderStates;
+    }
+
+    //sorts the render states by type and drops all but the last value of a state that's set more than once
+    void CanonicalizeRenderStates();
 
-    void Save(class OFileStream& file) const;
-    void Load(class IFileStream& file);
+    void Save(class OFileStream& file, eEffectFormat::Enum format) const;
+    void Load(class IFileStream& file, eEffectFormat::Enum format);
     void SaveToFx(EffectWriter& file, const class Effect& effect, uint16_t index) const;
     bool LoadFromFx(const HLSLPass* pass, const class Effect& effect);
 
 private:
-    uint8_t mVertexProgramIndex;
-    uint8_t mPixelProgramIndex;
+    uint16_t mVertexProgramIndex;
+    uint16_t mPixelProgramIndex;
     rage::atArray<RenderState> mRenderStates;
 };
 
@@ -217,18 +240,32 @@ class EffectTechnique
 {
 public:
     friend class Effect;
+    friend class BakedEffect;
 
     EffectTechnique() = default;
     ~EffectTechnique() = default;
 
-    void Save(class OFileStream& file) const;
-    void Load(class IFileStream& file);
+    const char* GetName() const
+    {
+        return mName.Get();
+    }
+    uint32_t GetNameHash() const
+    {
+        return mName.GetHash();
+    }
+    const rage::atArray<EffectPass>& GetPasses() const
+    {
+        return mPasses;
+    }
+
+    void Save(class OFileStream& file, eEffectFormat::Enum format) const;
+    void Load(class IFileStream& file, eEffectFormat::Enum format);
+    static void Skip(class IFileStream& file, eEffectFormat::Enum format);
     void SaveToFx(EffectWriter& file, const class Effect& effect) const;
     bool LoadFromFx(const HLSLTechnique* technique, const class Effect& effect);
 
 private:
-    uint32_t mNameHash;
-    CString mName;
+    InternedString mName;
     rage::atArray<EffectPass> mPasses;
 };
 
@@ -242,7 +279,7 @@ struct eAnnotationType
 
     static const char* EnumToString(Enum type)
     {
-        if((size_t)type <= std::size(msNames))
+        if((size_t)type < std::size(msNames))
             return msNames[(uint32_t)type];
         else
             return "INVALID";
@@ -250,13 +287,8 @@ struct eAnnotationType
 
     static Enum StringToEnum(const char* string)
     {
-        for(size_t i = 0; i < std::size(msNames); i++)
-        {
-            if(strcmp(string, msNames[i]) == 0)
-                return (Enum)i;
-        }
-
-        return Enum::COUNT;
+        size_t index = msNameTable.Find(string);
+        return index < std::size(msNames) ? (Enum)index : Enum::COUNT;
     }
 
     static Enum ParserTypeToEnum(HLSLAnnotationType type)
@@ -271,6 +303,7 @@ struct eAnnotationType
     }
 private:
     static constexpr const char* msNames[] {"int", "float", "string"};
+    static constexpr PerfectHashTable<std::size(msNames)> msNameTable {msNames};
 };
 
 class Annotation
@@ -303,11 +336,12 @@ public:
         return *this;
     }
 
-    void Save(class OFileStream& file) const;
-    void Load(class IFileStream& file);
+    void Save(class OFileStream& file, eEffectFormat::Enum format) const;
+    void Load(class IFileStream& file, eEffectFormat::Enum format);
+    static void Skip(class IFileStream& file, eEffectFormat::Enum format);
     void LoadFromFx(const HLSLAnnotation& annotation, HLSLTree& tree);
 
-    CString mName;
+    InternedString mName;
     eAnnotationType::Enum mType;
     struct
     {
@@ -331,7 +365,7 @@ struct eSamplerStateType
 
     static const char* EnumToString(Enum type)
     {
-        if((size_t)type <= std::size(msNames))
+        if((size_t)type < std::size(msNames))
             return msNames[(uint32_t)type];
         else
             return "INVALID";
@@ -339,18 +373,14 @@ struct eSamplerStateType
 
     static Enum StringToEnum(const char* string)
     {
-        for(size_t i = 0; i < std::size(msNames); i++)
-        {
-            if(strcmp(string, msNames[i]) == 0)
-                return (Enum)i;
-        }
-
-        return Enum::COUNT;
+        size_t index = msNameTable.Find(string);
+        return index < std::size(msNames) ? (Enum)index : Enum::COUNT;
     }
 
 private:
     static constexpr const char* msNames[]
     {"AddressU", "AddressV", "AddressW", "BorderColor", "MagFilter", "MinFilter", "MipFilter", "MipMapLodBias", "MaxMipLevel", "MaxAnisotropy", "SRGBTexture", "DMapOffset", "DMapOffset"};
+    static constexpr PerfectHashTable<std::size(msNames)> msNameTable {msNames};
 };
 
 struct eTextureAddress
@@ -391,6 +421,9 @@ class Parameter
 {
 public:
     friend class Effect;
+    friend class BakedEffect;
+    friend class EffectVerifier;
+    friend class EffectDiff;
 
     struct eType
     {
@@ -401,7 +434,7 @@ public:
 
         static const char* EnumToString(Enum type)
         {
-            if((size_t)type <= std::size(msNames))
+            if((size_t)type < std::size(msNames))
                 return msNames[(uint32_t)type];
             else
                 return "INVALID";
@@ -409,13 +442,8 @@ public:
 
         static Enum StringToEnum(const char* string)
         {
-            for(size_t i = 0; i < std::size(msNames); i++)
-            {
-                if(strcmp(string, msNames[i]) == 0)
-                    return (Enum)i;
-            }
-
-            return Enum::COUNT;
+            size_t index = msNameTable.Find(string);
+            return index < std::size(msNames) ? (Enum)index : Enum::COUNT;
         }
 
         static Enum ParserTypeToEnum(HLSLBaseType type)
@@ -442,10 +470,11 @@ public:
     private:
         static constexpr const char* msNames[]
         {"NONE", "int", "float", "float2", "float3", "float4", "sampler", "bool", "float4x3", "float4x4", "string"};
+        static constexpr PerfectHashTable<std::size(msNames)> msNameTable {msNames};
     };
 
 public:
-    Parameter() : mType(eType::NONE), mCount(0), mSize(0), mAnnotationCount(0), mNameHash(0), mSemanticHash(0), mValue{.AsInt = 0}, mAnnotations(nullptr)
+    Parameter() : mType(eType::NONE), mCount(0), mSize(0), mAnnotationCount(0), mValue{.AsInt = 0}, mAnnotations(nullptr)
     {}
 
     ~Parameter()
@@ -476,34 +505,38 @@ public:
     };
     uint32_t GetNameHash() const
     {
-        return mNameHash;
+        return mName.GetHash();
     };
     uint32_t GetSemanticHash() const
     {
-        return mSemanticHash;
+        return mSemantic.GetHash();
     };
 
     eType::Enum GetType() const
     {
         return mType;
     }
+    uint16_t GetCount() const
+    {
+        return mCount;
+    }
 
     uint32_t GetTotalSize() const;
 
-    void Save(OFileStream& file) const;
-    void Load(class IFileStream& file);
+    void Save(OFileStream& file, eEffectFormat::Enum format) const;
+    void Load(class IFileStream& file, eEffectFormat::Enum format);
+    static void Skip(class IFileStream& file, eEffectFormat::Enum format);
     void SaveToFx(EffectWriter& file, bool isGlobal = false) const;
     bool LoadFromFx(const HLSLDeclaration& declaration, HLSLTree& tree);
 
 private:
     eType::Enum mType;
-    uint8_t mCount;
-    uint8_t mSize;
-    uint8_t mAnnotationCount;
-    CString mName;
-    CString mSemantic;
-    uint32_t mNameHash;
-    uint32_t mSemanticHash;
+    uint16_t mCount;
+    //in dwords as stored in the file
+    uint32_t mSize;
+    uint16_t mAnnotationCount;
+    InternedString mName;
+    InternedString mSemantic;
     Annotation* mAnnotations;
     struct
     {
@@ -530,16 +563,16 @@ public:
     class Param
     {
     public:
-        Param() : mType(Parameter::eType::NONE), mUnknown(0), mRegisterIndex(0xFFFF), mNameHash(0)
+        Param() : mType(Parameter::eType::NONE), mUnknown(0), mRegisterIndex(0xFFFF), mName()
         {};
 
-        void Save(OFileStream& file, const class Effect& effect) const;
-        void Load(class IFileStream& file);
+        void Save(OFileStream& file, const class Effect& effect, eEffectFormat::Enum format) const;
+        void Load(class IFileStream& file, eEffectFormat::Enum format);
 
         Parameter::eType::Enum mType;
         uint8_t mUnknown;
         uint16_t mRegisterIndex;
-        uint32_t mNameHash;
+        InternedString mName;
     };
 
 public:
@@ -548,12 +581,15 @@ public:
 
     GpuProgram& operator=(const GpuProgram& rhs);
 
-    void Save(OFileStream& file, const class Effect& effect) const;
-    void Load(class IFileStream& file);
+    void Save(OFileStream& file, const class Effect& effect, eEffectFormat::Enum format) const;
+    void Load(class IFileStream& file, eEffectFormat::Enum format);
+    static void Skip(class IFileStream& file, eEffectFormat::Enum format);
     bool LoadFromAssembly(const HLSLDeclaration& declaration, const class Effect& effect);
-    bool LoadFromFunction(const HLSLFunction& function, const char* source, const char* profile, const class Effect& effect, DWORD shaderFlags);
+    bool LoadFromFunction(const HLSLFunction& function, const char* source, const char* profile, const class Effect& effect, uint32_t shaderFlags);
 
     CString GetDisassembly() const;
+    //instructions in the bytecode not counting declarations, definitions and comments
+    uint32_t GetInstructionCount() const;
 
     uint32_t mNameHash;
     rage::atArray<Param> mParams;
@@ -564,23 +600,106 @@ using VertexProgram = GpuProgram;
 using PixelProgram = GpuProgram;
 
 
+struct eEffectLoadMode
+{
+    enum Enum : uint8_t
+    {
+        //decode the whole file up front
+        FULL,
+        //keep the file in memory, skim it for the offset of every entry and decode entries the first time they're used.
+        //the whole file is still validated up front, which reads every byte once so nothing decoded later has to be checked.
+        //entries can be decoded from any number of threads at once
+        LAZY,
+    };
+};
+
+struct eEffectLoadError
+{
+    enum Enum : uint8_t
+    {
+        NONE, READ_FAILED, BAD_MAGIC, TRUNCATED, BAD_STRING, BAD_PARAMETER_TYPE, BAD_PARAMETER_SIZE, BAD_ANNOTATION_TYPE, BAD_SAMPLER_STATE,
+        BAD_RENDER_STATE, BAD_SHADER_SIZE, UNDECLARED_PARAMETER, BAD_VERSION, BAD_SECTION, TOO_MANY_ENTRIES, COUNT
+    };
+
+    static const char* EnumToString(Enum type)
+    {
+        if((size_t)type < std::size(msNames))
+            return msNames[(uint32_t)type];
+        else
+            return "INVALID";
+    }
+
+private:
+    static constexpr const char* msNames[] {"no error", "read failed", "bad magic", "unexpected end of file", "unterminated string",
+                                            "invalid parameter type", "parameter value doesn't fit its type", "invalid annotation type",
+                                            "invalid sampler state", "invalid render state", "shader size isn't a multiple of 4",
+                                            "program uses an undeclared parameter", "unsupported extended format version",
+                                            "invalid section table", "more entries than an effect can hold"};
+};
+
 class Effect
 {
 public:
-    Effect(IFileStream& file);
-    Effect() = default;
+    //the file is validated before anything is decoded. if it fails the effect stays empty and GetLoadError says why
+    Effect(IFileStream& file, eEffectLoadMode::Enum mode = eEffectLoadMode::FULL);
+    //same as above without copying the file. a lazily loaded effect keeps decoding from data so it has to outlive the effect
+    Effect(const char* filePath, const uint8_t* data, size_t size, eEffectLoadMode::Enum mode = eEffectLoadMode::FULL);
+    Effect() : mFormat(eEffectFormat::CLASSIC), mLoadError(eEffectLoadError::NONE), mLoadErrorOffset(0)
+    {}
     ~Effect() = default;
 
-    bool Save(const std::filesystem::path& filePath) const;
+    //walks a whole .fxc checking every count, size, string and enum without decoding anything and stops at the first
+    //inconsistency. errorOffset receives the offset of the field that failed
+    static eEffectLoadError::Enum Validate(const uint8_t* data, size_t size, size_t* errorOffset = nullptr);
+
+    //the format the effect was loaded from, classic for effects compiled from source
+    eEffectFormat::Enum GetFormat() const
+    {
+        return mFormat;
+    }
+
+    eEffectLoadError::Enum GetLoadError() const
+    {
+        return mLoadError;
+    }
+    size_t GetLoadErrorOffset() const
+    {
+        return mLoadErrorOffset;
+    }
+
+    //fails without writing anything if the effect is past one of the classic format's limits
+    bool Save(const std::filesystem::path& filePath, eEffectFormat::Enum format = eEffectFormat::CLASSIC) const;
+    bool Save(OFileStream& file, eEffectFormat::Enum format = eEffectFormat::CLASSIC) const;
     bool SaveToFx(const std::filesystem::path& filePath) const;
-    bool LoadFromFx(const HLSLParser& parser, DWORD shaderFlags, const D3DXMACRO* defines);
+    bool SaveToFx(EffectWriter& file) const;
+    bool LoadFromFx(const HLSLParser& parser, uint32_t shaderFlags);
+    //loads only the parameters, which doesn't need the compiler. after a syntax error this still reports what's wrong with
+    //the parameters the parser recovered, the programs would only fail again on the same error
+    bool LoadParametersFromFx(const HLSLParser& parser);
+    //drops programs no pass uses and the parameters none of the remaining programs bind, then remaps the program indices
+    //of every pass. logs what it removed and how much smaller the .fxc gets
+    void Prune();
+    //puts the render states of every pass in canonical order, see EffectPass::CanonicalizeRenderStates
+    void CanonicalizeRenderStates();
 
     const Parameter* FindParameterByName(const char* name) const;
     const Parameter* FindParameterByHash(uint32_t hash) const;
     const Parameter* FindGlobalParameterByName(const char* name) const;
     const Parameter* FindGlobalParameterByHash(uint32_t hash) const;
     const Parameter* GetParameterAt(uint32_t index) const;
+    uint32_t GetParameterCount() const;
+    const Parameter* GetGlobalParameterAt(uint32_t index) const;
+    uint32_t GetGlobalParameterCount() const;
+
+    const EffectTechnique* GetTechniqueAt(uint32_t index) const;
+    uint32_t GetTechniqueCount() const;
 
+    const VertexProgram* GetVertexProgramAt(uint32_t index) const;
+    uint32_t GetVertexProgramCount() const;
+    const PixelProgram* GetPixelProgramAt(uint32_t index) const;
+    uint32_t GetPixelProgramCount() const;
+
+    //UINT32_MAX if no program has that name
     uint32_t GetShaderIndex(const char* name) const;
     uint32_t GetShaderIndex(uint32_t hash) const;
 
@@ -590,14 +709,49 @@ public:
     const char* GetFilePath() const;
 
     static constexpr uint32_t MAGIC = (uint32_t)'axgr';
+    static constexpr uint32_t MAGIC_EXTENDED = (uint32_t)'xxgr';
+    static constexpr uint32_t EXTENDED_VERSION = 1;
 
 private:
+    friend class EffectArchive;
+
+    //validates and loads whatever GetFileData returns
+    void LoadFromMemory(eEffectLoadMode::Enum mode);
+    void Load(IFileStream& file, bool lazy);
+    void LoadExtended(IFileStream& file, bool lazy);
+    //logs the first thing the classic format can't store
+    bool FitsClassicFormat(const char* filePath) const;
     void SaveProgramParametersToFx(EffectWriter& file, const GpuProgram& program) const;
 
-    rage::atArray<EffectTechnique> mTechniques;
-    rage::atArray<Parameter> mParameters;
-    rage::atArray<Parameter> mGlobalParameters;
-    rage::atArray<VertexProgram> mVertexPrograms;
-    rage::atArray<PixelProgram> mPixelPrograms;
+    template<typename T, typename CounterT>
+    void LoadEntry(rage::atArray<T, CounterT>& entries, rage::atArray<uint32_t>& offsets, uint32_t index) const;
+    void LoadAllEntries() const;
+
+    std::span<const uint8_t> GetFileData() const
+    {
+        return mExternalData.empty() ? std::span<const uint8_t>(mFileData) : mExternalData;
+    }
+
+    //entries of a lazily loaded effect get decoded from const accessors, see LoadEntry
+    mutable rage::atArray<EffectTechnique> mTechniques;
+    mutable rage::atArray<Parameter> mParameters;
+    mutable rage::atArray<Parameter> mGlobalParameters;
+    mutable rage::atArray<VertexProgram> mVertexPrograms;
+    mutable rage::atArray<PixelProgram> mPixelPrograms;
     CString mFilePath;
+    eEffectFormat::Enum mFormat;
+    eEffectLoadError::Enum mLoadError;
+    size_t mLoadErrorOffset;
+
+    //lazy loading. the file stays in memory and every entry that hasn't been decoded yet has its offset into it here, 0 once it has
+    std::vector<uint8_t> mFileData;
+    //set instead of mFileData when the file belongs to someone else, like an archive
+    std::span<const uint8_t> mExternalData;
+    mutable rage::atArray<uint32_t> mTechniqueOffsets;
+    mutable rage::atArray<uint32_t> mParameterOffsets;
+    mutable rage::atArray<uint32_t> mGlobalParameterOffsets;
+    mutable rage::atArray<uint32_t> mVertexProgramOffsets;
+    mutable rage::atArray<uint32_t> mPixelProgramOffsets;
+    //held while an entry is decoded, once it has been its offset is cleared and it's read without locking
+    mutable std::mutex mLazyMutex;
 };
\ No newline at end of file
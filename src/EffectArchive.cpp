@@ -0,0 +1,524 @@
+#include "EffectArchive.h"
+#include "FileStream.h"
+#include "Parallel.h"
+#include "rage/StringHash.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+static constexpr uint32_t ALIGNMENT = 16;
+
+struct ArchiveHeader
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t EffectCount;
+    uint32_t ProgramCount;
+    //file offsets of the sorted entries, the bytecode references of deduped effects and the path strings
+    uint32_t Entries;
+    uint32_t Programs;
+    uint32_t Strings;
+    uint32_t StringSize;
+};
+ASSERT_SIZE(ArchiveHeader, 0x20);
+
+struct ArchiveEntry
+{
+    uint32_t PathHash;
+    uint32_t Path;
+    uint32_t Offset;
+    uint32_t Size;
+    //none unless the effect is deduped
+    uint32_t FirstProgram;
+    uint32_t ProgramCount;
+    uint32_t Reserved[2];
+};
+ASSERT_SIZE(ArchiveEntry, 0x20);
+
+struct ArchiveProgram
+{
+    uint32_t Offset;
+    uint32_t Size;
+};
+ASSERT_SIZE(ArchiveProgram, 0x8);
+
+struct PackedEffect
+{
+    std::string Path;
+    uint32_t PathHash;
+    bool Valid;
+    std::vector<uint8_t> Data;
+    //bytecode dedupe took out of the effect, indexed like EffectArchive::GetProgram
+    std::vector<std::vector<uint8_t>> Programs;
+    std::vector<uint32_t> PoolIndices;
+};
+
+static uint64_t Align(uint64_t offset)
+{
+    return (offset + ALIGNMENT - 1) & ~(uint64_t)(ALIGNMENT - 1);
+}
+
+static void WritePadding(OFileStream& file, uint64_t offset)
+{
+    static constexpr uint8_t sZeros[ALIGNMENT] {};
+    file.Write(sZeros, offset - file.Tell());
+}
+
+//the same characters atStringHash folds together
+static bool SamePath(const char* lhs, const char* rhs)
+{
+    for(; *lhs && *rhs; lhs++, rhs++)
+    {
+        char l = *lhs == '\\' ? '/' : (char)tolower((uint8_t)*lhs);
+        char r = *rhs == '\\' ? '/' : (char)tolower((uint8_t)*rhs);
+        if(l != r)
+            return false;
+    }
+
+    return *lhs == *rhs;
+}
+
+static void SetBytecode(GpuProgram& program, const uint8_t* data, uint32_t size)
+{
+    program.mShaderData = {size};
+    if(size)
+        memcpy(&program.mShaderData[0], data, size);
+}
+
+GpuProgram& EffectArchive::GetProgram(const Effect& effect, uint32_t index)
+{
+    uint32_t vertexCount = effect.GetVertexProgramCount();
+    if(index < vertexCount)
+    {
+        effect.GetVertexProgramAt(index);
+        return effect.mVertexPrograms[(uint16_t)index];
+    }
+
+    effect.GetPixelProgramAt(index - vertexCount);
+    return effect.mPixelPrograms[(uint16_t)(index - vertexCount)];
+}
+
+bool EffectArchive::Pack(const char* folder, const char* archivePath, bool dedupe, uint32_t threadCount)
+{
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    std::vector<std::filesystem::path> files;
+    if(!FindFiles(folder, files))
+        return false;
+
+    std::vector<PackedEffect> effects(files.size());
+    ParallelFor((uint32_t)files.size(), [&](uint32_t i)
+    {
+        PackedEffect& packed = effects[i];
+        packed.Path = std::filesystem::relative(files[i], folder).generic_string();
+        packed.PathHash = rage::atStringHash(packed.Path.c_str());
+        packed.Valid = false;
+
+        Log::Job job(files[i].string().c_str());
+        IFileStream file(files[i].string().c_str());
+        if(!file.Open())
+            return;
+
+        packed.Data.resize(file.GetSize());
+        if(!packed.Data.empty() && !file.Read(packed.Data.data(), packed.Data.size()))
+        {
+            Log::Error("Unable to read file \"%s\"", files[i].string().c_str());
+            return;
+        }
+
+        //the archive only serves effects that load
+        size_t errorOffset;
+        eEffectLoadError::Enum loadError = Effect::Validate(packed.Data.data(), packed.Data.size(), &errorOffset);
+        if(loadError != eEffectLoadError::NONE)
+        {
+            Log::Error("\"%s\" is not a valid effect file: %s at offset 0x%zX", files[i].string().c_str(), eEffectLoadError::EnumToString(loadError), errorOffset);
+            return;
+        }
+
+        packed.Valid = true;
+        if(!dedupe)
+            return;
+
+        Effect effect(packed.Path.c_str(), packed.Data.data(), packed.Data.size());
+        uint32_t programCount = effect.GetVertexProgramCount() + effect.GetPixelProgramCount();
+        if(!programCount)
+            return;
+
+        std::vector<std::vector<uint8_t>> programs(programCount);
+        for(uint32_t j = 0; j < programCount; j++)
+        {
+            GpuProgram& program = GetProgram(effect, j);
+            if(program.mShaderData.GetCapacity())
+                programs[j].assign(&program.mShaderData[0], &program.mShaderData[0] + program.mShaderData.GetCapacity());
+            program.mShaderData = {};
+        }
+
+        std::vector<uint8_t> stripped;
+        OFileStream strippedFile(packed.Path.c_str(), stripped);
+        if(!effect.Save(strippedFile, effect.GetFormat()))
+            return;
+
+        //only files fxdc or the game's tools wrote are sure to save back to the same bytes, anything else is stored whole
+        Effect restored(packed.Path.c_str(), stripped.data(), stripped.size());
+        if(restored.GetLoadError() != eEffectLoadError::NONE)
+            return;
+
+        for(uint32_t j = 0; j < programCount; j++)
+            SetBytecode(GetProgram(restored, j), programs[j].data(), (uint32_t)programs[j].size());
+
+        std::vector<uint8_t> repacked;
+        OFileStream repackedFile(packed.Path.c_str(), repacked);
+        if(!restored.Save(repackedFile, restored.GetFormat()) || repacked != packed.Data)
+        {
+            Log::Warn("\"%s\" doesn't save back to the same bytes, its bytecode isn't deduped", files[i].string().c_str());
+            return;
+        }
+
+        packed.Data = std::move(stripped);
+        packed.Programs = std::move(programs);
+    }, threadCount);
+
+    std::vector<uint32_t> order;
+    order.reserve(effects.size());
+    for(uint32_t i = 0; i < (uint32_t)effects.size(); i++)
+    {
+        if(effects[i].Valid)
+            order.push_back(i);
+    }
+
+    uint32_t failedCount = (uint32_t)(effects.size() - order.size());
+
+    //stable so effects with the same hash stay sorted by path
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t lhs, uint32_t rhs)
+    {
+        return effects[lhs].PathHash < effects[rhs].PathHash;
+    });
+
+    for(size_t i = 0; i < order.size(); i++)
+    {
+        for(size_t j = i + 1; j < order.size() && effects[order[j]].PathHash == effects[order[i]].PathHash; j++)
+        {
+            if(SamePath(effects[order[i]].Path.c_str(), effects[order[j]].Path.c_str()))
+                Log::Warn("\"%s\" and \"%s\" only differ in case, Find only returns the first one", effects[order[i]].Path.c_str(), effects[order[j]].Path.c_str());
+        }
+    }
+
+    //identical bytecode is stored once no matter how many effects or programs use it
+    std::vector<const std::vector<uint8_t>*> pool;
+    std::unordered_map<std::string_view, uint32_t> poolIndices;
+    uint32_t programCount = 0;
+    for(uint32_t index : order)
+    {
+        PackedEffect& packed = effects[index];
+        for(const std::vector<uint8_t>& bytecode : packed.Programs)
+        {
+            std::string_view key((const char*)bytecode.data(), bytecode.size());
+            auto [it, inserted] = poolIndices.try_emplace(key, (uint32_t)pool.size());
+            if(inserted)
+                pool.push_back(&bytecode);
+            packed.PoolIndices.push_back(it->second);
+        }
+
+        programCount += (uint32_t)packed.Programs.size();
+    }
+
+    std::string strings;
+    std::vector<ArchiveEntry> entries(order.size());
+    for(size_t i = 0; i < order.size(); i++)
+    {
+        const PackedEffect& packed = effects[order[i]];
+        entries[i] = {};
+        entries[i].PathHash = packed.PathHash;
+        entries[i].Path = (uint32_t)strings.size();
+        entries[i].Size = (uint32_t)packed.Data.size();
+        strings += packed.Path;
+        strings += '\0';
+    }
+
+    ArchiveHeader header {};
+    header.Magic = MAGIC;
+    header.Version = VERSION;
+    header.EffectCount = (uint32_t)entries.size();
+    header.ProgramCount = programCount;
+    header.Entries = sizeof(ArchiveHeader);
+    header.Programs = header.Entries + header.EffectCount * sizeof(ArchiveEntry);
+    header.Strings = header.Programs + header.ProgramCount * sizeof(ArchiveProgram);
+    header.StringSize = (uint32_t)strings.size();
+
+    //effects and then the pool, every one of them aligned
+    uint64_t offset = header.Strings + (uint64_t)header.StringSize;
+    for(ArchiveEntry& entry : entries)
+    {
+        offset = Align(offset);
+        entry.Offset = (uint32_t)offset;
+        offset += entry.Size;
+    }
+
+    std::vector<ArchiveProgram> poolPrograms(pool.size());
+    for(size_t i = 0; i < pool.size(); i++)
+    {
+        offset = Align(offset);
+        poolPrograms[i] = {(uint32_t)offset, (uint32_t)pool[i]->size()};
+        offset += pool[i]->size();
+    }
+
+    if(offset > UINT32_MAX)
+    {
+        Log::Error("\"%s\" would be %llu bytes but archives are limited to 4 GiB, pack fewer effects into each one", archivePath, (unsigned long long)offset);
+        return false;
+    }
+
+    std::vector<ArchiveProgram> programs;
+    programs.reserve(programCount);
+    for(size_t i = 0; i < order.size(); i++)
+    {
+        const PackedEffect& packed = effects[order[i]];
+        entries[i].FirstProgram = (uint32_t)programs.size();
+        entries[i].ProgramCount = (uint32_t)packed.PoolIndices.size();
+        for(uint32_t poolIndex : packed.PoolIndices)
+            programs.push_back(poolPrograms[poolIndex]);
+    }
+
+    OFileStream file(archivePath);
+    if(!file.Open())
+        return false;
+
+    file.Write(&header, sizeof(header));
+    if(!entries.empty())
+        file.Write(entries.data(), entries.size() * sizeof(ArchiveEntry));
+    if(!programs.empty())
+        file.Write(programs.data(), programs.size() * sizeof(ArchiveProgram));
+    file.Write(strings.data(), strings.size());
+
+    uint64_t effectSize = 0;
+    for(size_t i = 0; i < order.size(); i++)
+    {
+        const std::vector<uint8_t>& data = effects[order[i]].Data;
+        WritePadding(file, entries[i].Offset);
+        if(!data.empty())
+            file.Write(data.data(), data.size());
+        effectSize += data.size();
+    }
+
+    uint64_t poolSize = 0;
+    for(size_t i = 0; i < pool.size(); i++)
+    {
+        WritePadding(file, poolPrograms[i].Offset);
+        if(!pool[i]->empty())
+            file.Write(pool[i]->data(), pool[i]->size());
+        poolSize += pool[i]->size();
+    }
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1);
+    if(dedupe)
+    {
+        Log::Info("packed %u effects, %llu bytes, and %u programs sharing %zu bytecode blobs, %llu bytes (took %lldms)", header.EffectCount,
+                  (unsigned long long)effectSize, programCount, pool.size(), (unsigned long long)poolSize, ms.count());
+    }
+    else
+    {
+        Log::Info("packed %u effects, %llu bytes (took %lldms)", header.EffectCount, (unsigned long long)effectSize, ms.count());
+    }
+
+    if(failedCount)
+        Log::Error("%u effect(s) couldn't be packed", failedCount);
+    return failedCount == 0;
+}
+
+bool EffectArchive::Open(const char* archivePath)
+{
+    if(!mFile.Open(archivePath))
+        return false;
+
+    //entries are checked as they're used so opening doesn't touch more than the header
+    const ArchiveHeader* header = (const ArchiveHeader*)mFile.GetData();
+    uint64_t size = mFile.GetSize();
+    if(size < sizeof(ArchiveHeader) || header->Magic != MAGIC || header->Version != VERSION ||
+       header->Entries + (uint64_t)header->EffectCount * sizeof(ArchiveEntry) > size ||
+       header->Programs + (uint64_t)header->ProgramCount * sizeof(ArchiveProgram) > size ||
+       header->Strings + (uint64_t)header->StringSize > size || (header->Entries & 3) || (header->Programs & 3) ||
+       (header->StringSize && mFile.GetData()[header->Strings + header->StringSize - 1] != '\0'))
+    {
+        Log::Error("\"%s\" is not an effect archive.", archivePath);
+        mFile.Close();
+        return false;
+    }
+
+    return true;
+}
+
+uint32_t EffectArchive::GetEffectCount() const
+{
+    const ArchiveHeader* header = (const ArchiveHeader*)mFile.GetData();
+    return header ? header->EffectCount : 0;
+}
+
+const char* EffectArchive::GetEffectPath(uint32_t index) const
+{
+    const ArchiveHeader* header = (const ArchiveHeader*)mFile.GetData();
+    if(!header || index >= header->EffectCount)
+        return "";
+
+    const ArchiveEntry& entry = ((const ArchiveEntry*)(mFile.GetData() + header->Entries))[index];
+    if(entry.Path >= header->StringSize)
+        return "";
+
+    return (const char*)mFile.GetData() + header->Strings + entry.Path;
+}
+
+uint32_t EffectArchive::Find(const char* path) const
+{
+    const ArchiveHeader* header = (const ArchiveHeader*)mFile.GetData();
+    if(!header)
+        return NOT_FOUND;
+
+    uint32_t hash = rage::atStringHash(path);
+    const ArchiveEntry* entries = (const ArchiveEntry*)(mFile.GetData() + header->Entries);
+    const ArchiveEntry* entriesEnd = entries + header->EffectCount;
+    const ArchiveEntry* it = std::lower_bound(entries, entriesEnd, hash, [](const ArchiveEntry& lhs, uint32_t rhs)
+    {
+        return lhs.PathHash < rhs;
+    });
+
+    for(; it != entriesEnd && it->PathHash == hash; it++)
+    {
+        uint32_t index = (uint32_t)(it - entries);
+        if(SamePath(GetEffectPath(index), path))
+            return index;
+    }
+
+    return NOT_FOUND;
+}
+
+std::span<const uint8_t> EffectArchive::GetEffectData(uint32_t index) const
+{
+    const ArchiveHeader* header = (const ArchiveHeader*)mFile.GetData();
+    if(!header || index >= header->EffectCount)
+        return {};
+
+    const ArchiveEntry& entry = ((const ArchiveEntry*)(mFile.GetData() + header->Entries))[index];
+    if(entry.Offset + (uint64_t)entry.Size > mFile.GetSize())
+        return {};
+
+    return {mFile.GetData() + entry.Offset, entry.Size};
+}
+
+bool EffectArchive::IsDeduped(uint32_t index) const
+{
+    const ArchiveHeader* header = (const ArchiveHeader*)mFile.GetData();
+    if(!header || index >= header->EffectCount)
+        return false;
+
+    return ((const ArchiveEntry*)(mFile.GetData() + header->Entries))[index].ProgramCount != 0;
+}
+
+std::unique_ptr<Effect> EffectArchive::LoadEffect(uint32_t index, eEffectLoadMode::Enum mode) const
+{
+    std::span<const uint8_t> data = GetEffectData(index);
+    if(!data.data())
+    {
+        Log::Error("effect %u is out of range or past the end of the archive", index);
+        return nullptr;
+    }
+
+    auto effect = std::make_unique<Effect>(GetEffectPath(index), data.data(), data.size(), mode);
+    if(effect->GetLoadError() != eEffectLoadError::NONE || !IsDeduped(index))
+        return effect;
+
+    const ArchiveHeader* header = (const ArchiveHeader*)mFile.GetData();
+    const ArchiveEntry& entry = ((const ArchiveEntry*)(mFile.GetData() + header->Entries))[index];
+    if(entry.ProgramCount != effect->GetVertexProgramCount() + effect->GetPixelProgramCount() ||
+       entry.FirstProgram + (uint64_t)entry.ProgramCount > header->ProgramCount)
+    {
+        Log::Error("\"%s\" doesn't match the bytecode the archive has for it", GetEffectPath(index));
+        return nullptr;
+    }
+
+    const ArchiveProgram* programs = (const ArchiveProgram*)(mFile.GetData() + header->Programs) + entry.FirstProgram;
+    for(uint32_t i = 0; i < entry.ProgramCount; i++)
+    {
+        if(programs[i].Offset + (uint64_t)programs[i].Size > mFile.GetSize() || (programs[i].Size & 3))
+        {
+            Log::Error("the bytecode of \"%s\" is past the end of the archive", GetEffectPath(index));
+            return nullptr;
+        }
+
+        SetBytecode(GetProgram(*effect, i), mFile.GetData() + programs[i].Offset, programs[i].Size);
+    }
+
+    return effect;
+}
+
+bool EffectArchive::Unpack(const char* archivePath, const char* folder)
+{
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    EffectArchive archive;
+    if(!archive.Open(archivePath))
+        return false;
+
+    std::atomic<uint32_t> failedCount = 0;
+    ParallelFor(archive.GetEffectCount(), [&](uint32_t i)
+    {
+        const char* path = archive.GetEffectPath(i);
+        Log::Job job(path);
+
+        //the paths come from the archive, don't let one write outside of the folder
+        std::filesystem::path relative = std::filesystem::path(path).lexically_normal();
+        if(relative.empty() || relative.has_root_path() || *relative.begin() == "..")
+        {
+            Log::Error("\"%s\" isn't inside the folder it was packed from", path);
+            failedCount++;
+            return;
+        }
+
+        std::span<const uint8_t> data = archive.GetEffectData(i);
+        std::vector<uint8_t> restored;
+        if(archive.IsDeduped(i))
+        {
+            std::unique_ptr<Effect> effect = archive.LoadEffect(i, eEffectLoadMode::FULL);
+            OFileStream restoredFile(path, restored);
+            if(!effect || effect->GetLoadError() != eEffectLoadError::NONE || !effect->Save(restoredFile, effect->GetFormat()))
+            {
+                failedCount++;
+                return;
+            }
+
+            data = restored;
+        }
+        else if(!data.data())
+        {
+            Log::Error("\"%s\" is past the end of the archive", path);
+            failedCount++;
+            return;
+        }
+
+        std::filesystem::path filePath = std::filesystem::path(folder) / relative;
+        std::error_code error;
+        std::filesystem::create_directories(filePath.parent_path(), error);
+
+        OFileStream file(filePath.string().c_str());
+        if(!file.Open())
+        {
+            failedCount++;
+            return;
+        }
+
+        if(!data.empty())
+            file.Write(data.data(), data.size());
+    });
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1);
+    Log::Info("unpacked %u effects (took %lldms)", archive.GetEffectCount() - failedCount, ms.count());
+    return failedCount == 0;
+}
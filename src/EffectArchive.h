@@ -0,0 +1,49 @@
+#pragma once
+#include "Effect.h"
+#include "MappedFile.h"
+
+#include <cstdint>
+#include <memory>
+#include <span>
+
+//packs every .fxc in a folder into one file. a directory sorted by path hash points at the effects, which are 16 byte
+//aligned so they can be loaded straight from the mapping. finding an effect is a binary search over the directory and
+//loading it lazily only decodes the entries that are used, without copying the file.
+//with dedupe the bytecode of programs is moved out of the effects into a pool shared by the whole archive, so a shader
+//compiled into many effects is only stored once
+class EffectArchive
+{
+public:
+    static constexpr uint32_t MAGIC = (uint32_t)'pxgr';
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t NOT_FOUND = UINT32_MAX;
+
+    //scans folder and its subfolders, threadCount 0 uses every hardware thread
+    static bool Pack(const char* folder, const char* archivePath, bool dedupe, uint32_t threadCount = 0);
+    //writes every effect back to folder as the file it was packed from
+    static bool Unpack(const char* archivePath, const char* folder);
+
+    bool Open(const char* archivePath);
+
+    uint32_t GetEffectCount() const;
+    //relative to the folder the archive was packed from, with forward slashes
+    const char* GetEffectPath(uint32_t index) const;
+    //path is matched the same way rage hashes it, ignoring case and the direction of slashes
+    uint32_t Find(const char* path) const;
+
+    //the effect as it's stored. unless IsDeduped it's the .fxc the archive was packed from
+    std::span<const uint8_t> GetEffectData(uint32_t index) const;
+    //whether the effect's program bytecode is in the shared pool instead of in the effect
+    bool IsDeduped(uint32_t index) const;
+
+    //lazily loaded effects decode from the mapping, the archive has to stay open for as long as they're used. like any lazy
+    //effect they can be read from several threads at once.
+    //deduped effects get their programs decoded right away to put the bytecode back
+    std::unique_ptr<Effect> LoadEffect(uint32_t index, eEffectLoadMode::Enum mode = eEffectLoadMode::LAZY) const;
+
+private:
+    //vertex programs first, then pixel programs. decodes the program if the effect was loaded lazily
+    static GpuProgram& GetProgram(const Effect& effect, uint32_t index);
+
+    MappedFile mFile;
+};
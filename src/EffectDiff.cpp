@@ -0,0 +1,649 @@
+#include "EffectDiff.h"
+#include "Effect.h"
+#include "FileStream.h"
+#include "Parallel.h"
+#include "RenderStatePool.h"
+#include "rage/StringHash.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <vector>
+
+template<typename ...Args>
+static void AddChange(EffectDiff::Result& result, const char* fmt, Args ...args)
+{
+    char line[512];
+    snprintf(line, sizeof(line), fmt, args...);
+    result.Report += "    ";
+    result.Report += line;
+    result.Report += '\n';
+    result.ChangeCount++;
+}
+
+static const char* OrEmpty(const char* string)
+{
+    return string ? string : "";
+}
+
+static bool IsFloatType(Parameter::eType::Enum type)
+{
+    return type == Parameter::eType::FLOAT || type == Parameter::eType::VECTOR2 || type == Parameter::eType::VECTOR3 || type == Parameter::eType::VECTOR4 ||
+           type == Parameter::eType::MATRIX4X3 || type == Parameter::eType::MATRIX4X4;
+}
+
+static void AppendValue(std::string& string, uint32_t value, bool isFloat)
+{
+    char text[32];
+    if(isFloat)
+    {
+        float f;
+        memcpy(&f, &value, sizeof(f));
+        snprintf(text, sizeof(text), "%.9g", f);
+    }
+    else
+        snprintf(text, sizeof(text), "%d", (int32_t)value);
+
+    string += text;
+}
+
+static std::string FormatArraySize(const Parameter& param)
+{
+    if(param.GetCount() <= 1)
+        return {};
+
+    return "[" + std::to_string(param.GetCount()) + "]";
+}
+
+static uint64_t HashBytecode(const GpuProgram& program)
+{
+    uint64_t hash = 0xCBF29CE484222325;
+    for(uint32_t i = 0; i < program.mShaderData.GetCapacity(); i++)
+    {
+        hash ^= program.mShaderData[i];
+        hash *= 0x100000001B3;
+    }
+
+    return hash;
+}
+
+//programs loaded from a .fxc have no name, they're called what SaveToFx would call them
+static uint32_t GetProgramNameHash(const GpuProgram& program, bool pixel, uint32_t index)
+{
+    if(program.mNameHash)
+        return program.mNameHash;
+
+    char name[32];
+    snprintf(name, sizeof(name), pixel ? "PixelShader%u" : "VertexShader%u", index);
+    return rage::atStringHash(name);
+}
+
+//pairs every program of a with one of b, first by identical bytecode and then by name. -1 for programs only one side has
+struct ProgramMatch
+{
+    std::vector<int32_t> AToB;
+    std::vector<int32_t> BToA;
+};
+
+static ProgramMatch MatchPrograms(const Effect& a, const Effect& b, bool pixel)
+{
+    auto getProgram = [pixel](const Effect& effect, uint32_t index)
+    {
+        return pixel ? effect.GetPixelProgramAt(index) : effect.GetVertexProgramAt(index);
+    };
+
+    uint32_t countA = pixel ? a.GetPixelProgramCount() : a.GetVertexProgramCount();
+    uint32_t countB = pixel ? b.GetPixelProgramCount() : b.GetVertexProgramCount();
+
+    ProgramMatch match;
+    match.AToB.assign(countA, -1);
+    match.BToA.assign(countB, -1);
+
+    std::multimap<uint64_t, uint32_t> bytecodeB;
+    for(uint32_t i = 0; i < countB; i++)
+        bytecodeB.emplace(HashBytecode(*getProgram(b, i)), i);
+
+    //an unchanged program keeps its match even if programs before it were added or removed
+    for(uint32_t i = 0; i < countA; i++)
+    {
+        const GpuProgram& program = *getProgram(a, i);
+        auto range = bytecodeB.equal_range(HashBytecode(program));
+        for(auto it = range.first; it != range.second; ++it)
+        {
+            const GpuProgram& other = *getProgram(b, it->second);
+            if(match.BToA[it->second] == -1 && other.mShaderData.GetCapacity() == program.mShaderData.GetCapacity() &&
+               (!program.mShaderData.GetCapacity() || memcmp(&other.mShaderData[0], &program.mShaderData[0], program.mShaderData.GetCapacity()) == 0))
+            {
+                match.AToB[i] = it->second;
+                match.BToA[it->second] = i;
+                break;
+            }
+        }
+    }
+
+    for(uint32_t i = 0; i < countA; i++)
+    {
+        if(match.AToB[i] != -1)
+            continue;
+
+        uint32_t nameHash = GetProgramNameHash(*getProgram(a, i), pixel, i);
+        for(uint32_t j = 0; j < countB; j++)
+        {
+            if(match.BToA[j] == -1 && GetProgramNameHash(*getProgram(b, j), pixel, j) == nameHash)
+            {
+                match.AToB[i] = j;
+                match.BToA[j] = i;
+                break;
+            }
+        }
+    }
+
+    return match;
+}
+
+static void ComparePrograms(const Effect& a, const Effect& b, bool pixel, const ProgramMatch& match, EffectDiff::Result& result)
+{
+    const char* kind = pixel ? "ps" : "vs";
+    auto getProgram = [pixel](const Effect& effect, uint32_t index)
+    {
+        return pixel ? effect.GetPixelProgramAt(index) : effect.GetVertexProgramAt(index);
+    };
+
+    for(uint32_t i = 0; i < match.AToB.size(); i++)
+    {
+        const GpuProgram& programA = *getProgram(a, i);
+        result.Instructions[0][pixel] += programA.GetInstructionCount();
+
+        if(match.AToB[i] == -1)
+        {
+            AddChange(result, "- %s %u (%u instructions)", kind, i, programA.GetInstructionCount());
+            continue;
+        }
+
+        uint32_t j = match.AToB[i];
+        const GpuProgram& programB = *getProgram(b, j);
+        uint32_t sizeA = programA.mShaderData.GetCapacity();
+        uint32_t sizeB = programB.mShaderData.GetCapacity();
+        if(sizeA != sizeB || (sizeA && memcmp(&programA.mShaderData[0], &programB.mShaderData[0], sizeA) != 0))
+        {
+            int32_t instructionsA = (int32_t)programA.GetInstructionCount();
+            int32_t instructionsB = (int32_t)programB.GetInstructionCount();
+            AddChange(result, "%s %u: bytecode changed, 0x%X -> 0x%X bytes, %d -> %d instructions (%+d)", kind, i, sizeA, sizeB,
+                      instructionsA, instructionsB, instructionsB - instructionsA);
+        }
+
+        //constants are matched by name so a moved register shows up as one line
+        for(const GpuProgram::Param& paramA : programA.mParams)
+        {
+            auto paramB = std::find_if(programB.mParams.begin(), programB.mParams.end(), [&](const GpuProgram::Param& param)
+            {
+                return param.mName == paramA.mName;
+            });
+
+            if(paramB == programB.mParams.end())
+                AddChange(result, "%s %u: - \"%s\" c%u", kind, i, OrEmpty(paramA.mName.Get()), paramA.mRegisterIndex);
+            else if(paramB->mRegisterIndex != paramA.mRegisterIndex || paramB->mType != paramA.mType)
+                AddChange(result, "%s %u: \"%s\" %s c%u -> %s c%u", kind, i, OrEmpty(paramA.mName.Get()), Parameter::eType::EnumToString(paramA.mType),
+                          paramA.mRegisterIndex, Parameter::eType::EnumToString(paramB->mType), paramB->mRegisterIndex);
+        }
+
+        for(const GpuProgram::Param& paramB : programB.mParams)
+        {
+            auto paramA = std::find_if(programA.mParams.begin(), programA.mParams.end(), [&](const GpuProgram::Param& param)
+            {
+                return param.mName == paramB.mName;
+            });
+
+            if(paramA == programA.mParams.end())
+                AddChange(result, "%s %u: + \"%s\" c%u", kind, i, OrEmpty(paramB.mName.Get()), paramB.mRegisterIndex);
+        }
+    }
+
+    for(uint32_t j = 0; j < match.BToA.size(); j++)
+    {
+        const GpuProgram& programB = *getProgram(b, j);
+        result.Instructions[1][pixel] += programB.GetInstructionCount();
+
+        if(match.BToA[j] == -1)
+            AddChange(result, "+ %s %u (%u instructions)", kind, j, programB.GetInstructionCount());
+    }
+}
+
+void EffectDiff::CompareParameter(const Parameter& a, const Parameter& b, const char* label, Result& result)
+{
+    const char* name = OrEmpty(a.GetName());
+    if(a.mSemantic != b.mSemantic)
+        AddChange(result, "%s \"%s\" semantic: \"%s\" -> \"%s\"", label, name, OrEmpty(a.GetSemantic()), OrEmpty(b.GetSemantic()));
+
+    if(a.mType != b.mType || a.mCount != b.mCount)
+    {
+        AddChange(result, "%s \"%s\" type: %s[%u] -> %s[%u]", label, name, Parameter::eType::EnumToString(a.mType), a.mCount,
+                  Parameter::eType::EnumToString(b.mType), b.mCount);
+        return;
+    }
+
+    for(uint16_t i = 0; i < a.mAnnotationCount; i++)
+    {
+        const Annotation& annotationA = a.mAnnotations[i];
+        const Annotation* annotationB = nullptr;
+        for(uint16_t j = 0; j < b.mAnnotationCount && !annotationB; j++)
+        {
+            if(b.mAnnotations[j].mName == annotationA.mName)
+                annotationB = &b.mAnnotations[j];
+        }
+
+        const char* annotationName = OrEmpty(annotationA.mName.Get());
+        if(!annotationB)
+            AddChange(result, "%s \"%s\" - annotation \"%s\"", label, name, annotationName);
+        else if(annotationA.mType != annotationB->mType)
+            AddChange(result, "%s \"%s\" annotation \"%s\" type: %s -> %s", label, name, annotationName, eAnnotationType::EnumToString(annotationA.mType),
+                      eAnnotationType::EnumToString(annotationB->mType));
+        else if(annotationA.mType == eAnnotationType::STRING)
+        {
+            if(strcmp(OrEmpty(annotationA.mValue.AsString), OrEmpty(annotationB->mValue.AsString)) != 0)
+                AddChange(result, "%s \"%s\" annotation \"%s\": \"%s\" -> \"%s\"", label, name, annotationName, OrEmpty(annotationA.mValue.AsString),
+                          OrEmpty(annotationB->mValue.AsString));
+        }
+        else if(annotationA.mValue.AsInt != annotationB->mValue.AsInt)
+        {
+            if(annotationA.mType == eAnnotationType::FLOAT)
+                AddChange(result, "%s \"%s\" annotation \"%s\": %.9g -> %.9g", label, name, annotationName, annotationA.mValue.AsFloat, annotationB->mValue.AsFloat);
+            else
+                AddChange(result, "%s \"%s\" annotation \"%s\": %d -> %d", label, name, annotationName, annotationA.mValue.AsInt, annotationB->mValue.AsInt);
+        }
+    }
+
+    for(uint16_t i = 0; i < b.mAnnotationCount; i++)
+    {
+        bool found = false;
+        for(uint16_t j = 0; j < a.mAnnotationCount && !found; j++)
+            found = a.mAnnotations[j].mName == b.mAnnotations[i].mName;
+
+        if(!found)
+            AddChange(result, "%s \"%s\" + annotation \"%s\"", label, name, OrEmpty(b.mAnnotations[i].mName.Get()));
+    }
+
+    if(a.mType == Parameter::eType::TEXTURE)
+    {
+        //sampler states are matched by type, their order doesn't matter
+        uint32_t countA = 4 * a.mSize / sizeof(SamplerState);
+        uint32_t countB = 4 * b.mSize / sizeof(SamplerState);
+        for(uint32_t i = 0; i < countA; i++)
+        {
+            const SamplerState& stateA = a.mValue.AsSamplerState[i];
+            const SamplerState* stateB = nullptr;
+            for(uint32_t j = 0; j < countB && !stateB; j++)
+            {
+                if(b.mValue.AsSamplerState[j].Type == stateA.Type)
+                    stateB = &b.mValue.AsSamplerState[j];
+            }
+
+            const char* stateName = eSamplerStateType::EnumToString(stateA.Type);
+            if(!stateB)
+            {
+                AddChange(result, "%s \"%s\" - %s", label, name, stateName);
+                continue;
+            }
+
+            uint32_t valueA, valueB;
+            memcpy(&valueA, &stateA.Value, sizeof(uint32_t));
+            memcpy(&valueB, &stateB->Value, sizeof(uint32_t));
+            if(valueA == valueB)
+                continue;
+
+            if(stateA.Type == eSamplerStateType::MIPMAPLODBIAS)
+                AddChange(result, "%s \"%s\" %s: %.9g -> %.9g", label, name, stateName, stateA.Value.MipMapLodBias, stateB->Value.MipMapLodBias);
+            else
+                AddChange(result, "%s \"%s\" %s: %u -> %u", label, name, stateName, valueA, valueB);
+        }
+
+        for(uint32_t i = 0; i < countB; i++)
+        {
+            bool found = false;
+            for(uint32_t j = 0; j < countA && !found; j++)
+                found = a.mValue.AsSamplerState[j].Type == b.mValue.AsSamplerState[i].Type;
+
+            if(!found)
+                AddChange(result, "%s \"%s\" + %s", label, name, eSamplerStateType::EnumToString(b.mValue.AsSamplerState[i].Type));
+        }
+        return;
+    }
+
+    if(a.mSize != b.mSize)
+    {
+        AddChange(result, "%s \"%s\" default: %u -> %u values", label, name, a.mSize, b.mSize);
+        return;
+    }
+
+    if(!a.mSize)
+        return;
+
+    //each element is stored padded out to the full size of its type, only the part the file holds is compared
+    bool isFloat = IsFloatType(a.mType);
+    uint32_t elementSize = a.mSize / a.mCount;
+    uint32_t elementStride = a.GetTotalSize() / 4 / a.mCount;
+    const uint32_t* valuesA = (const uint32_t*)a.mValue.AsVoid;
+    const uint32_t* valuesB = (const uint32_t*)b.mValue.AsVoid;
+
+    uint32_t changed = 0;
+    uint32_t first = 0;
+    for(uint32_t i = 0; i < a.mCount; i++)
+    {
+        for(uint32_t j = 0; j < elementSize; j++)
+        {
+            uint32_t index = i * elementStride + j;
+            if(valuesA[index] != valuesB[index] && !changed++)
+                first = index;
+        }
+    }
+
+    if(!changed)
+        return;
+
+    //small values are printed whole, anything bigger only says where it starts to differ
+    std::string line;
+    if(a.mSize <= 4)
+    {
+        for(const uint32_t* values : {valuesA, valuesB})
+        {
+            line += line.empty() ? "(" : " -> (";
+            for(uint32_t i = 0; i < a.mCount; i++)
+            {
+                for(uint32_t j = 0; j < elementSize; j++)
+                {
+                    if(i || j)
+                        line += ", ";
+                    AppendValue(line, values[i * elementStride + j], isFloat);
+                }
+            }
+            line += ")";
+        }
+    }
+    else
+    {
+        char text[64];
+        snprintf(text, sizeof(text), "%u of %u values, first [%u][%u] ", changed, (uint32_t)a.mSize, first / elementStride, first % elementStride);
+        line += text;
+        AppendValue(line, valuesA[first], isFloat);
+        line += " -> ";
+        AppendValue(line, valuesB[first], isFloat);
+    }
+
+    AddChange(result, "%s \"%s\" default: %s", label, name, line.c_str());
+}
+
+void EffectDiff::CompareParameters(const Effect& a, const Effect& b, bool global, Result& result)
+{
+    const char* label = global ? "shared parameter" : "parameter";
+    uint32_t countA = global ? a.GetGlobalParameterCount() : a.GetParameterCount();
+    uint32_t countB = global ? b.GetGlobalParameterCount() : b.GetParameterCount();
+    auto getParameter = [global](const Effect& effect, uint32_t index)
+    {
+        return global ? effect.GetGlobalParameterAt(index) : effect.GetParameterAt(index);
+    };
+
+    auto find = [&](const Effect& effect, uint32_t count, uint32_t nameHash) -> const Parameter*
+    {
+        for(uint32_t i = 0; i < count; i++)
+        {
+            const Parameter* param = getParameter(effect, i);
+            if(param->GetNameHash() == nameHash)
+                return param;
+        }
+
+        return nullptr;
+    };
+
+    for(uint32_t i = 0; i < countA; i++)
+    {
+        const Parameter& paramA = *getParameter(a, i);
+        const Parameter* paramB = find(b, countB, paramA.GetNameHash());
+        if(paramB)
+            CompareParameter(paramA, *paramB, label, result);
+        else
+            AddChange(result, "- %s %s %s%s : %s", label, Parameter::eType::EnumToString(paramA.GetType()), OrEmpty(paramA.GetName()),
+                      FormatArraySize(paramA).c_str(), OrEmpty(paramA.GetSemantic()));
+    }
+
+    for(uint32_t i = 0; i < countB; i++)
+    {
+        const Parameter& paramB = *getParameter(b, i);
+        if(!find(a, countA, paramB.GetNameHash()))
+            AddChange(result, "+ %s %s %s%s : %s", label, Parameter::eType::EnumToString(paramB.GetType()), OrEmpty(paramB.GetName()),
+                      FormatArraySize(paramB).c_str(), OrEmpty(paramB.GetSemantic()));
+    }
+}
+
+static void ComparePass(const EffectPass& passA, const EffectPass& passB, const char* technique, uint32_t index, const ProgramMatch& vertexMatch,
+                        const ProgramMatch& pixelMatch, EffectDiff::Result& result)
+{
+    //a pass only changed programs if the one it used isn't the one its program was matched with
+    auto checkProgram = [&](const char* kind, uint16_t programA, uint16_t programB, const ProgramMatch& match)
+    {
+        int32_t expected = programA < match.AToB.size() ? match.AToB[programA] : programA;
+        if(expected != (int32_t)programB)
+            AddChange(result, "technique \"%s\" pass %u %s: %u -> %u", technique, index, kind, programA, programB);
+    };
+    checkProgram("vs", passA.GetVertexProgramIndex(), passB.GetVertexProgramIndex(), vertexMatch);
+    checkProgram("ps", passA.GetPixelProgramIndex(), passB.GetPixelProgramIndex(), pixelMatch);
+
+    auto format = [](const RenderState& state, char* text, size_t size)
+    {
+        if(state.State == eRenderStateType::SLOPESCALEDEPTHBIAS || state.State == eRenderStateType::DEPTHBIAS)
+            snprintf(text, size, "%.9g", state.Value.DepthBias);
+        else
+        {
+            uint32_t value;
+            memcpy(&value, &state.Value, sizeof(value));
+            snprintf(text, size, "%u", value);
+        }
+    };
+
+    //compared by the values the passes end up with, a state set twice only counts with its last value
+    auto canonicalize = [](const rage::atArray<RenderState>& states)
+    {
+        std::vector<RenderState> canonical(states.begin(), states.end());
+        canonical.resize(RenderStatePool::Canonicalize(canonical.data(), (uint32_t)canonical.size()));
+        return canonical;
+    };
+    std::vector<RenderState> statesA = canonicalize(passA.GetRenderStates());
+    std::vector<RenderState> statesB = canonicalize(passB.GetRenderStates());
+    char valueA[32], valueB[32];
+    for(const RenderState& stateA : statesA)
+    {
+        auto stateB = std::find_if(statesB.begin(), statesB.end(), [&](const RenderState& state)
+        {
+            return state.State == stateA.State;
+        });
+
+        const char* stateName = eRenderStateType::EnumToString(stateA.State);
+        format(stateA, valueA, sizeof(valueA));
+        if(stateB == statesB.end())
+        {
+            AddChange(result, "technique \"%s\" pass %u - %s = %s", technique, index, stateName, valueA);
+            continue;
+        }
+
+        format(*stateB, valueB, sizeof(valueB));
+        if(strcmp(valueA, valueB) != 0)
+            AddChange(result, "technique \"%s\" pass %u %s: %s -> %s", technique, index, stateName, valueA, valueB);
+    }
+
+    for(const RenderState& stateB : statesB)
+    {
+        auto stateA = std::find_if(statesA.begin(), statesA.end(), [&](const RenderState& state)
+        {
+            return state.State == stateB.State;
+        });
+
+        if(stateA == statesA.end())
+        {
+            format(stateB, valueB, sizeof(valueB));
+            AddChange(result, "technique \"%s\" pass %u + %s = %s", technique, index, eRenderStateType::EnumToString(stateB.State), valueB);
+        }
+    }
+}
+
+void EffectDiff::Compare(const Effect& a, const Effect& b, Result& result)
+{
+    CompareParameters(a, b, true, result);
+    CompareParameters(a, b, false, result);
+
+    ProgramMatch vertexMatch = MatchPrograms(a, b, false);
+    ProgramMatch pixelMatch = MatchPrograms(a, b, true);
+    ComparePrograms(a, b, false, vertexMatch, result);
+    ComparePrograms(a, b, true, pixelMatch, result);
+
+    for(uint32_t i = 0; i < a.GetTechniqueCount(); i++)
+    {
+        const EffectTechnique& techniqueA = *a.GetTechniqueAt(i);
+        const EffectTechnique* techniqueB = nullptr;
+        for(uint32_t j = 0; j < b.GetTechniqueCount() && !techniqueB; j++)
+        {
+            if(b.GetTechniqueAt(j)->GetNameHash() == techniqueA.GetNameHash())
+                techniqueB = b.GetTechniqueAt(j);
+        }
+
+        const char* name = OrEmpty(techniqueA.GetName());
+        if(!techniqueB)
+        {
+            AddChange(result, "- technique \"%s\"", name);
+            continue;
+        }
+
+        const rage::atArray<EffectPass>& passesA = techniqueA.GetPasses();
+        const rage::atArray<EffectPass>& passesB = techniqueB->GetPasses();
+        if(passesA.GetCount() != passesB.GetCount())
+            AddChange(result, "technique \"%s\" passes: %u -> %u", name, passesA.GetCount(), passesB.GetCount());
+
+        for(uint16_t j = 0; j < std::min(passesA.GetCount(), passesB.GetCount()); j++)
+            ComparePass(passesA[j], passesB[j], name, j, vertexMatch, pixelMatch, result);
+    }
+
+    for(uint32_t i = 0; i < b.GetTechniqueCount(); i++)
+    {
+        const EffectTechnique& techniqueB = *b.GetTechniqueAt(i);
+        bool found = false;
+        for(uint32_t j = 0; j < a.GetTechniqueCount() && !found; j++)
+            found = a.GetTechniqueAt(j)->GetNameHash() == techniqueB.GetNameHash();
+
+        if(!found)
+            AddChange(result, "+ technique \"%s\"", OrEmpty(techniqueB.GetName()));
+    }
+}
+
+static bool CollectFiles(const char* folder, std::vector<std::filesystem::path>& files)
+{
+    std::vector<std::filesystem::path> found;
+    if(!FindFiles(folder, found))
+        return false;
+
+    for(const std::filesystem::path& file : found)
+        files.push_back(std::filesystem::relative(file, folder));
+    return true;
+}
+
+bool EffectDiff::Diff(const char* pathA, const char* pathB, uint32_t threadCount)
+{
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    bool isFolderA = std::filesystem::is_directory(pathA);
+    bool isFolderB = std::filesystem::is_directory(pathB);
+    if(isFolderA != isFolderB)
+    {
+        Log::Error("can only diff two files or two folders");
+        return false;
+    }
+
+    //relative paths of every effect in either folder, sorted so the report reads the same every run
+    std::vector<std::filesystem::path> files;
+    if(isFolderA)
+    {
+        if(!CollectFiles(pathA, files) || !CollectFiles(pathB, files))
+            return false;
+
+        std::sort(files.begin(), files.end());
+        files.erase(std::unique(files.begin(), files.end()), files.end());
+    }
+    else
+    {
+        files.push_back({});
+    }
+
+    //0 only in a, 1 only in b, 2 in both, 3 couldn't be loaded
+    std::vector<uint8_t> status(files.size());
+    std::vector<Result> results(files.size());
+    ParallelFor((uint32_t)files.size(), [&](uint32_t i)
+    {
+        Log::Job job(files[i].string().c_str());
+        std::filesystem::path fileA = isFolderA ? std::filesystem::path(pathA) / files[i] : std::filesystem::path(pathA);
+        std::filesystem::path fileB = isFolderB ? std::filesystem::path(pathB) / files[i] : std::filesystem::path(pathB);
+        results[i] = {};
+
+        bool existsA = std::filesystem::exists(fileA);
+        bool existsB = std::filesystem::exists(fileB);
+        if(!existsA || !existsB)
+        {
+            status[i] = existsA ? 0 : 1;
+            return;
+        }
+
+        IFileStream streamA(fileA.string().c_str());
+        IFileStream streamB(fileB.string().c_str());
+        if(!streamA.Open() || !streamB.Open())
+        {
+            status[i] = 3;
+            return;
+        }
+
+        Effect effectA(streamA);
+        Effect effectB(streamB);
+        if(effectA.GetLoadError() != eEffectLoadError::NONE || effectB.GetLoadError() != eEffectLoadError::NONE)
+        {
+            status[i] = 3;
+            return;
+        }
+
+        status[i] = 2;
+        Compare(effectA, effectB, results[i]);
+    }, threadCount);
+
+    uint32_t counts[4] {};
+    uint32_t changedCount = 0;
+    unsigned long long instructions[2][2] {};
+    for(size_t i = 0; i < files.size(); i++)
+    {
+        std::string path = isFolderA ? files[i].string() : std::string(pathA) + " -> " + pathB;
+        counts[status[i]]++;
+
+        if(status[i] == 0)
+            printf("- \"%s\"\n", path.c_str());
+        else if(status[i] == 1)
+            printf("+ \"%s\"\n", path.c_str());
+        else if(status[i] == 3)
+            printf("? \"%s\" couldn't be loaded\n", path.c_str());
+        else if(results[i].ChangeCount)
+        {
+            changedCount++;
+            printf("\"%s\" (%u changes)\n%s", path.c_str(), results[i].ChangeCount, results[i].Report.c_str());
+        }
+
+        for(uint32_t j = 0; j < 2; j++)
+        {
+            for(uint32_t k = 0; k < 2; k++)
+                instructions[j][k] += results[i].Instructions[j][k];
+        }
+    }
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1);
+    Log::Info("%u effects compared, %u changed, %u added, %u removed, %u unreadable", counts[2], changedCount, counts[1], counts[0], counts[3]);
+    Log::Info("vs instructions %llu -> %llu (%+lld), ps instructions %llu -> %llu (%+lld) (took %lldms)",
+              instructions[0][0], instructions[1][0], (long long)(instructions[1][0] - instructions[0][0]),
+              instructions[0][1], instructions[1][1], (long long)(instructions[1][1] - instructions[0][1]), ms.count());
+
+    return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+class Effect;
+class Parameter;
+
+//semantic diff between two builds of an effect: parameters and their defaults, annotations and sampler states matched by name,
+//render states per pass, and programs matched by bytecode and then by name with their instruction counts
+class EffectDiff
+{
+public:
+    struct Result
+    {
+        //one indented line per change
+        std::string Report;
+        uint32_t ChangeCount;
+        //[old or new][vertex or pixel] instructions over every program of the effect
+        uint32_t Instructions[2][2];
+    };
+
+    //a and b are both .fxc files or both folders. folders are matched by relative path and diffed in parallel,
+    //threadCount 0 uses every hardware thread. prints one report for everything and returns false if it couldn't run
+    static bool Diff(const char* pathA, const char* pathB, uint32_t threadCount = 0);
+
+    static void Compare(const Effect& a, const Effect& b, Result& result);
+
+private:
+    static void CompareParameters(const Effect& a, const Effect& b, bool global, Result& result);
+    static void CompareParameter(const Parameter& a, const Parameter& b, const char* label, Result& result);
+};
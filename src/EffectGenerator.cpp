@@ -0,0 +1,1000 @@
+#include "EffectGenerator.h"
+#include "Effect.h"
+#include "EffectWriter.h"
+#include "FileStream.h"
+#include "CompilerBackend.h"
+#include "ShaderAssembler.h"
+#include "Parallel.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+//splitmix64. the distributions in <random> differ between standard libraries, this gives the same corpus everywhere
+class Random
+{
+public:
+    Random(uint64_t seed) : mState(seed)
+    {}
+
+    uint64_t Next()
+    {
+        uint64_t z = (mState += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    //in [0, count)
+    uint32_t Below(uint32_t count)
+    {
+        return count ? (uint32_t)(Next() % count) : 0;
+    }
+
+    //between half of max and max
+    uint32_t Around(uint32_t max)
+    {
+        return max / 2 + Below(max - max / 2 + 1);
+    }
+
+    bool Chance(uint32_t percent)
+    {
+        return Below(100) < percent;
+    }
+
+    //multiples of a quarter up to max, they print the same everywhere
+    float Quarter(uint32_t max)
+    {
+        return Below(max * 4 + 1) * 0.25f;
+    }
+
+    template<typename T>
+    void Shuffle(std::vector<T>& values)
+    {
+        for(size_t i = values.size(); i > 1; i--)
+            std::swap(values[i - 1], values[Below((uint32_t)i)]);
+    }
+
+private:
+    uint64_t mState;
+};
+
+struct eGeneratedType
+{
+    enum Enum : uint8_t
+    {
+        FLOAT, FLOAT2, FLOAT3, FLOAT4, FLOAT4_ARRAY, FLOAT4X3, FLOAT4X4, INT, BOOL, SAMPLER, COUNT
+    };
+};
+
+static constexpr struct
+{
+    const char* HlslName;
+    //parameters are named after what they'd hold in a game
+    const char* Prefix;
+} sTypes[] =
+{
+    {"float",     "Scale"},
+    {"float2",    "Offset"},
+    {"float3",    "Direction"},
+    {"float4",    "Color"},
+    {"float4",    "Palette"},
+    {"float4x3",  "Bones"},
+    {"float4x4",  "Transform"},
+    {"int",       "Count"},
+    {"bool",      "Enable"},
+    {"sampler2D", "Sampler"},
+};
+static_assert(std::size(sTypes) == eGeneratedType::COUNT);
+
+struct StateChoice
+{
+    const char* Name;
+    //null terminated, null for a number between Min and Max
+    const char* const* Values;
+    uint32_t Min;
+    uint32_t Max;
+    bool Float;
+};
+
+static constexpr const char* sBooleans[] = {"True", "False", nullptr};
+static constexpr const char* sCompares[] = {"Never", "Less", "Equal", "LessEqual", "Greater", "NotEqual", "GreaterEqual", "Always", nullptr};
+static constexpr const char* sBlends[] = {"Zero", "One", "SrcColor", "InvSrcColor", "SrcAlpha", "InvSrcAlpha", "DestAlpha", "InvDestAlpha", "DestColor",
+                                          "InvDestColor", nullptr};
+static constexpr const char* sBlendOps[] = {"Add", "Subtract", "RevSubtract", "Min", "Max", nullptr};
+static constexpr const char* sCullModes[] = {"None", "CW", "CCW", nullptr};
+static constexpr const char* sFillModes[] = {"Point", "Wireframe", "Solid", nullptr};
+static constexpr const char* sStencilOps[] = {"Keep", "Zero", "Replace", "IncrSat", "DecrSat", "Invert", "Incr", "Decr", nullptr};
+static constexpr const char* sColorMasks[] = {"Red | Green | Blue | Alpha", "Red | Green | Blue", "Alpha", "False", nullptr};
+static constexpr const char* sAddresses[] = {"Wrap", "Mirror", "Clamp", "Border", nullptr};
+static constexpr const char* sFilters[] = {"Point", "Linear", "Anisotropic", nullptr};
+static constexpr const char* sMipFilters[] = {"None", "Point", "Linear", nullptr};
+
+static constexpr StateChoice sRenderStates[] =
+{
+    {"ZEnable",                  sBooleans},
+    {"ZWriteEnable",             sBooleans},
+    {"ZFunc",                    sCompares},
+    {"AlphaBlendEnable",         sBooleans},
+    {"SrcBlend",                 sBlends},
+    {"DestBlend",                sBlends},
+    {"BlendOp",                  sBlendOps},
+    {"SeparateAlphaBlendEnable", sBooleans},
+    {"SrcBlendAlpha",            sBlends},
+    {"DestBlendAlpha",           sBlends},
+    {"AlphaTestEnable",          sBooleans},
+    {"AlphaFunc",                sCompares},
+    {"AlphaRef",                 nullptr, 0, 255},
+    {"CullMode",                 sCullModes},
+    {"FillMode",                 sFillModes},
+    {"StencilEnable",            sBooleans},
+    {"StencilFunc",              sCompares},
+    {"StencilFail",              sStencilOps},
+    {"StencilPass",              sStencilOps},
+    {"StencilRef",               nullptr, 0, 255},
+    {"ColorWriteEnable",         sColorMasks},
+    {"DepthBias",                nullptr, 0, 4, true},
+    {"SlopeScaleDepthBias",      nullptr, 0, 4, true},
+};
+
+static constexpr StateChoice sSamplerStates[] =
+{
+    {"AddressU",      sAddresses},
+    {"AddressV",      sAddresses},
+    {"AddressW",      sAddresses},
+    {"MagFilter",     sFilters},
+    {"MinFilter",     sFilters},
+    {"MipFilter",     sMipFilters},
+    {"MipMapLodBias", nullptr, 0, 4, true},
+    {"MaxMipLevel",   nullptr, 0, 12},
+    {"MaxAnisotropy", nullptr, 1, 16},
+    {"SRGBTexture",   sBooleans},
+};
+
+static constexpr struct
+{
+    const char* Name;
+    uint32_t EffectGenerator::Settings::* Value;
+    uint32_t Min;
+    uint32_t Max;
+} sSettings[] =
+{
+    {"seed",          &EffectGenerator::Settings::Seed,              0, UINT32_MAX},
+    {"effects",       &EffectGenerator::Settings::EffectCount,       1, 1000000},
+    //.fxc files count most things in a byte
+    {"globals",       &EffectGenerator::Settings::GlobalCount,       0, 255},
+    {"shared",        &EffectGenerator::Settings::SharedCount,       0, 255},
+    {"annotations",   &EffectGenerator::Settings::AnnotationCount,   0, 255},
+    {"samplers",      &EffectGenerator::Settings::SamplerCount,      0, 255},
+    {"samplerstates", &EffectGenerator::Settings::SamplerStateCount, 0, (uint32_t)std::size(sSamplerStates)},
+    {"techniques",    &EffectGenerator::Settings::TechniqueCount,    0, 255},
+    {"passes",        &EffectGenerator::Settings::PassCount,         0, 255},
+    {"renderstates",  &EffectGenerator::Settings::RenderStateCount,  0, (uint32_t)std::size(sRenderStates)},
+    {"functions",     &EffectGenerator::Settings::FunctionCount,     0, 127},
+    {"asm",           &EffectGenerator::Settings::AsmCount,          0, 127},
+    {"includes",      &EffectGenerator::Settings::IncludeDepth,      0, 64},
+    {"arraysize",     &EffectGenerator::Settings::ArraySize,         2, 255},
+};
+
+//parameters a program reads at most, and the float registers it can bind before it runs out in a pixel shader
+static constexpr uint32_t MAX_PROGRAM_READS = 4;
+static constexpr uint32_t MAX_FLOAT_REGISTERS = 200;
+
+static constexpr uint64_t FNV_OFFSET = 14695981039346656037ull;
+static constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+struct GeneratedParameter
+{
+    std::string Name;
+    eGeneratedType::Enum Type;
+    uint32_t ArraySize;
+};
+
+struct GeneratedProgram
+{
+    std::string Name;
+    bool Pixel;
+    bool Asm;
+    //what d3dx would disassemble the program to. asm programs are written to the effect with it
+    std::string Disassembly;
+    std::vector<uint8_t> Bytecode;
+};
+
+struct GeneratedEffect
+{
+    std::filesystem::path Path;
+    std::string Source;
+    std::string Preprocessed;
+    std::vector<GeneratedProgram> Programs;
+    bool Failed;
+};
+
+static void AppendFormat(std::string& string, const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    string += Log::FormatArgList(fmt, args);
+    va_end(args);
+}
+
+//always with a point so the parser never takes it for an integer
+static void AppendFloat(std::string& string, float value)
+{
+    char number[32];
+    snprintf(number, sizeof(number), "%g", value);
+    string += number;
+    if(!strpbrk(number, ".e"))
+        string += ".0";
+}
+
+static void AppendVector(std::string& string, uint32_t columns, Random& random)
+{
+    AppendFormat(string, "float%u(", columns);
+    for(uint32_t i = 0; i < columns; i++)
+    {
+        if(i)
+            string += ", ";
+        AppendFloat(string, random.Quarter(4));
+    }
+    string += ")";
+}
+
+static void AppendStateValue(std::string& string, const StateChoice& state, Random& random)
+{
+    if(state.Values)
+    {
+        uint32_t valueCount = 0;
+        while(state.Values[valueCount])
+            valueCount++;
+        string += state.Values[random.Below(valueCount)];
+    }
+    else if(state.Float)
+    {
+        AppendFloat(string, random.Quarter(state.Max));
+    }
+    else
+    {
+        AppendFormat(string, "%u", state.Min + random.Below(state.Max - state.Min + 1));
+    }
+}
+
+//count different states out of choices, in a random order
+template<size_t Size>
+static void AppendStates(std::string& string, const StateChoice (&choices)[Size], uint32_t count, const char* indent, Random& random)
+{
+    std::vector<uint32_t> order(Size);
+    for(uint32_t i = 0; i < Size; i++)
+        order[i] = i;
+    random.Shuffle(order);
+
+    for(uint32_t i = 0; i < count && i < Size; i++)
+    {
+        const StateChoice& state = choices[order[i]];
+        AppendFormat(string, "%s%s = ", indent, state.Name);
+        AppendStateValue(string, state, random);
+        string += ";\n";
+    }
+}
+
+static void AppendAnnotation(std::string& string, const GeneratedParameter& param, uint32_t index, Random& random)
+{
+    static constexpr const char* sWidgets[] = {"Slider", "Color", "Numeric", "Spinner"};
+
+    switch(index)
+    {
+        case 0:
+            AppendFormat(string, "    string UIName = \"%s\";\n", param.Name.c_str() + 1);
+        break;
+
+        case 1:
+            AppendFormat(string, "    string UIWidget = \"%s\";\n", sWidgets[random.Below((uint32_t)std::size(sWidgets))]);
+        break;
+
+        case 2:
+            string += "    float UIMin = ";
+            AppendFloat(string, random.Quarter(4));
+            string += ";\n";
+        break;
+
+        case 3:
+            string += "    float UIMax = ";
+            AppendFloat(string, 4 + random.Quarter(12));
+            string += ";\n";
+        break;
+
+        case 4:
+            string += "    float UIStep = ";
+            AppendFloat(string, 0.25f + random.Quarter(1));
+            string += ";\n";
+        break;
+
+        case 5:
+            AppendFormat(string, "    int UIOrder = %u;\n", random.Below(256));
+        break;
+
+        default:
+            AppendFormat(string, "    string Tag%u = \"value %u\";\n", index, random.Below(1000));
+        break;
+    }
+}
+
+static void AppendParameter(std::string& string, const GeneratedParameter& param, bool shared, uint32_t maxAnnotations, Random& random)
+{
+    AppendFormat(string, "%s%s %s", shared ? "shared " : "", sTypes[param.Type].HlslName, param.Name.c_str());
+    if(param.Type == eGeneratedType::FLOAT4_ARRAY)
+        AppendFormat(string, "[%u]", param.ArraySize);
+    if(shared || random.Chance(50))
+        AppendFormat(string, " : %s", param.Name.c_str() + 1);
+
+    uint32_t annotationCount = random.Below(maxAnnotations + 1);
+    if(annotationCount)
+    {
+        string += "\n<\n";
+        for(uint32_t i = 0; i < annotationCount; i++)
+            AppendAnnotation(string, param, i, random);
+        string += ">";
+    }
+
+    //matrices are left to the game
+    if(random.Chance(30) || param.Type == eGeneratedType::FLOAT4X3 || param.Type == eGeneratedType::FLOAT4X4)
+    {
+        string += ";\n";
+        return;
+    }
+
+    string += " = ";
+    switch(param.Type)
+    {
+        case eGeneratedType::FLOAT:
+            AppendFloat(string, random.Quarter(4));
+        break;
+
+        case eGeneratedType::FLOAT2:
+        case eGeneratedType::FLOAT3:
+        case eGeneratedType::FLOAT4:
+            AppendVector(string, param.Type - eGeneratedType::FLOAT + 1, random);
+        break;
+
+        case eGeneratedType::FLOAT4_ARRAY:
+            string += "\n{\n";
+            for(uint32_t i = 0; i < param.ArraySize; i++)
+            {
+                string += "    ";
+                AppendVector(string, 4, random);
+                string += i != param.ArraySize - 1 ? ",\n" : "\n";
+            }
+            string += "}";
+        break;
+
+        case eGeneratedType::INT:
+            AppendFormat(string, "%u", random.Below(64));
+        break;
+
+        case eGeneratedType::BOOL:
+            string += random.Chance(50) ? "true" : "false";
+        break;
+
+        default:
+        break;
+    }
+    string += ";\n";
+}
+
+static GeneratedParameter MakeParameter(eGeneratedType::Enum type, const char* prefix, uint32_t index, const EffectGenerator::Settings& settings, Random& random)
+{
+    GeneratedParameter param;
+    param.Name = Log::Format("%s%s%u", prefix, sTypes[type].Prefix, index);
+    param.Type = type;
+    param.ArraySize = type == eGeneratedType::FLOAT4_ARRAY ? 2 + random.Below(settings.ArraySize - 1) : 1;
+    return param;
+}
+
+//chain headers have a helper each that programs can call, it scales by 0.5 and adds this
+static float GetHelperBias(uint32_t helper)
+{
+    return 0.125f * (helper + 1);
+}
+
+static bool IsFloatRegisterType(eGeneratedType::Enum type)
+{
+    return type == eGeneratedType::FLOAT || type == eGeneratedType::FLOAT4 || type == eGeneratedType::FLOAT4_ARRAY || type == eGeneratedType::FLOAT4X4;
+}
+
+//reads a few parameters into r0 and writes it out. the effect gets it as an hlsl function or an asm program, the compiler
+//answers with the disassembly, which for a function has the constant table in its comments the way d3dx writes it
+static void GenerateProgram(GeneratedProgram& program, const std::vector<const GeneratedParameter*>& parameters, uint32_t helperCount, Random& random,
+                            std::string& source)
+{
+    std::vector<const GeneratedParameter*> reads;
+    for(const GeneratedParameter* param : parameters)
+    {
+        if(IsFloatRegisterType(param->Type) || (param->Type == eGeneratedType::SAMPLER && program.Pixel))
+            reads.push_back(param);
+    }
+    random.Shuffle(reads);
+    reads.resize(std::min<size_t>(reads.size(), 1 + random.Below(MAX_PROGRAM_READS)));
+
+    std::string body;
+    std::string definitions;
+    std::string declarations;
+    std::string instructions;
+    std::string constants;
+    std::string registers;
+    std::string annotations;
+    uint32_t floatRegister = 0;
+    uint32_t samplerRegister = 0;
+    for(const GeneratedParameter* param : reads)
+    {
+        const char* name = param->Name.c_str();
+        uint32_t element = param->Type == eGeneratedType::FLOAT4_ARRAY ? random.Below(param->ArraySize) : 0;
+
+        //asm programs bind whole arrays, the compiler only as much as is read
+        uint32_t size = 1;
+        if(param->Type == eGeneratedType::FLOAT4X4)
+            size = 4;
+        else if(param->Type == eGeneratedType::FLOAT4_ARRAY)
+            size = program.Asm ? param->ArraySize : element + 1;
+
+        bool sampler = param->Type == eGeneratedType::SAMPLER;
+        if(!sampler && floatRegister + size > MAX_FLOAT_REGISTERS)
+            continue;
+
+        uint32_t reg = sampler ? samplerRegister++ : floatRegister;
+        switch(param->Type)
+        {
+            case eGeneratedType::FLOAT:
+                AppendFormat(body, "    result = result * %s;\n", name);
+                AppendFormat(instructions, "    mul r0, r0, c%u.x\n", reg);
+            break;
+
+            case eGeneratedType::FLOAT4:
+                AppendFormat(body, "    result = result * %s + %s;\n", name, name);
+                AppendFormat(instructions, "    mad r0, r0, c%u, c%u\n", reg, reg);
+            break;
+
+            case eGeneratedType::FLOAT4_ARRAY:
+                AppendFormat(body, "    result = result + %s[%u];\n", name, element);
+                AppendFormat(instructions, "    add r0, r0, c%u\n", reg + element);
+            break;
+
+            case eGeneratedType::FLOAT4X4:
+                AppendFormat(body, "    result = mul(result, %s);\n", name);
+                for(uint32_t i = 0; i < 4; i++)
+                    AppendFormat(instructions, "    dp4 r1.%c, r0, c%u\n", "xyzw"[i], reg + i);
+                instructions += "    mov r0, r1\n";
+            break;
+
+            case eGeneratedType::SAMPLER:
+                AppendFormat(body, "    result = result * tex2D(%s, texCoord);\n", name);
+                AppendFormat(declarations, "    dcl_2d s%u\n", reg);
+                AppendFormat(instructions, "    texld r1, v0, s%u\n", reg);
+                instructions += "    mul r0, r0, r1\n";
+            break;
+
+            default:
+            break;
+        }
+
+        if(!sampler)
+            floatRegister += size;
+
+        AppendFormat(constants, "//   %s %s", sTypes[param->Type].HlslName, name);
+        if(param->Type == eGeneratedType::FLOAT4_ARRAY)
+            AppendFormat(constants, "[%u]", param->ArraySize);
+        constants += ";\n";
+        AppendFormat(registers, "//   %-24s %c%-4u %4u\n", name, sampler ? 's' : 'c', reg, size);
+        AppendFormat(annotations, "    string %s = \"parameter register(%u)\";\n", name, reg);
+    }
+
+    if(!program.Asm && helperCount && random.Chance(50))
+    {
+        uint32_t helper = random.Below(helperCount);
+        AppendFormat(body, "    result = Chain%uScale(result);\n", helper);
+        AppendFormat(definitions, "    def c%u, 0.5, ", floatRegister);
+        AppendFloat(definitions, GetHelperBias(helper));
+        definitions += ", 0, 0\n";
+        AppendFormat(instructions, "    mad r0, r0, c%u.x, c%u.y\n", floatRegister, floatRegister);
+    }
+
+    std::string code = program.Pixel ? "    ps_3_0\n" : "    vs_3_0\n";
+    code += definitions;
+    code += program.Pixel ? "    dcl_texcoord v0.xy\n" : "    dcl_position v0\n    dcl_position o0\n";
+    code += declarations;
+    code += program.Pixel ? "    mov r0, v0.xyxy\n" : "    mov r0, v0\n";
+    code += instructions;
+    code += program.Pixel ? "    mov oC0, r0\n" : "    mov o0, r0\n";
+
+    if(program.Asm)
+    {
+        program.Disassembly = code;
+
+        AppendFormat(source, "%s %s\n", program.Pixel ? "PixelShader" : "VertexShader", program.Name.c_str());
+        if(!annotations.empty())
+            source += "<\n" + annotations + ">\n";
+        source += "= asm\n{\n" + code + "};\n\n";
+        return;
+    }
+
+    program.Disassembly = "//\n// Generated by fxdc /Generate\n";
+    if(!constants.empty())
+    {
+        program.Disassembly += "//\n// Parameters:\n//\n" + constants + "//\n//\n// Registers:\n//\n";
+        AppendFormat(program.Disassembly, "//   %-24s %-5s %4s\n", "Name", "Reg", "Size");
+        AppendFormat(program.Disassembly, "//   %-24s %-5s %4s\n", "------------------------", "-----", "----");
+        program.Disassembly += registers;
+    }
+    program.Disassembly += "//\n\n" + code;
+
+    if(program.Pixel)
+        AppendFormat(source, "float4 %s(float2 texCoord : TEXCOORD0) : COLOR\n{\n    float4 result = texCoord.xyxy;\n", program.Name.c_str());
+    else
+        AppendFormat(source, "float4 %s(float4 position : POSITION) : POSITION\n{\n    float4 result = position;\n", program.Name.c_str());
+    source += body;
+    source += "    return result;\n}\n\n";
+}
+
+static void GenerateEffect(GeneratedEffect& effect, const std::string& name, const EffectGenerator::Settings& settings,
+                           const std::vector<GeneratedParameter>& shared, Random& random)
+{
+    std::string& text = effect.Source;
+    AppendFormat(text, "//generated by fxdc /Generate with seed %u\n", settings.Seed);
+    if(settings.IncludeDepth)
+    {
+        text += "#include \"include/chain0.fxh\"\n";
+    }
+    else if(!shared.empty())
+    {
+        text += "\n";
+        for(const GeneratedParameter& param : shared)
+            AppendParameter(text, param, true, settings.AnnotationCount, random);
+    }
+
+    std::vector<GeneratedParameter> parameters;
+    uint32_t globalCount = random.Around(settings.GlobalCount);
+    uint32_t samplerCount = random.Around(settings.SamplerCount);
+    parameters.reserve(globalCount + samplerCount);
+
+    if(globalCount)
+        text += "\n";
+    for(uint32_t i = 0; i < globalCount; i++)
+    {
+        parameters.push_back(MakeParameter((eGeneratedType::Enum)random.Below(eGeneratedType::SAMPLER), "g", i, settings, random));
+        AppendParameter(text, parameters.back(), false, settings.AnnotationCount, random);
+    }
+
+    for(uint32_t i = 0; i < samplerCount; i++)
+    {
+        parameters.push_back(MakeParameter(eGeneratedType::SAMPLER, "g", i, settings, random));
+        AppendFormat(text, "\ntexture gTexture%u;\n", i);
+        AppendFormat(text, "sampler2D %s = sampler_state\n{\n    Texture = <gTexture%u>;\n", parameters.back().Name.c_str(), i);
+        AppendStates(text, sSamplerStates, random.Around(settings.SamplerStateCount), "    ", random);
+        text += "};\n";
+    }
+
+    std::vector<const GeneratedParameter*> readable;
+    for(const GeneratedParameter& param : shared)
+        readable.push_back(&param);
+    for(const GeneratedParameter& param : parameters)
+        readable.push_back(&param);
+
+    //vertex and pixel programs take turns, every effect gets at least one of each
+    uint32_t functionCount = random.Around(settings.FunctionCount);
+    uint32_t asmCount = random.Around(settings.AsmCount);
+    if(functionCount + asmCount < 2)
+        functionCount = 2 - asmCount;
+
+    text += "\n";
+    std::vector<uint32_t> vertexPrograms;
+    std::vector<uint32_t> pixelPrograms;
+    effect.Programs.resize(functionCount + asmCount);
+    for(uint32_t i = 0; i < functionCount + asmCount; i++)
+    {
+        GeneratedProgram& program = effect.Programs[i];
+        program.Pixel = i % 2 == 1;
+        program.Asm = i >= functionCount;
+        //functions are looked up by name when they're compiled, so the name of the effect keeps them apart
+        program.Name = Log::Format("%s%s_%s_%u", program.Pixel ? "PS" : "VS", program.Asm ? "Asm" : "", name.c_str(), i);
+        (program.Pixel ? pixelPrograms : vertexPrograms).push_back(i);
+
+        GenerateProgram(program, readable, settings.IncludeDepth, random, text);
+    }
+
+    uint32_t techniqueCount = random.Around(settings.TechniqueCount);
+    for(uint32_t i = 0; i < techniqueCount; i++)
+    {
+        AppendFormat(text, "technique Technique%u\n{\n", i);
+        uint32_t passCount = random.Around(settings.PassCount);
+        for(uint32_t j = 0; j < passCount; j++)
+        {
+            AppendFormat(text, "    pass p%u\n    {\n", j);
+            AppendStates(text, sRenderStates, random.Around(settings.RenderStateCount), "        ", random);
+
+            const GeneratedProgram& vertexProgram = effect.Programs[vertexPrograms[random.Below((uint32_t)vertexPrograms.size())]];
+            const GeneratedProgram& pixelProgram = effect.Programs[pixelPrograms[random.Below((uint32_t)pixelPrograms.size())]];
+            for(const GeneratedProgram* program : {&vertexProgram, &pixelProgram})
+            {
+                const char* state = program->Pixel ? "PixelShader" : "VertexShader";
+                if(program->Asm)
+                    AppendFormat(text, "        %s = %s;\n", state, program->Name.c_str());
+                else
+                    AppendFormat(text, "        %s = compile %s %s();\n", state, program->Pixel ? "ps_3_0" : "vs_3_0", program->Name.c_str());
+            }
+
+            text += j != passCount - 1 ? "    }\n\n" : "    }\n";
+        }
+        text += "}\n";
+        if(i != techniqueCount - 1)
+            text += "\n";
+    }
+}
+
+//what d3dx makes of an effect: every #include replaced by the header it names, with #line directives so messages still
+//point at the right file
+static void Flatten(const std::string& path, const std::string& text, const std::unordered_map<std::string, std::string>& headers, std::string& preprocessed)
+{
+    preprocessed += "#line 1 \"" + path + "\"\n";
+
+    static constexpr std::string_view sInclude = "#include \"";
+    uint32_t line = 1;
+    for(size_t begin = 0; begin < text.size(); line++)
+    {
+        size_t end = text.find('\n', begin);
+        if(end == std::string::npos)
+            end = text.size();
+        std::string_view current(text.data() + begin, end - begin);
+        begin = end + 1;
+
+        if(!current.starts_with(sInclude))
+        {
+            preprocessed.append(current);
+            preprocessed += '\n';
+            continue;
+        }
+
+        std::string_view name = current.substr(sInclude.size(), current.find('"', sInclude.size()) - sInclude.size());
+        std::string includePath = (std::filesystem::path(path).parent_path() / name).lexically_normal().generic_string();
+        auto header = headers.find(includePath);
+        if(header == headers.end())
+            continue;
+
+        Flatten(includePath, header->second, headers, preprocessed);
+        preprocessed += Log::Format("#line %u \"", line + 1) + path + "\"\n";
+    }
+}
+
+//hash of everything but the comments, which is what an asm program assembled with its constant table has in common with
+//the same program assembled without one
+static uint64_t HashInstructions(const std::vector<uint8_t>& bytecode)
+{
+    const uint32_t* tokens = (const uint32_t*)bytecode.data();
+    uint32_t tokenCount = (uint32_t)(bytecode.size() / sizeof(uint32_t));
+
+    uint64_t hash = FNV_OFFSET;
+    auto add = [&hash](uint32_t token)
+    {
+        for(uint32_t i = 0; i < 4; i++)
+            hash = (hash ^ ((token >> (i * 8)) & 0xFF)) * FNV_PRIME;
+    };
+
+    if(tokenCount)
+        add(tokens[0]);
+    for(uint32_t i = 1; i < tokenCount;)
+    {
+        uint32_t token = tokens[i];
+        if((token & 0xFFFF) == 0xFFFE)
+        {
+            i += 1 + ((token >> 16) & 0x7FFF);
+            continue;
+        }
+
+        uint32_t length = (token & 0xFFFF) == 0xFFFF ? 1 : 1 + ((token >> 24) & 0xF);
+        for(uint32_t j = i; j < i + length && j < tokenCount; j++)
+            add(tokens[j]);
+        i += length;
+    }
+
+    return hash;
+}
+
+static uint64_t HashBytecode(const uint8_t* data, size_t size)
+{
+    uint64_t hash = FNV_OFFSET;
+    for(size_t i = 0; i < size; i++)
+        hash = (hash ^ data[i]) * FNV_PRIME;
+    return hash;
+}
+
+//answers for the generated effects what d3dx would, so the record backend can write it down
+class GeneratedCompilerBackend : public CompilerBackend
+{
+public:
+    const char* GetName() const override
+    {
+        return "generated";
+    }
+
+    bool Preprocess(const char* filePath, const ShaderMacro* macros, CString& source, CString& messages) override
+    {
+        auto found = mSources.find(filePath);
+        if(found == mSources.end())
+        {
+            messages = CString("not a generated effect: ", filePath);
+            return false;
+        }
+
+        source = found->second.c_str();
+        return true;
+    }
+
+    bool PreprocessSource(const char* fileName, const char* data, size_t length, const ShaderMacro* macros, ShaderIncludeHandler* includes,
+                          CString& source, CString& messages) override
+    {
+        messages = CString("not a generated effect: ", fileName);
+        return false;
+    }
+
+    bool Compile(const char* source, size_t length, const char* entryPoint, const char* profile, uint32_t flags, ShaderBytecode& bytecode, CString& messages) override
+    {
+        //validating the whole effect
+        if(!entryPoint || !entryPoint[0])
+            return true;
+
+        auto found = mPrograms.find(entryPoint);
+        if(found == mPrograms.end())
+        {
+            messages = CString("not a generated function: ", entryPoint);
+            return false;
+        }
+
+        bytecode = {(uint32_t)found->second.size()};
+        memcpy(&bytecode[0], found->second.data(), found->second.size());
+        return true;
+    }
+
+    //asm programs are all shader model 3, the native assembler takes care of them
+    bool Assemble(const char* source, size_t length, ShaderBytecode& bytecode, CString& messages) override
+    {
+        messages = "generated asm programs are assembled natively";
+        return false;
+    }
+
+    bool Disassemble(const ShaderBytecode& bytecode, CString& disassembly) override
+    {
+        if(!bytecode.GetCapacity())
+            return false;
+
+        auto found = mDisassemblies.find(HashBytecode(&bytecode[0], bytecode.GetCapacity()));
+        if(found == mDisassemblies.end())
+        {
+            std::vector<uint8_t> data(&bytecode[0], &bytecode[0] + bytecode.GetCapacity());
+            found = mAsmDisassemblies.find(HashInstructions(data));
+            if(found == mAsmDisassemblies.end())
+                return false;
+        }
+
+        disassembly = found->second.c_str();
+        return true;
+    }
+
+    void Add(GeneratedEffect& effect)
+    {
+        mSources[effect.Path.string()] = std::move(effect.Preprocessed);
+        for(GeneratedProgram& program : effect.Programs)
+        {
+            if(program.Asm)
+            {
+                mAsmDisassemblies[HashInstructions(program.Bytecode)] = std::move(program.Disassembly);
+            }
+            else
+            {
+                mDisassemblies[HashBytecode(program.Bytecode.data(), program.Bytecode.size())] = std::move(program.Disassembly);
+                mPrograms[program.Name] = std::move(program.Bytecode);
+            }
+        }
+    }
+
+private:
+    //keyed by the path as it's given to Preprocess
+    std::unordered_map<std::string, std::string> mSources;
+    //bytecode of every function, by name
+    std::unordered_map<std::string, std::vector<uint8_t>> mPrograms;
+    //functions by their bytecode, asm programs by their instructions as they get a constant table from their annotations
+    std::unordered_map<uint64_t, std::string> mDisassemblies;
+    std::unordered_map<uint64_t, std::string> mAsmDisassemblies;
+};
+
+static bool WriteText(const std::filesystem::path& path, const std::string& text)
+{
+    OFileStream file(path.string().c_str());
+    if(!file.Open())
+        return false;
+
+    file.Write(text.data(), text.size());
+    file.Close();
+    return true;
+}
+
+bool EffectGenerator::ParseSettings(const char* text, Settings& settings)
+{
+    std::string_view remaining = text;
+    while(!remaining.empty())
+    {
+        size_t comma = remaining.find(',');
+        std::string_view setting = remaining.substr(0, comma);
+        remaining = comma == std::string_view::npos ? std::string_view() : remaining.substr(comma + 1);
+        if(setting.empty())
+            continue;
+
+        size_t equals = setting.find('=');
+        std::string name(setting.substr(0, equals));
+        std::string value(equals == std::string_view::npos ? std::string_view() : setting.substr(equals + 1));
+
+        auto found = std::find_if(std::begin(sSettings), std::end(sSettings), [&name](const auto& entry)
+        {
+            return name == entry.Name;
+        });
+        if(found == std::end(sSettings))
+        {
+            Log::Error("unknown generator setting \"%s\"", name.c_str());
+            return false;
+        }
+
+        char* end = nullptr;
+        unsigned long long number = strtoull(value.c_str(), &end, 10);
+        if(value.empty() || *end != '\0' || number < found->Min || number > found->Max)
+        {
+            Log::Error("generator setting \"%s\" must be a number from %u to %u", found->Name, found->Min, found->Max);
+            return false;
+        }
+
+        settings.*(found->Value) = (uint32_t)number;
+    }
+
+    if(settings.GlobalCount + settings.SamplerCount > 255)
+    {
+        Log::Error("globals and samplers can't add up to more than 255, .fxc files count parameters in a byte");
+        return false;
+    }
+
+    return true;
+}
+
+bool EffectGenerator::Generate(const char* folder, const Settings& settings, const CompileFunc& compile, uint32_t threadCount)
+{
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    std::filesystem::path root = folder;
+    std::error_code error;
+    std::filesystem::create_directories(root / "include", error);
+    if(error)
+    {
+        Log::Error("Unable to create folder \"%s\"", folder);
+        return false;
+    }
+
+    //shared parameters and the headers are the same for every effect
+    Random sharedRandom(((uint64_t)settings.Seed << 32) | 0xFFFFFFFF);
+    std::vector<GeneratedParameter> shared;
+    for(uint32_t i = 0; i < settings.SharedCount; i++)
+        shared.push_back(MakeParameter((eGeneratedType::Enum)sharedRandom.Below(eGeneratedType::SAMPLER), "gShared", i, settings, sharedRandom));
+
+    std::unordered_map<std::string, std::string> headers;
+    for(uint32_t i = 0; i < settings.IncludeDepth; i++)
+    {
+        std::string text = Log::Format("//generated by fxdc /Generate, header %u of %u\n", i + 1, settings.IncludeDepth);
+        if(i != settings.IncludeDepth - 1)
+            AppendFormat(text, "#include \"chain%u.fxh\"\n", i + 1);
+        else if(!shared.empty())
+            text += "#include \"shared.fxh\"\n";
+
+        AppendFormat(text, "\nfloat4 Chain%uScale(float4 value)\n{\n    return value * 0.5 + ", i);
+        AppendFloat(text, GetHelperBias(i));
+        text += ";\n}\n";
+        headers[(root / "include" / Log::Format("chain%u.fxh", i)).lexically_normal().generic_string()] = text;
+    }
+
+    if(settings.IncludeDepth && !shared.empty())
+    {
+        std::string text = "//generated by fxdc /Generate, parameters every effect shares\n";
+        for(const GeneratedParameter& param : shared)
+            AppendParameter(text, param, true, settings.AnnotationCount, sharedRandom);
+        headers[(root / "include" / "shared.fxh").lexically_normal().generic_string()] = text;
+    }
+
+    for(const auto& [path, text] : headers)
+    {
+        if(!WriteText(path, text))
+            return false;
+    }
+
+    uint32_t nameWidth = 4;
+    for(uint32_t i = 10000; i < settings.EffectCount; i *= 10)
+        nameWidth++;
+
+    //each effect has a generator of its own so the corpus doesn't depend on how the work is spread over the threads
+    std::vector<GeneratedEffect> effects(settings.EffectCount);
+    ParallelFor(settings.EffectCount, [&](uint32_t i)
+    {
+        GeneratedEffect& effect = effects[i];
+        std::string name = Log::Format("e%0*u", nameWidth, i);
+        effect.Path = root / (name + ".fx");
+        effect.Failed = true;
+
+        Log::Job job(effect.Path.string().c_str());
+        Random random(((uint64_t)settings.Seed << 32) | i);
+        GenerateEffect(effect, name, settings, shared, random);
+        Flatten(effect.Path.lexically_normal().generic_string(), effect.Source, headers, effect.Preprocessed);
+
+        for(GeneratedProgram& program : effect.Programs)
+        {
+            ShaderBytecode bytecode;
+            CString messages;
+            rage::atArray<ShaderConstant> noConstants;
+            if(ShaderAssembler::Assemble(program.Disassembly.data(), program.Disassembly.size(), noConstants, bytecode, messages) != eAssembleResult::OK)
+            {
+                Log::Error("generated program \"%s\" doesn't assemble: %s", program.Name.c_str(), messages.Get() ? messages.Get() : "");
+                return;
+            }
+            program.Bytecode.assign(&bytecode[0], &bytecode[0] + bytecode.GetCapacity());
+        }
+
+        effect.Failed = !WriteText(effect.Path, effect.Source);
+    }, threadCount);
+
+    std::unique_ptr<GeneratedCompilerBackend> backend = std::make_unique<GeneratedCompilerBackend>();
+    for(GeneratedEffect& effect : effects)
+    {
+        if(effect.Failed)
+            return false;
+        backend->Add(effect);
+    }
+
+    std::filesystem::path cacheFolder = root / "cache";
+    SetRecordingCompilerBackend(std::move(backend), cacheFolder.string().c_str());
+
+    std::atomic<uint32_t> failedCount = 0;
+    ParallelFor(settings.EffectCount, [&](uint32_t i)
+    {
+        const std::filesystem::path& fileIn = effects[i].Path;
+        std::filesystem::path fileOut = fileIn;
+        fileOut.replace_extension(".fxc");
+
+        Log::Job job(fileIn.string().c_str());
+        if(!compile(fileIn, fileOut))
+        {
+            failedCount++;
+            return;
+        }
+
+        //unpacking asks for the disassembly of every program, which gets recorded with the rest
+        IFileStream file(fileOut.string().c_str());
+        if(!file.Open())
+        {
+            failedCount++;
+            return;
+        }
+
+        Effect effect(file);
+        EffectWriter writer;
+        if(effect.GetLoadError() != eEffectLoadError::NONE || !effect.SaveToFx(writer))
+        {
+            Log::Error("generated effect \"%s\" doesn't unpack", fileOut.string().c_str());
+            failedCount++;
+        }
+    }, threadCount);
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1);
+    Log::Info("generated %u effects in \"%s\", %u failed (took %lldms)", settings.EffectCount, folder, failedCount.load(), ms.count());
+    Log::Info("compile them again with /Backend replay /Cache %s", cacheFolder.string().c_str());
+
+    return failedCount == 0;
+}
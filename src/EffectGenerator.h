@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+
+//writes a corpus of synthetic effects for benchmarking and profiling the parser, the loader and the writer at any scale.
+//the same seed and settings always give the same files. d3dx isn't needed: the compiler results the effects ask for are
+//made up alongside them and recorded to <folder>/cache, so they compile again with /Backend replay /Cache <folder>/cache
+//from any working directory, and after the folder is moved
+class EffectGenerator
+{
+public:
+    //counts marked per effect are upper bounds, every effect picks between half of it and all of it
+    struct Settings
+    {
+        uint32_t Seed = 1;
+        uint32_t EffectCount = 16;
+        //per effect, not counting samplers
+        uint32_t GlobalCount = 24;
+        //declared in the innermost header so every effect has them
+        uint32_t SharedCount = 8;
+        //per parameter, from none up to this many
+        uint32_t AnnotationCount = 4;
+        //per effect
+        uint32_t SamplerCount = 4;
+        //per sampler
+        uint32_t SamplerStateCount = 4;
+        //per effect
+        uint32_t TechniqueCount = 3;
+        //per technique
+        uint32_t PassCount = 2;
+        //per pass
+        uint32_t RenderStateCount = 4;
+        //hlsl vertex and pixel shader functions per effect
+        uint32_t FunctionCount = 4;
+        //asm vertex and pixel shaders per effect
+        uint32_t AsmCount = 2;
+        //headers every effect includes through each other, the last one holds the shared parameters
+        uint32_t IncludeDepth = 2;
+        //largest float4 array
+        uint32_t ArraySize = 8;
+    };
+
+    //compiles fileIn to fileOut, which already ends in .fxc
+    using CompileFunc = std::function<bool(const std::filesystem::path& fileIn, const std::filesystem::path& fileOut)>;
+
+    //text is comma separated name=value pairs like "effects=1000,seed=7,passes=4". names are seed, effects, globals, shared,
+    //annotations, samplers, samplerstates, techniques, passes, renderstates, functions, asm, includes and arraysize.
+    //settings that aren't named keep their defaults
+    static bool ParseSettings(const char* text, Settings& settings);
+
+    //writes the effects and their headers to folder, makes the recording backend the compiler backend, then compiles every
+    //effect next to its source and unpacks the result again so the disassembly is recorded too.
+    //returns false if an effect fails either way, which is a bug in the generator
+    static bool Generate(const char* folder, const Settings& settings, const CompileFunc& compile, uint32_t threadCount = 0);
+};
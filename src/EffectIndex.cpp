@@ -0,0 +1,361 @@
+#include "EffectIndex.h"
+#include "Effect.h"
+#include "FileStream.h"
+#include "Parallel.h"
+#include "rage/StringHash.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+struct IndexHeader
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t EffectCount;
+    uint32_t KeyCount;
+    uint32_t PostingCount;
+    //file offsets of the effect path offsets, the sorted keys, the postings and the path strings
+    uint32_t Effects;
+    uint32_t Keys;
+    uint32_t Postings;
+    uint32_t Strings;
+    uint32_t StringSize;
+};
+ASSERT_SIZE(IndexHeader, 0x28);
+
+struct IndexKey
+{
+    uint64_t Key;
+    uint32_t FirstPosting;
+    uint32_t PostingCount;
+};
+ASSERT_SIZE(IndexKey, 0x10);
+
+struct IndexEntry
+{
+    uint64_t Key;
+    EffectIndex::Posting Posting;
+
+    bool operator<(const IndexEntry& rhs) const
+    {
+        if(Key != rhs.Key)
+            return Key < rhs.Key;
+        if(Posting.Effect != rhs.Posting.Effect)
+            return Posting.Effect < rhs.Posting.Effect;
+        return Posting.Item < rhs.Posting.Item;
+    }
+
+    bool operator==(const IndexEntry& rhs) const
+    {
+        return Key == rhs.Key && Posting.Effect == rhs.Posting.Effect && Posting.Item == rhs.Posting.Item;
+    }
+};
+
+static void CollectEntries(const Effect& effect, uint32_t effectIndex, std::vector<IndexEntry>& entries)
+{
+    using eKeyType = EffectIndex::eKeyType;
+
+    auto addParameter = [&](const Parameter& param, uint32_t item)
+    {
+        entries.push_back({EffectIndex::MakeKey(eKeyType::PARAMETER_NAME, param.GetNameHash()), {effectIndex, item}});
+        entries.push_back({EffectIndex::MakeKey(eKeyType::SEMANTIC, param.GetSemanticHash()), {effectIndex, item}});
+    };
+
+    for(uint32_t i = 0; i < effect.GetGlobalParameterCount(); i++)
+        addParameter(*effect.GetGlobalParameterAt(i), i | EffectIndex::GLOBAL_PARAMETER);
+    for(uint32_t i = 0; i < effect.GetParameterCount(); i++)
+        addParameter(*effect.GetParameterAt(i), i);
+
+    for(uint32_t i = 0; i < effect.GetTechniqueCount(); i++)
+    {
+        const EffectTechnique& technique = *effect.GetTechniqueAt(i);
+        entries.push_back({EffectIndex::MakeKey(eKeyType::TECHNIQUE, technique.GetNameHash()), {effectIndex, i}});
+
+        for(uint32_t j = 0; j < technique.GetPasses().GetCount(); j++)
+        {
+            for(const RenderState& state : technique.GetPasses()[(uint16_t)j].GetRenderStates())
+            {
+                uint32_t value;
+                memcpy(&value, &state.Value, sizeof(value));
+                entries.push_back({EffectIndex::MakeKey(eKeyType::RENDER_STATE, value, state.State), {effectIndex, (i << 16) | j}});
+            }
+        }
+    }
+
+    for(uint32_t i = 0; i < effect.GetVertexProgramCount(); i++)
+    {
+        for(const GpuProgram::Param& param : effect.GetVertexProgramAt(i)->mParams)
+            entries.push_back({EffectIndex::MakeKey(eKeyType::VERTEX_PROGRAM_PARAM, param.mName.GetHash(), param.mRegisterIndex), {effectIndex, i}});
+    }
+
+    for(uint32_t i = 0; i < effect.GetPixelProgramCount(); i++)
+    {
+        for(const GpuProgram::Param& param : effect.GetPixelProgramAt(i)->mParams)
+            entries.push_back({EffectIndex::MakeKey(eKeyType::PIXEL_PROGRAM_PARAM, param.mName.GetHash(), param.mRegisterIndex), {effectIndex, i}});
+    }
+}
+
+bool EffectIndex::Build(const char* folder, const char* indexPath, uint32_t threadCount)
+{
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    std::vector<std::filesystem::path> files;
+    if(!FindFiles(folder, files))
+        return false;
+
+    //every effect fills its own list so the workers never share anything but the string interner
+    std::vector<std::vector<IndexEntry>> effectEntries(files.size());
+    ParallelFor((uint32_t)files.size(), [&](uint32_t i)
+    {
+        Log::Job job(files[i].string().c_str());
+        IFileStream file(files[i].string().c_str());
+        if(!file.Open())
+            return;
+
+        Effect effect(file);
+        if(effect.GetLoadError() == eEffectLoadError::NONE)
+            CollectEntries(effect, i, effectEntries[i]);
+    }, threadCount);
+
+    size_t entryCount = 0;
+    for(const std::vector<IndexEntry>& entries : effectEntries)
+        entryCount += entries.size();
+
+    std::vector<IndexEntry> entries;
+    entries.reserve(entryCount);
+    for(std::vector<IndexEntry>& list : effectEntries)
+    {
+        entries.insert(entries.end(), list.begin(), list.end());
+        std::vector<IndexEntry>().swap(list);
+    }
+
+    std::sort(entries.begin(), entries.end());
+    entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+
+    std::vector<IndexKey> keys;
+    std::vector<Posting> postings;
+    postings.reserve(entries.size());
+    for(const IndexEntry& entry : entries)
+    {
+        if(keys.empty() || keys.back().Key != entry.Key)
+            keys.push_back({entry.Key, (uint32_t)postings.size(), 0});
+
+        keys.back().PostingCount++;
+        postings.push_back(entry.Posting);
+    }
+
+    std::vector<uint32_t> pathOffsets;
+    std::string strings;
+    pathOffsets.reserve(files.size());
+    for(const std::filesystem::path& path : files)
+    {
+        pathOffsets.push_back((uint32_t)strings.size());
+        strings += std::filesystem::relative(path, folder).generic_string();
+        strings += '\0';
+    }
+
+    IndexHeader header {};
+    header.Magic = MAGIC;
+    header.Version = VERSION;
+    header.EffectCount = (uint32_t)files.size();
+    header.KeyCount = (uint32_t)keys.size();
+    header.PostingCount = (uint32_t)postings.size();
+    header.Effects = sizeof(IndexHeader);
+    //keys are 8 byte aligned for the mapped reads
+    header.Keys = (header.Effects + header.EffectCount * sizeof(uint32_t) + 7) & ~7;
+    header.Postings = header.Keys + header.KeyCount * sizeof(IndexKey);
+    header.Strings = header.Postings + header.PostingCount * sizeof(Posting);
+    header.StringSize = (uint32_t)strings.size();
+
+    OFileStream file(indexPath);
+    if(!file.Open())
+        return false;
+
+    file.Write(&header, sizeof(header));
+    if(!pathOffsets.empty())
+        file.Write(pathOffsets.data(), pathOffsets.size() * sizeof(uint32_t));
+
+    uint64_t padding = 0;
+    file.Write(&padding, header.Keys - (header.Effects + header.EffectCount * sizeof(uint32_t)));
+    if(!keys.empty())
+        file.Write(keys.data(), keys.size() * sizeof(IndexKey));
+    if(!postings.empty())
+        file.Write(postings.data(), postings.size() * sizeof(Posting));
+    file.Write(strings.data(), strings.size());
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1);
+    Log::Info("indexed %u effects, %u keys (took %lldms)", header.EffectCount, header.KeyCount, ms.count());
+    return true;
+}
+
+bool EffectIndex::Open(const char* indexPath)
+{
+    if(!mFile.Open(indexPath))
+        return false;
+
+    const IndexHeader* header = (const IndexHeader*)mFile.GetData();
+    uint64_t size = mFile.GetSize();
+    if(size < sizeof(IndexHeader) || header->Magic != MAGIC || header->Version != VERSION ||
+       header->Effects + (uint64_t)header->EffectCount * sizeof(uint32_t) > size ||
+       header->Keys + (uint64_t)header->KeyCount * sizeof(IndexKey) > size ||
+       header->Postings + (uint64_t)header->PostingCount * sizeof(Posting) > size ||
+       header->Strings + (uint64_t)header->StringSize > size || (header->Keys & 7) ||
+       (header->StringSize && mFile.GetData()[header->Strings + header->StringSize - 1] != '\0'))
+    {
+        Log::Error("\"%s\" is not an effect index.", indexPath);
+        mFile.Close();
+        return false;
+    }
+
+    return true;
+}
+
+std::span<const EffectIndex::Posting> EffectIndex::Find(uint64_t key) const
+{
+    const IndexHeader* header = (const IndexHeader*)mFile.GetData();
+    if(!header)
+        return {};
+
+    const IndexKey* keys = (const IndexKey*)(mFile.GetData() + header->Keys);
+    const IndexKey* keysEnd = keys + header->KeyCount;
+    const IndexKey* it = std::lower_bound(keys, keysEnd, key, [](const IndexKey& lhs, uint64_t rhs)
+    {
+        return lhs.Key < rhs;
+    });
+
+    if(it == keysEnd || it->Key != key || (uint64_t)it->FirstPosting + it->PostingCount > header->PostingCount)
+        return {};
+
+    const Posting* postings = (const Posting*)(mFile.GetData() + header->Postings);
+    return {postings + it->FirstPosting, it->PostingCount};
+}
+
+uint32_t EffectIndex::GetEffectCount() const
+{
+    const IndexHeader* header = (const IndexHeader*)mFile.GetData();
+    return header ? header->EffectCount : 0;
+}
+
+const char* EffectIndex::GetEffectPath(uint32_t index) const
+{
+    const IndexHeader* header = (const IndexHeader*)mFile.GetData();
+    if(!header || index >= header->EffectCount)
+        return "";
+
+    uint32_t offset = ((const uint32_t*)(mFile.GetData() + header->Effects))[index];
+    if(offset >= header->StringSize)
+        return "";
+
+    return (const char*)mFile.GetData() + header->Strings + offset;
+}
+
+bool EffectIndex::Query(const char* indexPath, const char* type, const char* value)
+{
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    eKeyType::Enum keyType = eKeyType::StringToEnum(type);
+    if(keyType == eKeyType::COUNT)
+    {
+        Log::Error("unknown query \"%s\", expected name, semantic, technique, state, vs or ps", type);
+        return false;
+    }
+
+    uint64_t key;
+    if(keyType == eKeyType::RENDER_STATE || keyType == eKeyType::VERTEX_PROGRAM_PARAM || keyType == eKeyType::PIXEL_PROGRAM_PARAM)
+    {
+        const char* separator = strchr(value, '=');
+        if(!separator)
+        {
+            Log::Error("expected <name>=<value> but got \"%s\"", value);
+            return false;
+        }
+
+        std::string name(value, separator - value);
+        const char* valueStr = separator + 1;
+
+        if(keyType == eKeyType::RENDER_STATE)
+        {
+            eRenderStateType::Enum state = eRenderStateType::StringToEnum(name.c_str());
+            if(state == eRenderStateType::COUNT)
+            {
+                Log::Error("unknown render state \"%s\"", name.c_str());
+                return false;
+            }
+
+            //render states are stored as raw dwords, floats keep their bits
+            uint32_t stateValue;
+            if(strcmp(valueStr, "true") == 0 || strcmp(valueStr, "false") == 0)
+            {
+                stateValue = valueStr[0] == 't';
+            }
+            else if(strchr(valueStr, '.'))
+            {
+                float f = strtof(valueStr, nullptr);
+                memcpy(&stateValue, &f, sizeof(stateValue));
+            }
+            else
+            {
+                stateValue = strtoul(valueStr, nullptr, 0);
+            }
+
+            key = MakeKey(keyType, stateValue, state);
+        }
+        else
+        {
+            //c12, s0, b3 or just the register index
+            if(isalpha(valueStr[0]))
+                valueStr++;
+            key = MakeKey(keyType, rage::atStringHash(name.c_str()), strtoul(valueStr, nullptr, 10));
+        }
+    }
+    else
+    {
+        key = MakeKey(keyType, rage::atStringHash(value));
+    }
+
+    EffectIndex index;
+    if(!index.Open(indexPath))
+        return false;
+
+    std::span<const Posting> postings = index.Find(key);
+    for(const Posting& posting : postings)
+    {
+        const char* path = index.GetEffectPath(posting.Effect);
+        switch(keyType)
+        {
+            case eKeyType::PARAMETER_NAME:
+            case eKeyType::SEMANTIC:
+                if(posting.Item & GLOBAL_PARAMETER)
+                    Log::Info("%s : global parameter %u", path, posting.Item & ~GLOBAL_PARAMETER);
+                else
+                    Log::Info("%s : parameter %u", path, posting.Item);
+                break;
+            case eKeyType::TECHNIQUE:
+                Log::Info("%s : technique %u", path, posting.Item);
+                break;
+            case eKeyType::RENDER_STATE:
+                Log::Info("%s : technique %u pass %u", path, posting.Item >> 16, posting.Item & 0xFFFF);
+                break;
+            case eKeyType::VERTEX_PROGRAM_PARAM:
+                Log::Info("%s : vertex program %u", path, posting.Item);
+                break;
+            case eKeyType::PIXEL_PROGRAM_PARAM:
+                Log::Info("%s : pixel program %u", path, posting.Item);
+                break;
+            default:
+                break;
+        }
+    }
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1);
+    Log::Info("%zu match(es) among %u effects (took %lldus)", postings.size(), index.GetEffectCount(), us.count());
+    return true;
+}
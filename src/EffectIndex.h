@@ -0,0 +1,75 @@
+#pragma once
+#include "MappedFile.h"
+#include "Utils.h"
+
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <span>
+
+//inverted index over every .fxc in a folder. keys are made from parameter name and semantic hashes, technique names,
+//render state values and the registers programs bind parameters to, each one lists the effects it was found in.
+//the index is memory mapped for queries so a lookup only touches the keys it binary searches and the postings it returns.
+class EffectIndex
+{
+public:
+    struct eKeyType
+    {
+        enum Enum : uint8_t
+        {
+            PARAMETER_NAME, SEMANTIC, TECHNIQUE, RENDER_STATE, VERTEX_PROGRAM_PARAM, PIXEL_PROGRAM_PARAM, COUNT
+        };
+
+        static const char* EnumToString(Enum type)
+        {
+            if((size_t)type < std::size(msNames))
+                return msNames[(uint32_t)type];
+            else
+                return "INVALID";
+        }
+
+        static Enum StringToEnum(const char* string)
+        {
+            size_t index = msNameTable.Find(string);
+            return index < std::size(msNames) ? (Enum)index : Enum::COUNT;
+        }
+
+    private:
+        static constexpr const char* msNames[] {"name", "semantic", "technique", "state", "vs", "ps"};
+        static constexpr PerfectHashTable<std::size(msNames)> msNameTable {msNames};
+    };
+
+    struct Posting
+    {
+        uint32_t Effect;
+        //parameter, technique or program index in the effect. global parameters have GLOBAL_PARAMETER set,
+        //render states have the technique index in the upper 16 bits and the pass index in the lower
+        uint32_t Item;
+    };
+
+    static constexpr uint32_t GLOBAL_PARAMETER = 0x80000000;
+    static constexpr uint32_t MAGIC = (uint32_t)'ixgr';
+    static constexpr uint32_t VERSION = 1;
+
+    //type in the top 8 bits, the 24 bit value (render state type or register index) below it and the hash in the low 32.
+    //render states use the state's value as the hash
+    static constexpr uint64_t MakeKey(eKeyType::Enum type, uint32_t hash, uint32_t value = 0)
+    {
+        return ((uint64_t)type << 56) | ((uint64_t)(value & 0xFFFFFF) << 32) | hash;
+    }
+
+    //scans folder and its subfolders, threadCount 0 uses every hardware thread
+    static bool Build(const char* folder, const char* indexPath, uint32_t threadCount = 0);
+    //parses a query like "semantic World", "state AlphaBlendEnable=1" or "ps gLightColor=c12" and prints the matches
+    static bool Query(const char* indexPath, const char* type, const char* value);
+
+    bool Open(const char* indexPath);
+
+    std::span<const Posting> Find(uint64_t key) const;
+    uint32_t GetEffectCount() const;
+    //relative to the folder the index was built from
+    const char* GetEffectPath(uint32_t index) const;
+
+private:
+    MappedFile mFile;
+};
@@ -0,0 +1,272 @@
+#include "EffectStats.h"
+#include "Effect.h"
+#include "FileStream.h"
+#include "ShaderStats.h"
+#include "Parallel.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+struct PassStats
+{
+    //interned, it stays valid after the effect is gone
+    const char* Technique;
+    uint16_t Pass;
+    uint16_t VertexProgram;
+    uint16_t PixelProgram;
+    //instruction counts of both programs added up, registers the larger of the two
+    ShaderStats Stats;
+};
+
+struct EffectStatsEntry
+{
+    bool Loaded;
+    std::vector<ShaderStats> VertexPrograms;
+    std::vector<ShaderStats> PixelPrograms;
+    std::vector<PassStats> Passes;
+};
+
+static void CollectStats(const Effect& effect, EffectStatsEntry& entry)
+{
+    entry.VertexPrograms.resize(effect.GetVertexProgramCount());
+    for(uint32_t i = 0; i < effect.GetVertexProgramCount(); i++)
+        entry.VertexPrograms[i].Init(effect.GetVertexProgramAt(i)->mShaderData);
+
+    entry.PixelPrograms.resize(effect.GetPixelProgramCount());
+    for(uint32_t i = 0; i < effect.GetPixelProgramCount(); i++)
+        entry.PixelPrograms[i].Init(effect.GetPixelProgramAt(i)->mShaderData);
+
+    for(uint32_t i = 0; i < effect.GetTechniqueCount(); i++)
+    {
+        const EffectTechnique& technique = *effect.GetTechniqueAt(i);
+        for(uint16_t j = 0; j < technique.GetPasses().GetCount(); j++)
+        {
+            const EffectPass& pass = technique.GetPasses()[j];
+            PassStats& passStats = entry.Passes.emplace_back();
+            passStats.Technique = technique.GetName() ? technique.GetName() : "";
+            passStats.Pass = j;
+            passStats.VertexProgram = pass.GetVertexProgramIndex();
+            passStats.PixelProgram = pass.GetPixelProgramIndex();
+
+            ShaderStats& stats = passStats.Stats;
+            for(const ShaderStats* program : {passStats.VertexProgram < entry.VertexPrograms.size() ? &entry.VertexPrograms[passStats.VertexProgram] : nullptr,
+                                              passStats.PixelProgram < entry.PixelPrograms.size() ? &entry.PixelPrograms[passStats.PixelProgram] : nullptr})
+            {
+                if(!program)
+                    continue;
+
+                stats.Instructions += program->Instructions;
+                stats.Alu += program->Alu;
+                stats.Texture += program->Texture;
+                stats.FlowControl += program->FlowControl;
+                stats.Temps = std::max(stats.Temps, program->Temps);
+                stats.FloatConstants = std::max(stats.FloatConstants, program->FloatConstants);
+                stats.IntConstants = std::max(stats.IntConstants, program->IntConstants);
+                stats.BoolConstants = std::max(stats.BoolConstants, program->BoolConstants);
+                stats.Samplers = std::max(stats.Samplers, program->Samplers);
+            }
+        }
+    }
+}
+
+static void AppendFormat(std::string& string, const char* fmt, ...)
+{
+    char text[256];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(text, sizeof(text), fmt, args);
+    va_end(args);
+    string += text;
+}
+
+static void AppendCsvString(std::string& string, const std::string& value)
+{
+    string += '"';
+    for(char c : value)
+    {
+        if(c == '"')
+            string += '"';
+        string += c;
+    }
+    string += '"';
+}
+
+static void AppendJsonString(std::string& string, const std::string& value)
+{
+    string += '"';
+    for(char c : value)
+    {
+        if(c == '"' || c == '\\')
+            string += '\\';
+        string += c;
+    }
+    string += '"';
+}
+
+static void AppendCsvStats(std::string& string, const ShaderStats& stats)
+{
+    AppendFormat(string, ",%u,%u,%u,%u,%u,%u,%u,%u,%u\n", stats.Instructions, stats.Alu, stats.Texture, stats.FlowControl, stats.Temps,
+                 stats.FloatConstants, stats.IntConstants, stats.BoolConstants, stats.Samplers);
+}
+
+static void AppendJsonStats(std::string& string, const ShaderStats& stats)
+{
+    AppendFormat(string, "\"instructions\": %u, \"alu\": %u, \"texture\": %u, \"flow_control\": %u, \"temps\": %u, \"float_constants\": %u, "
+                 "\"int_constants\": %u, \"bool_constants\": %u, \"samplers\": %u}", stats.Instructions, stats.Alu, stats.Texture, stats.FlowControl,
+                 stats.Temps, stats.FloatConstants, stats.IntConstants, stats.BoolConstants, stats.Samplers);
+}
+
+//one row per program and one per pass. program rows leave technique and pass empty, pass rows name the programs they use
+static std::string WriteCsv(const std::vector<std::filesystem::path>& files, const std::vector<EffectStatsEntry>& entries)
+{
+    std::string csv = "effect,kind,index,technique,pass,vs,ps,instructions,alu,texture,flow_control,temps,float_constants,int_constants,bool_constants,samplers\n";
+    for(size_t i = 0; i < files.size(); i++)
+    {
+        const EffectStatsEntry& entry = entries[i];
+        if(!entry.Loaded)
+            continue;
+
+        for(bool pixel : {false, true})
+        {
+            const std::vector<ShaderStats>& programs = pixel ? entry.PixelPrograms : entry.VertexPrograms;
+            for(size_t j = 0; j < programs.size(); j++)
+            {
+                AppendCsvString(csv, files[i].string());
+                AppendFormat(csv, ",%s,%zu,,,,", pixel ? "ps" : "vs", j);
+                AppendCsvStats(csv, programs[j]);
+            }
+        }
+
+        for(const PassStats& pass : entry.Passes)
+        {
+            AppendCsvString(csv, files[i].string());
+            csv += ",pass,,";
+            AppendCsvString(csv, pass.Technique);
+            AppendFormat(csv, ",%u,%u,%u", pass.Pass, pass.VertexProgram, pass.PixelProgram);
+            AppendCsvStats(csv, pass.Stats);
+        }
+    }
+
+    return csv;
+}
+
+static std::string WriteJson(const std::vector<std::filesystem::path>& files, const std::vector<EffectStatsEntry>& entries)
+{
+    std::string json = "[\n";
+    bool first = true;
+    for(size_t i = 0; i < files.size(); i++)
+    {
+        const EffectStatsEntry& entry = entries[i];
+        if(!entry.Loaded)
+            continue;
+
+        json += first ? "    {\"effect\": " : ",\n    {\"effect\": ";
+        first = false;
+        AppendJsonString(json, files[i].string());
+
+        for(bool pixel : {false, true})
+        {
+            const std::vector<ShaderStats>& programs = pixel ? entry.PixelPrograms : entry.VertexPrograms;
+            json += pixel ? ",\n     \"pixel_programs\": [" : ",\n     \"vertex_programs\": [";
+            for(size_t j = 0; j < programs.size(); j++)
+            {
+                AppendFormat(json, "%s\n        {\"index\": %zu, ", j ? "," : "", j);
+                AppendJsonStats(json, programs[j]);
+            }
+            json += "]";
+        }
+
+        json += ",\n     \"passes\": [";
+        for(size_t j = 0; j < entry.Passes.size(); j++)
+        {
+            const PassStats& pass = entry.Passes[j];
+            json += j ? ",\n        {\"technique\": " : "\n        {\"technique\": ";
+            AppendJsonString(json, pass.Technique);
+            AppendFormat(json, ", \"pass\": %u, \"vs\": %u, \"ps\": %u, ", pass.Pass, pass.VertexProgram, pass.PixelProgram);
+            AppendJsonStats(json, pass.Stats);
+        }
+        json += "]}";
+    }
+    json += "\n]\n";
+
+    return json;
+}
+
+bool EffectStats::Report(const char* path, const char* outPath, uint32_t threadCount)
+{
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    std::vector<std::filesystem::path> files;
+    if(!std::filesystem::is_directory(path))
+        files.push_back(path);
+    else if(!FindFiles(path, files))
+        return false;
+
+    std::vector<EffectStatsEntry> entries(files.size());
+    ParallelFor((uint32_t)files.size(), [&](uint32_t i)
+    {
+        Log::Job job(files[i].string().c_str());
+        IFileStream file(files[i].string().c_str());
+        if(!file.Open())
+            return;
+
+        Effect effect(file);
+        if(effect.GetLoadError() != eEffectLoadError::NONE)
+            return;
+
+        CollectStats(effect, entries[i]);
+        entries[i].Loaded = true;
+    }, threadCount);
+
+    std::string report = std::filesystem::path(outPath).extension() == ".json" ? WriteJson(files, entries) : WriteCsv(files, entries);
+
+    OFileStream file(outPath);
+    if(!file.Open())
+        return false;
+    file.Write(report.data(), report.size());
+    file.Close();
+
+    struct ProgramRef
+    {
+        uint32_t Effect;
+        uint32_t Index;
+    };
+
+    std::vector<ProgramRef> pixelPrograms;
+    uint32_t loadedCount = 0;
+    for(uint32_t i = 0; i < entries.size(); i++)
+    {
+        loadedCount += entries[i].Loaded;
+        for(uint32_t j = 0; j < entries[i].PixelPrograms.size(); j++)
+            pixelPrograms.push_back({i, j});
+    }
+
+    auto instructions = [&](const ProgramRef& program)
+    {
+        return entries[program.Effect].PixelPrograms[program.Index].Instructions;
+    };
+    size_t topCount = std::min<size_t>(pixelPrograms.size(), 10);
+    std::partial_sort(pixelPrograms.begin(), pixelPrograms.begin() + topCount, pixelPrograms.end(), [&](const ProgramRef& a, const ProgramRef& b)
+    {
+        return instructions(a) > instructions(b);
+    });
+
+    Log::Info("heaviest pixel shaders:");
+    for(size_t i = 0; i < topCount; i++)
+    {
+        const ShaderStats& stats = entries[pixelPrograms[i].Effect].PixelPrograms[pixelPrograms[i].Index];
+        Log::Info("    %4u instructions (%u alu, %u texture, %u flow control), %u temps, %u samplers  \"%s\" ps %u", stats.Instructions, stats.Alu,
+                  stats.Texture, stats.FlowControl, stats.Temps, stats.Samplers, files[pixelPrograms[i].Effect].string().c_str(), pixelPrograms[i].Index);
+    }
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1);
+    Log::Info("wrote stats for %u of %zu effects to \"%s\" (took %lldms)", loadedCount, files.size(), outPath, ms.count());
+
+    return true;
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <cstdint>
+
+//cost report over .fxc files built from the program bytecode alone: instruction mix and registers used per program,
+//and the same summed over the programs of every technique pass
+class EffectStats
+{
+public:
+    //path is a .fxc or a folder that's scanned with its subfolders, threadCount 0 uses every hardware thread.
+    //the report is written as json if outPath ends in .json and as csv otherwise, then the heaviest pixel shaders are printed
+    static bool Report(const char* path, const char* outPath, uint32_t threadCount = 0);
+};
@@ -0,0 +1,401 @@
+#include "EffectVerifier.h"
+#include "Effect.h"
+#include "FileStream.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+//collects the lines of a diff. every difference is counted but only the first few are kept so a badly broken effect
+//doesn't bury the rest of the corpus
+class DiffReport
+{
+public:
+    DiffReport(std::string& text, uint32_t maxLines) : mText(text), mMaxLines(maxLines), mCount(0)
+    {}
+
+    template<typename ...Args>
+    void Add(const char* fmt, Args ...args)
+    {
+        if(mCount++ >= mMaxLines)
+            return;
+
+        char line[512];
+        snprintf(line, sizeof(line), fmt, args...);
+        mText += "    ";
+        mText += line;
+        mText += '\n';
+    }
+
+    uint32_t GetCount() const
+    {
+        return mCount;
+    }
+
+private:
+    std::string& mText;
+    uint32_t mMaxLines;
+    uint32_t mCount;
+};
+
+static const char* OrEmpty(const char* string)
+{
+    return string ? string : "";
+}
+
+static bool IsFloatType(Parameter::eType::Enum type)
+{
+    return type == Parameter::eType::FLOAT || type == Parameter::eType::VECTOR2 || type == Parameter::eType::VECTOR3 || type == Parameter::eType::VECTOR4 ||
+           type == Parameter::eType::MATRIX4X3 || type == Parameter::eType::MATRIX4X4;
+}
+
+static void ComparePrograms(const Effect& expected, const Effect& actual, bool pixel, DiffReport& diff)
+{
+    const char* kind = pixel ? "ps" : "vs";
+    uint32_t expectedCount = pixel ? expected.GetPixelProgramCount() : expected.GetVertexProgramCount();
+    uint32_t actualCount = pixel ? actual.GetPixelProgramCount() : actual.GetVertexProgramCount();
+    if(expectedCount != actualCount)
+        diff.Add("%s count: %u -> %u", kind, expectedCount, actualCount);
+
+    for(uint32_t i = 0; i < std::min(expectedCount, actualCount); i++)
+    {
+        const GpuProgram& a = pixel ? *expected.GetPixelProgramAt(i) : *expected.GetVertexProgramAt(i);
+        const GpuProgram& b = pixel ? *actual.GetPixelProgramAt(i) : *actual.GetVertexProgramAt(i);
+
+        if(a.mParams.GetCount() != b.mParams.GetCount())
+            diff.Add("%s %u param count: %u -> %u", kind, i, a.mParams.GetCount(), b.mParams.GetCount());
+
+        for(uint16_t j = 0; j < std::min(a.mParams.GetCount(), b.mParams.GetCount()); j++)
+        {
+            const GpuProgram::Param& pa = a.mParams[j];
+            const GpuProgram::Param& pb = b.mParams[j];
+            if(pa.mName != pb.mName)
+                diff.Add("%s %u param %u name: \"%s\" -> \"%s\"", kind, i, j, OrEmpty(pa.mName.Get()), OrEmpty(pb.mName.Get()));
+            if(pa.mType != pb.mType)
+                diff.Add("%s %u param \"%s\" type: %s -> %s", kind, i, OrEmpty(pa.mName.Get()), Parameter::eType::EnumToString(pa.mType),
+                         Parameter::eType::EnumToString(pb.mType));
+            if(pa.mRegisterIndex != pb.mRegisterIndex)
+                diff.Add("%s %u param \"%s\" register: %u -> %u", kind, i, OrEmpty(pa.mName.Get()), pa.mRegisterIndex, pb.mRegisterIndex);
+            if(pa.mUnknown != pb.mUnknown)
+                diff.Add("%s %u param \"%s\" unknown: %u -> %u", kind, i, OrEmpty(pa.mName.Get()), pa.mUnknown, pb.mUnknown);
+        }
+
+        uint32_t sizeA = a.mShaderData.GetCapacity();
+        uint32_t sizeB = b.mShaderData.GetCapacity();
+        uint32_t common = std::min(sizeA, sizeB);
+        uint32_t offset = 0;
+        while(offset < common && a.mShaderData[offset] == b.mShaderData[offset])
+            offset++;
+
+        if(sizeA != sizeB)
+            diff.Add("%s %u bytecode size: %u -> %u, first difference at 0x%X", kind, i, sizeA, sizeB, offset);
+        else if(offset != common)
+            diff.Add("%s %u bytecode: first difference at 0x%X", kind, i, offset);
+    }
+}
+
+void EffectVerifier::CompareParameter(const Parameter& expected, const Parameter& actual, const char* label, DiffReport& diff)
+{
+    const char* name = OrEmpty(expected.GetName());
+    if(expected.mName != actual.mName)
+        diff.Add("%s name: \"%s\" -> \"%s\"", label, name, OrEmpty(actual.GetName()));
+    if(expected.mSemantic != actual.mSemantic)
+        diff.Add("%s \"%s\" semantic: \"%s\" -> \"%s\"", label, name, OrEmpty(expected.GetSemantic()), OrEmpty(actual.GetSemantic()));
+    if(expected.mType != actual.mType)
+        diff.Add("%s \"%s\" type: %s -> %s", label, name, Parameter::eType::EnumToString(expected.mType), Parameter::eType::EnumToString(actual.mType));
+    if(expected.mCount != actual.mCount)
+        diff.Add("%s \"%s\" count: %u -> %u", label, name, expected.mCount, actual.mCount);
+    if(expected.mSize != actual.mSize)
+        diff.Add("%s \"%s\" size: %u -> %u", label, name, expected.mSize, actual.mSize);
+
+    if(expected.mAnnotationCount != actual.mAnnotationCount)
+        diff.Add("%s \"%s\" annotation count: %u -> %u", label, name, expected.mAnnotationCount, actual.mAnnotationCount);
+
+    for(uint16_t i = 0; i < std::min(expected.mAnnotationCount, actual.mAnnotationCount); i++)
+    {
+        const Annotation& a = expected.mAnnotations[i];
+        const Annotation& b = actual.mAnnotations[i];
+        const char* annotationName = OrEmpty(a.mName.Get());
+
+        if(a.mName != b.mName)
+            diff.Add("%s \"%s\" annotation %u name: \"%s\" -> \"%s\"", label, name, i, annotationName, OrEmpty(b.mName.Get()));
+        if(a.mType != b.mType)
+        {
+            diff.Add("%s \"%s\" annotation \"%s\" type: %s -> %s", label, name, annotationName, eAnnotationType::EnumToString(a.mType),
+                     eAnnotationType::EnumToString(b.mType));
+            continue;
+        }
+
+        if(a.mType == eAnnotationType::STRING)
+        {
+            if(strcmp(OrEmpty(a.mValue.AsString), OrEmpty(b.mValue.AsString)) != 0)
+                diff.Add("%s \"%s\" annotation \"%s\": \"%s\" -> \"%s\"", label, name, annotationName, OrEmpty(a.mValue.AsString), OrEmpty(b.mValue.AsString));
+        }
+        else if(a.mType == eAnnotationType::FLOAT)
+        {
+            //compare the bits, %.9g losses are exactly what this is meant to catch
+            if(memcmp(&a.mValue.AsFloat, &b.mValue.AsFloat, sizeof(float)) != 0)
+                diff.Add("%s \"%s\" annotation \"%s\": %.9g -> %.9g", label, name, annotationName, a.mValue.AsFloat, b.mValue.AsFloat);
+        }
+        else if(a.mValue.AsInt != b.mValue.AsInt)
+            diff.Add("%s \"%s\" annotation \"%s\": %d -> %d", label, name, annotationName, a.mValue.AsInt, b.mValue.AsInt);
+    }
+
+    //values are only comparable when both sides laid them out the same way
+    if(expected.mType != actual.mType || expected.mCount != actual.mCount || expected.mSize != actual.mSize || !expected.mSize)
+        return;
+
+    if(expected.mType == Parameter::eType::TEXTURE)
+    {
+        uint32_t stateCount = 4 * expected.mSize / sizeof(SamplerState);
+        for(uint32_t i = 0; i < stateCount; i++)
+        {
+            const SamplerState& a = expected.mValue.AsSamplerState[i];
+            const SamplerState& b = actual.mValue.AsSamplerState[i];
+            if(a.Type != b.Type)
+            {
+                diff.Add("%s \"%s\" sampler state %u: %s -> %s", label, name, i, eSamplerStateType::EnumToString(a.Type), eSamplerStateType::EnumToString(b.Type));
+                continue;
+            }
+
+            uint32_t valueA, valueB;
+            memcpy(&valueA, &a.Value, sizeof(uint32_t));
+            memcpy(&valueB, &b.Value, sizeof(uint32_t));
+            if(valueA == valueB)
+                continue;
+
+            if(a.Type == eSamplerStateType::MIPMAPLODBIAS)
+                diff.Add("%s \"%s\" %s: %.9g -> %.9g", label, name, eSamplerStateType::EnumToString(a.Type), a.Value.MipMapLodBias, b.Value.MipMapLodBias);
+            else
+                diff.Add("%s \"%s\" %s: %u -> %u", label, name, eSamplerStateType::EnumToString(a.Type), valueA, valueB);
+        }
+        return;
+    }
+
+    //each element is stored padded out to the full size of its type, only the part the file holds is compared
+    uint32_t elementSize = expected.mSize / expected.mCount;
+    uint32_t elementStride = expected.GetTotalSize() / 4 / expected.mCount;
+    const uint32_t* valuesA = (const uint32_t*)expected.mValue.AsVoid;
+    const uint32_t* valuesB = (const uint32_t*)actual.mValue.AsVoid;
+    for(uint32_t i = 0; i < expected.mCount; i++)
+    {
+        for(uint32_t j = 0; j < elementSize; j++)
+        {
+            uint32_t index = i * elementStride + j;
+            if(valuesA[index] == valuesB[index])
+                continue;
+
+            if(IsFloatType(expected.mType))
+            {
+                float a, b;
+                memcpy(&a, &valuesA[index], sizeof(float));
+                memcpy(&b, &valuesB[index], sizeof(float));
+                diff.Add("%s \"%s\" value[%u][%u]: %.9g -> %.9g", label, name, i, j, a, b);
+            }
+            else
+                diff.Add("%s \"%s\" value[%u][%u]: 0x%X -> 0x%X", label, name, i, j, valuesA[index], valuesB[index]);
+        }
+    }
+}
+
+uint32_t EffectVerifier::Compare(const Effect& expected, const Effect& actual, std::string& report, uint32_t maxLines)
+{
+    DiffReport diff(report, maxLines);
+
+    ComparePrograms(expected, actual, false, diff);
+    ComparePrograms(expected, actual, true, diff);
+
+    if(expected.GetGlobalParameterCount() != actual.GetGlobalParameterCount())
+        diff.Add("global parameter count: %u -> %u", expected.GetGlobalParameterCount(), actual.GetGlobalParameterCount());
+    for(uint32_t i = 0; i < std::min(expected.GetGlobalParameterCount(), actual.GetGlobalParameterCount()); i++)
+        CompareParameter(*expected.GetGlobalParameterAt(i), *actual.GetGlobalParameterAt(i), "global parameter", diff);
+
+    if(expected.GetParameterCount() != actual.GetParameterCount())
+        diff.Add("parameter count: %u -> %u", expected.GetParameterCount(), actual.GetParameterCount());
+    for(uint32_t i = 0; i < std::min(expected.GetParameterCount(), actual.GetParameterCount()); i++)
+        CompareParameter(*expected.GetParameterAt(i), *actual.GetParameterAt(i), "parameter", diff);
+
+    if(expected.GetTechniqueCount() != actual.GetTechniqueCount())
+        diff.Add("technique count: %u -> %u", expected.GetTechniqueCount(), actual.GetTechniqueCount());
+
+    for(uint32_t i = 0; i < std::min(expected.GetTechniqueCount(), actual.GetTechniqueCount()); i++)
+    {
+        const EffectTechnique& a = *expected.GetTechniqueAt(i);
+        const EffectTechnique& b = *actual.GetTechniqueAt(i);
+        const char* name = OrEmpty(a.GetName());
+
+        if(a.GetNameHash() != b.GetNameHash())
+            diff.Add("technique %u name: \"%s\" -> \"%s\"", i, name, OrEmpty(b.GetName()));
+        if(a.GetPasses().GetCount() != b.GetPasses().GetCount())
+            diff.Add("technique \"%s\" pass count: %u -> %u", name, a.GetPasses().GetCount(), b.GetPasses().GetCount());
+
+        for(uint16_t j = 0; j < std::min(a.GetPasses().GetCount(), b.GetPasses().GetCount()); j++)
+        {
+            const EffectPass& passA = a.GetPasses()[j];
+            const EffectPass& passB = b.GetPasses()[j];
+
+            if(passA.GetVertexProgramIndex() != passB.GetVertexProgramIndex())
+                diff.Add("technique \"%s\" pass %u vs: %u -> %u", name, j, passA.GetVertexProgramIndex(), passB.GetVertexProgramIndex());
+            if(passA.GetPixelProgramIndex() != passB.GetPixelProgramIndex())
+                diff.Add("technique \"%s\" pass %u ps: %u -> %u", name, j, passA.GetPixelProgramIndex(), passB.GetPixelProgramIndex());
+
+            const rage::atArray<RenderState>& statesA = passA.GetRenderStates();
+            const rage::atArray<RenderState>& statesB = passB.GetRenderStates();
+            if(statesA.GetCount() != statesB.GetCount())
+                diff.Add("technique \"%s\" pass %u state count: %u -> %u", name, j, statesA.GetCount(), statesB.GetCount());
+
+            for(uint16_t k = 0; k < std::min(statesA.GetCount(), statesB.GetCount()); k++)
+            {
+                const RenderState& stateA = statesA[k];
+                const RenderState& stateB = statesB[k];
+                if(stateA.State != stateB.State)
+                {
+                    diff.Add("technique \"%s\" pass %u state %u: %s -> %s", name, j, k, eRenderStateType::EnumToString(stateA.State),
+                             eRenderStateType::EnumToString(stateB.State));
+                    continue;
+                }
+
+                uint32_t valueA, valueB;
+                memcpy(&valueA, &stateA.Value, sizeof(uint32_t));
+                memcpy(&valueB, &stateB.Value, sizeof(uint32_t));
+                if(valueA == valueB)
+                    continue;
+
+                if(stateA.State == eRenderStateType::SLOPESCALEDEPTHBIAS || stateA.State == eRenderStateType::DEPTHBIAS)
+                {
+                    float a, b;
+                    memcpy(&a, &valueA, sizeof(float));
+                    memcpy(&b, &valueB, sizeof(float));
+                    diff.Add("technique \"%s\" pass %u %s: %.9g -> %.9g", name, j, eRenderStateType::EnumToString(stateA.State), a, b);
+                }
+                else
+                    diff.Add("technique \"%s\" pass %u %s: %u -> %u", name, j, eRenderStateType::EnumToString(stateA.State), valueA, valueB);
+            }
+        }
+    }
+
+    return diff.GetCount();
+}
+
+static constexpr uint32_t MAX_DIFF_LINES = 16;
+
+//unpacks and repacks one effect. returns whether it came back identical, report receives the diff or why it couldn't be round tripped
+static bool VerifyEffect(const std::filesystem::path& filePath, uint32_t shaderFlags, std::string& report)
+{
+    std::string path = filePath.string();
+
+    MappedFile mapped;
+    if(!mapped.Open(path.c_str()))
+    {
+        report += "    unable to open the file\n";
+        return false;
+    }
+
+    IFileStream input(path.c_str(), mapped.GetData(), mapped.GetSize());
+    Effect original(input);
+    if(original.GetLoadError() != eEffectLoadError::NONE)
+    {
+        report += "    not a valid effect file: ";
+        report += eEffectLoadError::EnumToString(original.GetLoadError());
+        report += '\n';
+        return false;
+    }
+
+    EffectWriter writer;
+    if(!original.SaveToFx(writer))
+    {
+        report += "    unable to unpack the effect\n";
+        return false;
+    }
+    std::string source = writer.GetString();
+
+    M4::Allocator allocator;
+    M4::HLSLParser parser(&allocator, path.c_str(), source.c_str(), source.length());
+    M4::HLSLTree tree(&allocator);
+    if(!parser.Parse(&tree))
+    {
+        report += "    the unpacked effect doesn't parse\n";
+        return false;
+    }
+
+    Effect repacked;
+    if(!repacked.LoadFromFx(parser, shaderFlags))
+    {
+        report += "    the unpacked effect doesn't compile\n";
+        return false;
+    }
+
+    std::vector<uint8_t> bytes;
+    OFileStream output(path.c_str(), bytes);
+    if(!repacked.Save(output, original.GetFormat()))
+    {
+        report += "    the repacked effect can't be saved\n";
+        return false;
+    }
+
+    uint32_t differences = EffectVerifier::Compare(original, repacked, report, MAX_DIFF_LINES);
+    if(differences > MAX_DIFF_LINES)
+    {
+        char line[64];
+        snprintf(line, sizeof(line), "    and %u more\n", differences - MAX_DIFF_LINES);
+        report += line;
+    }
+
+    //the structural diff says what changed, this catches anything it doesn't look at
+    size_t common = std::min(mapped.GetSize(), bytes.size());
+    size_t offset = 0;
+    while(offset < common && mapped.GetData()[offset] == bytes[offset])
+        offset++;
+
+    if(offset != common || mapped.GetSize() != bytes.size())
+    {
+        char line[128];
+        snprintf(line, sizeof(line), "    bytes: size 0x%zX -> 0x%zX, first difference at 0x%zX\n", mapped.GetSize(), bytes.size(), offset);
+        report += line;
+        differences++;
+    }
+
+    return differences == 0;
+}
+
+bool EffectVerifier::Verify(const char* path, uint32_t shaderFlags, uint32_t threadCount)
+{
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    std::vector<std::filesystem::path> files;
+    if(!std::filesystem::is_directory(path))
+        files.push_back(path);
+    else if(!FindFiles(path, files))
+        return false;
+
+    std::vector<std::string> reports(files.size());
+    std::vector<uint8_t> passed(files.size());
+    ParallelFor((uint32_t)files.size(), [&](uint32_t i)
+    {
+        Log::Job job(files[i].string().c_str());
+        passed[i] = VerifyEffect(files[i], shaderFlags, reports[i]);
+    }, threadCount);
+
+    //printed afterwards so the output is the same no matter how the work was spread out
+    uint32_t failCount = 0;
+    for(size_t i = 0; i < files.size(); i++)
+    {
+        if(passed[i])
+            continue;
+
+        failCount++;
+        Log::Error("\"%s\" didn't survive the round trip", files[i].string().c_str());
+        printf("%s", reports[i].c_str());
+    }
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1);
+    Log::Info("verified %zu effects, %u failed (took %lldms)", files.size(), failCount, ms.count());
+
+    return failCount == 0;
+}
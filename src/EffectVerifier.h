@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+class Effect;
+class Parameter;
+class DiffReport;
+
+//round trips .fxc files through SaveToFx, the parser, LoadFromFx and Save entirely in memory and reports whatever didn't
+//survive, field by field and byte by byte. nothing is written to disk
+class EffectVerifier
+{
+public:
+    //path is a .fxc or a folder that's scanned with its subfolders, threadCount 0 uses every hardware thread.
+    //prints a short diff for every effect that changed and returns whether all of them came back identical
+    static bool Verify(const char* path, uint32_t shaderFlags = 0, uint32_t threadCount = 0);
+
+    //appends one indented line per differing field to report, up to maxLines of them. returns how many fields differ
+    static uint32_t Compare(const Effect& expected, const Effect& actual, std::string& report, uint32_t maxLines = 16);
+
+private:
+    static void CompareParameter(const Parameter& expected, const Parameter& actual, const char* label, DiffReport& diff);
+};
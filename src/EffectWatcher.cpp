@@ -0,0 +1,437 @@
+#include "EffectWatcher.h"
+#include "Parallel.h"
+#include "Log.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+//saves closer together than this are handled as one batch, editors often write a file more than once when saving it
+static constexpr auto DEBOUNCE_TIME = std::chrono::milliseconds(100);
+//how often the folder is scanned again where there's no change notification
+static constexpr auto POLL_TIME = std::chrono::milliseconds(250);
+
+static bool IsSourceFile(const std::filesystem::path& path)
+{
+    std::filesystem::path extension = path.extension();
+    return extension == ".fx" || extension == ".fxh" || extension == ".h" || extension == ".hlsl";
+}
+
+//#include lines of a file. a name is looked up next to the including file and then at the root of the watched folder.
+//includes that don't exist yet are kept so creating them later still recompiles the effects that want them
+static std::vector<std::filesystem::path> ReadIncludes(const std::filesystem::path& file, const std::filesystem::path& root)
+{
+    std::vector<std::filesystem::path> includes;
+    std::ifstream stream(file);
+    std::string line;
+    while(std::getline(stream, line))
+    {
+        size_t start = line.find_first_not_of(" \t");
+        if(start == std::string::npos || line[start] != '#')
+            continue;
+
+        start = line.find_first_not_of(" \t", start + 1);
+        if(start == std::string::npos || line.compare(start, 7, "include") != 0)
+            continue;
+
+        size_t begin = line.find_first_of("\"<", start + 7);
+        size_t end = begin == std::string::npos ? std::string::npos : line.find_first_of("\">", begin + 1);
+        if(end == std::string::npos)
+            continue;
+
+        std::filesystem::path name = line.substr(begin + 1, end - begin - 1);
+        std::filesystem::path path = (file.parent_path() / name).lexically_normal();
+        std::error_code error;
+        if(!std::filesystem::exists(path, error) && std::filesystem::exists(root / name, error))
+            path = (root / name).lexically_normal();
+
+        includes.push_back(path);
+    }
+
+    return includes;
+}
+
+void IncludeGraph::Update(const std::filesystem::path& file, const std::filesystem::path& root)
+{
+    std::error_code error;
+    if(std::filesystem::is_regular_file(file, error))
+        mIncludes[file] = ReadIncludes(file, root);
+    else
+        mIncludes.erase(file);
+}
+
+std::vector<std::filesystem::path> IncludeGraph::GetEffects() const
+{
+    std::vector<std::filesystem::path> effects;
+    for(const auto& [file, includes] : mIncludes)
+    {
+        if(file.extension() == ".fx")
+            effects.push_back(file);
+    }
+
+    return effects;
+}
+
+std::set<std::filesystem::path> IncludeGraph::GetFiles(const std::filesystem::path& effect) const
+{
+    std::set<std::filesystem::path> files;
+    std::vector<std::filesystem::path> pending = {effect};
+    while(!pending.empty())
+    {
+        std::filesystem::path file = pending.back();
+        pending.pop_back();
+        if(!files.insert(file).second)
+            continue;
+
+        auto it = mIncludes.find(file);
+        if(it != mIncludes.end())
+            pending.insert(pending.end(), it->second.begin(), it->second.end());
+    }
+
+    return files;
+}
+
+std::vector<std::filesystem::path> IncludeGraph::GetAffectedEffects(const std::set<std::filesystem::path>& changed) const
+{
+    std::vector<std::filesystem::path> affected;
+    for(const std::filesystem::path& effect : GetEffects())
+    {
+        std::set<std::filesystem::path> files = GetFiles(effect);
+        bool isAffected = std::any_of(changed.begin(), changed.end(), [&](const std::filesystem::path& file)
+        {
+            return files.contains(file);
+        });
+
+        if(isAffected)
+            affected.push_back(effect);
+    }
+
+    return affected;
+}
+
+//blocks until source files in the folder changed and then stayed untouched for DEBOUNCE_TIME.
+//uses inotify on linux and compares write times everywhere else
+class ChangeMonitor
+{
+public:
+#ifdef __linux__
+    ChangeMonitor() : mInotify(-1), mOverflowed(false)
+    {}
+
+    ~ChangeMonitor()
+    {
+        if(mInotify != -1)
+            close(mInotify);
+    }
+
+    bool Init(const std::filesystem::path& root)
+    {
+        mInotify = inotify_init1(IN_CLOEXEC);
+        if(mInotify == -1)
+        {
+            Log::Error("unable to create an inotify instance");
+            return false;
+        }
+
+        std::set<std::filesystem::path> ignored;
+        return AddWatches(root, ignored);
+    }
+
+    //returns false if changes were lost and every file has to be looked at again
+    bool Wait(std::set<std::filesystem::path>& changed)
+    {
+        while(changed.empty() && !mOverflowed)
+            ReadEvents(-1, changed);
+
+        while(ReadEvents((int)DEBOUNCE_TIME.count(), changed))
+            ;
+
+        bool overflowed = mOverflowed;
+        mOverflowed = false;
+        return !overflowed;
+    }
+
+private:
+    //the folder and its subfolders. files already in a folder count as changed, it was created after the watch started
+    bool AddWatches(const std::filesystem::path& folder, std::set<std::filesystem::path>& changed)
+    {
+        uint32_t mask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+        int watch = inotify_add_watch(mInotify, folder.string().c_str(), mask);
+        if(watch == -1)
+        {
+            Log::Error("unable to watch \"%s\"", folder.string().c_str());
+            return false;
+        }
+        mFolders[watch] = folder;
+
+        std::error_code error;
+        for(auto it = std::filesystem::directory_iterator(folder, error); !error && it != std::filesystem::directory_iterator(); it.increment(error))
+        {
+            if(it->is_directory())
+                AddWatches(it->path(), changed);
+            else if(IsSourceFile(it->path()))
+                changed.insert(it->path());
+        }
+
+        return true;
+    }
+
+    //waits up to timeout milliseconds, -1 for no limit. returns whether anything arrived
+    bool ReadEvents(int timeout, std::set<std::filesystem::path>& changed)
+    {
+        pollfd fd = {mInotify, POLLIN, 0};
+        if(poll(&fd, 1, timeout) <= 0)
+            return false;
+
+        alignas(inotify_event) char buffer[16 * 1024];
+        ssize_t size = read(mInotify, buffer, sizeof(buffer));
+        for(ssize_t offset = 0; offset < size;)
+        {
+            const inotify_event& event = *(const inotify_event*)(buffer + offset);
+            offset += sizeof(inotify_event) + event.len;
+
+            if(event.mask & IN_Q_OVERFLOW)
+            {
+                mOverflowed = true;
+                continue;
+            }
+
+            auto folder = mFolders.find(event.wd);
+            if(folder == mFolders.end() || !event.len)
+                continue;
+
+            std::filesystem::path path = folder->second / event.name;
+            if(event.mask & IN_ISDIR)
+            {
+                if(event.mask & (IN_CREATE | IN_MOVED_TO))
+                    AddWatches(path, changed);
+            }
+            else if(IsSourceFile(path))
+            {
+                changed.insert(path);
+            }
+        }
+
+        return true;
+    }
+
+    int mInotify;
+    bool mOverflowed;
+    std::map<int, std::filesystem::path> mFolders;
+#else
+    bool Init(const std::filesystem::path& root)
+    {
+        mRoot = root;
+        std::set<std::filesystem::path> ignored;
+        Scan(ignored);
+        return true;
+    }
+
+    bool Wait(std::set<std::filesystem::path>& changed)
+    {
+        while(changed.empty())
+        {
+            std::this_thread::sleep_for(POLL_TIME);
+            Scan(changed);
+        }
+
+        //keep going until a scan turns up nothing new
+        for(size_t count = 0; count != changed.size();)
+        {
+            count = changed.size();
+            std::this_thread::sleep_for(DEBOUNCE_TIME);
+            Scan(changed);
+        }
+
+        return true;
+    }
+
+private:
+    void Scan(std::set<std::filesystem::path>& changed)
+    {
+        //a folder that can't be read is looked at again next time rather than taken as empty
+        std::vector<std::filesystem::path> files;
+        if(!FindFiles(mRoot, files, IsSourceFile))
+            return;
+
+        std::map<std::filesystem::path, std::filesystem::file_time_type> writeTimes;
+        for(const std::filesystem::path& file : files)
+        {
+            std::error_code error;
+            std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(file, error);
+            if(!error)
+                writeTimes[file] = writeTime;
+        }
+
+        for(const auto& [path, writeTime] : writeTimes)
+        {
+            auto it = mWriteTimes.find(path);
+            if(it == mWriteTimes.end() || it->second != writeTime)
+                changed.insert(path);
+        }
+
+        for(const auto& [path, writeTime] : mWriteTimes)
+        {
+            if(!writeTimes.contains(path))
+                changed.insert(path);
+        }
+
+        mWriteTimes = std::move(writeTimes);
+    }
+
+    std::filesystem::path mRoot;
+    std::map<std::filesystem::path, std::filesystem::file_time_type> mWriteTimes;
+#endif
+};
+
+static std::filesystem::path GetOutputPath(const std::filesystem::path& effect, const std::filesystem::path& root, const std::filesystem::path& outRoot)
+{
+    return (outRoot / effect.lexically_relative(root)).replace_extension(".fxc");
+}
+
+static bool IsOutdated(const IncludeGraph& graph, const std::filesystem::path& effect, const std::filesystem::path& output)
+{
+    std::error_code error;
+    std::filesystem::file_time_type outputTime = std::filesystem::last_write_time(output, error);
+    if(error)
+        return true;
+
+    for(const std::filesystem::path& file : graph.GetFiles(effect))
+    {
+        std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(file, error);
+        if(!error && writeTime > outputTime)
+            return true;
+    }
+
+    return false;
+}
+
+static void CompileEffects(const std::vector<std::filesystem::path>& effects, const std::filesystem::path& root, const std::filesystem::path& outRoot,
+                           const EffectWatcher::CompileFunc& compile, uint32_t threadCount)
+{
+    if(effects.empty())
+        return;
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    std::vector<uint8_t> compiled(effects.size());
+    ParallelFor((uint32_t)effects.size(), [&](uint32_t i)
+    {
+        Log::Job job(effects[i].string().c_str());
+        std::filesystem::path output = GetOutputPath(effects[i], root, outRoot);
+        std::filesystem::path staging = output.parent_path() / (".fxdc_" + output.filename().string());
+
+        std::error_code error;
+        std::filesystem::create_directories(output.parent_path(), error);
+
+        //a rename within a folder replaces the old output in one step
+        if(compile(effects[i], staging))
+        {
+            std::filesystem::rename(staging, output, error);
+            compiled[i] = !error;
+            if(error)
+                Log::Error("unable to replace \"%s\"", output.string().c_str());
+        }
+        else
+        {
+            std::filesystem::remove(staging, error);
+        }
+    }, threadCount);
+
+    uint32_t compiledCount = 0;
+    for(uint8_t result : compiled)
+        compiledCount += result;
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1);
+    Log::Info("compiled %u of %zu effects (took %lldms)", compiledCount, effects.size(), ms.count());
+}
+
+//reads the includes of every source file in the folder again and compiles the effects that are out of date
+static void CompileOutdatedEffects(IncludeGraph& graph, const std::filesystem::path& root, const std::filesystem::path& outRoot,
+                                   const EffectWatcher::CompileFunc& compile, uint32_t threadCount)
+{
+    std::vector<std::filesystem::path> files;
+    FindFiles(root, files, IsSourceFile);
+
+    graph = {};
+    for(const std::filesystem::path& file : files)
+        graph.Update(file, root);
+
+    std::vector<std::filesystem::path> outdated;
+    for(const std::filesystem::path& effect : graph.GetEffects())
+    {
+        if(IsOutdated(graph, effect, GetOutputPath(effect, root, outRoot)))
+            outdated.push_back(effect);
+    }
+
+    CompileEffects(outdated, root, outRoot, compile, threadCount);
+}
+
+static bool GetRoots(const char* folder, const char* outFolder, std::filesystem::path& root, std::filesystem::path& outRoot)
+{
+    std::error_code error;
+    root = std::filesystem::absolute(folder, error).lexically_normal();
+    outRoot = std::filesystem::absolute(outFolder, error).lexically_normal();
+    if(!std::filesystem::is_directory(root, error))
+    {
+        Log::Error("\"%s\" is not a folder", folder);
+        return false;
+    }
+
+    return true;
+}
+
+bool EffectWatcher::CompileOutdated(const char* folder, const char* outFolder, const CompileFunc& compile, uint32_t threadCount)
+{
+    std::filesystem::path root, outRoot;
+    if(!GetRoots(folder, outFolder, root, outRoot))
+        return false;
+
+    IncludeGraph graph;
+    CompileOutdatedEffects(graph, root, outRoot, compile, threadCount);
+    return true;
+}
+
+bool EffectWatcher::Watch(const char* folder, const char* outFolder, const CompileFunc& compile, uint32_t threadCount)
+{
+    std::filesystem::path root, outRoot;
+    if(!GetRoots(folder, outFolder, root, outRoot))
+        return false;
+
+    //started before the first scan so nothing saved in between is missed
+    ChangeMonitor monitor;
+    if(!monitor.Init(root))
+        return false;
+
+    IncludeGraph graph;
+    CompileOutdatedEffects(graph, root, outRoot, compile, threadCount);
+    Log::Info("watching \"%s\" for changes", folder);
+
+    while(true)
+    {
+        std::set<std::filesystem::path> changed;
+        if(!monitor.Wait(changed))
+        {
+            Log::Warn("missed some changes, checking every effect");
+            CompileOutdatedEffects(graph, root, outRoot, compile, threadCount);
+            continue;
+        }
+
+        for(const std::filesystem::path& file : changed)
+            graph.Update(file, root);
+
+        CompileEffects(graph.GetAffectedEffects(changed), root, outRoot, compile, threadCount);
+    }
+}
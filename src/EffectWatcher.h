@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <set>
+#include <vector>
+
+//which files include which, so a saved header maps to the effects built from it
+class IncludeGraph
+{
+public:
+    //reads the includes of a file again, or forgets it if it's gone. an include is looked up next to the file, then in root
+    void Update(const std::filesystem::path& file, const std::filesystem::path& root);
+
+    std::vector<std::filesystem::path> GetEffects() const;
+    //the effect and everything it includes, directly or through other headers
+    std::set<std::filesystem::path> GetFiles(const std::filesystem::path& effect) const;
+    //the effects built from any of the files
+    std::vector<std::filesystem::path> GetAffectedEffects(const std::set<std::filesystem::path>& changed) const;
+
+private:
+    std::map<std::filesystem::path, std::vector<std::filesystem::path>> mIncludes;
+};
+
+//recompiles the .fx files in a folder as they or the headers they include are saved. saves are collected until the folder
+//has been quiet for a moment, then only the effects that include a changed file are compiled, in parallel. each output is
+//written next to where it goes and renamed over it, so a game reloading .fxc files never sees a half written one
+class EffectWatcher
+{
+public:
+    //compiles fileIn to fileOut, which already ends in .fxc
+    using CompileFunc = std::function<bool(const std::filesystem::path& fileIn, const std::filesystem::path& fileOut)>;
+
+    //outputs mirror the layout of folder inside outFolder. effects whose output is missing or older than one of their files
+    //are compiled first. runs until the process is stopped, returns false if the folder can't be watched
+    static bool Watch(const char* folder, const char* outFolder, const CompileFunc& compile, uint32_t threadCount = 0);
+    //compiles what Watch compiles before it starts waiting and returns, false if folder isn't a folder
+    static bool CompileOutdated(const char* folder, const char* outFolder, const CompileFunc& compile, uint32_t threadCount = 0);
+};
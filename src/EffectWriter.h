@@ -3,12 +3,18 @@
 
 #include <fstream>
 #include <filesystem>
+#include <sstream>
+#include <string>
 #include <vector>
 
 class EffectWriter
 {
 public:
-    EffectWriter(const char* filePath) : mTabCount(0), mTempString(MAX_STRLEN)
+    //writes to memory, the text is returned by GetString
+    EffectWriter() : mStream(&mString), mTabCount(0), mTempString(MAX_STRLEN)
+    {}
+
+    EffectWriter(const char* filePath) : mStream(&mFile), mTabCount(0), mTempString(MAX_STRLEN)
     {
         std::filesystem::path absFilePath = std::filesystem::absolute(filePath).string().c_str();
         absFilePath.make_preferred();
@@ -24,9 +30,17 @@ public:
     
     bool IsOpen()
     {
+        if(mStream == &mString)
+            return mString.good();
+
         return mFile.good() && mFile.is_open();
     }
 
+    std::string GetString() const
+    {
+        return mString.str();
+    }
+
     inline void PushTab()
     {
         ++mTabCount;
@@ -39,12 +53,12 @@ public:
 
     inline void NewLine()
     {
-        mFile << '\n';
+        *mStream << '\n';
     }
 
     inline void NewLineIndented()
     {
-        mFile << '\n';
+        *mStream << '\n';
         WriteTabs();
     }
 
@@ -52,7 +66,7 @@ public:
     inline void Write(const char* fmt, Args ...args)
     {
         sprintf(mTempString.data(), fmt, args...);
-        mFile << mTempString.data();
+        *mStream << mTempString.data();
     }
 
     template<typename ...Args>
@@ -60,14 +74,14 @@ public:
     {
         sprintf(mTempString.data(), fmt, args...);
         WriteTabs();
-        mFile << mTempString.data();
+        *mStream << mTempString.data();
     }
 
     template<typename ...Args>
     inline void WriteLine(const char* fmt, Args ...args)
     {
         sprintf(mTempString.data(), fmt, args...);
-        mFile << mTempString.data() << "\n";
+        *mStream << mTempString.data() << "\n";
     }
 
     template<typename ...Args>
@@ -75,17 +89,19 @@ public:
     {
         sprintf(mTempString.data(), fmt, args...);
         WriteTabs();
-        mFile << mTempString.data() << "\n";
+        *mStream << mTempString.data() << "\n";
     }
 
 private:
     inline void WriteTabs()
     {
         for(uint32_t i = 0; i < mTabCount; i++)
-            mFile << TAB;
+            *mStream << TAB;
     }
 
     std::ofstream mFile;
+    std::ostringstream mString;
+    std::ostream* mStream;
     uint32_t mTabCount;
     std::vector<char> mTempString;
     static constexpr uint32_t MAX_STRLEN = 2 << 14;
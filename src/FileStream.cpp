@@ -1,22 +1,33 @@
 #include "FileStream.h"
 #include "Log.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <filesystem>
 
-IFileStream::IFileStream(const char* filePath) : mSize(0)
+#ifdef _WIN32
+static constexpr char sPathSeparator = '\\';
+#else
+static constexpr char sPathSeparator = '/';
+#endif
+
+IFileStream::IFileStream(const char* filePath) : mSize(0), mData(nullptr), mPosition(0)
 {
     mPath = std::filesystem::absolute(filePath).string().c_str();
     for(char* c = mPath.Get(); *c; c++)
     {
         if(*c == '/')
-            *c = '\\';
+            *c = sPathSeparator;
     }
 }
 
+IFileStream::IFileStream(const char* filePath, const uint8_t* data, size_t size) : mPath(filePath), mSize(size), mData(data), mPosition(0)
+{}
+
 bool IFileStream::Open()
 {
-    if(mFile.is_open())
+    if(mData || mFile.is_open())
         return true;
 
     mFile = std::ifstream(mPath.Get(), std::ios::binary | std::ios::ate);
@@ -44,7 +55,7 @@ const char* IFileStream::GetFilePath()
 
 CString IFileStream::GetFileName()
 {
-    const char* separator = strrchr(mPath.Get(), '\\');
+    const char* separator = strrchr(mPath.Get(), sPathSeparator);
 
     CString fileName;
     if(!separator)
@@ -57,7 +68,7 @@ CString IFileStream::GetFileName()
 
 CString IFileStream::GetFileNameNoExtension()
 {
-    const char* separator = strrchr(mPath.Get(), '\\');
+    const char* separator = strrchr(mPath.Get(), sPathSeparator);
 
     CString fileName;
     if(!separator)
@@ -79,10 +90,17 @@ size_t IFileStream::GetSize()
 
 void IFileStream::Seek(std::streamoff offset, eSeekDir dir)
 {
+    if(mData)
+    {
+        size_t base = dir == eSeekDir::CURRENT ? mPosition : dir == eSeekDir::END ? mSize : 0;
+        mPosition = std::min((size_t)(base + offset), mSize);
+        return;
+    }
+
     std::ios::seekdir dirStd {};
     if(dir == eSeekDir::CURRENT)
         dirStd = std::ios::cur;
-    else if(dirStd == eSeekDir::BEGGINING)
+    else if(dir == eSeekDir::BEGGINING)
         dirStd = std::ios::beg;
     else if(dir == eSeekDir::END)
         dirStd = std::ios::end;
@@ -90,12 +108,40 @@ void IFileStream::Seek(std::streamoff offset, eSeekDir dir)
     mFile.seekg(offset, dirStd);
 }
 
-inline bool IFileStream::Read(void* buffer, std::streamsize count)
+size_t IFileStream::Tell()
 {
+    if(mData)
+        return mPosition;
+
+    return (size_t)mFile.tellg();
+}
+
+bool IFileStream::Read(void* buffer, std::streamsize count)
+{
+    if(mData)
+    {
+        //a read past the end zero fills what is missing so a truncated file never leaves values uninitialized
+        size_t available = std::min((size_t)count, mSize - mPosition);
+        memcpy(buffer, mData + mPosition, available);
+        memset((uint8_t*)buffer + available, 0, (size_t)count - available);
+        mPosition += available;
+        return available == (size_t)count;
+    }
+
     assert(mFile.is_open());
     
     mFile.read((char*)buffer, count);
-    return mFile.rdstate() & std::ios::badbit;
+    return !mFile.fail();
+}
+
+const uint8_t* IFileStream::ReadInPlace(size_t count)
+{
+    if(!mData || count > mSize - mPosition)
+        return nullptr;
+
+    const uint8_t* data = mData + mPosition;
+    mPosition += count;
+    return data;
 }
 
 bool IFileStream::ReadByte(void* buffer)
@@ -115,19 +161,22 @@ bool IFileStream::ReadDword(void* buffer)
 
 
 //OFileStream
-OFileStream::OFileStream(const char* filePath)
+OFileStream::OFileStream(const char* filePath) : mBuffer(nullptr), mPosition(0)
 {
     mPath = std::filesystem::absolute(filePath).string().c_str();
     for(char* c = mPath.Get(); *c; c++)
     {
         if(*c == '/')
-            *c = '\\';
+            *c = sPathSeparator;
     }
 }
 
+OFileStream::OFileStream(const char* filePath, std::vector<uint8_t>& buffer) : mPath(filePath), mBuffer(&buffer), mPosition(0)
+{}
+
 bool OFileStream::Open()
 {
-    if(mFile.is_open())
+    if(mBuffer || mFile.is_open())
         return true;
 
     mFile = std::ofstream(mPath.Get(), std::ios::binary);
@@ -152,7 +201,7 @@ const char* OFileStream::GetFilePath()
 
 CString OFileStream::GetFileName()
 {
-    const char* separator = strrchr(mPath.Get(), '\\');
+    const char* separator = strrchr(mPath.Get(), sPathSeparator);
 
     CString fileName;
     if(!separator)
@@ -165,7 +214,7 @@ CString OFileStream::GetFileName()
 
 CString OFileStream::GetFileNameNoExtension()
 {
-    const char* separator = strrchr(mPath.Get(), '\\');
+    const char* separator = strrchr(mPath.Get(), sPathSeparator);
 
     CString fileName;
     if(!separator)
@@ -182,10 +231,18 @@ CString OFileStream::GetFileNameNoExtension()
 
 void OFileStream::Seek(std::streamoff offset, eSeekDir dir)
 {
+    if(mBuffer)
+    {
+        //like a file, seeking past the end leaves a zero filled gap once something is written there
+        size_t base = dir == eSeekDir::CURRENT ? mPosition : dir == eSeekDir::END ? mBuffer->size() : 0;
+        mPosition = base + offset;
+        return;
+    }
+
     std::ios::seekdir dirStd {};
     if(dir == eSeekDir::CURRENT)
         dirStd = std::ios::cur;
-    else if(dirStd == eSeekDir::BEGGINING)
+    else if(dir == eSeekDir::BEGGINING)
         dirStd = std::ios::beg;
     else if(dir == eSeekDir::END)
         dirStd = std::ios::end;
@@ -193,8 +250,26 @@ void OFileStream::Seek(std::streamoff offset, eSeekDir dir)
     mFile.seekp(offset, dirStd);
 }
 
-inline bool OFileStream::Write(const void* buffer, std::streamsize count)
+size_t OFileStream::Tell()
 {
+    if(mBuffer)
+        return mPosition;
+
+    return (size_t)mFile.tellp();
+}
+
+bool OFileStream::Write(const void* buffer, std::streamsize count)
+{
+    if(mBuffer)
+    {
+        if(mPosition + count > mBuffer->size())
+            mBuffer->resize(mPosition + count);
+
+        memcpy(mBuffer->data() + mPosition, buffer, (size_t)count);
+        mPosition += (size_t)count;
+        return false;
+    }
+
     assert(mFile.is_open());
 
     mFile.write((char*)buffer, count);
@@ -2,8 +2,10 @@
 #include "CString.h"
 
 #include <fstream>
+#include <vector>
 
-//very simple wrapper for std::fstream in binary mode
+//very simple wrapper for std::fstream in binary mode. IFileStream can also read from a buffer already in memory and
+//OFileStream can write to one
 
 enum eSeekDir : uint8_t
 {
@@ -16,6 +18,8 @@ class IFileStream
 {
 public:
     IFileStream(const char* filePath);
+    //reads from data instead of the file. data isn't copied and has to outlive the stream
+    IFileStream(const char* filePath, const uint8_t* data, size_t size);
 
     ~IFileStream() = default;
 
@@ -28,8 +32,12 @@ public:
     size_t GetSize();
 
     void Seek(std::streamoff offset, eSeekDir dir = eSeekDir::CURRENT);
+    size_t Tell();
 
-    inline bool Read(void* buffer, std::streamsize count);
+    bool Read(void* buffer, std::streamsize count);
+    //the next count bytes without copying them when reading from memory. returns nullptr without moving if the stream reads
+    //from a file or has fewer than count bytes left, Read takes care of both
+    const uint8_t* ReadInPlace(size_t count);
     bool ReadByte(void* buffer);
     bool ReadWord(void* buffer);
     bool ReadDword(void* buffer);
@@ -38,6 +46,8 @@ private:
     CString mPath;
     size_t mSize;
     std::ifstream mFile;
+    const uint8_t* mData;
+    size_t mPosition;
 };
 
 
@@ -45,6 +55,8 @@ class OFileStream
 {
 public:
     OFileStream(const char* filePath);
+    //writes to buffer instead of the file. buffer has to outlive the stream
+    OFileStream(const char* filePath, std::vector<uint8_t>& buffer);
 
     ~OFileStream() = default;
 
@@ -56,8 +68,9 @@ public:
     CString GetFileNameNoExtension();
 
     void Seek(std::streamoff offset, eSeekDir dir = eSeekDir::CURRENT);
+    size_t Tell();
 
-    inline bool Write(const void* buffer, std::streamsize count);
+    bool Write(const void* buffer, std::streamsize count);
     bool WriteByte(const void* buffer);
     bool WriteWord(const void* buffer);
     bool WriteDword(const void* buffer);
@@ -65,4 +78,6 @@ public:
 private:
     CString mPath;
     std::ofstream mFile;
+    std::vector<uint8_t>* mBuffer;
+    size_t mPosition;
 };
\ No newline at end of file
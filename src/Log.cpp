@@ -0,0 +1,338 @@
+#include "Log.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <io.h>
+
+#ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
+#endif
+
+#define ISATTY _isatty
+#define FILENO _fileno
+#else
+#include <unistd.h>
+
+#define ISATTY isatty
+#define FILENO fileno
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+
+static thread_local Log::Job* tJob = nullptr;
+
+//held while writing to stdout or the json stream
+static std::mutex sMutex;
+static std::atomic<bool> sQuiet = false;
+static std::atomic<bool> sJsonEnabled = false;
+static FILE* sJsonFile = nullptr;
+
+static constexpr const char* sPrefixes[] = {"", "Warning: ", "ERROR: "};
+static constexpr const char* sLevelNames[] = {"info", "warning", "error"};
+
+struct eColorMode
+{
+    enum Enum : uint8_t
+    {
+        NONE,
+        ANSI,
+        //windows consoles that don't understand escapes
+        CONSOLE,
+    };
+};
+
+//colours only go to a terminal and not at all when NO_COLOR is set
+static eColorMode::Enum GetColorMode()
+{
+    static const eColorMode::Enum sMode = []()
+    {
+        if(getenv("NO_COLOR") || !ISATTY(FILENO(stdout)))
+            return eColorMode::NONE;
+
+    #ifdef _WIN32
+        HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+        DWORD mode = 0;
+        if(GetConsoleMode(console, &mode) && SetConsoleMode(console, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING))
+            return eColorMode::ANSI;
+        return eColorMode::CONSOLE;
+    #else
+        return eColorMode::ANSI;
+    #endif
+    }();
+
+    return sMode;
+}
+
+static void PrintEntry(const Log::Entry& entry, eColorMode::Enum colorMode)
+{
+    std::string line;
+    line.reserve(entry.Text.size() + 32);
+
+    bool colored = entry.Level != eLogLevel::INFO && colorMode != eColorMode::NONE;
+    if(colored && colorMode == eColorMode::ANSI)
+        line += entry.Level == eLogLevel::WARN ? "\033[33m" : "\033[31m";
+    line += sPrefixes[entry.Level];
+    line += entry.Text;
+    if(colored && colorMode == eColorMode::ANSI)
+        line += "\033[0m";
+    line += '\n';
+
+#ifdef _WIN32
+    if(colored && colorMode == eColorMode::CONSOLE)
+    {
+        fflush(stdout);
+        SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), entry.Level == eLogLevel::WARN ? FOREGROUND_RED | FOREGROUND_GREEN : FOREGROUND_RED);
+    }
+#endif
+
+    fwrite(line.data(), 1, line.size(), stdout);
+
+#ifdef _WIN32
+    if(colored && colorMode == eColorMode::CONSOLE)
+    {
+        fflush(stdout);
+        SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE);
+    }
+#endif
+}
+
+static void AppendJsonString(std::string& json, const char* begin, const char* end)
+{
+    json += '"';
+    for(const char* c = begin; c < end; c++)
+    {
+        switch(*c)
+        {
+            case '"':  json += "\\\""; break;
+            case '\\': json += "\\\\"; break;
+            case '\t': json += "\\t"; break;
+            case '\r': json += "\\r"; break;
+            case '\n': json += "\\n"; break;
+            default:
+                if((uint8_t)*c < 0x20)
+                {
+                    char escape[8];
+                    snprintf(escape, sizeof(escape), "\\u%04x", (uint8_t)*c);
+                    json += escape;
+                }
+                else
+                {
+                    json += *c;
+                }
+                break;
+        }
+    }
+    json += '"';
+}
+
+static const char* ParseNumber(const char* c, const char* end, uint32_t& value)
+{
+    const char* begin = c;
+    value = 0;
+    for(; c < end && *c >= '0' && *c <= '9'; c++)
+        value = value * 10 + (*c - '0');
+
+    return c > begin ? c : nullptr;
+}
+
+//messages from the parser and the compiler start with file(line) or file(line,column), sometimes followed by a column range,
+//then a colon
+static bool ParseLocation(const char* begin, const char* end, const char*& fileEnd, uint32_t& line, uint32_t& column, const char*& message)
+{
+    for(const char* open = begin; (open = (const char*)memchr(open, '(', end - open)); open++)
+    {
+        column = 0;
+        const char* c = ParseNumber(open + 1, end, line);
+        if(c && c < end && *c == ',')
+            c = ParseNumber(c + 1, end, column);
+        if(c && c < end && *c == '-')
+        {
+            uint32_t columnEnd;
+            c = ParseNumber(c + 1, end, columnEnd);
+        }
+        if(!c || c >= end || *c != ')' || open == begin)
+            continue;
+
+        for(c++; c < end && *c == ' '; c++);
+        if(c >= end || *c != ':')
+            continue;
+
+        for(c++; c < end && *c == ' '; c++);
+        fileEnd = open;
+        message = c;
+        return true;
+    }
+
+    return false;
+}
+
+//one object per line of the message so the output of a whole compile can be told apart
+static void WriteJson(const Log::Entry& entry, const char* jobName)
+{
+    const char* text = entry.Text.c_str();
+    const char* textEnd = text + entry.Text.size();
+    while(text < textEnd)
+    {
+        const char* lineEnd = (const char*)memchr(text, '\n', textEnd - text);
+        if(!lineEnd)
+            lineEnd = textEnd;
+
+        const char* begin = text;
+        const char* end = lineEnd > begin && lineEnd[-1] == '\r' ? lineEnd - 1 : lineEnd;
+        text = lineEnd + 1;
+        if(begin == end)
+            continue;
+
+        std::string json = "{\"level\":\"";
+        json += sLevelNames[entry.Level];
+        json += '"';
+        if(jobName && jobName[0])
+        {
+            json += ",\"job\":";
+            AppendJsonString(json, jobName, jobName + strlen(jobName));
+        }
+
+        const char* fileEnd;
+        const char* message;
+        uint32_t line;
+        uint32_t column;
+        if(ParseLocation(begin, end, fileEnd, line, column, message))
+        {
+            json += ",\"file\":";
+            AppendJsonString(json, begin, fileEnd);
+            json += ",\"line\":" + std::to_string(line);
+            if(column)
+                json += ",\"column\":" + std::to_string(column);
+            begin = message;
+        }
+
+        json += ",\"message\":";
+        AppendJsonString(json, begin, end);
+        json += "}\n";
+        fwrite(json.data(), 1, json.size(), sJsonFile);
+    }
+}
+
+static void WriteEntries(const Log::Entry* entries, size_t count, const char* jobName)
+{
+    bool quiet = sQuiet;
+    bool json = sJsonEnabled;
+    bool infosOnly = std::all_of(entries, entries + count, [](const Log::Entry& entry)
+    {
+        return entry.Level == eLogLevel::INFO;
+    });
+    if(quiet && !json && infosOnly)
+        return;
+
+    eColorMode::Enum colorMode = GetColorMode();
+
+    std::lock_guard lock(sMutex);
+    for(size_t i = 0; i < count; i++)
+    {
+        if(!quiet || entries[i].Level != eLogLevel::INFO)
+            PrintEntry(entries[i], colorMode);
+        if(sJsonFile)
+            WriteJson(entries[i], jobName);
+    }
+
+    if(sJsonFile)
+        fflush(sJsonFile);
+}
+
+Log::Job::Job(const char* name) : Job(name, false)
+{}
+
+Log::Job::Job(const char* name, bool capture) : mName(name ? name : ""), mEntries(), mPrevious(tJob), mCapture(capture)
+{
+    tJob = this;
+}
+
+Log::Job::~Job()
+{
+    tJob = mPrevious;
+    if(mCapture || mEntries.empty())
+        return;
+
+    //a job within a job ends up in the report of the outer one
+    if(mPrevious)
+    {
+        for(Entry& entry : mEntries)
+            mPrevious->Add(entry.Level, std::move(entry.Text));
+        return;
+    }
+
+    WriteEntries(mEntries.data(), mEntries.size(), mName.c_str());
+}
+
+void Log::Job::Add(eLogLevel::Enum level, std::string text)
+{
+    mEntries.push_back({level, std::move(text)});
+}
+
+std::string Log::Capture::GetText() const
+{
+    std::string text;
+    for(const Entry& entry : mEntries)
+    {
+        text += sPrefixes[entry.Level];
+        text += entry.Text;
+        text += '\n';
+    }
+
+    return text;
+}
+
+void Log::SetQuiet(bool quiet)
+{
+    sQuiet = quiet;
+}
+
+bool Log::SetJsonFile(const char* filePath)
+{
+    std::lock_guard lock(sMutex);
+    if(sJsonFile)
+        fclose(sJsonFile);
+
+    sJsonFile = filePath ? fopen(filePath, "wb") : nullptr;
+    sJsonEnabled = sJsonFile != nullptr;
+    return !filePath || sJsonFile;
+}
+
+std::string Log::FormatArgList(const char *fmt, va_list args)
+{
+    va_list tmp;
+    va_copy(tmp, args);
+    int length = vsnprintf(nullptr, 0, fmt, tmp);
+    va_end(tmp);
+    if(length <= 0)
+        return {};
+
+    std::string text(length, '\0');
+    vsnprintf(text.data(), length + 1, fmt, args);
+    return text;
+}
+
+std::string Log::Format(const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    std::string text = FormatArgList(fmt, args);
+    va_end(args);
+    return text;
+}
+
+void Log::Write(eLogLevel::Enum level, std::string text)
+{
+    if(tJob)
+    {
+        tJob->Add(level, std::move(text));
+        return;
+    }
+
+    Entry entry = {level, std::move(text)};
+    WriteEntries(&entry, 1, nullptr);
+}
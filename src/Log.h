@@ -1,39 +1,90 @@
 #pragma once
-#define WIN32_LEAN_AND_MEAN
+#include <cstdarg>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
-#include <windows.h>
+#include <string>
+#include <vector>
 
+struct eLogLevel
+{
+    enum Enum : uint8_t
+    {
+        INFO,
+        WARN,
+        ERR,
+    };
+};
+
+//messages are formatted on the calling thread and written out whole, so lines from different threads never run into each
+//other. a Job keeps the messages of its thread until it ends and writes them in one go, taking the lock once per job
+//instead of once per message
 namespace Log
 {
+    struct Entry
+    {
+        eLogLevel::Enum Level;
+        std::string Text;
+    };
+
+    class Job
+    {
+    public:
+        //name shows up in the json stream next to every message of the job
+        Job(const char* name = nullptr);
+        ~Job();
+
+        Job(const Job&) = delete;
+        Job& operator=(const Job&) = delete;
+
+        void Add(eLogLevel::Enum level, std::string text);
+
+    protected:
+        //a capture keeps its messages instead of writing them out when it ends
+        Job(const char* name, bool capture);
+
+        std::string mName;
+        std::vector<Entry> mEntries;
+        Job* mPrevious;
+        bool mCapture;
+    };
+
+    //collects what the calling thread logs for as long as it lives, so a library call can hand its messages back to its
+    //caller instead of printing them
+    class Capture : public Job
+    {
+    public:
+        Capture() : Job(nullptr, true)
+        {}
+
+        //every message on its own line with the same prefix it would have been printed with
+        std::string GetText() const;
+    };
+
+    //infos aren't printed any more, warnings, errors and the json stream are unaffected
+    void SetQuiet(bool quiet);
+    //writes every message to filePath as a line of json, a null path stops it. returns false if the file can't be created
+    bool SetJsonFile(const char* filePath);
+
+    std::string FormatArgList(const char *fmt, va_list args);
+    std::string Format(const char *fmt, ...);
+    void Write(eLogLevel::Enum level, std::string text);
+
     template<typename ...Args>
     inline void Info(const char *fmt, Args ...args)
     {
-        printf(fmt, args...);
-        printf("\n");
+        Write(eLogLevel::INFO, Format(fmt, args...));
     }
 
     template<typename ...Args>
     inline void Warn(const char *fmt, Args ...args)
     {
-        SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), FOREGROUND_RED | FOREGROUND_GREEN);
-
-        printf("Warning: ");
-        printf(fmt, args...);
-        printf("\n");
-
-        SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE);
+        Write(eLogLevel::WARN, Format(fmt, args...));
     }
 
     template<typename ...Args>
     inline void Error(const char *fmt, Args ...args)
     {
-        SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), FOREGROUND_RED);
-
-        printf("ERROR: ");
-        printf(fmt, args...);
-        printf("\n");
-     
-        SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE);
+        Write(eLogLevel::ERR, Format(fmt, args...));
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,99 @@
+#include "MappedFile.h"
+#include "Log.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool MappedFile::Open(const char* filePath)
+{
+    Close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filePath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(file == INVALID_HANDLE_VALUE)
+    {
+        Log::Error("Unable to open file \"%s\"", filePath);
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+        Log::Error("Unable to open file \"%s\"", filePath);
+        return false;
+    }
+
+    mFile = file;
+    mSize = (size_t)size.QuadPart;
+    if(!mSize)
+        return true;
+
+    mMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(mMapping)
+        mData = (const uint8_t*)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+#else
+    int32_t file = open(filePath, O_RDONLY);
+    if(file < 0)
+    {
+        Log::Error("Unable to open file \"%s\"", filePath);
+        return false;
+    }
+
+    struct stat status;
+    if(fstat(file, &status) != 0)
+    {
+        close(file);
+        Log::Error("Unable to open file \"%s\"", filePath);
+        return false;
+    }
+
+    mFile = (void*)(intptr_t)(file + 1);
+    mSize = (size_t)status.st_size;
+    if(!mSize)
+        return true;
+
+    void* data = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, file, 0);
+    if(data != MAP_FAILED)
+        mData = (const uint8_t*)data;
+#endif
+
+    if(!mData)
+    {
+        Log::Error("Unable to map file \"%s\"", filePath);
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+    if(mData)
+        UnmapViewOfFile(mData);
+    if(mMapping)
+        CloseHandle(mMapping);
+    if(mFile)
+        CloseHandle(mFile);
+#else
+    if(mData)
+        munmap((void*)mData, mSize);
+    //the descriptor is stored off by one so 0 can mean closed
+    if(mFile)
+        close((int32_t)((intptr_t)mFile - 1));
+#endif
+
+    mData = nullptr;
+    mSize = 0;
+    mFile = nullptr;
+    mMapping = nullptr;
+}
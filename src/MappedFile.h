@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+//read only memory mapping of a whole file. the pages are only read in when they're touched
+class MappedFile
+{
+public:
+    MappedFile() : mData(nullptr), mSize(0), mFile(nullptr), mMapping(nullptr)
+    {}
+
+    ~MappedFile()
+    {
+        Close();
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const char* filePath);
+    void Close();
+
+    const uint8_t* GetData() const
+    {
+        return mData;
+    }
+
+    size_t GetSize() const
+    {
+        return mSize;
+    }
+
+private:
+    const uint8_t* mData;
+    size_t mSize;
+    //file and mapping HANDLEs on windows. elsewhere mFile holds the descriptor + 1 and mMapping is unused
+    void* mFile;
+    void* mMapping;
+};
@@ -0,0 +1,26 @@
+#include "Parallel.h"
+#include "Log.h"
+
+bool IsEffectFile(const std::filesystem::path& path)
+{
+    return path.extension() == ".fxc";
+}
+
+bool FindFiles(const std::filesystem::path& folder, std::vector<std::filesystem::path>& files, bool (*filter)(const std::filesystem::path& path))
+{
+    std::error_code error;
+    for(auto it = std::filesystem::recursive_directory_iterator(folder, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+    {
+        if(it->is_regular_file() && filter(it->path()))
+            files.push_back(it->path());
+    }
+
+    if(error)
+    {
+        Log::Error("Unable to scan folder \"%s\"", folder.string().c_str());
+        return false;
+    }
+
+    std::sort(files.begin(), files.end());
+    return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+//calls func(index) for every index in [0, count) spread over the hardware threads. indices are handed out one at a time
+//so a few slow items don't hold up a whole chunk. func must be safe to call concurrently, and should put what it does in a
+//Log::Job so its messages come out together rather than interleaved with those of the other threads
+template<typename Func>
+void ParallelFor(uint32_t count, Func&& func, uint32_t threadCount = 0)
+{
+    if(!threadCount)
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    threadCount = std::min(threadCount, count);
+
+    if(threadCount <= 1)
+    {
+        for(uint32_t i = 0; i < count; i++)
+            func(i);
+        return;
+    }
+
+    std::atomic<uint32_t> next = 0;
+    auto worker = [&]()
+    {
+        for(uint32_t i = next++; i < count; i = next++)
+            func(i);
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount - 1);
+    for(uint32_t i = 0; i < threadCount - 1; i++)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for(std::thread& thread : threads)
+        thread.join();
+}
+
+bool IsEffectFile(const std::filesystem::path& path);
+
+//the files in folder and its subfolders that filter accepts, sorted so the same folder is always worked through in the same
+//order. logs an error and returns false if the folder can't be scanned
+bool FindFiles(const std::filesystem::path& folder, std::vector<std::filesystem::path>& files,
+               bool (*filter)(const std::filesystem::path& path) = IsEffectFile);
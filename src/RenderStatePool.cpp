@@ -0,0 +1,194 @@
+#include "RenderStatePool.h"
+#include "FileStream.h"
+#include "Parallel.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <string>
+
+static uint64_t HashStates(const RenderState* states, uint32_t count)
+{
+    uint64_t hash = 0xCBF29CE484222325ull;
+    const uint8_t* bytes = (const uint8_t*)states;
+    for(size_t i = 0; i < count * sizeof(RenderState); i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ull;
+    }
+
+    return hash;
+}
+
+uint32_t RenderStatePool::Canonicalize(RenderState* states, uint32_t count)
+{
+    //stable so states set twice stay in the order they were set in
+    std::stable_sort(states, states + count, [](const RenderState& a, const RenderState& b)
+    {
+        return a.State < b.State;
+    });
+
+    uint32_t newCount = 0;
+    for(uint32_t i = 0; i < count; i++)
+    {
+        if(newCount && states[newCount - 1].State == states[i].State)
+            states[newCount - 1] = states[i];
+        else
+            states[newCount++] = states[i];
+    }
+
+    return newCount;
+}
+
+uint32_t RenderStatePool::Add(const RenderState* states, uint32_t count)
+{
+    mAddCount++;
+
+    std::vector<RenderState> canonical(states, states + count);
+    canonical.resize(Canonicalize(canonical.data(), count));
+
+    uint64_t hash = HashStates(canonical.data(), (uint32_t)canonical.size());
+    auto range = mLookup.equal_range(hash);
+    for(auto it = range.first; it != range.second; ++it)
+    {
+        Block& block = mBlocks[it->second];
+        if(block.Count == canonical.size() && (canonical.empty() || memcmp(&mStates[block.Offset], canonical.data(), canonical.size() * sizeof(RenderState)) == 0))
+        {
+            block.UseCount++;
+            return it->second;
+        }
+    }
+
+    uint32_t index = (uint32_t)mBlocks.size();
+    mBlocks.push_back({(uint32_t)mStates.size(), (uint32_t)canonical.size(), 1});
+    mStates.insert(mStates.end(), canonical.begin(), canonical.end());
+    mLookup.emplace(hash, index);
+    return index;
+}
+
+static void AppendState(std::string& string, const RenderState& state)
+{
+    char text[64];
+    if(state.State == eRenderStateType::SLOPESCALEDEPTHBIAS || state.State == eRenderStateType::DEPTHBIAS)
+        snprintf(text, sizeof(text), "%s=%.9g", eRenderStateType::EnumToString(state.State), state.Value.DepthBias);
+    else
+    {
+        uint32_t value;
+        memcpy(&value, &state.Value, sizeof(value));
+        snprintf(text, sizeof(text), "%s=%u", eRenderStateType::EnumToString(state.State), value);
+    }
+
+    if(!string.empty())
+        string += ' ';
+    string += text;
+}
+
+struct StateBlockEntry
+{
+    bool Loaded;
+    //in pass order, canonicalized
+    std::vector<std::vector<RenderState>> Passes;
+    uint32_t DistinctBlocks;
+    //passes that set their states out of order or set one twice
+    uint32_t NonCanonicalPasses;
+};
+
+bool RenderStatePool::Report(const char* path, uint32_t threadCount)
+{
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    std::vector<std::filesystem::path> files;
+    if(!std::filesystem::is_directory(path))
+        files.push_back(path);
+    else if(!FindFiles(path, files))
+        return false;
+
+    std::vector<StateBlockEntry> entries(files.size());
+    ParallelFor((uint32_t)files.size(), [&](uint32_t i)
+    {
+        Log::Job job(files[i].string().c_str());
+        IFileStream file(files[i].string().c_str());
+        if(!file.Open())
+            return;
+
+        Effect effect(file);
+        if(effect.GetLoadError() != eEffectLoadError::NONE)
+            return;
+
+        StateBlockEntry& entry = entries[i];
+        RenderStatePool pool;
+        for(uint32_t j = 0; j < effect.GetTechniqueCount(); j++)
+        {
+            for(const EffectPass& pass : effect.GetTechniqueAt(j)->GetPasses())
+            {
+                const rage::atArray<RenderState>& states = pass.GetRenderStates();
+                uint32_t index = pool.Add(states);
+                const RenderState* block = pool.GetBlockStates(index);
+                uint32_t count = pool.GetBlock(index).Count;
+
+                entry.Passes.emplace_back(block, block + count);
+                if(count != states.GetCount() || (count && memcmp(block, &states[0], count * sizeof(RenderState)) != 0))
+                    entry.NonCanonicalPasses++;
+            }
+        }
+        entry.DistinctBlocks = pool.GetBlockCount();
+        entry.Loaded = true;
+    }, threadCount);
+
+    //merged in file order so block indices don't depend on how the work was spread out
+    RenderStatePool pool;
+    uint32_t effectCount = 0;
+    uint32_t distinctWithinEffects = 0;
+    uint32_t nonCanonicalPasses = 0;
+    for(const StateBlockEntry& entry : entries)
+    {
+        if(!entry.Loaded)
+            continue;
+
+        effectCount++;
+        distinctWithinEffects += entry.DistinctBlocks;
+        nonCanonicalPasses += entry.NonCanonicalPasses;
+        for(const std::vector<RenderState>& states : entry.Passes)
+            pool.Add(states.data(), (uint32_t)states.size());
+    }
+
+    uint32_t passCount = pool.GetAddCount();
+    auto percent = [&](uint32_t count)
+    {
+        return passCount ? 100.0 * count / passCount : 0.0;
+    };
+
+    Log::Info("%u passes in %u effects set %u distinct render state blocks counted per effect, %u across all of them", passCount, effectCount,
+              distinctWithinEffects, pool.GetBlockCount());
+    Log::Info("%u passes (%.1f%%) repeat a block another pass of the same effect set, %u (%.1f%%) one set by any pass", passCount - distinctWithinEffects,
+              percent(passCount - distinctWithinEffects), passCount - pool.GetBlockCount(), percent(passCount - pool.GetBlockCount()));
+    Log::Info("%u passes (%.1f%%) set their states out of canonical order or set one twice", nonCanonicalPasses, percent(nonCanonicalPasses));
+
+    std::vector<uint32_t> blocks(pool.GetBlockCount());
+    for(uint32_t i = 0; i < blocks.size(); i++)
+        blocks[i] = i;
+
+    size_t topCount = std::min<size_t>(blocks.size(), 10);
+    std::partial_sort(blocks.begin(), blocks.begin() + topCount, blocks.end(), [&](uint32_t a, uint32_t b)
+    {
+        return pool.GetBlock(a).UseCount > pool.GetBlock(b).UseCount;
+    });
+
+    Log::Info("most shared blocks:");
+    for(size_t i = 0; i < topCount; i++)
+    {
+        const Block& block = pool.GetBlock(blocks[i]);
+        std::string states;
+        for(uint32_t j = 0; j < block.Count; j++)
+            AppendState(states, pool.GetBlockStates(blocks[i])[j]);
+
+        Log::Info("    %5u passes  %s", block.UseCount, block.Count ? states.c_str() : "(no states)");
+    }
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1);
+    Log::Info("pooled render states of %u of %zu effects (took %lldms)", effectCount, files.size(), ms.count());
+
+    return true;
+}
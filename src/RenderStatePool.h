@@ -0,0 +1,68 @@
+#pragma once
+#include "Effect.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+//every distinct render state block stored once. blocks are canonicalized before they're looked up, so passes that set
+//the same states in a different order or set one of them twice share an entry
+class RenderStatePool
+{
+public:
+    struct Block
+    {
+        //first state in GetStates()
+        uint32_t Offset;
+        uint32_t Count;
+        //number of Add calls that returned this block
+        uint32_t UseCount;
+    };
+
+    RenderStatePool() : mAddCount(0)
+    {}
+
+    //returns the index of the block, adding it if there's no identical one yet
+    uint32_t Add(const RenderState* states, uint32_t count);
+    uint32_t Add(const rage::atArray<RenderState>& states)
+    {
+        return Add(states.GetCount() ? &states[0] : nullptr, states.GetCount());
+    }
+
+    uint32_t GetBlockCount() const
+    {
+        return (uint32_t)mBlocks.size();
+    }
+    const Block& GetBlock(uint32_t index) const
+    {
+        return mBlocks[index];
+    }
+    const RenderState* GetBlockStates(uint32_t index) const
+    {
+        return mStates.data() + mBlocks[index].Offset;
+    }
+
+    const std::vector<RenderState>& GetStates() const
+    {
+        return mStates;
+    }
+
+    uint32_t GetAddCount() const
+    {
+        return mAddCount;
+    }
+
+    //sorts the states by type and keeps the last value of a state set more than once, which is the one the device ends up with.
+    //returns the new count
+    static uint32_t Canonicalize(RenderState* states, uint32_t count);
+
+    //how often passes share a render state block, within each effect and across every .fxc in a folder
+    static bool Report(const char* path, uint32_t threadCount = 0);
+
+private:
+    std::vector<RenderState> mStates;
+    std::vector<Block> mBlocks;
+    //hash of the canonical states to the blocks with that hash
+    std::unordered_multimap<uint64_t, uint32_t> mLookup;
+    uint32_t mAddCount;
+};
@@ -0,0 +1,1177 @@
+#include "ShaderAssembler.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <vector>
+
+//D3DSIO_ values
+struct eOpcode
+{
+    enum Enum : uint16_t
+    {
+        NOP, MOV, ADD, SUB, MAD, MUL, RCP, RSQ, DP3, DP4, MIN, MAX, SLT, SGE, EXP, LOG, LIT, DST, LRP, FRC,
+        M4x4, M4x3, M3x4, M3x3, M3x2, CALL, CALLNZ, LOOP, RET, ENDLOOP, LABEL, DCL, POW, CRS, SGN, ABS, NRM, SINCOS,
+        REP, ENDREP, IF, IFC, ELSE, ENDIF, BREAK, BREAKC, MOVA, DEFB, DEFI,
+
+        TEXKILL = 65, TEX = 66, EXPP = 78, LOGP = 79, CND = 80, DEF = 81, CMP = 88, BEM = 89,
+        DP2ADD = 90, DSX, DSY, TEXLDD, SETP, TEXLDL, BREAKP,
+
+        COMMENT = 0xFFFE, END = 0xFFFF,
+    };
+};
+
+//D3DSPR_ values
+struct eRegisterType
+{
+    enum Enum : uint8_t
+    {
+        TEMP = 0, INPUT = 1, CONSTANT = 2, ADDRESS = 3, TEXTURE = 3, RASTOUT = 4, ATTROUT = 5, OUTPUT = 6, CONSTINT = 7,
+        COLOROUT = 8, DEPTHOUT = 9, SAMPLER = 10, CONSTBOOL = 14, LOOP = 15, MISCTYPE = 17, LABEL = 18, PREDICATE = 19,
+    };
+};
+
+//D3DSPSM_ values
+struct eSourceModifier
+{
+    enum Enum : uint8_t
+    {
+        NONE, NEG, BIAS, BIASNEG, SIGN, SIGNNEG, COMP, X2, X2NEG, DZ, DW, ABS, ABSNEG, NOT,
+    };
+};
+
+//D3DXREGISTER_SET, D3DXPARAMETER_CLASS and D3DXPARAMETER_TYPE values used by the constant table
+struct eConstantInfo
+{
+    enum Enum : uint8_t
+    {
+        SET_BOOL = 0, SET_INT4 = 1, SET_FLOAT4 = 2, SET_SAMPLER = 3,
+
+        CLASS_SCALAR = 0, CLASS_VECTOR = 1, CLASS_MATRIX_ROWS = 2, CLASS_MATRIX_COLUMNS = 3, CLASS_OBJECT = 4,
+
+        TYPE_BOOL = 1, TYPE_INT = 2, TYPE_FLOAT = 3, TYPE_SAMPLER = 10, TYPE_SAMPLER1D = 11, TYPE_SAMPLER2D = 12,
+        TYPE_SAMPLER3D = 13, TYPE_SAMPLERCUBE = 14,
+    };
+};
+
+static constexpr uint32_t VS_VERSION_TOKEN = 0xFFFE0000;
+static constexpr uint32_t PS_VERSION_TOKEN = 0xFFFF0000;
+static constexpr uint32_t PARAMETER_TOKEN = 0x80000000;
+static constexpr uint32_t RELATIVE_ADDRESSING = 1 << 13;
+static constexpr uint32_t PREDICATED = 1 << 28;
+static constexpr uint32_t DEFAULT_SWIZZLE = 0xE4;
+static constexpr uint32_t CTAB_FOURCC = 'C' | ('T' << 8) | ('A' << 16) | ('B' << 24);
+
+struct InstructionInfo
+{
+    const char* mName;
+    uint16_t mOpcode;
+    uint8_t mDstCount;
+    uint8_t mSrcCount;
+    //bits 16-23 of the instruction token
+    uint8_t mControl;
+};
+
+//def, defi, defb and dcl have their own encoding and are handled separately
+static constexpr InstructionInfo sInstructions[] =
+{
+    {"nop",     eOpcode::NOP,     0, 0, 0},
+    {"mov",     eOpcode::MOV,     1, 1, 0},
+    {"add",     eOpcode::ADD,     1, 2, 0},
+    {"sub",     eOpcode::SUB,     1, 2, 0},
+    {"mad",     eOpcode::MAD,     1, 3, 0},
+    {"mul",     eOpcode::MUL,     1, 2, 0},
+    {"rcp",     eOpcode::RCP,     1, 1, 0},
+    {"rsq",     eOpcode::RSQ,     1, 1, 0},
+    {"dp3",     eOpcode::DP3,     1, 2, 0},
+    {"dp4",     eOpcode::DP4,     1, 2, 0},
+    {"min",     eOpcode::MIN,     1, 2, 0},
+    {"max",     eOpcode::MAX,     1, 2, 0},
+    {"slt",     eOpcode::SLT,     1, 2, 0},
+    {"sge",     eOpcode::SGE,     1, 2, 0},
+    {"exp",     eOpcode::EXP,     1, 1, 0},
+    {"log",     eOpcode::LOG,     1, 1, 0},
+    {"lit",     eOpcode::LIT,     1, 1, 0},
+    {"dst",     eOpcode::DST,     1, 2, 0},
+    {"lrp",     eOpcode::LRP,     1, 3, 0},
+    {"frc",     eOpcode::FRC,     1, 1, 0},
+    {"m4x4",    eOpcode::M4x4,    1, 2, 0},
+    {"m4x3",    eOpcode::M4x3,    1, 2, 0},
+    {"m3x4",    eOpcode::M3x4,    1, 2, 0},
+    {"m3x3",    eOpcode::M3x3,    1, 2, 0},
+    {"m3x2",    eOpcode::M3x2,    1, 2, 0},
+    {"call",    eOpcode::CALL,    0, 1, 0},
+    {"callnz",  eOpcode::CALLNZ,  0, 2, 0},
+    {"loop",    eOpcode::LOOP,    0, 2, 0},
+    {"ret",     eOpcode::RET,     0, 0, 0},
+    {"endloop", eOpcode::ENDLOOP, 0, 0, 0},
+    {"label",   eOpcode::LABEL,   0, 1, 0},
+    {"pow",     eOpcode::POW,     1, 2, 0},
+    {"crs",     eOpcode::CRS,     1, 2, 0},
+    {"sgn",     eOpcode::SGN,     1, 3, 0},
+    {"abs",     eOpcode::ABS,     1, 1, 0},
+    {"nrm",     eOpcode::NRM,     1, 1, 0},
+    {"sincos",  eOpcode::SINCOS,  1, 1, 0},
+    {"rep",     eOpcode::REP,     0, 1, 0},
+    {"endrep",  eOpcode::ENDREP,  0, 0, 0},
+    {"if",      eOpcode::IF,      0, 1, 0},
+    {"else",    eOpcode::ELSE,    0, 0, 0},
+    {"endif",   eOpcode::ENDIF,   0, 0, 0},
+    {"break",   eOpcode::BREAK,   0, 0, 0},
+    {"mova",    eOpcode::MOVA,    1, 1, 0},
+    {"texkill", eOpcode::TEXKILL, 1, 0, 0},
+    {"texld",   eOpcode::TEX,     1, 2, 0},
+    {"texldp",  eOpcode::TEX,     1, 2, 1},
+    {"texldb",  eOpcode::TEX,     1, 2, 2},
+    {"expp",    eOpcode::EXPP,    1, 1, 0},
+    {"logp",    eOpcode::LOGP,    1, 1, 0},
+    {"cnd",     eOpcode::CND,     1, 3, 0},
+    {"cmp",     eOpcode::CMP,     1, 3, 0},
+    {"bem",     eOpcode::BEM,     1, 2, 0},
+    {"dp2add",  eOpcode::DP2ADD,  1, 3, 0},
+    {"dsx",     eOpcode::DSX,     1, 1, 0},
+    {"dsy",     eOpcode::DSY,     1, 1, 0},
+    {"texldd",  eOpcode::TEXLDD,  1, 4, 0},
+    {"setp",    eOpcode::SETP,    1, 2, 0},
+    {"texldl",  eOpcode::TEXLDL,  1, 2, 0},
+    {"breakp",  eOpcode::BREAKP,  0, 1, 0},
+};
+
+//index is the D3DSPC_ value
+static constexpr const char* sComparisons[] = {nullptr, "gt", "eq", "ge", "lt", "ne", "le"};
+
+//index is the D3DDECLUSAGE value
+static constexpr const char* sUsages[] =
+{
+    "position", "blendweight", "blendindices", "normal", "psize", "texcoord", "tangent", "binormal",
+    "tessfactor", "positiont", "color", "fog", "depth", "sample",
+};
+
+struct RegisterPrefix
+{
+    const char* mName;
+    eRegisterType::Enum mType;
+    //-1 if the register number follows the prefix
+    int16_t mIndex;
+};
+
+//longer prefixes come first so "oDepth" isn't read as oD
+static constexpr RegisterPrefix sRegisterPrefixes[] =
+{
+    {"oPos",   eRegisterType::RASTOUT,   0},
+    {"oFog",   eRegisterType::RASTOUT,   1},
+    {"oPts",   eRegisterType::RASTOUT,   2},
+    {"oDepth", eRegisterType::DEPTHOUT,  0},
+    {"oC",     eRegisterType::COLOROUT,  -1},
+    {"oD",     eRegisterType::ATTROUT,   -1},
+    {"oT",     eRegisterType::OUTPUT,    -1},
+    {"o",      eRegisterType::OUTPUT,    -1},
+    {"vPos",   eRegisterType::MISCTYPE,  0},
+    {"vFace",  eRegisterType::MISCTYPE,  1},
+    {"v",      eRegisterType::INPUT,     -1},
+    {"aL",     eRegisterType::LOOP,      0},
+    {"a",      eRegisterType::ADDRESS,   -1},
+    {"r",      eRegisterType::TEMP,      -1},
+    {"c",      eRegisterType::CONSTANT,  -1},
+    {"i",      eRegisterType::CONSTINT,  -1},
+    {"b",      eRegisterType::CONSTBOOL, -1},
+    {"s",      eRegisterType::SAMPLER,   -1},
+    {"t",      eRegisterType::TEXTURE,   -1},
+    {"l",      eRegisterType::LABEL,     -1},
+    {"p",      eRegisterType::PREDICATE, -1},
+};
+
+static inline uint32_t MakeRegisterToken(uint32_t type, uint32_t index)
+{
+    return PARAMETER_TOKEN | ((type & 0x7) << 28) | ((type & 0x18) << 8) | (index & 0x7FF);
+}
+
+static inline bool IsRegisterType(uint32_t token, uint32_t type)
+{
+    return (token & 0x70001800) == (MakeRegisterToken(type, 0) & 0x70001800);
+}
+
+static inline const char* SkipSpaces(const char* c)
+{
+    while(*c == ' ' || *c == '\t' || *c == '\r')
+        c++;
+    return c;
+}
+
+static inline int ComponentIndex(char c)
+{
+    switch(c)
+    {
+        case 'x': case 'r': return 0;
+        case 'y': case 'g': return 1;
+        case 'z': case 'b': return 2;
+        case 'w': case 'a': return 3;
+        default: return -1;
+    }
+}
+
+//compares the word starting at c with name and returns the end of the word if they match
+static inline const char* MatchWord(const char* c, const char* name)
+{
+    size_t length = strlen(name);
+    if(strncmp(c, name, length) != 0)
+        return nullptr;
+    return c + length;
+}
+
+class Assembler
+{
+public:
+    Assembler(const rage::atArray<ShaderConstant>& constants, CString& messages) : mConstants(constants), mMessages(messages),
+        mLine(0), mVersion(0), mHeaderSection(eHeaderSection::NONE), mHasHeader(false)
+    {}
+
+    eAssembleResult::Enum Run(const char* source, size_t length, ShaderBytecode& bytecode)
+    {
+        //a disassembled instruction averages around 3 tokens per 30 characters
+        mTokens.reserve(length / 8 + 16);
+
+        const char* end = source + length;
+        const char* lineStart = source;
+        char line[1024];
+        while(lineStart < end)
+        {
+            const char* lineEnd = (const char*)memchr(lineStart, '\n', end - lineStart);
+            if(!lineEnd)
+                lineEnd = end;
+            mLine++;
+
+            size_t lineLength = lineEnd - lineStart;
+            if(lineLength >= sizeof(line))
+                return Error("line is too long");
+            memcpy(line, lineStart, lineLength);
+            line[lineLength] = '\0';
+
+            eAssembleResult::Enum result = ParseLine(line);
+            if(result != eAssembleResult::OK)
+                return result;
+
+            lineStart = lineEnd + 1;
+        }
+
+        if(!mVersion)
+            return Error("missing shader version");
+
+        mTokens.push_back(eOpcode::END);
+
+        bytecode = {(uint32_t)(mTokens.size() * sizeof(uint32_t))};
+        memcpy(&bytecode[0], mTokens.data(), mTokens.size() * sizeof(uint32_t));
+        return eAssembleResult::OK;
+    }
+
+private:
+    struct eHeaderSection
+    {
+        enum Enum : uint8_t
+        {
+            NONE, PARAMETERS, REGISTERS,
+        };
+    };
+
+    //D3DXSHADER_CONSTANTINFO and D3DXSHADER_TYPEINFO fields of one constant
+    struct TableEntry
+    {
+        const char* mName;
+        uint8_t mRegisterSet;
+        uint16_t mRegisterIndex;
+        uint16_t mRegisterCount;
+        uint8_t mClass;
+        uint8_t mType;
+        uint8_t mRows;
+        uint8_t mColumns;
+        uint16_t mElements;
+    };
+
+    struct HeaderParameter
+    {
+        char mName[64];
+        TableEntry mEntry;
+        bool mHasRegister;
+    };
+
+    struct Operand
+    {
+        uint32_t mToken;
+        uint32_t mRelativeToken;
+        bool mRelative;
+    };
+
+    eAssembleResult::Enum Error(const char* fmt, ...)
+    {
+        char message[512];
+        int length = snprintf(message, sizeof(message), "line %d: ", mLine);
+
+        va_list args;
+        va_start(args, fmt);
+        vsnprintf(message + length, sizeof(message) - length, fmt, args);
+        va_end(args);
+
+        mMessages = message;
+        return eAssembleResult::SYNTAX_ERROR;
+    }
+
+    eAssembleResult::Enum Unsupported(const char* what, const char* name)
+    {
+        Error("unsupported %s \"%s\"", what, name);
+        return eAssembleResult::UNSUPPORTED;
+    }
+
+    eAssembleResult::Enum ParseLine(char* line)
+    {
+        char* comment = strstr(line, "//");
+        if(comment)
+        {
+            if(!mVersion)
+            {
+                eAssembleResult::Enum result = ParseHeaderComment(comment + 2);
+                if(result != eAssembleResult::OK)
+                    return result;
+            }
+            *comment = '\0';
+        }
+        comment = strchr(line, ';');
+        if(comment)
+            *comment = '\0';
+
+        const char* c = SkipSpaces(line);
+        if(*c == '\0' || *c == '\n')
+            return eAssembleResult::OK;
+
+        if(!mVersion)
+            return ParseVersion(c);
+
+        return ParseInstruction(c);
+    }
+
+    eAssembleResult::Enum ParseVersion(const char* c)
+    {
+        uint32_t type = 0;
+        if(c[0] == 'v' && c[1] == 's')
+            type = VS_VERSION_TOKEN;
+        else if(c[0] == 'p' && c[1] == 's')
+            type = PS_VERSION_TOKEN;
+        else
+            return Error("expected a shader version instead of \"%s\"", c);
+
+        if(strncmp(c + 2, "_3_0", 4) != 0 || *SkipSpaces(c + 6) != '\0')
+            return Unsupported("shader version", c);
+
+        mVersion = type | 0x0300;
+        mTokens.push_back(mVersion);
+        WriteConstantTable(c);
+        return eAssembleResult::OK;
+    }
+
+    eAssembleResult::Enum ParseInstruction(const char* c)
+    {
+        Operand predicate {};
+        bool predicated = false;
+        if(*c == '(')
+        {
+            c = SkipSpaces(c + 1);
+            const char* close = strchr(c, ')');
+            if(!close)
+                return Error("missing ')' after the predicate");
+
+            char text[32];
+            if((size_t)(close - c) >= sizeof(text))
+                return Error("invalid predicate");
+            memcpy(text, c, close - c);
+            text[close - c] = '\0';
+
+            eAssembleResult::Enum result = ParseSource(text, predicate);
+            if(result != eAssembleResult::OK)
+                return result;
+            if(predicate.mRelative || !IsRegisterType(predicate.mToken, eRegisterType::PREDICATE))
+                return Error("predicate must be p0");
+
+            predicated = true;
+            c = SkipSpaces(close + 1);
+        }
+
+        char mnemonic[64];
+        size_t mnemonicLength = 0;
+        while(c[mnemonicLength] && !isspace((unsigned char)c[mnemonicLength]))
+            mnemonicLength++;
+        if(mnemonicLength >= sizeof(mnemonic))
+            return Error("invalid instruction");
+        memcpy(mnemonic, c, mnemonicLength);
+        mnemonic[mnemonicLength] = '\0';
+        c = SkipSpaces(c + mnemonicLength);
+
+        //split the operands on commas, register names never contain any
+        char operands[8][128];
+        uint32_t operandCount = 0;
+        if(*c)
+        {
+            while(true)
+            {
+                if(operandCount == std::size(operands))
+                    return Error("too many operands");
+
+                const char* comma = strchr(c, ',');
+                size_t operandLength = comma ? comma - c : strlen(c);
+                while(operandLength && isspace((unsigned char)c[operandLength - 1]))
+                    operandLength--;
+                if(!operandLength)
+                    return Error("empty operand");
+                if(operandLength >= sizeof(operands[0]))
+                    return Error("operand is too long");
+
+                memcpy(operands[operandCount], c, operandLength);
+                operands[operandCount][operandLength] = '\0';
+                operandCount++;
+
+                if(!comma)
+                    break;
+                c = SkipSpaces(comma + 1);
+            }
+        }
+
+        //modifiers follow the base name: mul_sat_pp, if_ne, dcl_texcoord1_centroid
+        char* suffixes = strchr(mnemonic, '_');
+        if(suffixes)
+            *suffixes++ = '\0';
+
+        if(strcmp(mnemonic, "def") == 0 || strcmp(mnemonic, "defi") == 0 || strcmp(mnemonic, "defb") == 0)
+        {
+            if(predicated)
+                return Error("%s can't be predicated", mnemonic);
+            return ParseDefinition(mnemonic, operands, operandCount);
+        }
+
+        if(strcmp(mnemonic, "dcl") == 0)
+        {
+            if(predicated)
+                return Error("dcl can't be predicated");
+            return ParseDeclaration(suffixes, operands, operandCount);
+        }
+
+        const InstructionInfo* info = nullptr;
+        for(const InstructionInfo& instruction : sInstructions)
+        {
+            if(strcmp(instruction.mName, mnemonic) == 0)
+            {
+                info = &instruction;
+                break;
+            }
+        }
+        if(!info)
+            return Unsupported("instruction", mnemonic);
+
+        uint16_t opcode = info->mOpcode;
+        uint8_t srcCount = info->mSrcCount;
+        uint32_t control = info->mControl;
+        uint32_t resultModifier = 0;
+
+        while(suffixes)
+        {
+            char* suffix = suffixes;
+            suffixes = strchr(suffixes, '_');
+            if(suffixes)
+                *suffixes++ = '\0';
+
+            uint32_t modifier = ParseResultModifier(suffix);
+            if(modifier)
+            {
+                resultModifier |= modifier;
+                continue;
+            }
+
+            uint32_t comparison = 0;
+            for(uint32_t i = 1; i < std::size(sComparisons); i++)
+            {
+                if(strcmp(sComparisons[i], suffix) == 0)
+                    comparison = i;
+            }
+            if(!comparison || control)
+                return Unsupported("instruction modifier", suffix);
+
+            if(opcode == eOpcode::IF)
+            {
+                opcode = eOpcode::IFC;
+                srcCount = 2;
+            }
+            else if(opcode == eOpcode::BREAK)
+            {
+                opcode = eOpcode::BREAKC;
+                srcCount = 2;
+            }
+            else if(opcode != eOpcode::SETP)
+            {
+                return Error("%s doesn't take a comparison", mnemonic);
+            }
+            control = comparison;
+        }
+
+        if(opcode == eOpcode::SETP && !control)
+            return Error("setp needs a comparison");
+        if(resultModifier && !info->mDstCount)
+            return Error("%s doesn't have a destination to modify", mnemonic);
+        if(operandCount != info->mDstCount + srcCount)
+            return Error("%s takes %d operands, got %d", mnemonic, info->mDstCount + srcCount, operandCount);
+
+        size_t instructionToken = mTokens.size();
+        mTokens.push_back(opcode | (control << 16) | (predicated ? PREDICATED : 0));
+
+        uint32_t operand = 0;
+        if(info->mDstCount)
+        {
+            Operand dst;
+            eAssembleResult::Enum result = ParseDestination(operands[operand++], resultModifier, dst);
+            if(result != eAssembleResult::OK)
+                return result;
+            WriteOperand(dst);
+        }
+
+        if(predicated)
+            WriteOperand(predicate);
+
+        for(uint32_t i = 0; i < srcCount; i++)
+        {
+            Operand src;
+            eAssembleResult::Enum result = ParseSource(operands[operand++], src);
+            if(result != eAssembleResult::OK)
+                return result;
+            WriteOperand(src);
+        }
+
+        mTokens[instructionToken] |= (uint32_t)(mTokens.size() - instructionToken - 1) << 24;
+        return eAssembleResult::OK;
+    }
+
+    eAssembleResult::Enum ParseDefinition(const char* mnemonic, char (*operands)[128], uint32_t operandCount)
+    {
+        bool isBool = mnemonic[3] == 'b';
+        bool isInt = mnemonic[3] == 'i';
+        uint32_t valueCount = isBool ? 1 : 4;
+        if(operandCount != valueCount + 1)
+            return Error("%s takes %d operands, got %d", mnemonic, valueCount + 1, operandCount);
+
+        Operand dst;
+        eAssembleResult::Enum result = ParseDestination(operands[0], 0, dst);
+        if(result != eAssembleResult::OK)
+            return result;
+
+        uint32_t expectedType = isBool ? eRegisterType::CONSTBOOL : isInt ? eRegisterType::CONSTINT : eRegisterType::CONSTANT;
+        if(dst.mRelative || !IsRegisterType(dst.mToken, expectedType))
+            return Error("%s can't define \"%s\"", mnemonic, operands[0]);
+
+        uint16_t opcode = isBool ? eOpcode::DEFB : isInt ? eOpcode::DEFI : eOpcode::DEF;
+        mTokens.push_back(opcode | ((valueCount + 1) << 24));
+        mTokens.push_back(dst.mToken);
+
+        for(uint32_t i = 1; i <= valueCount; i++)
+        {
+            const char* text = SkipSpaces(operands[i]);
+            uint32_t value = 0;
+            if(isBool)
+            {
+                if(strcmp(text, "true") == 0)
+                    value = 1;
+                else if(strcmp(text, "false") != 0)
+                    return Error("expected true or false instead of \"%s\"", text);
+            }
+            else if(isInt)
+            {
+                char* end = nullptr;
+                int32_t integer = (int32_t)strtol(text, &end, 0);
+                if(end == text || *SkipSpaces(end) != '\0')
+                    return Error("invalid integer \"%s\"", text);
+                memcpy(&value, &integer, sizeof(value));
+            }
+            else
+            {
+                float number = 0.0f;
+                if(!ParseFloat(text, number))
+                    return Error("invalid number \"%s\"", text);
+                memcpy(&value, &number, sizeof(value));
+            }
+            mTokens.push_back(value);
+        }
+
+        return eAssembleResult::OK;
+    }
+
+    eAssembleResult::Enum ParseDeclaration(char* suffixes, char (*operands)[128], uint32_t operandCount)
+    {
+        if(operandCount != 1)
+            return Error("dcl takes 1 operand, got %d", operandCount);
+
+        uint32_t declaration = PARAMETER_TOKEN;
+        uint32_t resultModifier = 0;
+        bool isSampler = false;
+        while(suffixes)
+        {
+            char* suffix = suffixes;
+            suffixes = strchr(suffixes, '_');
+            if(suffixes)
+                *suffixes++ = '\0';
+
+            uint32_t modifier = ParseResultModifier(suffix);
+            if(modifier)
+            {
+                resultModifier |= modifier;
+                continue;
+            }
+
+            //D3DSAMPLER_TEXTURE_TYPE
+            uint32_t samplerType = strcmp(suffix, "2d") == 0 ? 2 : strcmp(suffix, "cube") == 0 ? 3 : strcmp(suffix, "volume") == 0 ? 4 : 0;
+            if(samplerType)
+            {
+                declaration |= samplerType << 27;
+                isSampler = true;
+                continue;
+            }
+
+            //usage names end with the usage index: texcoord1
+            size_t nameLength = strlen(suffix);
+            while(nameLength && isdigit((unsigned char)suffix[nameLength - 1]))
+                nameLength--;
+            uint32_t usageIndex = (uint32_t)atoi(suffix + nameLength);
+            suffix[nameLength] = '\0';
+
+            uint32_t usage = 0;
+            while(usage < std::size(sUsages) && strcmp(sUsages[usage], suffix) != 0)
+                usage++;
+            if(usage == std::size(sUsages) || usageIndex > 15)
+                return Unsupported("declaration", suffix);
+            declaration |= usage | (usageIndex << 16);
+        }
+
+        Operand dst;
+        eAssembleResult::Enum result = ParseDestination(operands[0], resultModifier, dst);
+        if(result != eAssembleResult::OK)
+            return result;
+        if(dst.mRelative)
+            return Error("dcl can't use relative addressing");
+
+        bool dstIsSampler = IsRegisterType(dst.mToken, eRegisterType::SAMPLER);
+        if(isSampler != dstIsSampler)
+            return Error(isSampler ? "\"%s\" isn't a sampler" : "sampler \"%s\" needs a texture type", operands[0]);
+
+        mTokens.push_back(eOpcode::DCL | (2 << 24));
+        mTokens.push_back(declaration);
+        mTokens.push_back(dst.mToken);
+        return eAssembleResult::OK;
+    }
+
+    static uint32_t ParseResultModifier(const char* suffix)
+    {
+        //D3DSPDM_ values, already shifted into place
+        if(strcmp(suffix, "sat") == 0)
+            return 1 << 20;
+        else if(strcmp(suffix, "pp") == 0)
+            return 2 << 20;
+        else if(strcmp(suffix, "centroid") == 0)
+            return 4 << 20;
+        return 0;
+    }
+
+    static bool ParseFloat(const char* text, float& value)
+    {
+        char* end = nullptr;
+        double number = strtod(text, &end);
+        if(end == text)
+            return false;
+
+        //the msvc runtime prints special values as 1.#INF, -1.#INF, 1.#QNAN and -1.#IND
+        if(*end == '#')
+        {
+            if(strncmp(end + 1, "INF", 3) == 0)
+                number = number < 0.0 ? -std::numeric_limits<double>::infinity() : std::numeric_limits<double>::infinity();
+            else if(strncmp(end + 1, "QNAN", 4) == 0 || strncmp(end + 1, "IND", 3) == 0 || strncmp(end + 1, "SNAN", 4) == 0)
+                number = std::numeric_limits<double>::quiet_NaN();
+            else
+                return false;
+
+            end++;
+            while(isalnum((unsigned char)*end))
+                end++;
+        }
+
+        if(*SkipSpaces(end) != '\0')
+            return false;
+
+        value = (float)number;
+        return true;
+    }
+
+    //reads a register name and number, the number is optional when relative addressing follows: c[a0.x + 4]
+    eAssembleResult::Enum ParseRegister(const char*& c, uint32_t& type, uint32_t& index)
+    {
+        for(const RegisterPrefix& prefix : sRegisterPrefixes)
+        {
+            const char* end = MatchWord(c, prefix.mName);
+            if(!end)
+                continue;
+
+            if(prefix.mIndex >= 0)
+            {
+                if(isalnum((unsigned char)*end))
+                    continue;
+                type = prefix.mType;
+                index = prefix.mIndex;
+                c = end;
+                return eAssembleResult::OK;
+            }
+
+            if(!isdigit((unsigned char)*end) && *end != '[')
+                continue;
+
+            type = prefix.mType;
+            index = 0;
+            while(isdigit((unsigned char)*end))
+                index = index * 10 + (*end++ - '0');
+            if(index > 0x7FF)
+                return Error("register number %u is out of range", index);
+
+            c = end;
+            return eAssembleResult::OK;
+        }
+
+        return Error("unknown register \"%s\"", c);
+    }
+
+    eAssembleResult::Enum ParseRegisterWithAddressing(const char*& c, Operand& operand)
+    {
+        uint32_t type = 0;
+        uint32_t index = 0;
+        eAssembleResult::Enum result = ParseRegister(c, type, index);
+        if(result != eAssembleResult::OK)
+            return result;
+
+        operand.mRelative = false;
+        operand.mRelativeToken = 0;
+        if(*c == '[')
+        {
+            c = SkipSpaces(c + 1);
+
+            uint32_t addressType = 0;
+            uint32_t addressIndex = 0;
+            result = ParseRegister(c, addressType, addressIndex);
+            if(result != eAssembleResult::OK)
+                return result;
+            if(addressType != eRegisterType::ADDRESS && addressType != eRegisterType::LOOP)
+                return Error("relative addressing needs a0 or aL");
+
+            //the address register token always uses a replicate swizzle
+            uint32_t component = 0;
+            if(*c == '.')
+            {
+                int value = ComponentIndex(c[1]);
+                if(value < 0 || isalnum((unsigned char)c[2]))
+                    return Error("relative addressing needs a single component");
+                component = value;
+                c += 2;
+            }
+
+            c = SkipSpaces(c);
+            if(*c == '+')
+            {
+                char* end = nullptr;
+                index += (uint32_t)strtoul(SkipSpaces(c + 1), &end, 10);
+                c = SkipSpaces(end);
+            }
+            if(*c != ']')
+                return Error("missing ']'");
+            c++;
+
+            operand.mRelative = true;
+            operand.mRelativeToken = MakeRegisterToken(addressType, addressIndex) | ((component * 0x55) << 16);
+        }
+
+        operand.mToken = MakeRegisterToken(type, index) | (operand.mRelative ? RELATIVE_ADDRESSING : 0);
+        return eAssembleResult::OK;
+    }
+
+    eAssembleResult::Enum ParseDestination(const char* text, uint32_t resultModifier, Operand& operand)
+    {
+        const char* c = SkipSpaces(text);
+        eAssembleResult::Enum result = ParseRegisterWithAddressing(c, operand);
+        if(result != eAssembleResult::OK)
+            return result;
+
+        uint32_t writeMask = 0xF;
+        if(*c == '.')
+        {
+            writeMask = 0;
+            int last = -1;
+            for(c++; ComponentIndex(*c) >= 0; c++)
+            {
+                int component = ComponentIndex(*c);
+                if(component <= last)
+                    return Error("invalid write mask in \"%s\"", text);
+                writeMask |= 1 << component;
+                last = component;
+            }
+        }
+
+        if(*SkipSpaces(c) != '\0')
+            return Error("unexpected \"%s\" in destination \"%s\"", c, text);
+
+        operand.mToken |= (writeMask << 16) | resultModifier;
+        return eAssembleResult::OK;
+    }
+
+    eAssembleResult::Enum ParseSource(const char* text, Operand& operand)
+    {
+        const char* c = SkipSpaces(text);
+        bool negate = false;
+        bool invert = false;
+        if(*c == '-')
+        {
+            negate = true;
+            c = SkipSpaces(c + 1);
+        }
+        else if(*c == '!')
+        {
+            invert = true;
+            c = SkipSpaces(c + 1);
+        }
+
+        eAssembleResult::Enum result = ParseRegisterWithAddressing(c, operand);
+        if(result != eAssembleResult::OK)
+            return result;
+
+        eSourceModifier::Enum modifier = negate ? eSourceModifier::NEG : invert ? eSourceModifier::NOT : eSourceModifier::NONE;
+        if(*c == '_')
+        {
+            const char* end = nullptr;
+            if((end = MatchWord(c, "_abs")))
+                modifier = negate ? eSourceModifier::ABSNEG : eSourceModifier::ABS;
+            else if((end = MatchWord(c, "_bias")))
+                modifier = negate ? eSourceModifier::BIASNEG : eSourceModifier::BIAS;
+            else if((end = MatchWord(c, "_bx2")))
+                modifier = negate ? eSourceModifier::SIGNNEG : eSourceModifier::SIGN;
+            else if((end = MatchWord(c, "_x2")))
+                modifier = negate ? eSourceModifier::X2NEG : eSourceModifier::X2;
+            else if((end = MatchWord(c, "_dz")) || (end = MatchWord(c, "_db")))
+                modifier = eSourceModifier::DZ;
+            else if((end = MatchWord(c, "_dw")) || (end = MatchWord(c, "_da")))
+                modifier = eSourceModifier::DW;
+            else
+                return Error("unknown source modifier in \"%s\"", text);
+
+            if(invert || (negate && (modifier == eSourceModifier::DZ || modifier == eSourceModifier::DW)))
+                return Error("invalid source modifier combination in \"%s\"", text);
+            c = end;
+        }
+
+        //missing components repeat the last one: .xy is .xyyy
+        uint32_t swizzle = DEFAULT_SWIZZLE;
+        if(*c == '.')
+        {
+            c++;
+            uint32_t componentCount = 0;
+            int component = 0;
+            swizzle = 0;
+            while(componentCount < 4 && ComponentIndex(*c) >= 0)
+            {
+                component = ComponentIndex(*c++);
+                swizzle |= component << (componentCount * 2);
+                componentCount++;
+            }
+            if(!componentCount)
+                return Error("invalid swizzle in \"%s\"", text);
+            for(; componentCount < 4; componentCount++)
+                swizzle |= component << (componentCount * 2);
+        }
+
+        if(*SkipSpaces(c) != '\0')
+            return Error("unexpected \"%s\" in source \"%s\"", c, text);
+
+        operand.mToken |= (swizzle << 16) | ((uint32_t)modifier << 24);
+        return eAssembleResult::OK;
+    }
+
+    void WriteOperand(const Operand& operand)
+    {
+        mTokens.push_back(operand.mToken);
+        if(operand.mRelative)
+            mTokens.push_back(operand.mRelativeToken);
+    }
+
+    //the disassembly of a compiled shader starts with the contents of its constant table:
+    //  Generated by Microsoft (R) HLSL Shader Compiler 9.29.952.3111
+    //  Parameters:
+    //    row_major float4x3 gWorld;
+    //  Registers:
+    //    Name   Reg   Size
+    //    ------ ----- ----
+    //    gWorld c0       3
+    eAssembleResult::Enum ParseHeaderComment(const char* comment)
+    {
+        const char* c = SkipSpaces(comment);
+        const char* end = nullptr;
+        if((end = MatchWord(c, "Generated by ")))
+        {
+            snprintf(mCreator, sizeof(mCreator), "%s", end);
+            TrimEnd(mCreator);
+            mHasHeader = true;
+            return eAssembleResult::OK;
+        }
+        if(MatchWord(c, "Parameters:"))
+        {
+            mHeaderSection = eHeaderSection::PARAMETERS;
+            mHasHeader = true;
+            return eAssembleResult::OK;
+        }
+        if(MatchWord(c, "Registers:"))
+        {
+            mHeaderSection = eHeaderSection::REGISTERS;
+            return eAssembleResult::OK;
+        }
+        if(*c == '\0' || *c == '\r' || *c == '\n')
+            return eAssembleResult::OK;
+
+        if(mHeaderSection == eHeaderSection::PARAMETERS)
+            return ParseHeaderParameter(c);
+        if(mHeaderSection == eHeaderSection::REGISTERS)
+            return ParseHeaderRegister(c);
+        return eAssembleResult::OK;
+    }
+
+    eAssembleResult::Enum ParseHeaderParameter(const char* c)
+    {
+        if(MatchWord(c, "struct"))
+            return Unsupported("constant table entry", "struct");
+
+        HeaderParameter parameter {};
+        TableEntry& constant = parameter.mEntry;
+        constant.mClass = eConstantInfo::CLASS_SCALAR;
+        constant.mRows = 1;
+        constant.mColumns = 1;
+        constant.mElements = 1;
+        bool rowMajor = false;
+        const char* end = nullptr;
+        if((end = MatchWord(c, "row_major ")))
+        {
+            rowMajor = true;
+            c = SkipSpaces(end);
+        }
+        else if((end = MatchWord(c, "column_major ")))
+        {
+            c = SkipSpaces(end);
+        }
+
+        static constexpr struct
+        {
+            const char* mName;
+            eConstantInfo::Enum mType;
+            eConstantInfo::Enum mRegisterSet;
+        } types[] =
+        {
+            {"samplerCUBE", eConstantInfo::TYPE_SAMPLERCUBE, eConstantInfo::SET_SAMPLER},
+            {"sampler1D",   eConstantInfo::TYPE_SAMPLER1D,   eConstantInfo::SET_SAMPLER},
+            {"sampler2D",   eConstantInfo::TYPE_SAMPLER2D,   eConstantInfo::SET_SAMPLER},
+            {"sampler3D",   eConstantInfo::TYPE_SAMPLER3D,   eConstantInfo::SET_SAMPLER},
+            {"sampler",     eConstantInfo::TYPE_SAMPLER,     eConstantInfo::SET_SAMPLER},
+            {"float",       eConstantInfo::TYPE_FLOAT,       eConstantInfo::SET_FLOAT4},
+            {"half",        eConstantInfo::TYPE_FLOAT,       eConstantInfo::SET_FLOAT4},
+            {"int",         eConstantInfo::TYPE_INT,         eConstantInfo::SET_INT4},
+            {"bool",        eConstantInfo::TYPE_BOOL,        eConstantInfo::SET_BOOL},
+        };
+
+        bool found = false;
+        for(const auto& type : types)
+        {
+            if(!(end = MatchWord(c, type.mName)))
+                continue;
+
+            constant.mType = type.mType;
+            constant.mRegisterSet = type.mRegisterSet;
+            if(type.mRegisterSet == eConstantInfo::SET_SAMPLER)
+                constant.mClass = eConstantInfo::CLASS_OBJECT;
+            found = true;
+            break;
+        }
+        if(!found)
+            return Unsupported("constant table entry", c);
+        c = end;
+
+        //float, float4 or float4x3
+        if(isdigit((unsigned char)*c))
+        {
+            uint32_t first = *c++ - '0';
+            if(*c == 'x' && isdigit((unsigned char)c[1]))
+            {
+                constant.mRows = (uint8_t)first;
+                constant.mColumns = (uint8_t)(c[1] - '0');
+                constant.mClass = rowMajor ? eConstantInfo::CLASS_MATRIX_ROWS : eConstantInfo::CLASS_MATRIX_COLUMNS;
+                c += 2;
+            }
+            else
+            {
+                constant.mColumns = (uint8_t)first;
+                constant.mClass = eConstantInfo::CLASS_VECTOR;
+            }
+        }
+
+        c = SkipSpaces(c);
+        size_t nameLength = 0;
+        while(isalnum((unsigned char)c[nameLength]) || c[nameLength] == '_')
+            nameLength++;
+        if(!nameLength || nameLength >= sizeof(parameter.mName))
+            return Error("invalid constant table entry \"%s\"", c);
+        memcpy(parameter.mName, c, nameLength);
+        c += nameLength;
+
+        if(*c == '[')
+            constant.mElements = (uint16_t)atoi(c + 1);
+
+        mHeaderParameters.push_back(parameter);
+        return eAssembleResult::OK;
+    }
+
+    eAssembleResult::Enum ParseHeaderRegister(const char* c)
+    {
+        char name[64];
+        char reg[16];
+        uint32_t size = 0;
+        if(sscanf(c, "%63s %15s %u", name, reg, &size) != 3)
+            return eAssembleResult::OK; //column titles and the separator
+
+        for(HeaderParameter& parameter : mHeaderParameters)
+        {
+            if(strcmp(parameter.mName, name) != 0)
+                continue;
+
+            parameter.mEntry.mRegisterIndex = (uint16_t)atoi(reg + 1);
+            parameter.mEntry.mRegisterCount = (uint16_t)size;
+            parameter.mHasRegister = true;
+            return eAssembleResult::OK;
+        }
+
+        return Error("register entry for unknown constant \"%s\"", name);
+    }
+
+    static void TrimEnd(char* string)
+    {
+        size_t length = strlen(string);
+        while(length && isspace((unsigned char)string[length - 1]))
+            string[--length] = '\0';
+    }
+
+    //layout follows D3DXSHADER_CONSTANTTABLE: header, constant infos, then every constant's name and type info,
+    //then the target and creator strings. all offsets are relative to the header.
+    void WriteConstantTable(const char* target)
+    {
+        std::vector<TableEntry> constants;
+        if(mHasHeader)
+        {
+            for(HeaderParameter& parameter : mHeaderParameters)
+            {
+                if(!parameter.mHasRegister)
+                    continue;
+                parameter.mEntry.mName = parameter.mName;
+                constants.push_back(parameter.mEntry);
+            }
+        }
+        else if(mConstants.GetCount())
+        {
+            for(const ShaderConstant& constant : mConstants)
+            {
+                constants.push_back({constant.mName.Get() ? constant.mName.Get() : "", constant.mRegisterSet, constant.mRegisterIndex, constant.mRegisterCount,
+                                     constant.mClass, constant.mType, constant.mRows, constant.mColumns, constant.mElements});
+            }
+            snprintf(mCreator, sizeof(mCreator), "fxdc");
+        }
+        else
+        {
+            //plain asm, D3DXAssembleShader doesn't write a constant table either
+            return;
+        }
+
+        std::vector<uint8_t> table(28 + constants.size() * 20);
+        auto writeDword = [&table](size_t offset, uint32_t value)
+        {
+            memcpy(&table[offset], &value, sizeof(value));
+        };
+        auto writeWord = [&table](size_t offset, uint16_t value)
+        {
+            memcpy(&table[offset], &value, sizeof(value));
+        };
+        auto appendString = [&table](const char* string, bool align)
+        {
+            size_t offset = table.size();
+            table.insert(table.end(), string, string + strlen(string) + 1);
+            if(align)
+                table.resize((table.size() + 3) & ~3);
+            return (uint32_t)offset;
+        };
+
+        for(size_t i = 0; i < constants.size(); i++)
+        {
+            const TableEntry& constant = constants[i];
+            size_t info = 28 + i * 20;
+
+            writeDword(info + 0, appendString(constant.mName, true));
+            writeWord(info + 4, constant.mRegisterSet);
+            writeWord(info + 6, constant.mRegisterIndex);
+            writeWord(info + 8, constant.mRegisterCount);
+            writeWord(info + 10, 0);
+
+            //D3DXSHADER_TYPEINFO
+            size_t typeInfo = table.size();
+            table.resize(typeInfo + 16);
+            writeWord(typeInfo + 0, constant.mClass);
+            writeWord(typeInfo + 2, constant.mType);
+            writeWord(typeInfo + 4, constant.mRows);
+            writeWord(typeInfo + 6, constant.mColumns);
+            writeWord(typeInfo + 8, constant.mElements);
+            writeWord(typeInfo + 10, 0);
+            writeDword(typeInfo + 12, 0);
+
+            writeDword(info + 12, (uint32_t)typeInfo);
+            writeDword(info + 16, 0);
+        }
+
+        char targetName[8];
+        snprintf(targetName, sizeof(targetName), "%.6s", target);
+        uint32_t targetOffset = appendString(targetName, false);
+        uint32_t creatorOffset = appendString(mCreator, false);
+        table.resize((table.size() + 3) & ~3);
+
+        writeDword(0, 28);
+        writeDword(4, creatorOffset);
+        writeDword(8, mVersion);
+        writeDword(12, (uint32_t)constants.size());
+        writeDword(16, 28);
+        writeDword(20, 0);
+        writeDword(24, targetOffset);
+
+        uint32_t commentLength = (uint32_t)(table.size() / sizeof(uint32_t)) + 1;
+        mTokens.push_back(eOpcode::COMMENT | (commentLength << 16));
+        mTokens.push_back(CTAB_FOURCC);
+        size_t tableStart = mTokens.size();
+        mTokens.resize(tableStart + table.size() / sizeof(uint32_t));
+        memcpy(&mTokens[tableStart], table.data(), table.size());
+    }
+
+    const rage::atArray<ShaderConstant>& mConstants;
+    CString& mMessages;
+    std::vector<uint32_t> mTokens;
+    std::vector<HeaderParameter> mHeaderParameters;
+    char mCreator[128] = "";
+    int mLine;
+    uint32_t mVersion;
+    eHeaderSection::Enum mHeaderSection;
+    bool mHasHeader;
+};
+
+eAssembleResult::Enum ShaderAssembler::Assemble(const char* source, size_t length, const rage::atArray<ShaderConstant>& constants, ShaderBytecode& bytecode, CString& messages)
+{
+    Assembler assembler(constants, messages);
+    return assembler.Run(source, length, bytecode);
+}
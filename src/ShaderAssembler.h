@@ -0,0 +1,24 @@
+#pragma once
+#include "CompilerBackend.h"
+
+#include <cstddef>
+#include <cstdint>
+
+struct eAssembleResult
+{
+    enum Enum : uint8_t
+    {
+        OK,
+        SYNTAX_ERROR,
+        //shader model or instruction the native assembler doesn't handle, the compiler backend has to assemble it
+        UNSUPPORTED,
+    };
+};
+
+//native vs_3_0/ps_3_0 assembler for the syntax D3DXDisassembleShader writes. the instruction stream matches D3DXAssembleShader.
+//if the text still has the "Parameters" and "Registers" comments of a compiled shader the constant table is rebuilt from them.
+//otherwise a non empty constants array is written as the constant table. messages receive "line N: error" relative to the start of the source.
+namespace ShaderAssembler
+{
+    eAssembleResult::Enum Assemble(const char* source, size_t length, const rage::atArray<ShaderConstant>& constants, ShaderBytecode& bytecode, CString& messages);
+}
@@ -0,0 +1,172 @@
+#include "ShaderStats.h"
+#include "ConstantTable.h"
+
+#include <bitset>
+
+//D3DSIO_ values the counts care about
+static constexpr uint16_t OPCODE_NOP = 0;
+static constexpr uint16_t OPCODE_DCL = 31;
+static constexpr uint16_t OPCODE_DEFB = 47;
+static constexpr uint16_t OPCODE_DEFI = 48;
+static constexpr uint16_t OPCODE_DEF = 81;
+static constexpr uint16_t OPCODE_BREAKP = 96;
+static constexpr uint16_t OPCODE_PHASE = 0xFFFD;
+static constexpr uint16_t OPCODE_COMMENT = 0xFFFE;
+static constexpr uint16_t OPCODE_END = 0xFFFF;
+
+//D3DSPR_ values
+static constexpr uint32_t REGISTER_TEMP = 0;
+static constexpr uint32_t REGISTER_CONST = 2;
+static constexpr uint32_t REGISTER_CONSTINT = 7;
+static constexpr uint32_t REGISTER_SAMPLER = 10;
+static constexpr uint32_t REGISTER_CONSTBOOL = 14;
+
+static constexpr uint32_t RELATIVE_ADDRESSING = 1 << 13;
+static constexpr uint16_t REGISTER_SET_FLOAT4 = 2;
+
+static bool IsTextureOpcode(uint16_t opcode)
+{
+    //texcoord to texm3x3vspec, texreg2rgb to texdepth, texldd and texldl
+    return (opcode >= 64 && opcode <= 77) || (opcode >= 82 && opcode <= 87) || opcode == 93 || opcode == 95;
+}
+
+static bool IsFlowControlOpcode(uint16_t opcode)
+{
+    //call to label, rep to breakc and breakp
+    return (opcode >= 25 && opcode <= 30) || (opcode >= 38 && opcode <= 45) || opcode == OPCODE_BREAKP;
+}
+
+template<size_t Size>
+static void MarkRegister(std::bitset<Size>& registers, uint32_t index)
+{
+    if(index < Size)
+        registers.set(index);
+}
+
+bool ShaderStats::Init(const uint8_t* bytecode, uint32_t size)
+{
+    *this = {};
+
+    const uint32_t* tokens = (const uint32_t*)bytecode;
+    uint32_t tokenCount = size / sizeof(uint32_t);
+    if(!tokenCount)
+        return false;
+
+    //shader model 1 instructions don't store their length
+    uint32_t version = tokens[0];
+    if(((version >> 16) != 0xFFFF && (version >> 16) != 0xFFFE) || ((version >> 8) & 0xFF) < 2)
+        return false;
+
+    IsPixelShader = (version >> 16) == 0xFFFF;
+
+    ConstantTable constantTable;
+    bool hasConstantTable = constantTable.Init(bytecode, size);
+
+    std::bitset<32> temps;
+    std::bitset<256> floatConstants;
+    std::bitset<16> intConstants;
+    std::bitset<16> boolConstants;
+    std::bitset<16> samplers;
+
+    auto markParameter = [&](uint32_t token)
+    {
+        uint32_t type = ((token >> 28) & 0x7) | ((token >> 8) & 0x18);
+        uint32_t index = token & 0x7FF;
+        switch(type)
+        {
+            case REGISTER_TEMP:
+                MarkRegister(temps, index);
+            break;
+
+            case REGISTER_CONST:
+                MarkRegister(floatConstants, index);
+                if((token & RELATIVE_ADDRESSING) && hasConstantTable)
+                {
+                    //the index register can land anywhere in the array the base register belongs to
+                    for(uint32_t i = 0; i < constantTable.GetConstantCount(); i++)
+                    {
+                        const ConstantTable::ConstantInfo& constant = constantTable.GetConstant(i);
+                        if(constant.RegisterSet == REGISTER_SET_FLOAT4 && index >= constant.RegisterIndex && index < constant.RegisterIndex + constant.RegisterCount)
+                        {
+                            for(uint32_t j = constant.RegisterIndex; j < constant.RegisterIndex + constant.RegisterCount; j++)
+                                MarkRegister(floatConstants, j);
+                        }
+                    }
+                }
+            break;
+
+            case REGISTER_CONSTINT:
+                MarkRegister(intConstants, index);
+            break;
+
+            case REGISTER_CONSTBOOL:
+                MarkRegister(boolConstants, index);
+            break;
+
+            case REGISTER_SAMPLER:
+                MarkRegister(samplers, index);
+            break;
+        }
+    };
+
+    bool ended = false;
+    for(uint32_t i = 1; i < tokenCount && !ended;)
+    {
+        uint32_t token = tokens[i++];
+        uint16_t opcode = token & 0xFFFF;
+
+        uint32_t length = opcode == OPCODE_COMMENT ? (token >> 16) & 0x7FFF : (token >> 24) & 0xF;
+        if(length > tokenCount - i)
+            return false;
+
+        const uint32_t* params = &tokens[i];
+        i += length;
+
+        switch(opcode)
+        {
+            case OPCODE_END:
+                ended = true;
+            break;
+
+            case OPCODE_COMMENT:
+            case OPCODE_PHASE:
+            case OPCODE_NOP:
+            break;
+
+            //the first token describes the usage, the register comes after it
+            case OPCODE_DCL:
+                if(length > 1)
+                    markParameter(params[1]);
+            break;
+
+            //the register is followed by the literal values
+            case OPCODE_DEF:
+            case OPCODE_DEFI:
+            case OPCODE_DEFB:
+                if(length)
+                    markParameter(params[0]);
+            break;
+
+            default:
+                Instructions++;
+                if(IsTextureOpcode(opcode))
+                    Texture++;
+                else if(IsFlowControlOpcode(opcode))
+                    FlowControl++;
+                else
+                    Alu++;
+
+                for(uint32_t j = 0; j < length; j++)
+                    markParameter(params[j]);
+            break;
+        }
+    }
+
+    Temps = (uint32_t)temps.count();
+    FloatConstants = (uint32_t)floatConstants.count();
+    IntConstants = (uint32_t)intConstants.count();
+    BoolConstants = (uint32_t)boolConstants.count();
+    Samplers = (uint32_t)samplers.count();
+
+    return ended;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "CompilerBackend.h"
+
+#include <cstdint>
+
+//instruction and register counts of a shader model 2 or 3 program, read straight from its token stream.
+//declarations, definitions and comments aren't instructions
+struct ShaderStats
+{
+    ShaderStats() : IsPixelShader(false), Instructions(0), Alu(0), Texture(0), FlowControl(0), Temps(0), FloatConstants(0), IntConstants(0),
+                    BoolConstants(0), Samplers(0)
+    {}
+
+    //returns false for an empty or truncated program or a shader model the token layout isn't known for
+    bool Init(const uint8_t* bytecode, uint32_t size);
+    bool Init(const ShaderBytecode& bytecode)
+    {
+        return bytecode.GetCapacity() && Init(&bytecode[0], bytecode.GetCapacity());
+    }
+
+    bool IsPixelShader;
+    uint32_t Instructions;
+    uint32_t Alu;
+    uint32_t Texture;
+    uint32_t FlowControl;
+    //distinct registers referenced. a relatively addressed constant counts the whole range its constant table entry covers
+    uint32_t Temps;
+    uint32_t FloatConstants;
+    uint32_t IntConstants;
+    uint32_t BoolConstants;
+    uint32_t Samplers;
+};
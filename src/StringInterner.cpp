@@ -0,0 +1,107 @@
+#include "StringInterner.h"
+#include "rage/StringHash.h"
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+//entries are carved out of big blocks so interning a string doesn't cost a heap allocation each
+static constexpr size_t BLOCK_SIZE = 64 * 1024;
+//strings are spread over shards by hash, each with its own lock, so threads loading different effects rarely wait on
+//each other. equal hashes always land in the same shard so a lookup only ever has to look in one
+static constexpr uint32_t SHARD_COUNT = 16;
+
+struct Shard
+{
+    std::mutex Mutex;
+    std::unordered_multimap<uint32_t, const InternedStringEntry*> Entries;
+    std::vector<std::unique_ptr<uint8_t[]>> Blocks;
+    uint8_t* CurrentBlock = nullptr;
+    size_t BlockUsed = BLOCK_SIZE;
+    size_t AllocatedSize = 0;
+};
+
+static Shard sShards[SHARD_COUNT];
+
+static InternedStringEntry* AllocateEntry(Shard& shard, uint32_t length)
+{
+    size_t size = (offsetof(InternedStringEntry, mString) + length + 1 + alignof(InternedStringEntry) - 1) & ~(alignof(InternedStringEntry) - 1);
+
+    //strings that don't fit in a block get a block of their own
+    if(size > BLOCK_SIZE)
+    {
+        shard.Blocks.emplace_back(new uint8_t[size]);
+        shard.AllocatedSize += size;
+        return (InternedStringEntry*)shard.Blocks.back().get();
+    }
+
+    if(shard.BlockUsed + size > BLOCK_SIZE)
+    {
+        shard.Blocks.emplace_back(new uint8_t[BLOCK_SIZE]);
+        shard.AllocatedSize += BLOCK_SIZE;
+        shard.CurrentBlock = shard.Blocks.back().get();
+        shard.BlockUsed = 0;
+    }
+
+    InternedStringEntry* entry = (InternedStringEntry*)(shard.CurrentBlock + shard.BlockUsed);
+    shard.BlockUsed += size;
+    return entry;
+}
+
+InternedString::InternedString(const char* str) : mEntry(nullptr)
+{
+    if(str)
+        *this = StringInterner::Intern(str);
+}
+
+InternedString StringInterner::Intern(const char* str)
+{
+    if(!str)
+        return {};
+
+    uint32_t hash = rage::atStringHash(str);
+    uint32_t length = (uint32_t)strlen(str);
+
+    Shard& shard = sShards[hash % SHARD_COUNT];
+    std::lock_guard lock(shard.Mutex);
+
+    auto range = shard.Entries.equal_range(hash);
+    for(auto it = range.first; it != range.second; ++it)
+    {
+        if(it->second->mLength == length && memcmp(it->second->mString, str, length) == 0)
+            return InternedString(it->second);
+    }
+
+    InternedStringEntry* entry = AllocateEntry(shard, length);
+    entry->mHash = hash;
+    entry->mLength = length;
+    memcpy(entry->mString, str, length + 1);
+
+    shard.Entries.emplace(hash, entry);
+    return InternedString((const InternedStringEntry*)entry);
+}
+
+uint32_t StringInterner::GetStringCount()
+{
+    uint32_t count = 0;
+    for(Shard& shard : sShards)
+    {
+        std::lock_guard lock(shard.Mutex);
+        count += (uint32_t)shard.Entries.size();
+    }
+    return count;
+}
+
+size_t StringInterner::GetMemoryUsage()
+{
+    size_t size = 0;
+    for(Shard& shard : sShards)
+    {
+        std::lock_guard lock(shard.Mutex);
+        //rough size of the table nodes, the buckets and the blocks
+        size += shard.AllocatedSize + shard.Entries.size() * (sizeof(void*) * 2 + sizeof(uint32_t) + sizeof(void*)) +
+                shard.Entries.bucket_count() * sizeof(void*);
+    }
+    return size;
+}
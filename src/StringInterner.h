@@ -0,0 +1,75 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+struct InternedStringEntry
+{
+    uint32_t mHash;
+    uint32_t mLength;
+    char mString[1];
+};
+
+class InternedString;
+
+namespace StringInterner
+{
+    //thread safe, only the shard the hash falls in is locked. strings are keyed on their atStringHash and compared byte
+    //for byte, so strings that only differ in case or in slashes (which the hash ignores) still get their own entries
+    InternedString Intern(const char* str);
+
+    uint32_t GetStringCount();
+    //bytes held by the interned strings and the lookup table
+    size_t GetMemoryUsage();
+}
+
+//handle to a string owned by the process wide interner. every distinct string is stored once and never freed,
+//so handles are a single pointer, copying one is free and two handles are equal only if they point at the same entry.
+class InternedString
+{
+public:
+    InternedString() : mEntry(nullptr)
+    {}
+
+    InternedString(const char* str);
+
+    //null for a default constructed handle, like an unset CString
+    const char* Get() const
+    {
+        return mEntry ? mEntry->mString : nullptr;
+    }
+
+    uint32_t Length() const
+    {
+        return mEntry ? mEntry->mLength : 0;
+    }
+
+    //rage::atStringHash of the string, computed once when it was interned
+    uint32_t GetHash() const
+    {
+        return mEntry ? mEntry->mHash : 0;
+    }
+
+    bool operator==(const InternedString& rhs) const
+    {
+        return mEntry == rhs.mEntry;
+    }
+
+    bool operator!=(const InternedString& rhs) const
+    {
+        return mEntry != rhs.mEntry;
+    }
+
+    bool operator==(const char* rhs) const
+    {
+        return mEntry && rhs && strcmp(mEntry->mString, rhs) == 0;
+    }
+
+private:
+    friend InternedString StringInterner::Intern(const char* str);
+
+    InternedString(const InternedStringEntry* entry) : mEntry(entry)
+    {}
+
+    const InternedStringEntry* mEntry;
+};
@@ -1,7 +1,16 @@
 #pragma once
+#include <bit>
+#include <cstddef>
+#include <cstdint>
 
 #define ASSERT_SIZE(type, size) static_assert(sizeof(type) == size, "sizeof("#type")" " != " #size)
 
+#ifdef _MSC_VER
+#define DEBUG_BREAK() __debugbreak()
+#else
+#define DEBUG_BREAK() __builtin_trap()
+#endif
+
 #define BITMASK_ENUM_OPERATORS(type) \
 inline bool operator&(type lhs, type rhs) \
 { \
@@ -35,6 +44,157 @@ inline type operator^=(type& lhs, type rhs) \
     return lhs; \
 }
 
+//perfect hash over a fixed list of names, built at compile time. every name gets its own slot so a lookup hashes the string
+//once and compares it against a single name. names that repeat an earlier one aren't added, the first one wins like it
+//would searching the list in order
+template<size_t Count, bool IgnoreCase = false>
+class PerfectHashTable
+{
+public:
+    static constexpr size_t NOT_FOUND = Count;
+
+    constexpr PerfectHashTable(const char* const (&names)[Count]) : mNames(), mSeeds(), mSlots()
+    {
+        for(size_t i = 0; i < Count; i++)
+            mNames[i] = names[i];
+        Build();
+    }
+
+    //for tables of structs, name points at the member holding the name. null names are skipped
+    template<typename T>
+    constexpr PerfectHashTable(const T (&entries)[Count], const char* const T::* name) : mNames(), mSeeds(), mSlots()
+    {
+        for(size_t i = 0; i < Count; i++)
+            mNames[i] = entries[i].*name;
+        Build();
+    }
+
+    //index of the name or NOT_FOUND
+    constexpr size_t Find(const char* string) const
+    {
+        if(!string)
+            return NOT_FOUND;
+
+        uint64_t hash = Hash(string);
+        uint16_t index = mSlots[Mix(hash, mSeeds[hash & (BUCKET_COUNT - 1)]) & (SLOT_COUNT - 1)];
+        if(index == EMPTY || !Equal(mNames[index], string))
+            return NOT_FOUND;
+
+        return index;
+    }
+
+private:
+    static_assert(Count > 0 && Count < UINT16_MAX);
+
+    static constexpr size_t BUCKET_COUNT = std::bit_ceil(Count);
+    //at most half full so a seed that places a bucket is found within a few tries
+    static constexpr size_t SLOT_COUNT = BUCKET_COUNT * 2;
+    static constexpr uint16_t EMPTY = UINT16_MAX;
+
+    static constexpr char Fold(char c)
+    {
+        return IgnoreCase && c >= 'A' && c <= 'Z' ? (char)(c + ('a' - 'A')) : c;
+    }
+
+    //fnv-1a
+    static constexpr uint64_t Hash(const char* string)
+    {
+        uint64_t hash = 0xCBF29CE484222325;
+        for(; *string; string++)
+            hash = (hash ^ (uint8_t)Fold(*string)) * 0x100000001B3;
+        return hash;
+    }
+
+    static constexpr uint64_t Mix(uint64_t hash, uint16_t seed)
+    {
+        hash ^= seed * 0x9E3779B97F4A7C15;
+        hash ^= hash >> 33;
+        hash *= 0xFF51AFD7ED558CCD;
+        hash ^= hash >> 33;
+        return hash;
+    }
+
+    static constexpr bool Equal(const char* lhs, const char* rhs)
+    {
+        for(; *lhs && Fold(*lhs) == Fold(*rhs); lhs++, rhs++);
+        return Fold(*lhs) == Fold(*rhs);
+    }
+
+    //buckets are placed biggest first while the slots are still mostly free, each one gets the first seed that puts all of
+    //its names in free slots
+    constexpr void Build()
+    {
+        uint64_t hashes[Count] {};
+        bool skipped[Count] {};
+        uint16_t bucketSizes[BUCKET_COUNT] {};
+        uint16_t maxBucketSize = 0;
+        for(size_t i = 0; i < Count; i++)
+        {
+            skipped[i] = !mNames[i];
+            if(skipped[i])
+                continue;
+
+            hashes[i] = Hash(mNames[i]);
+            for(size_t j = 0; j < i && !skipped[i]; j++)
+                skipped[i] = !skipped[j] && hashes[j] == hashes[i] && Equal(mNames[j], mNames[i]);
+            if(skipped[i])
+                continue;
+
+            uint16_t& bucketSize = bucketSizes[hashes[i] & (BUCKET_COUNT - 1)];
+            bucketSize++;
+            maxBucketSize = bucketSize > maxBucketSize ? bucketSize : maxBucketSize;
+        }
+
+        for(size_t i = 0; i < SLOT_COUNT; i++)
+            mSlots[i] = EMPTY;
+
+        for(uint16_t size = maxBucketSize; size > 0; size--)
+        {
+            for(size_t bucket = 0; bucket < BUCKET_COUNT; bucket++)
+            {
+                if(bucketSizes[bucket] != size)
+                    continue;
+
+                uint16_t members[Count] {};
+                uint16_t memberCount = 0;
+                for(size_t i = 0; i < Count; i++)
+                {
+                    if(!skipped[i] && (hashes[i] & (BUCKET_COUNT - 1)) == bucket)
+                        members[memberCount++] = (uint16_t)i;
+                }
+
+                for(uint32_t seed = 0;; seed++)
+                {
+                    //only two names with the same 64 bit hash can get here, which is worth a compile error
+                    if(seed > UINT16_MAX)
+                        throw "no perfect hash for these names";
+
+                    bool placed = true;
+                    for(uint16_t i = 0; i < memberCount && placed; i++)
+                    {
+                        size_t slot = Mix(hashes[members[i]], (uint16_t)seed) & (SLOT_COUNT - 1);
+                        placed = mSlots[slot] == EMPTY;
+                        for(uint16_t j = 0; j < i && placed; j++)
+                            placed = (Mix(hashes[members[j]], (uint16_t)seed) & (SLOT_COUNT - 1)) != slot;
+                    }
+
+                    if(!placed)
+                        continue;
+
+                    for(uint16_t i = 0; i < memberCount; i++)
+                        mSlots[Mix(hashes[members[i]], (uint16_t)seed) & (SLOT_COUNT - 1)] = members[i];
+                    mSeeds[bucket] = (uint16_t)seed;
+                    break;
+                }
+            }
+        }
+    }
+
+    const char* mNames[Count];
+    uint16_t mSeeds[BUCKET_COUNT];
+    uint16_t mSlots[SLOT_COUNT];
+};
+
 #define BASIC_ENUM_REFLECTION_WRITE_STRING(arg) #arg, 
 
 #define BASIC_ENUM_REFLECTION_FIRST_INDEX_1(underlyingType, firstValue, ...) \
@@ -44,7 +204,7 @@ inline type operator^=(type& lhs, type rhs) \
     }; \
     static const char* EnumToString(Enum type) \
     { \
-        if((size_t)type <= std::size(msNames)) \
+        if((size_t)type < std::size(msNames)) \
             return msNames[(uint32_t)type]; \
         else \
             return "INVALID"; \
@@ -52,19 +212,16 @@ inline type operator^=(type& lhs, type rhs) \
     \
     static Enum StringToEnum(const char* string) \
     { \
-    for(size_t i = 0; i < std::size(msNames); i++) \
-    { \
-        if(strcmp(string, msNames[i]) == 0) \
-            return (Enum)i; \
-    } \
-    return Enum::COUNT; \
+        size_t index = msNameTable.Find(string); \
+        return index < std::size(msNames) ? (Enum)index : Enum::COUNT; \
     } \
     \
 private: \
     static constexpr const char* msNames[] \
     { \
         "INVALID", #firstValue, FOR_EACH(BASIC_ENUM_REFLECTION_WRITE_STRING, __VA_ARGS__) \
-    };
+    }; \
+    static constexpr PerfectHashTable<std::size(msNames)> msNameTable {msNames};
 
 #define BASIC_ENUM_REFLECTION(underlyingType, ...) \
     enum Enum : underlyingType \
@@ -73,7 +230,7 @@ private: \
     }; \
     static const char* EnumToString(Enum type) \
     { \
-        if((size_t)type <= std::size(msNames)) \
+        if((size_t)type < std::size(msNames)) \
             return msNames[(uint32_t)type]; \
         else \
             return "INVALID"; \
@@ -81,19 +238,16 @@ private: \
     \
     static Enum StringToEnum(const char* string) \
     { \
-    for(size_t i = 0; i < std::size(msNames); i++) \
-    { \
-        if(strcmp(string, msNames[i]) == 0) \
-            return (Enum)i; \
-    } \
-    return Enum::COUNT; \
+        size_t index = msNameTable.Find(string); \
+        return index < std::size(msNames) ? (Enum)index : Enum::COUNT; \
     } \
     \
 private: \
     static constexpr const char* msNames[] \
     { \
         FOR_EACH(BASIC_ENUM_REFLECTION_WRITE_STRING, __VA_ARGS__) \
-    };
+    }; \
+    static constexpr PerfectHashTable<std::size(msNames)> msNameTable {msNames};
 
 
 //from https://stackoverflow.com/a/11994395
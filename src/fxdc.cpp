@@ -0,0 +1,227 @@
+#include "fxdc.h"
+#include "Effect.h"
+#include "EffectWriter.h"
+#include "FileStream.h"
+#include "CompilerBackend.h"
+#include "Log.h"
+#include "hlslparser/src/HLSLParser.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+static_assert(sizeof(fxdc_macro) == sizeof(ShaderMacro) && offsetof(fxdc_macro, definition) == offsetof(ShaderMacro, Definition));
+
+class IncludeHandler : public ShaderIncludeHandler
+{
+public:
+    IncludeHandler(const fxdc_include_handler& handler) : mHandler(handler)
+    {}
+
+    bool Open(bool system, const char* name, const char* parentName, const char*& data, size_t& size) override
+    {
+        const void* fileData = nullptr;
+        size_t fileSize = 0;
+        if(!mHandler.open || !mHandler.open(mHandler.user, system ? 1 : 0, name, parentName, &fileData, &fileSize))
+            return false;
+
+        data = (const char*)fileData;
+        size = fileSize;
+        return true;
+    }
+
+    void Close(const char* data) override
+    {
+        if(mHandler.close)
+            mHandler.close(mHandler.user, data);
+    }
+
+private:
+    const fxdc_include_handler& mHandler;
+};
+
+static void* Allocate(const fxdc_allocator* allocator, size_t size)
+{
+    return allocator ? allocator->alloc(allocator->user, size) : malloc(size);
+}
+
+//text blobs get a terminator
+static bool MakeBlob(const fxdc_allocator* allocator, const void* data, size_t size, bool text, fxdc_blob& blob)
+{
+    blob = {};
+    void* copy = Allocate(allocator, size + (text ? 1 : 0));
+    if(!copy)
+        return false;
+
+    if(size)
+        memcpy(copy, data, size);
+    if(text)
+        ((char*)copy)[size] = 0;
+
+    blob.data = copy;
+    blob.size = size;
+    return true;
+}
+
+//hands the captured messages back, the result of the call stands unless they can't be allocated
+static fxdc_result Finish(fxdc_result result, const fxdc_allocator* allocator, const Log::Capture& capture, fxdc_blob* messages)
+{
+    if(!messages)
+        return result;
+
+    std::string text = capture.GetText();
+    if(!MakeBlob(allocator, text.data(), text.size(), true, *messages))
+        return FXDC_OUT_OF_MEMORY;
+
+    return result;
+}
+
+fxdc_result fxdc_set_backend(const char* name, const char* cache_folder)
+{
+    if(!name)
+        return FXDC_INVALID_ARGUMENT;
+
+    return SetCompilerBackend(name, cache_folder) ? FXDC_OK : FXDC_INVALID_ARGUMENT;
+}
+
+fxdc_result fxdc_compile(const void* source, size_t length, const fxdc_compile_options* options, fxdc_blob* effect, fxdc_blob* messages)
+{
+    if(messages)
+        *messages = {};
+    if(!source || !effect)
+        return FXDC_INVALID_ARGUMENT;
+    *effect = {};
+
+    static const fxdc_compile_options sDefaultOptions = {};
+    if(!options)
+        options = &sDefaultOptions;
+
+    const char* fileName = options->source_name ? options->source_name : "memory.fx";
+    static const ShaderMacro sNoMacros[] = {{nullptr, nullptr}};
+    const ShaderMacro* macros = options->macros ? (const ShaderMacro*)options->macros : sNoMacros;
+
+    Log::Capture capture;
+    try
+    {
+        CompilerBackend& backend = GetCompilerBackend();
+
+        std::unique_ptr<IncludeHandler> includes;
+        if(options->includes)
+            includes = std::make_unique<IncludeHandler>(*options->includes);
+
+        CString preprocessed;
+        CString preprocessMessages;
+        if(!backend.PreprocessSource(fileName, (const char*)source, length, macros, includes.get(), preprocessed, preprocessMessages))
+        {
+            if(preprocessMessages.Length())
+                Log::Error("%s", preprocessMessages.Get());
+            else
+                Log::Error("unable to preprocess \"%s\"", fileName);
+            return Finish(FXDC_PREPROCESS_FAILED, options->allocator, capture, messages);
+        }
+
+        M4::Allocator allocator;
+        M4::HLSLParser parser(&allocator, fileName, preprocessed.Get(), preprocessed.Length());
+        M4::HLSLTree tree(&allocator);
+        if(!parser.Parse(&tree))
+        {
+            //report the broken parameters after the error in the same run
+            Effect recovered;
+            recovered.LoadParametersFromFx(parser);
+            return Finish(FXDC_PARSE_FAILED, options->allocator, capture, messages);
+        }
+
+        Effect compiled;
+        if(!compiled.LoadFromFx(parser, options->shader_flags))
+            return Finish(FXDC_COMPILE_FAILED, options->allocator, capture, messages);
+
+        if(options->prune)
+            compiled.Prune();
+        if(options->canonicalize_render_states)
+            compiled.CanonicalizeRenderStates();
+
+        std::vector<uint8_t> data;
+        OFileStream file(fileName, data);
+        if(!compiled.Save(file, options->extended_format ? eEffectFormat::EXTENDED : eEffectFormat::CLASSIC))
+            return Finish(FXDC_COMPILE_FAILED, options->allocator, capture, messages);
+
+        if(!MakeBlob(options->allocator, data.data(), data.size(), false, *effect))
+            return Finish(FXDC_OUT_OF_MEMORY, options->allocator, capture, messages);
+    }
+    catch(const std::bad_alloc&)
+    {
+        return Finish(FXDC_OUT_OF_MEMORY, options->allocator, capture, messages);
+    }
+
+    fxdc_result result = Finish(FXDC_OK, options->allocator, capture, messages);
+    if(result != FXDC_OK)
+        fxdc_free(options->allocator, effect);
+    return result;
+}
+
+fxdc_result fxdc_unpack(const void* effect, size_t size, const fxdc_allocator* allocator, fxdc_blob* text, fxdc_blob* messages)
+{
+    if(messages)
+        *messages = {};
+    if(!effect || !text)
+        return FXDC_INVALID_ARGUMENT;
+    *text = {};
+
+    Log::Capture capture;
+    try
+    {
+        IFileStream file("memory.fxc", (const uint8_t*)effect, size);
+        Effect loaded(file);
+        if(loaded.GetLoadError() != eEffectLoadError::NONE)
+            return Finish(FXDC_INVALID_EFFECT, allocator, capture, messages);
+
+        EffectWriter writer;
+        if(!loaded.SaveToFx(writer))
+            return Finish(FXDC_INVALID_EFFECT, allocator, capture, messages);
+
+        std::string source = writer.GetString();
+        if(!MakeBlob(allocator, source.data(), source.size(), true, *text))
+            return Finish(FXDC_OUT_OF_MEMORY, allocator, capture, messages);
+    }
+    catch(const std::bad_alloc&)
+    {
+        return Finish(FXDC_OUT_OF_MEMORY, allocator, capture, messages);
+    }
+
+    fxdc_result result = Finish(FXDC_OK, allocator, capture, messages);
+    if(result != FXDC_OK)
+        fxdc_free(allocator, text);
+    return result;
+}
+
+void fxdc_free(const fxdc_allocator* allocator, fxdc_blob* blob)
+{
+    if(!blob || !blob->data)
+        return;
+
+    if(allocator)
+        allocator->free(allocator->user, blob->data);
+    else
+        free(blob->data);
+
+    *blob = {};
+}
+
+const char* fxdc_result_string(fxdc_result result)
+{
+    switch(result)
+    {
+        case FXDC_OK:                return "ok";
+        case FXDC_INVALID_ARGUMENT:  return "invalid argument";
+        case FXDC_PREPROCESS_FAILED: return "preprocessing failed";
+        case FXDC_PARSE_FAILED:      return "parsing failed";
+        case FXDC_COMPILE_FAILED:    return "compiling failed";
+        case FXDC_INVALID_EFFECT:    return "invalid effect";
+        case FXDC_OUT_OF_MEMORY:     return "out of memory";
+    }
+
+    return "unknown result";
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+//c interface for embedding fxdc. effects are compiled from and unpacked to memory, nothing touches the file system unless
+//the include handler or the compiler backend does. every call is independent of the others and can run on any thread at the
+//same time as calls on other threads, as long as the backend isn't changed while they run. messages a call produces are
+//returned to its caller instead of being printed
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum fxdc_result
+{
+    FXDC_OK = 0,
+    FXDC_INVALID_ARGUMENT,
+    FXDC_PREPROCESS_FAILED,
+    FXDC_PARSE_FAILED,
+    FXDC_COMPILE_FAILED,
+    FXDC_INVALID_EFFECT,
+    FXDC_OUT_OF_MEMORY,
+} fxdc_result;
+
+//every blob handed out is allocated through these and has to be released with fxdc_free using the same allocator.
+//memory the library only uses for the length of a call comes from the process heap
+typedef struct fxdc_allocator
+{
+    void* (*alloc)(void* user, size_t size);
+    void (*free)(void* user, void* ptr);
+    void* user;
+} fxdc_allocator;
+
+typedef struct fxdc_include_handler
+{
+    //returns nonzero and fills data and size if it can serve name. system is nonzero for #include <name>. parent_name is the
+    //file holding the #include, the source_name of the compile for the source itself. data has to stay valid until close
+    int (*open)(void* user, int system, const char* name, const char* parent_name, const void** data, size_t* size);
+    //called once for every open that succeeded
+    void (*close)(void* user, const void* data);
+    void* user;
+} fxdc_include_handler;
+
+//same layout as D3DXMACRO
+typedef struct fxdc_macro
+{
+    const char* name;
+    const char* definition;
+} fxdc_macro;
+
+//zero initialized options are valid and compile with no flags, macros or includes
+typedef struct fxdc_compile_options
+{
+    //only used in messages and #line directives, "memory.fx" when null
+    const char* source_name;
+    //D3DXSHADER_ flags, see eShaderFlags
+    uint32_t shader_flags;
+    //terminated by an entry with a null name, can be null
+    const fxdc_macro* macros;
+    //same as /Prune and /Zsc
+    int prune;
+    int canonicalize_render_states;
+    //every #include fails when null
+    const fxdc_include_handler* includes;
+    //malloc and free when null
+    const fxdc_allocator* allocator;
+    //same as /Extended, the game can't read the result
+    int extended_format;
+} fxdc_compile_options;
+
+typedef struct fxdc_blob
+{
+    void* data;
+    //text blobs are null terminated, the terminator isn't counted
+    size_t size;
+} fxdc_blob;
+
+//name is one of "d3dx", "replay" or "record", see /Backend. when never called the first call picks the same default as the
+//command line. don't call it while other threads are inside fxdc_compile or fxdc_unpack
+fxdc_result fxdc_set_backend(const char* name, const char* cache_folder);
+
+//compiles the source of a .fx to a .fxc. messages is optional and receives every error and warning as text, it's set even
+//when the compile fails
+fxdc_result fxdc_compile(const void* source, size_t length, const fxdc_compile_options* options, fxdc_blob* effect, fxdc_blob* messages);
+
+//unpacks a .fxc to the source of a .fx. the effect is validated first, allocator and messages can be null
+fxdc_result fxdc_unpack(const void* effect, size_t size, const fxdc_allocator* allocator, fxdc_blob* text, fxdc_blob* messages);
+
+//releases a blob and leaves it empty, allocator has to be the one it was allocated with
+void fxdc_free(const fxdc_allocator* allocator, fxdc_blob* blob);
+
+const char* fxdc_result_string(fxdc_result result);
+
+#ifdef __cplusplus
+}
+#endif
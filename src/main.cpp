@@ -1,10 +1,21 @@
-#define WIN32_LEAN_AND_MEAN
-
 #include "Effect.h"
 #include "FileStream.h"
+#include "CompilerBackend.h"
+#include "EffectIndex.h"
+#include "EffectArchive.h"
+#include "EffectDiff.h"
+#include "EffectStats.h"
+#include "EffectVerifier.h"
+#include "RenderStatePool.h"
+#include "CompileServer.h"
+#include "EffectWatcher.h"
+#include "EffectGenerator.h"
 #include "hlslparser/src/HLSLParser.h"
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
+#endif
 #include <filesystem>
 #include <vector>
 #include <span>
@@ -29,18 +40,51 @@ CmdOption gCmdOptions[]
     {"/Gfp", "/Gfp                                             prefer flow control constructs"},
     {"/Gis", "/Gis                                             force IEE strictness"},
 
+    {"/Prune", "/Prune                                           drop programs no pass uses and parameters no program binds when compiling"},
+    {"/Zsc", "/Zsc                                             sort the render states of every pass and drop repeated ones when compiling"},
+    {"/Extended", "/Extended                                        write the extended .fxc format when compiling, for effects past the classic format's 255 entry\n"
+                  "                                                     and 64 KiB shader limits. the game can't read it, fxdc reads both"},
+
     {"/D",  "/D<name> <definition>                             define a macro"},
+
+    {"/Quiet", "/Quiet                                           only print warnings and errors"},
+    {"/Json", "/Json <file>                                     also write every message to a file as json lines, with the file, line and column of compiler errors split out"},
+
+    {"/Backend", "/Backend <d3dx, replay or record>                select the shader compiler. replay serves results recorded with record and runs without d3dx"},
+    {"/Cache", "/Cache <folder>                                  folder the replay and record backends keep compiler results in"},
+
+    {"/Index", "/Index <folder> <index_file>                      index the parameters, semantics, techniques, render states and program registers of every .fxc in a folder"},
+    {"/Query", "/Query <index_file> <type> <value>                look up effects in an index. type is name, semantic or technique with a name,\n"
+               "                                                     state with <state>=<value> or vs/ps with <parameter>=<register>"},
+    {"/Pack", "/Pack <folder> <archive_file>                    pack every .fxc in a folder into one archive the tools can map and look effects up in"},
+    {"/Dedupe", "/Dedupe                                          store program bytecode that's the same in several effects once when packing"},
+    {"/Unpack", "/Unpack <archive_file> <out_folder>              write every effect in an archive back to a folder"},
+    {"/Diff", "/Diff <a.fxc or folder> <b.fxc or folder>         print what changed between two builds of an effect or of a whole folder of them"},
+    {"/Stats", "/Stats <in_file or folder> <report_file>        write instruction and register counts per program and pass as csv, or as json if the report ends in .json"},
+    {"/StateBlocks", "/StateBlocks <in_file or folder>                 report how many passes share the same render states, within an effect and across all of them"},
+    {"/Watch", "/Watch <folder> <out_folder>                     compile every .fx in a folder whenever it or a file it includes is saved"},
+    {"/Server", "/Server <socket>                                 serve jobs sent with /Client on a unix domain socket, keeping the compiler and its results warm between them"},
+    {"/Client", "/Client <socket> <options>                       run the rest of the command line on the compile server listening on the socket"},
+    {"/Verify", "/Verify <in_file or folder>                      unpack and repack every .fxc in memory and report anything that doesn't come back identical"},
+    {"/Generate", "/Generate <out_folder> <settings>                write a seeded corpus of synthetic effects and compile it, recording the compiler results for replay.\n"
+                  "                                                     settings are comma separated name=value pairs out of seed, effects, globals, shared, annotations,\n"
+                  "                                                     samplers, samplerstates, techniques, passes, renderstates, functions, asm, includes and arraysize"},
 };
 
+//nonzero when an effect failed to compile or unpack or /Verify found one that didn't survive the round trip
+int32_t gExitCode = 0;
+
 //returns whether it should quit
 bool ProcessArguments(std::span<CString> args);
-bool ProcessEffect(std::filesystem::path fileIn, std::filesystem::path fileOut, DWORD shaderFlags, const D3DXMACRO* macros);
+int32_t RunServerJob(std::span<CString> args);
+bool ProcessEffect(std::filesystem::path fileIn, std::filesystem::path fileOut, uint32_t shaderFlags, const ShaderMacro* macros, bool prune, bool canonicalize,
+                   eEffectFormat::Enum format);
 
 int main(int32_t argc, char** argv)
 {
     if(argc == 1)
     {
-        #ifdef _DEBUG
+        #if defined(_DEBUG) && defined(_WIN32)
             char input[256] {0};
             wchar_t inputW[256] {0};
             DWORD bytesRead = 0;
@@ -98,7 +142,7 @@ int main(int32_t argc, char** argv)
         ProcessArguments(args);
     }
 
-    return 0;
+    return gExitCode;
 }
 
 void PrintHelp()
@@ -111,7 +155,7 @@ void PrintHelp()
 
         printf("   %s    %s", option.Name.Get(), option.Description.Get());
 
-        if(option.Name == "/Out" || option.Name == "/Zpc" || option.Name == "/Gis")
+        if(option.Name == "/Out" || option.Name == "/Zpc" || option.Name == "/Gis" || option.Name == "/Extended" || option.Name == "/D" || option.Name == "/Json" || option.Name == "/Cache")
             printf("\n\n");
         else
             printf("\n");
@@ -122,8 +166,34 @@ bool ProcessArguments(std::span<CString> args)
 {
     CString inFile;
     CString outFile;
-    DWORD shaderFlags = 0;
-    std::vector<D3DXMACRO> macros;
+    CString backendName;
+    CString cacheFolder;
+    CString indexFolder;
+    CString indexFile;
+    CString queryType;
+    CString queryValue;
+    CString verifyPath;
+    CString diffA;
+    CString statsPath;
+    CString statsReport;
+    CString diffB;
+    CString stateBlocksPath;
+    CString serverSocket;
+    CString watchFolder;
+    CString watchOutFolder;
+    CString jsonFile;
+    CString generateFolder;
+    CString generateSettings;
+    CString packFolder;
+    CString archiveFile;
+    CString unpackFolder;
+    bool dedupe = false;
+    bool quiet = false;
+    uint32_t shaderFlags = 0;
+    bool prune = false;
+    bool canonicalize = false;
+    eEffectFormat::Enum format = eEffectFormat::CLASSIC;
+    std::vector<ShaderMacro> macros;
     for(size_t i = 0; i < args.size(); i++)
     {
         const CString& arg = args[i];
@@ -159,7 +229,7 @@ bool ProcessArguments(std::span<CString> args)
                 }
                 else if(arg == "/D")
                 {
-                    D3DXMACRO macro;
+                    ShaderMacro macro;
                     if(i + 1 < args.size())
                     {
                         macro.Name = args[++i].Get();
@@ -183,37 +253,262 @@ bool ProcessArguments(std::span<CString> args)
                         return false;
                     }
                 }
+                else if(arg == "/Backend")
+                {
+                    if(i + 1 < args.size())
+                    {
+                        backendName = args[++i];
+                    }
+                    else
+                    {
+                        Log::Error("expected a compiler backend");
+                        PrintHelp();
+                        return false;
+                    }
+                }
+                else if(arg == "/Cache")
+                {
+                    if(i + 1 < args.size())
+                    {
+                        cacheFolder = args[++i];
+                    }
+                    else
+                    {
+                        Log::Error("expected a folder");
+                        PrintHelp();
+                        return false;
+                    }
+                }
+                else if(arg == "/Json")
+                {
+                    if(i + 1 < args.size())
+                    {
+                        jsonFile = args[++i];
+                    }
+                    else
+                    {
+                        Log::Error("expected a file");
+                        PrintHelp();
+                        return false;
+                    }
+                }
+                else if(arg == "/Quiet")
+                {
+                    quiet = true;
+                }
+                else if(arg == "/Index")
+                {
+                    if(i + 2 < args.size())
+                    {
+                        indexFolder = args[++i];
+                        indexFile = args[++i];
+                    }
+                    else
+                    {
+                        Log::Error("expected a folder and an index file");
+                        PrintHelp();
+                        return false;
+                    }
+                }
+                else if(arg == "/Query")
+                {
+                    if(i + 3 < args.size())
+                    {
+                        indexFile = args[++i];
+                        queryType = args[++i];
+                        queryValue = args[++i];
+                    }
+                    else
+                    {
+                        Log::Error("expected an index file, a query type and a value");
+                        PrintHelp();
+                        return false;
+                    }
+                }
+                else if(arg == "/Pack")
+                {
+                    if(i + 2 < args.size())
+                    {
+                        packFolder = args[++i];
+                        archiveFile = args[++i];
+                    }
+                    else
+                    {
+                        Log::Error("expected a folder and an archive file");
+                        PrintHelp();
+                        return false;
+                    }
+                }
+                else if(arg == "/Unpack")
+                {
+                    if(i + 2 < args.size())
+                    {
+                        archiveFile = args[++i];
+                        unpackFolder = args[++i];
+                    }
+                    else
+                    {
+                        Log::Error("expected an archive file and an output folder");
+                        PrintHelp();
+                        return false;
+                    }
+                }
+                else if(arg == "/Dedupe")
+                {
+                    dedupe = true;
+                }
+                else if(arg == "/Diff")
+                {
+                    if(i + 2 < args.size())
+                    {
+                        diffA = args[++i];
+                        diffB = args[++i];
+                    }
+                    else
+                    {
+                        Log::Error("expected two files or two folders");
+                        PrintHelp();
+                        return false;
+                    }
+                }
+                else if(arg == "/Stats")
+                {
+                    if(i + 2 < args.size())
+                    {
+                        statsPath = args[++i];
+                        statsReport = args[++i];
+                    }
+                    else
+                    {
+                        Log::Error("expected a file or a folder and a report file");
+                        PrintHelp();
+                        return false;
+                    }
+                }
+                else if(arg == "/Verify")
+                {
+                    if(i + 1 < args.size())
+                    {
+                        verifyPath = args[++i];
+                    }
+                    else
+                    {
+                        Log::Error("expected a file or a folder");
+                        PrintHelp();
+                        return false;
+                    }
+                }
+                else if(arg == "/StateBlocks")
+                {
+                    if(i + 1 < args.size())
+                    {
+                        stateBlocksPath = args[++i];
+                    }
+                    else
+                    {
+                        Log::Error("expected a file or a folder");
+                        PrintHelp();
+                        return false;
+                    }
+                }
+                else if(arg == "/Watch")
+                {
+                    if(i + 2 < args.size())
+                    {
+                        watchFolder = args[++i];
+                        watchOutFolder = args[++i];
+                    }
+                    else
+                    {
+                        Log::Error("expected a folder and an output folder");
+                        PrintHelp();
+                        return false;
+                    }
+                }
+                else if(arg == "/Generate")
+                {
+                    if(i + 2 < args.size())
+                    {
+                        generateFolder = args[++i];
+                        generateSettings = args[++i];
+                    }
+                    else
+                    {
+                        Log::Error("expected a folder and generator settings");
+                        PrintHelp();
+                        return false;
+                    }
+                }
+                else if(arg == "/Server")
+                {
+                    if(i + 1 < args.size())
+                    {
+                        serverSocket = args[++i];
+                    }
+                    else
+                    {
+                        Log::Error("expected a socket path");
+                        PrintHelp();
+                        return false;
+                    }
+                }
+                else if(arg == "/Client")
+                {
+                    if(i + 1 >= args.size())
+                    {
+                        Log::Error("expected a socket path");
+                        PrintHelp();
+                        return false;
+                    }
+
+                    //everything after the socket belongs to the job
+                    int32_t exitCode;
+                    gExitCode = CompileServer::Forward(args[i + 1].Get(), args.subspan(i + 2), exitCode) ? exitCode : 1;
+                    return false;
+                }
+                else if(arg == "/Prune")
+                {
+                    prune = true;
+                }
+                else if(arg == "/Zsc")
+                {
+                    canonicalize = true;
+                }
+                else if(arg == "/Extended")
+                {
+                    format = eEffectFormat::EXTENDED;
+                }
                 else if(arg == "/Od")
                 {
-                    shaderFlags |= D3DXSHADER_SKIPOPTIMIZATION;
+                    shaderFlags |= eShaderFlags::SKIP_OPTIMIZATION;
                 }
                 else if(arg == "/Zi")
                 {
-                    shaderFlags |= D3DXSHADER_DEBUG;
+                    shaderFlags |= eShaderFlags::DEBUG_INFO;
                 }
                 else if(arg == "/Zpr")
                 {
-                    shaderFlags |= D3DXSHADER_PACKMATRIX_ROWMAJOR;
+                    shaderFlags |= eShaderFlags::PACK_MATRIX_ROW_MAJOR;
                 }
                 else if(arg == "/Zpc")
                 {
-                    shaderFlags |= D3DXSHADER_PACKMATRIX_COLUMNMAJOR;
+                    shaderFlags |= eShaderFlags::PACK_MATRIX_COL_MAJOR;
                 }
                 else if(arg == "/Gpp")
                 {
-                    shaderFlags |= D3DXSHADER_PARTIALPRECISION;
+                    shaderFlags |= eShaderFlags::PARTIAL_PRECISION;
                 }
                 else if(arg == "/Gfa")
                 {
-                    shaderFlags |= D3DXSHADER_AVOID_FLOW_CONTROL;
+                    shaderFlags |= eShaderFlags::AVOID_FLOW_CONTROL;
                 }
                 else if(arg == "/Gfp")
                 {
-                    shaderFlags |= D3DXSHADER_PREFER_FLOW_CONTROL;
+                    shaderFlags |= eShaderFlags::PREFER_FLOW_CONTROL;
                 }
                 else if(arg == "/Gis")
                 {
-                    shaderFlags |= D3DXSHADER_IEEE_STRICTNESS;
+                    shaderFlags |= eShaderFlags::IEEE_STRICTNESS;
                 }
                 else
                 {
@@ -225,7 +520,82 @@ bool ProcessArguments(std::span<CString> args)
         }
     }
 
-    if(!inFile.Get() || !outFile.Get())
+    if(serverSocket.Get())
+    {
+        //RunServerJob resets them after every job
+        if(quiet || jsonFile.Get())
+            Log::Warn("/Quiet and /Json apply to the jobs sent to a server, not to the server itself");
+
+        EnableCompilerMemoryCache();
+        if(backendName.Get() && !SetCompilerBackend(backendName.Get(), cacheFolder.Get()))
+        {
+            PrintHelp();
+            return false;
+        }
+
+        if(!CompileServer::Run(serverSocket.Get(), RunServerJob))
+            gExitCode = 1;
+        return false;
+    }
+
+    Log::SetQuiet(quiet);
+    if(jsonFile.Get() && !Log::SetJsonFile(jsonFile.Get()))
+    {
+        Log::Error("unable to create \"%s\"", jsonFile.Get());
+        gExitCode = 1;
+        return false;
+    }
+
+    if(indexFolder.Get())
+    {
+        if(!EffectIndex::Build(indexFolder.Get(), indexFile.Get()))
+            gExitCode = 1;
+        return false;
+    }
+
+    if(queryType.Get())
+    {
+        if(!EffectIndex::Query(indexFile.Get(), queryType.Get(), queryValue.Get()))
+            gExitCode = 1;
+        return false;
+    }
+
+    if(packFolder.Get())
+    {
+        if(!EffectArchive::Pack(packFolder.Get(), archiveFile.Get(), dedupe))
+            gExitCode = 1;
+        return false;
+    }
+
+    if(unpackFolder.Get())
+    {
+        if(!EffectArchive::Unpack(archiveFile.Get(), unpackFolder.Get()))
+            gExitCode = 1;
+        return false;
+    }
+
+    if(diffA.Get())
+    {
+        if(!EffectDiff::Diff(diffA.Get(), diffB.Get()))
+            gExitCode = 1;
+        return false;
+    }
+
+    if(statsPath.Get())
+    {
+        if(!EffectStats::Report(statsPath.Get(), statsReport.Get()))
+            gExitCode = 1;
+        return false;
+    }
+
+    if(stateBlocksPath.Get())
+    {
+        if(!RenderStatePool::Report(stateBlocksPath.Get()))
+            gExitCode = 1;
+        return false;
+    }
+
+    if(!verifyPath.Get() && !watchFolder.Get() && !generateFolder.Get() && (!inFile.Get() || !outFile.Get()))
     {
         Log::Error("no files specified");
         PrintHelp();
@@ -233,13 +603,84 @@ bool ProcessArguments(std::span<CString> args)
     }
 
     //last one has to be null
-    macros.emplace_back(nullptr, nullptr);
+    macros.push_back({nullptr, nullptr});
+
+    if(generateFolder.Get())
+    {
+        //the generator brings its own backend
+        if(backendName.Get())
+            Log::Warn("/Backend is ignored by /Generate, the compiler results are recorded to the cache folder inside \"%s\"", generateFolder.Get());
+
+        EffectGenerator::Settings settings;
+        if(!EffectGenerator::ParseSettings(generateSettings.Get(), settings))
+        {
+            gExitCode = 1;
+            return false;
+        }
+
+        auto compile = [&](const std::filesystem::path& fileIn, const std::filesystem::path& fileOut)
+        {
+            return ProcessEffect(fileIn, fileOut, shaderFlags, macros.data(), prune, canonicalize, format);
+        };
+
+        if(!EffectGenerator::Generate(generateFolder.Get(), settings, compile))
+            gExitCode = 1;
+        return false;
+    }
+
+    if(backendName.Get() && !SetCompilerBackend(backendName.Get(), cacheFolder.Get()))
+    {
+        PrintHelp();
+        return false;
+    }
+
+    if(verifyPath.Get())
+    {
+        if(!EffectVerifier::Verify(verifyPath.Get(), shaderFlags))
+            gExitCode = 1;
+        return false;
+    }
 
-    ProcessEffect(inFile.Get(), outFile.Get(), shaderFlags, macros.data());
+    if(watchFolder.Get())
+    {
+        auto compile = [&](const std::filesystem::path& fileIn, const std::filesystem::path& fileOut)
+        {
+            return ProcessEffect(fileIn, fileOut, shaderFlags, macros.data(), prune, canonicalize, format);
+        };
+
+        if(!EffectWatcher::Watch(watchFolder.Get(), watchOutFolder.Get(), compile))
+            gExitCode = 1;
+        return false;
+    }
+
+    if(!ProcessEffect(inFile.Get(), outFile.Get(), shaderFlags, macros.data(), prune, canonicalize, format))
+        gExitCode = 1;
     return false;
 }
 
-bool ProcessEffect(std::filesystem::path fileIn, std::filesystem::path fileOut, DWORD shaderFlags, const D3DXMACRO* macros)
+//the exit code is reset for every job the compile server runs
+int32_t RunServerJob(std::span<CString> args)
+{
+    for(const CString& arg : args)
+    {
+        if(arg == "/Server" || arg == "/Client" || arg == "/Watch" || arg == "/Generate")
+        {
+            Log::Error("%s can't be sent to a compile server", arg.Get());
+            return 1;
+        }
+    }
+
+    gExitCode = 0;
+    ProcessArguments(args);
+
+    //a job's /Quiet and /Json only last as long as the job
+    Log::SetQuiet(false);
+    Log::SetJsonFile(nullptr);
+    return gExitCode;
+}
+
+bool ProcessEffect(std::filesystem::path fileIn, std::filesystem::path fileOut, uint32_t shaderFlags, const ShaderMacro* macros, bool prune, bool canonicalize,
+                   eEffectFormat::Enum format)
 {
     auto t1 = std::chrono::high_resolution_clock::now();
 
@@ -254,6 +695,8 @@ bool ProcessEffect(std::filesystem::path fileIn, std::filesystem::path fileOut,
         if(file.Open())
         {
             Effect effect(file);
+            if(effect.GetLoadError() != eEffectLoadError::NONE)
+                return false;
 
             fileOut.replace_extension(".fx");
             if(effect.SaveToFx(fileOut))
@@ -261,7 +704,7 @@ bool ProcessEffect(std::filesystem::path fileIn, std::filesystem::path fileOut,
                 auto t2 = std::chrono::high_resolution_clock::now();
                 auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1);
                 Log::Info("successfully unpacked effect \"%s\" (took %lldms)", fileOut.string().c_str(), ms.count());
-                return false;
+                return true;
             }
             else
             {
@@ -271,34 +714,39 @@ bool ProcessEffect(std::filesystem::path fileIn, std::filesystem::path fileOut,
     }
     else if(fileIn.extension() == ".fx")
     {
-        std::ifstream file(fileIn, std::ios::ate);
-        if(!file.good() || !file.is_open())
+        CString cFileName = fileIn.string().c_str();
+        CString source;
+        CString messages;
+        if(!GetCompilerBackend().Preprocess(cFileName.Get(), macros, source, messages))
         {
-            Log::Error("unable to open file \"%s\"", fileIn.string().c_str());
+            if(messages.Length())
+                Log::Error("%s", messages.Get());
+            else
+                Log::Error("unable to preprocess file \"%s\"", cFileName.Get());
             return false;
         }
 
-        CString cFileName = fileIn.string().c_str();
-        size_t fileSize = (size_t)file.tellg();
-        CString source(fileSize);
-        file.seekg(0);
-        file.read(source.Get(), fileSize);
-
         M4::Allocator allocator;
-        M4::HLSLParser parser(&allocator, cFileName.Get(), source.Get(), fileSize, macros);
+        M4::HLSLParser parser(&allocator, cFileName.Get(), source.Get(), source.Length());
         M4::HLSLTree tree(&allocator);
         if(!parser.Parse(&tree))
         {
+            //report the broken parameters after the error in the same run
+            Effect recovered;
+            recovered.LoadParametersFromFx(parser);
             return false;
         }
-        
-        LoadLibrary(L"D3DCompiler_43.dll");
 
         Effect effect;
-        if(!effect.LoadFromFx(parser, shaderFlags, macros))
+        if(!effect.LoadFromFx(parser, shaderFlags))
             return false;
 
-        if(effect.Save(fileOut.replace_extension(".fxc")))
+        if(prune)
+            effect.Prune();
+        if(canonicalize)
+            effect.CanonicalizeRenderStates();
+
+        if(effect.Save(fileOut.replace_extension(".fxc"), format))
         {
             auto t2 = std::chrono::high_resolution_clock::now();
             auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1);
@@ -1,6 +1,7 @@
 #pragma once
 #include "Utils.h"
 #include <cstdint>
+#include <cstring>
 #include <cassert>
 
 namespace rage
@@ -165,5 +166,5 @@ namespace rage
         CounterT mCount;
         CounterT mCapacity;
     };
-    ASSERT_SIZE(atArray<uint32_t>, 0x8);
+    ASSERT_SIZE(atArray<uint32_t>, (sizeof(void*) == 4 ? 0x8 : 0x10));
 }
\ No newline at end of file
@@ -0,0 +1,125 @@
+#include "Test.h"
+#include "BakedEffect.h"
+
+#include <cstring>
+
+static bool InBlock(const BakedEffect& baked, const BakedEffect::Range& range, size_t stride)
+{
+    return (uint64_t)range.Offset + (uint64_t)range.Count * stride <= baked.GetSize();
+}
+
+static bool IsString(const BakedEffect& baked, uint32_t offset)
+{
+    return offset == 0 || (offset < baked.GetSize() && memchr(baked.GetData() + offset, '\0', baked.GetSize() - offset));
+}
+
+TEST(baked, layout_stays_inside_the_block)
+{
+    Effect effect;
+    CHECK(Test::CompileFx(Test::SAMPLE_EFFECT, effect));
+    BakedEffect baked;
+    CHECK(baked.Bake(effect));
+
+    const BakedEffect::Header& header = *(const BakedEffect::Header*)baked.GetData();
+    CHECK(header.Magic == BakedEffect::MAGIC);
+    CHECK(header.Size == baked.GetSize());
+    CHECK(InBlock(baked, header.VertexPrograms, sizeof(BakedEffect::ProgramRecord)));
+    CHECK(InBlock(baked, header.PixelPrograms, sizeof(BakedEffect::ProgramRecord)));
+    CHECK(InBlock(baked, header.GlobalParameters, sizeof(BakedEffect::ParameterRecord)));
+    CHECK(InBlock(baked, header.Parameters, sizeof(BakedEffect::ParameterRecord)));
+    CHECK(InBlock(baked, header.Techniques, sizeof(BakedEffect::TechniqueRecord)));
+    CHECK(InBlock(baked, header.RenderStateBlocks, sizeof(BakedEffect::Range)));
+
+    for(uint32_t i = 0; i < baked.GetParameterCount(); i++)
+    {
+        const BakedEffect::ParameterRecord& record = baked.GetParameterAt(i);
+        CHECK(IsString(baked, record.Name) && IsString(baked, record.Semantic));
+        CHECK(record.Value % 16 == 0 && record.Value + record.ValueSize <= baked.GetSize());
+        CHECK(InBlock(baked, {record.Annotations, record.AnnotationCount}, sizeof(BakedEffect::AnnotationRecord)));
+    }
+
+    for(uint32_t i = 0; i < baked.GetVertexProgramCount(); i++)
+    {
+        const BakedEffect::ProgramRecord& record = baked.GetVertexProgramAt(i);
+        CHECK(record.Bytecode % 4 == 0 && record.Bytecode + record.BytecodeSize <= baked.GetSize());
+        CHECK(InBlock(baked, record.Params, sizeof(BakedEffect::ProgramParamRecord)));
+    }
+}
+
+TEST(baked, records_match_the_effect)
+{
+    Effect effect;
+    CHECK(Test::CompileFx(Test::SAMPLE_EFFECT, effect));
+    BakedEffect baked;
+    CHECK(baked.Bake(effect));
+
+    CHECK(baked.GetParameterCount() == effect.GetParameterCount());
+    CHECK(baked.GetGlobalParameterCount() == effect.GetGlobalParameterCount());
+    CHECK(baked.GetTechniqueCount() == effect.GetTechniqueCount());
+    CHECK(baked.GetVertexProgramCount() == effect.GetVertexProgramCount());
+    CHECK(baked.GetPixelProgramCount() == effect.GetPixelProgramCount());
+
+    for(uint32_t i = 0; i < baked.GetParameterCount(); i++)
+    {
+        const BakedEffect::ParameterRecord& record = baked.GetParameterAt(i);
+        const Parameter& param = *effect.GetParameterAt(i);
+        CHECK(strcmp(baked.GetString(record.Name), param.GetName()) == 0);
+        CHECK(record.NameHash == param.GetNameHash() && record.Type == param.GetType() && record.Count == param.GetCount());
+        CHECK(baked.FindParameterByHash(param.GetNameHash()) == &record);
+    }
+
+    for(uint32_t i = 0; i < baked.GetPixelProgramCount(); i++)
+    {
+        const BakedEffect::ProgramRecord& record = baked.GetPixelProgramAt(i);
+        const ShaderBytecode& bytecode = effect.GetPixelProgramAt(i)->mShaderData;
+        CHECK(record.BytecodeSize == bytecode.GetCapacity());
+        CHECK(!record.BytecodeSize || memcmp(baked.GetBlob(record.Bytecode), &bytecode[0], record.BytecodeSize) == 0);
+    }
+
+    const BakedEffect::ParameterRecord* shared = baked.FindGlobalParameterByHash(effect.FindGlobalParameterByName("gTime")->GetNameHash());
+    CHECK(shared && strcmp(baked.GetString(shared->Name), "gTime") == 0);
+
+    const BakedEffect::ParameterRecord* color = baked.FindParameterByHash(effect.FindParameterByName("gColor")->GetNameHash());
+    CHECK(color && strcmp(baked.GetString(color->Semantic), "Color") == 0);
+    if(color)
+    {
+        static const float expected[] = {1.0f, 0.5f, 0.25f, 1.0f};
+        CHECK(color->ValueSize == sizeof(expected) && memcmp(baked.GetBlob(color->Value), expected, sizeof(expected)) == 0);
+
+        CHECK(color->AnnotationCount == 3);
+        const BakedEffect::AnnotationRecord& name = baked.GetRecord<BakedEffect::AnnotationRecord>({color->Annotations, color->AnnotationCount}, 0);
+        CHECK(strcmp(baked.GetString(name.Name), "UIName") == 0);
+        CHECK(name.Type == eAnnotationType::STRING && strcmp(baked.GetString(name.Value), "Color") == 0);
+        const BakedEffect::AnnotationRecord& step = baked.GetRecord<BakedEffect::AnnotationRecord>({color->Annotations, color->AnnotationCount}, 2);
+        CHECK(step.Type == eAnnotationType::INT && step.Value == 2);
+    }
+}
+
+//the first passes of both techniques set the same states in a different order
+TEST(baked, passes_with_the_same_states_share_a_block)
+{
+    Effect effect;
+    CHECK(Test::CompileFx(Test::SAMPLE_EFFECT, effect));
+    BakedEffect baked;
+    CHECK(baked.Bake(effect));
+
+    CHECK(baked.GetTechniqueCount() == 2);
+    if(baked.GetTechniqueCount() != 2)
+        return;
+
+    const BakedEffect::TechniqueRecord& opaque = baked.GetTechniqueAt(0);
+    const BakedEffect::TechniqueRecord& blended = baked.GetTechniqueAt(1);
+    CHECK(strcmp(baked.GetString(blended.Name), "Blended") == 0 && blended.Passes.Count == 2);
+
+    const BakedEffect::PassRecord& opaquePass = baked.GetRecord<BakedEffect::PassRecord>(opaque.Passes, 0);
+    const BakedEffect::PassRecord& blendedPass = baked.GetRecord<BakedEffect::PassRecord>(blended.Passes, 0);
+    const BakedEffect::PassRecord& alphaPass = baked.GetRecord<BakedEffect::PassRecord>(blended.Passes, 1);
+    CHECK(opaquePass.RenderStateBlock == blendedPass.RenderStateBlock);
+    CHECK(opaquePass.RenderStates.Offset == blendedPass.RenderStates.Offset && opaquePass.RenderStates.Count == 2);
+    CHECK(alphaPass.RenderStateBlock != opaquePass.RenderStateBlock && alphaPass.RenderStates.Count == 3);
+    CHECK(baked.GetRenderStateBlockCount() == 2);
+
+    //canonical order, sorted by state
+    const RenderState* states = (const RenderState*)baked.GetBlob(opaquePass.RenderStates.Offset);
+    CHECK(states && states[0].State < states[1].State);
+}
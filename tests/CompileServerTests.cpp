@@ -0,0 +1,165 @@
+#include "Test.h"
+#include "CompileServer.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <afunix.h>
+
+using Socket = SOCKET;
+#define CLOSE_SOCKET closesocket
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using Socket = int;
+#define CLOSE_SOCKET close
+#endif
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+static constexpr uint32_t PROTOCOL_MAGIC = (uint32_t)'fxds';
+
+//what the last job saw
+static std::mutex sJobMutex;
+static std::vector<std::string> sJobArgs;
+static std::filesystem::path sJobFolder;
+
+//records its arguments and folder, then wanders off to another folder the server has to come back from
+static int32_t RecordJob(std::span<CString> args)
+{
+    std::lock_guard lock(sJobMutex);
+    sJobArgs.clear();
+    for(const CString& arg : args)
+        sJobArgs.push_back(arg.Get());
+    sJobFolder = std::filesystem::current_path();
+    std::filesystem::current_path(std::filesystem::temp_directory_path());
+    return (int32_t)args.size();
+}
+
+//one server for the whole group, it serves until the process exits
+static std::string GetServerSocket()
+{
+    static std::string sSocketPath;
+    if(!sSocketPath.empty())
+        return sSocketPath;
+
+    sSocketPath = Test::GetTempFolder() + "/server.sock";
+    std::thread([]() { CompileServer::Run(sSocketPath.c_str(), RecordJob); }).detach();
+
+    for(int i = 0; i < 500 && !std::filesystem::exists(sSocketPath); i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    return sSocketPath;
+}
+
+static Socket Connect(const std::string& socketPath)
+{
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socketPath.c_str());
+
+    Socket client = socket(AF_UNIX, SOCK_STREAM, 0);
+    connect(client, (const sockaddr*)&address, sizeof(address));
+    return client;
+}
+
+//true once the server has closed the connection without answering
+static bool IsDropped(Socket client)
+{
+    char byte;
+    return recv(client, &byte, 1, 0) <= 0;
+}
+
+static bool Forward(std::vector<const char*> args, int32_t& exitCode)
+{
+    std::vector<CString> strings;
+    for(const char* arg : args)
+        strings.emplace_back(arg);
+    return CompileServer::Forward(GetServerSocket().c_str(), strings, exitCode);
+}
+
+TEST(server, runs_jobs_in_the_client_folder)
+{
+    std::filesystem::path testFolder = std::filesystem::current_path();
+    std::filesystem::path clientFolder = std::filesystem::path(Test::GetTempFolder()) / "client";
+    std::filesystem::create_directories(clientFolder);
+    std::filesystem::current_path(clientFolder);
+
+    int32_t exitCode = 0;
+    CHECK(Forward({"/Unpack", "a b.fxc", ""}, exitCode));
+    CHECK(exitCode == 3);
+    {
+        std::lock_guard lock(sJobMutex);
+        CHECK(sJobArgs == std::vector<std::string>({"/Unpack", "a b.fxc", ""}));
+        CHECK(std::filesystem::equivalent(sJobFolder, clientFolder));
+    }
+
+    //the job left for another folder, the server went back to its own
+    CHECK(std::filesystem::equivalent(std::filesystem::current_path(), clientFolder));
+    std::filesystem::current_path(testFolder);
+}
+
+TEST(server, drops_malformed_requests)
+{
+    std::string socketPath = GetServerSocket();
+
+    Socket badMagic = Connect(socketPath);
+    uint32_t header[2] = {PROTOCOL_MAGIC + 1, 1};
+    send(badMagic, (const char*)header, sizeof(header), 0);
+    CHECK(IsDropped(badMagic));
+    CLOSE_SOCKET(badMagic);
+
+    Socket tooManyStrings = Connect(socketPath);
+    header[0] = PROTOCOL_MAGIC;
+    header[1] = 4097;
+    send(tooManyStrings, (const char*)header, sizeof(header), 0);
+    CHECK(IsDropped(tooManyStrings));
+    CLOSE_SOCKET(tooManyStrings);
+
+    Socket tooLong = Connect(socketPath);
+    uint32_t request[3] = {PROTOCOL_MAGIC, 1, (64 << 20) + 1};
+    send(tooLong, (const char*)request, sizeof(request), 0);
+    CHECK(IsDropped(tooLong));
+    CLOSE_SOCKET(tooLong);
+
+    int32_t exitCode = 0;
+    CHECK(Forward({"/Help"}, exitCode) && exitCode == 1);
+}
+
+TEST(server, a_stalled_client_holds_up_nobody)
+{
+    std::string socketPath = GetServerSocket();
+
+    //half a header and then nothing
+    Socket stalled = Connect(socketPath);
+    uint32_t magic = PROTOCOL_MAGIC;
+    send(stalled, (const char*)&magic, sizeof(magic), 0);
+
+    auto t1 = std::chrono::steady_clock::now();
+    int32_t exitCode = 0;
+    CHECK(Forward({"/Help"}, exitCode) && exitCode == 1);
+    CHECK(std::chrono::steady_clock::now() - t1 < std::chrono::seconds(10));
+
+    CLOSE_SOCKET(stalled);
+}
+
+TEST(server, leaves_files_that_arent_sockets_alone)
+{
+    std::string path = Test::GetTempFolder() + "/not_a_socket";
+    {
+        std::ofstream file(path);
+        file << "keep me";
+    }
+
+    Log::Capture capture;
+    CHECK(!CompileServer::Run(path.c_str(), RecordJob));
+    CHECK(capture.GetText().find("isn't a socket") != std::string::npos);
+    CHECK(std::filesystem::is_regular_file(path));
+}
@@ -0,0 +1,149 @@
+#include "Test.h"
+#include "CompilerBackend.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+//answers every preprocess with where it was asked for, so a replay shows which recording it served
+class RecordingBackend : public CompilerBackend
+{
+public:
+    const char* GetName() const override
+    {
+        return "test recorder";
+    }
+
+    bool Preprocess(const char* filePath, const ShaderMacro* macros, CString& source, CString& messages) override
+    {
+        source = CString("recorded ", filePath);
+        return true;
+    }
+
+    bool PreprocessSource(const char* fileName, const char* data, size_t length, const ShaderMacro* macros, ShaderIncludeHandler* includes,
+                          CString& source, CString& messages) override
+    {
+        source = CString("recorded ", fileName);
+        return true;
+    }
+
+    bool Compile(const char* source, size_t length, const char* entryPoint, const char* profile, uint32_t flags, ShaderBytecode& bytecode, CString& messages) override
+    {
+        return false;
+    }
+
+    bool Assemble(const char* source, size_t length, ShaderBytecode& bytecode, CString& messages) override
+    {
+        return false;
+    }
+
+    bool Disassemble(const ShaderBytecode& bytecode, CString& disassembly) override
+    {
+        return false;
+    }
+};
+
+static void WriteFile(const std::filesystem::path& path, const char* text)
+{
+    std::filesystem::create_directories(path.parent_path());
+    std::ofstream file(path, std::ios::binary);
+    file << text;
+}
+
+static bool Preprocess(const std::filesystem::path& path, CString& source)
+{
+    Log::Capture capture;
+    static const ShaderMacro sMacros[] = {{"FOO", "1"}, {nullptr, nullptr}};
+    CString messages;
+    return GetCompilerBackend().Preprocess(path.string().c_str(), sMacros, source, messages);
+}
+
+TEST(backend, replay_keys_files_relative_to_the_cache)
+{
+    std::filesystem::path folder = std::filesystem::path(Test::GetTempFolder()) / "replay";
+    std::filesystem::path recorded = folder / "recorded";
+    WriteFile(recorded / "shaders" / "a.fx", "float gA;");
+
+    CString source;
+    SetRecordingCompilerBackend(std::make_unique<RecordingBackend>(), (recorded / "cache").string().c_str());
+    CHECK(Preprocess(recorded / "shaders" / "a.fx", source));
+    CString expected = source;
+
+    //the whole tree moves, cache included, and the file is spelled differently
+    std::filesystem::path moved = folder / "moved";
+    std::filesystem::copy(recorded, moved, std::filesystem::copy_options::recursive);
+    CHECK(SetCompilerBackend("replay", (moved / "cache/").string().c_str()));
+
+    source = CString();
+    CHECK(Preprocess(moved / "." / "shaders" / ".." / "shaders" / "a.fx", source));
+    CHECK(source.Get() && strcmp(source.Get(), expected.Get()) == 0);
+
+    //the contents are still part of the key
+    WriteFile(moved / "shaders" / "a.fx", "float gB;");
+    CHECK(!Preprocess(moved / "shaders" / "a.fx", source));
+
+    Test::ResetCompilerBackend();
+}
+
+TEST(backend, replay_keys_source_names_without_separators_or_case)
+{
+    std::filesystem::path cache = std::filesystem::path(Test::GetTempFolder()) / "replay_source" / "cache";
+    static const ShaderMacro sNoMacros[] = {{nullptr, nullptr}};
+    const char* data = "float gA;";
+    CString source;
+    CString messages;
+
+    SetRecordingCompilerBackend(std::make_unique<RecordingBackend>(), cache.string().c_str());
+    CHECK(GetCompilerBackend().PreprocessSource("Shaders\\Water.fx", data, strlen(data), sNoMacros, nullptr, source, messages));
+
+    CHECK(SetCompilerBackend("replay", cache.string().c_str()));
+    source = CString();
+    CHECK(GetCompilerBackend().PreprocessSource("shaders/water.fx", data, strlen(data), sNoMacros, nullptr, source, messages));
+    CHECK(source.Get() && strcmp(source.Get(), "recorded Shaders\\Water.fx") == 0);
+
+    Test::ResetCompilerBackend();
+}
+
+//jobs recording the same calls at once each write a whole entry and rename it into place
+TEST(backend, record_never_leaves_partial_entries)
+{
+    std::filesystem::path cache = std::filesystem::path(Test::GetTempFolder()) / "record_parallel" / "cache";
+    static const ShaderMacro sNoMacros[] = {{nullptr, nullptr}};
+    SetRecordingCompilerBackend(std::make_unique<RecordingBackend>(), cache.string().c_str());
+
+    std::vector<std::thread> threads;
+    for(int i = 0; i < 8; i++)
+    {
+        threads.emplace_back([&]()
+        {
+            for(int j = 0; j < 32; j++)
+            {
+                std::string name = "shader" + std::to_string(j) + ".fx";
+                CString source;
+                CString messages;
+                GetCompilerBackend().PreprocessSource(name.c_str(), "float gA;", 9, sNoMacros, nullptr, source, messages);
+            }
+        });
+    }
+    for(std::thread& thread : threads)
+        thread.join();
+
+    uint32_t entryCount = 0;
+    for(const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(cache))
+    {
+        CHECK(entry.path().extension() == ".fxr");
+        entryCount++;
+    }
+    CHECK(entryCount == 32);
+
+    CHECK(SetCompilerBackend("replay", cache.string().c_str()));
+    CString source;
+    CString messages;
+    CHECK(GetCompilerBackend().PreprocessSource("shader31.fx", "float gA;", 9, sNoMacros, nullptr, source, messages));
+    CHECK(source.Get() && strcmp(source.Get(), "recorded shader31.fx") == 0);
+
+    Test::ResetCompilerBackend();
+}
@@ -0,0 +1,102 @@
+#include "Test.h"
+#include "BakedEffect.h"
+
+#include <cstring>
+#include <string>
+
+static const char* const TECHNIQUE = "VertexShader gVS = NULL;\n"
+                                     "PixelShader gPS = NULL;\n"
+                                     "technique t { pass p { VertexShader = gVS; PixelShader = gPS; } }\n";
+
+//the value of a parameter in register layout
+static std::vector<float> GetValue(const Effect& effect, const char* name)
+{
+    const Parameter* param = effect.FindParameterByName(name);
+    BakedEffect baked;
+    if(!param || !baked.Bake(effect))
+        return {};
+
+    const BakedEffect::ParameterRecord* record = baked.FindParameterByHash(param->GetNameHash());
+    if(!record)
+        return {};
+
+    const float* value = (const float*)baked.GetBlob(record->Value);
+    return std::vector<float>(value, value + record->ValueSize / sizeof(float));
+}
+
+//compiles source, which is expected to fail, and returns what was logged
+static std::string GetErrors(const std::string& source)
+{
+    Effect effect;
+    std::string messages;
+    CHECK(!Test::CompileFx((source + TECHNIQUE).c_str(), effect, &messages));
+    return messages;
+}
+
+TEST(fold, folds_expressions)
+{
+    std::string source = "static const float kScale = 2;\n"
+                         "static const float kTable[3] = {1, 2, 3};\n"
+                         "float4 gArithmetic = float4(kScale, kScale * 3, 1 / 4.0, -kScale);\n"
+                         "float gIndexed = kTable[2] + kTable[0];\n"
+                         "float3 gSwizzled = float4(1, 2, 3, 4).zyx;\n"
+                         "float gChosen = 3 > 2 ? 5 : 6;\n"
+                         "float gIntegerDivision = 7 / 2;\n"
+                         "float3 gSplat = 2;\n"
+                         "float2 gList[2] = {1, 2, 3, 4};\n"
+                         "int gTruncated = 2.75;\n"
+                         "bool gBool = 3;\n";
+    source += TECHNIQUE;
+
+    Effect effect;
+    std::string messages;
+    CHECK(Test::CompileFx(source.c_str(), effect, &messages));
+    CHECK(messages.empty());
+
+    CHECK(GetValue(effect, "gArithmetic") == std::vector<float>({2.0f, 6.0f, 0.25f, -2.0f}));
+    CHECK(GetValue(effect, "gIndexed") == std::vector<float>({4.0f, 0.0f, 0.0f, 0.0f}));
+    CHECK(GetValue(effect, "gSwizzled") == std::vector<float>({3.0f, 2.0f, 1.0f, 0.0f}));
+    CHECK(GetValue(effect, "gChosen") == std::vector<float>({5.0f, 0.0f, 0.0f, 0.0f}));
+    CHECK(GetValue(effect, "gIntegerDivision") == std::vector<float>({3.0f, 0.0f, 0.0f, 0.0f}));
+    CHECK(GetValue(effect, "gSplat") == std::vector<float>({2.0f, 2.0f, 2.0f, 0.0f}));
+    CHECK(GetValue(effect, "gList") == std::vector<float>({1.0f, 2.0f, 0.0f, 0.0f, 3.0f, 4.0f, 0.0f, 0.0f}));
+    CHECK(GetValue(effect, "gTruncated") == std::vector<float>({2.0f, 0.0f, 0.0f, 0.0f}));
+    CHECK(GetValue(effect, "gBool") == std::vector<float>({1.0f, 0.0f, 0.0f, 0.0f}));
+}
+
+//every error names the line of the expression that couldn't be folded
+TEST(fold, reports_the_failing_line)
+{
+    struct ErrorCase
+    {
+        const char* Source;
+        const char* Error;
+    };
+
+    static const ErrorCase cases[]
+    {
+        {"float gOther;\n"
+         "float gBad = gOther;\n", "test.fx(2) : \"gOther\" isn't a constant"},
+        {"float gBad =\n"
+         "    sin(1.0);\n", "test.fx(2) : call to \"sin\" isn't a constant expression"},
+        {"float4 gBad[2] = {float4(1, 2, 3, 4),\n"
+         "                  1, 2, 3};\n", "test.fx(1) : initializer has 7 values, 8 expected"},
+        {"float2 gBad[2] = {1, 2, 3,\n"
+         "                  4, 5};\n", "test.fx(2) : too many values, 4 expected"},
+        {"\n"
+         "float gBad = 1 / 0;\n", "test.fx(2) : division by zero"},
+        {"float4 gBad = float4(1, 2,\n"
+         "                     3);\n", "test.fx(1) : constructor takes 4 values, got 3"},
+        {"static const float kTable[2] = {1, 2};\n"
+         "float gBad = kTable[2];\n", "test.fx(2) : index 2 is out of the bounds of \"kTable\""},
+        {"float3 gBad = float2(1, 2);\n", "test.fx(1) : a value with 2 components can't initialize \"gBad\""},
+    };
+
+    for(const ErrorCase& errorCase : cases)
+    {
+        std::string errors = GetErrors(errorCase.Source);
+        CHECK(errors.find(errorCase.Error) != std::string::npos);
+        if(errors.find(errorCase.Error) == std::string::npos)
+            printf("expected \"%s\" in:\n%s\n", errorCase.Error, errors.c_str());
+    }
+}
@@ -0,0 +1,165 @@
+#include "Test.h"
+#include "ConstantTable.h"
+#include "rage/StringHash.h"
+
+#include <cstring>
+
+static constexpr uint32_t CTAB_FOURCC = 'C' | ('T' << 8) | ('A' << 16) | ('B' << 24);
+
+//a table with one float4x3 constant "gWorld" at c4, laid out the way the compiler does
+static std::vector<uint8_t> MakeTable()
+{
+    std::vector<uint8_t> table(28 + 20);
+    auto writeDword = [&table](size_t offset, uint32_t value)
+    {
+        memcpy(&table[offset], &value, sizeof(value));
+    };
+    auto writeWord = [&table](size_t offset, uint16_t value)
+    {
+        memcpy(&table[offset], &value, sizeof(value));
+    };
+    auto appendString = [&table](const char* string)
+    {
+        uint32_t offset = (uint32_t)table.size();
+        table.insert(table.end(), string, string + strlen(string) + 1);
+        table.resize((table.size() + 3) & ~3);
+        return offset;
+    };
+
+    uint32_t name = appendString("gWorld");
+    uint32_t typeInfo = (uint32_t)table.size();
+    table.resize(typeInfo + 16);
+    writeWord(typeInfo + 0, 2);
+    writeWord(typeInfo + 2, 3);
+    writeWord(typeInfo + 4, 4);
+    writeWord(typeInfo + 6, 3);
+    writeWord(typeInfo + 8, 1);
+    uint32_t target = appendString("vs_3_0");
+    uint32_t creator = appendString("test");
+
+    writeDword(0, 28);
+    writeDword(4, creator);
+    writeDword(8, 0xFFFE0300);
+    writeDword(12, 1);
+    writeDword(16, 28);
+    writeDword(20, 0);
+    writeDword(24, target);
+
+    writeDword(28 + 0, name);
+    writeWord(28 + 4, 2);
+    writeWord(28 + 6, 4);
+    writeWord(28 + 8, 3);
+    writeDword(28 + 12, typeInfo);
+    return table;
+}
+
+//a vs_3_0 program holding table in a comment, after another comment if there's one
+static std::vector<uint8_t> MakeBytecode(const std::vector<uint8_t>& table, bool otherComment = false)
+{
+    std::vector<uint32_t> tokens = {0xFFFE0300};
+    if(otherComment)
+    {
+        tokens.push_back(0xFFFE | (2 << 16));
+        tokens.push_back('D' | ('B' << 8) | ('U' << 16) | ('G' << 24));
+        tokens.push_back(0);
+    }
+
+    if(!table.empty())
+    {
+        tokens.push_back(0xFFFE | ((uint32_t)(table.size() / 4 + 1) << 16));
+        tokens.push_back(CTAB_FOURCC);
+        size_t start = tokens.size();
+        tokens.resize(start + table.size() / 4);
+        memcpy(&tokens[start], table.data(), table.size());
+    }
+
+    tokens.push_back(0x0000FFFF);
+
+    std::vector<uint8_t> bytecode(tokens.size() * sizeof(uint32_t));
+    memcpy(bytecode.data(), tokens.data(), bytecode.size());
+    return bytecode;
+}
+
+static bool Init(ConstantTable& table, const std::vector<uint8_t>& bytecode)
+{
+    return table.Init(bytecode.data(), (uint32_t)bytecode.size());
+}
+
+TEST(ctab, reads_a_table)
+{
+    std::vector<uint8_t> bytecode = MakeBytecode(MakeTable());
+    ConstantTable table;
+    CHECK(Init(table, bytecode));
+    CHECK(strcmp(table.GetCreator(), "test") == 0);
+    CHECK(strcmp(table.GetTarget(), "vs_3_0") == 0);
+    CHECK(table.GetConstantCount() == 1);
+    CHECK(strcmp(table.GetConstantName(0), "gWorld") == 0);
+    CHECK(table.FindConstant(rage::atStringHash("gWorld")) == 0);
+    CHECK(table.FindConstant(rage::atStringHash("gView")) == -1);
+
+    const ConstantTable::ConstantInfo& constant = table.GetConstant(0);
+    CHECK(constant.RegisterSet == 2 && constant.RegisterIndex == 4 && constant.RegisterCount == 3);
+    const ConstantTable::TypeInfo* type = table.GetConstantType(0);
+    CHECK(type && type->Class == 2 && type->Type == 3 && type->Rows == 4 && type->Columns == 3 && type->Elements == 1);
+}
+
+TEST(ctab, skips_other_comments)
+{
+    std::vector<uint8_t> bytecode = MakeBytecode(MakeTable(), true);
+    ConstantTable table;
+    CHECK(Init(table, bytecode));
+    CHECK(table.GetConstantCount() == 1);
+}
+
+TEST(ctab, rejects_bytecode_without_a_table)
+{
+    std::vector<uint8_t> bytecode = MakeBytecode({}, true);
+    ConstantTable table;
+    CHECK(!Init(table, bytecode));
+    CHECK(strcmp(table.GetCreator(), "") == 0);
+    CHECK(table.GetConstantCount() == 0);
+}
+
+TEST(ctab, rejects_a_comment_past_the_end)
+{
+    std::vector<uint8_t> bytecode = MakeBytecode(MakeTable());
+    bytecode.resize(bytecode.size() - 12);
+    ConstantTable table;
+    CHECK(!Init(table, bytecode));
+}
+
+TEST(ctab, rejects_offsets_outside_the_table)
+{
+    std::vector<uint8_t> table = MakeTable();
+    uint32_t size = (uint32_t)table.size();
+    ConstantTable constantTable;
+
+    //constant count past the end
+    std::vector<uint8_t> broken = table;
+    uint32_t count = 1000;
+    memcpy(&broken[12], &count, sizeof(count));
+    CHECK(!Init(constantTable, MakeBytecode(broken)));
+
+    //name past the end
+    broken = table;
+    memcpy(&broken[28], &size, sizeof(size));
+    CHECK(!Init(constantTable, MakeBytecode(broken)));
+
+    //type info past the end and misaligned
+    broken = table;
+    uint32_t typeInfo = size - 8;
+    memcpy(&broken[28 + 12], &typeInfo, sizeof(typeInfo));
+    CHECK(!Init(constantTable, MakeBytecode(broken)));
+    broken = table;
+    typeInfo = 29;
+    memcpy(&broken[28 + 12], &typeInfo, sizeof(typeInfo));
+    CHECK(!Init(constantTable, MakeBytecode(broken)));
+
+    //a creator without a terminator only loses the creator
+    broken = table;
+    memcpy(&broken[4], &size, sizeof(size));
+    //the table points into the bytecode, which has to outlive it
+    std::vector<uint8_t> bytecode = MakeBytecode(broken);
+    CHECK(Init(constantTable, bytecode));
+    CHECK(strcmp(constantTable.GetCreator(), "") == 0);
+}
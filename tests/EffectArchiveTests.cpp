@@ -0,0 +1,103 @@
+#include "Test.h"
+#include "EffectArchive.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+
+static void WriteFile(const std::filesystem::path& path, const std::vector<uint8_t>& data)
+{
+    std::filesystem::create_directories(path.parent_path());
+    std::ofstream file(path, std::ios::binary);
+    file.write((const char*)data.data(), data.size());
+}
+
+static std::vector<uint8_t> ReadFile(const std::filesystem::path& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+//three effects sharing their programs, one of them extended and one in a subfolder. returns them by path
+static std::map<std::string, std::vector<uint8_t>> WriteEffects(const std::filesystem::path& folder)
+{
+    Effect effect;
+    CHECK(Test::CompileFx(Test::SAMPLE_EFFECT, effect));
+
+    std::string variant = Test::SAMPLE_EFFECT;
+    variant.replace(variant.find("int gCount = 7;"), strlen("int gCount = 7;"), "int gCount = 9;");
+    Effect other;
+    CHECK(Test::CompileFx(variant.c_str(), other));
+
+    std::map<std::string, std::vector<uint8_t>> effects;
+    effects["a.fxc"] = Test::SaveEffect(effect);
+    effects["Sub/B.fxc"] = Test::SaveEffect(effect, eEffectFormat::EXTENDED);
+    effects["c.fxc"] = Test::SaveEffect(other);
+    for(const auto& [path, data] : effects)
+        WriteFile(folder / path, data);
+    return effects;
+}
+
+static void CheckArchive(const char* name, bool dedupe)
+{
+    std::filesystem::path folder = std::filesystem::path(Test::GetTempFolder()) / name;
+    std::map<std::string, std::vector<uint8_t>> effects = WriteEffects(folder / "in");
+    std::string archivePath = (folder / "effects.rpf").string();
+
+    Log::Capture capture;
+    CHECK(EffectArchive::Pack((folder / "in").string().c_str(), archivePath.c_str(), dedupe, 2));
+
+    EffectArchive archive;
+    CHECK(archive.Open(archivePath.c_str()));
+    CHECK(archive.GetEffectCount() == effects.size());
+
+    //case and slashes don't matter
+    uint32_t index = archive.Find("sub\\b.FXC");
+    CHECK(index != EffectArchive::NOT_FOUND && index == archive.Find("Sub/B.fxc"));
+    CHECK(index != EffectArchive::NOT_FOUND && strcmp(archive.GetEffectPath(index), "Sub/B.fxc") == 0);
+    CHECK(archive.Find("missing.fxc") == EffectArchive::NOT_FOUND);
+
+    for(const auto& [path, data] : effects)
+    {
+        index = archive.Find(path.c_str());
+        CHECK(index != EffectArchive::NOT_FOUND);
+        if(index == EffectArchive::NOT_FOUND)
+            continue;
+
+        CHECK(archive.IsDeduped(index) == dedupe);
+        if(!dedupe)
+        {
+            std::span<const uint8_t> stored = archive.GetEffectData(index);
+            CHECK((uintptr_t)stored.data() % 16 == 0);
+            CHECK(std::vector<uint8_t>(stored.begin(), stored.end()) == data);
+        }
+
+        for(eEffectLoadMode::Enum mode : {eEffectLoadMode::LAZY, eEffectLoadMode::FULL})
+        {
+            std::unique_ptr<Effect> effect = archive.LoadEffect(index, mode);
+            CHECK(effect && effect->GetLoadError() == eEffectLoadError::NONE);
+            if(effect)
+                CHECK(Test::SaveEffect(*effect, effect->GetFormat()) == data);
+        }
+    }
+
+    CHECK(EffectArchive::Unpack(archivePath.c_str(), (folder / "out").string().c_str()));
+    for(const auto& [path, data] : effects)
+        CHECK(ReadFile(folder / "out" / path) == data);
+}
+
+TEST(archive, packs_and_unpacks)
+{
+    CheckArchive("archive", false);
+}
+
+TEST(archive, dedupes_bytecode)
+{
+    CheckArchive("archive_dedupe", true);
+
+    //the three effects share two programs, which are only stored once
+    std::filesystem::path folder = std::filesystem::path(Test::GetTempFolder());
+    CHECK(std::filesystem::file_size(folder / "archive_dedupe" / "effects.rpf") < std::filesystem::file_size(folder / "archive" / "effects.rpf"));
+}
@@ -0,0 +1,158 @@
+#include "Test.h"
+#include "EffectDiff.h"
+
+#include <cstring>
+#include <string>
+
+static const char* const DIFF_EFFECT =
+    "shared float4x4 gViewProjection : ViewProjection;\n"
+    "float4 gColor : Color = float4(1, 2, 3, 4);\n"
+    "float4x4 gTransform = float4x4(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1);\n"
+    "VertexShader gVSA < string gViewProjection = \"parameter register(0)\"; > = asm\n"
+    "{\n"
+    "    vs_3_0\n"
+    "    dcl_position v0\n"
+    "    dcl_position o0\n"
+    "    dp4 o0.x, v0, c0\n"
+    "};\n"
+    "VertexShader gVSB = asm\n"
+    "{\n"
+    "    vs_3_0\n"
+    "    dcl_position v0\n"
+    "    dcl_position o0\n"
+    "    mov o0, v0\n"
+    "};\n"
+    "PixelShader gPS < string gColor = \"parameter register(0)\"; > = asm\n"
+    "{\n"
+    "    ps_3_0\n"
+    "    mov oC0, c0\n"
+    "};\n"
+    "technique t\n"
+    "{\n"
+    "    pass p0 { ZEnable = true; CullMode = CW; VertexShader = gVSA; PixelShader = gPS; }\n"
+    "    pass p1 { VertexShader = gVSB; PixelShader = gPS; }\n"
+    "}\n";
+
+static std::string Replace(std::string source, const char* from, const char* to)
+{
+    size_t offset = source.find(from);
+    CHECK(offset != std::string::npos);
+    if(offset != std::string::npos)
+        source.replace(offset, strlen(from), to);
+    return source;
+}
+
+static EffectDiff::Result Diff(const std::string& sourceA, const std::string& sourceB)
+{
+    Effect a, b;
+    std::string messages;
+    CHECK(Test::CompileFx(sourceA.c_str(), a, &messages));
+    CHECK(Test::CompileFx(sourceB.c_str(), b, &messages));
+    CHECK(messages.empty());
+
+    EffectDiff::Result result = {};
+    EffectDiff::Compare(a, b, result);
+    return result;
+}
+
+TEST(diff, identical_effects_have_no_changes)
+{
+    EffectDiff::Result result = Diff(DIFF_EFFECT, DIFF_EFFECT);
+    CHECK(result.ChangeCount == 0 && result.Report.empty());
+    //dp4 and mov in the vertex programs, mov in the pixel one
+    CHECK(result.Instructions[0][0] == 2 && result.Instructions[1][0] == 2);
+    CHECK(result.Instructions[0][1] == 1 && result.Instructions[1][1] == 1);
+}
+
+TEST(diff, programs_match_by_bytecode_first)
+{
+    //gVSB moves in front of gVSA and gets renamed, both keep their bytecode so nothing changed
+    std::string moved = Replace(DIFF_EFFECT, "VertexShader gVSB = asm\n"
+                                             "{\n"
+                                             "    vs_3_0\n"
+                                             "    dcl_position v0\n"
+                                             "    dcl_position o0\n"
+                                             "    mov o0, v0\n"
+                                             "};\n", "");
+    moved = Replace(moved, "VertexShader gVSA", "VertexShader gVSMoved = asm\n"
+                                                "{\n"
+                                                "    vs_3_0\n"
+                                                "    dcl_position v0\n"
+                                                "    dcl_position o0\n"
+                                                "    mov o0, v0\n"
+                                                "};\n"
+                                                "VertexShader gVSA");
+    moved = Replace(moved, "VertexShader = gVSB", "VertexShader = gVSMoved");
+
+    EffectDiff::Result result = Diff(DIFF_EFFECT, moved);
+    CHECK(result.ChangeCount == 0);
+    CHECK(result.Report.empty());
+
+    //but a pass that now uses the other program did change
+    std::string swapped = Replace(moved, "VertexShader = gVSMoved", "VertexShader = gVSA");
+    result = Diff(DIFF_EFFECT, swapped);
+    CHECK(result.Report == "    technique \"t\" pass 1 vs: 1 -> 1\n");
+}
+
+TEST(diff, programs_fall_back_to_their_name)
+{
+    //gVSA gets an instruction more, it's still gVSA
+    std::string changed = Replace(DIFF_EFFECT, "    dp4 o0.x, v0, c0\n", "    dp4 o0.x, v0, c0\n    dp4 o0.y, v0, c1\n");
+
+    EffectDiff::Result result = Diff(DIFF_EFFECT, changed);
+    CHECK(result.Report == "    vs 0: bytecode changed, 0x94 -> 0xA4 bytes, 1 -> 2 instructions (+1)\n");
+    CHECK(result.Instructions[0][0] == 2 && result.Instructions[1][0] == 3);
+
+    //programs loaded from a .fxc have no names, they go by their index
+    Effect a, b;
+    CHECK(Test::CompileFx(DIFF_EFFECT, a));
+    CHECK(Test::CompileFx(changed.c_str(), b));
+    std::vector<uint8_t> dataA = Test::SaveEffect(a);
+    std::vector<uint8_t> dataB = Test::SaveEffect(b);
+    Effect loadedA("a.fxc", dataA.data(), dataA.size());
+    Effect loadedB("b.fxc", dataB.data(), dataB.size());
+    EffectDiff::Result loaded = {};
+    EffectDiff::Compare(loadedA, loadedB, loaded);
+    CHECK(loaded.Report == result.Report);
+
+    //a program with a new name and new bytecode is one removed and one added
+    std::string renamed = Replace(changed, "VertexShader gVSA", "VertexShader gVSC");
+    renamed = Replace(renamed, "VertexShader = gVSA", "VertexShader = gVSC");
+    result = Diff(DIFF_EFFECT, renamed);
+    CHECK(result.Report == "    - vs 0 (1 instructions)\n"
+                           "    + vs 0 (2 instructions)\n"
+                           "    technique \"t\" pass 0 vs: 0 -> 0\n");
+    CHECK(result.ChangeCount == 3);
+}
+
+TEST(diff, render_states_compare_their_final_values)
+{
+    std::string changed = Replace(DIFF_EFFECT, "ZEnable = true; CullMode = CW;", "ZEnable = false; AlphaBlendEnable = true;");
+    EffectDiff::Result result = Diff(DIFF_EFFECT, changed);
+    CHECK(result.Report == "    technique \"t\" pass 0 ZEnable: 1 -> 0\n"
+                           "    technique \"t\" pass 0 - CullMode = 2\n"
+                           "    technique \"t\" pass 0 + AlphaBlendEnable = 1\n");
+
+    //the order they're set in doesn't matter, and a state set twice only counts with its last value
+    std::string reordered = Replace(DIFF_EFFECT, "ZEnable = true; CullMode = CW;", "CullMode = CW; ZEnable = false; ZEnable = true;");
+    result = Diff(DIFF_EFFECT, reordered);
+    CHECK(result.ChangeCount == 0 && result.Report.empty());
+}
+
+TEST(diff, defaults_and_declarations)
+{
+    std::string changed = Replace(DIFF_EFFECT, "float4(1, 2, 3, 4)", "float4(1, 2, 5, 4)");
+    changed = Replace(changed, "float4x4(1, 0, 0, 0, 0, 1, 0, 0", "float4x4(1, 0, 0, 0, 0, 2, 0, 0");
+    changed = Replace(changed, ": ViewProjection;\n", ": ViewProj;\nfloat2 gNew[2];\n");
+
+    //small values are printed whole, bigger ones say where they start to differ
+    EffectDiff::Result result = Diff(DIFF_EFFECT, changed);
+    CHECK(result.Report == "    shared parameter \"gViewProjection\" semantic: \"ViewProjection\" -> \"ViewProj\"\n"
+                           "    parameter \"gColor\" default: (1, 2, 3, 4) -> (1, 2, 5, 4)\n"
+                           "    parameter \"gTransform\" default: 1 of 16 values, first [0][5] 1 -> 2\n"
+                           "    + parameter float2 gNew[2] : gNew\n");
+    CHECK(result.ChangeCount == 4);
+
+    result = Diff(changed, DIFF_EFFECT);
+    CHECK(result.Report.find("    - parameter float2 gNew[2] : gNew\n") != std::string::npos);
+}
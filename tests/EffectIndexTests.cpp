@@ -0,0 +1,127 @@
+#include "Test.h"
+#include "EffectIndex.h"
+#include "rage/StringHash.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using eKeyType = EffectIndex::eKeyType;
+
+static const char* const INDEX_EFFECT_A =
+    "shared float4x4 gViewProjection : ViewProjection;\n"
+    "float4 gColor : Color = float4(1, 2, 3, 4);\n"
+    "VertexShader gVS < string gViewProjection = \"parameter register(0)\"; > = asm\n"
+    "{\n"
+    "    vs_3_0\n"
+    "    dcl_position v0\n"
+    "    dcl_position o0\n"
+    "    dp4 o0.x, v0, c0\n"
+    "};\n"
+    "PixelShader gPS < string gColor = \"parameter register(12)\"; > = asm\n"
+    "{\n"
+    "    ps_3_0\n"
+    "    mov oC0, c12\n"
+    "};\n"
+    "technique draw\n"
+    "{\n"
+    "    pass p0 { ZEnable = true; CullMode = CW; VertexShader = gVS; PixelShader = gPS; }\n"
+    "}\n";
+
+static const char* const INDEX_EFFECT_B =
+    "float4 gTint : Color;\n"
+    "float4 gColor;\n"
+    "VertexShader gVS = NULL;\n"
+    "PixelShader gPS = NULL;\n"
+    "technique shadow\n"
+    "{\n"
+    "    pass p0 { ZEnable = false; VertexShader = gVS; PixelShader = gPS; }\n"
+    "    pass p1 { CullMode = CW; VertexShader = gVS; PixelShader = gPS; }\n"
+    "}\n";
+
+static void WriteEffect(const std::filesystem::path& path, const char* source)
+{
+    Effect effect;
+    CHECK(Test::CompileFx(source, effect));
+    std::vector<uint8_t> data = Test::SaveEffect(effect);
+    std::filesystem::create_directories(path.parent_path());
+    std::ofstream file(path, std::ios::binary);
+    file.write((const char*)data.data(), (std::streamsize)data.size());
+}
+
+//effect and item of every posting
+static std::vector<std::pair<uint32_t, uint32_t>> Find(const EffectIndex& index, uint64_t key)
+{
+    std::vector<std::pair<uint32_t, uint32_t>> postings;
+    for(const EffectIndex::Posting& posting : index.Find(key))
+        postings.push_back({posting.Effect, posting.Item});
+    return postings;
+}
+
+static uint32_t Hash(const char* string)
+{
+    return rage::atStringHash(string);
+}
+
+TEST(index, build_open_find_round_trip)
+{
+    std::filesystem::path folder = std::filesystem::path(Test::GetTempFolder()) / "index";
+    std::filesystem::remove_all(folder);
+    WriteEffect(folder / "sub/b.fxc", INDEX_EFFECT_B);
+    WriteEffect(folder / "a.fxc", INDEX_EFFECT_A);
+    //not an effect, it's listed but has no keys
+    std::ofstream((folder / "broken.fxc").string(), std::ios::binary) << "not an effect";
+    std::ofstream((folder / "readme.txt").string(), std::ios::binary) << "not an .fxc";
+
+    std::string indexPath = (std::filesystem::path(Test::GetTempFolder()) / "index.fxi").string();
+    {
+        Log::Capture capture;
+        CHECK(EffectIndex::Build(folder.string().c_str(), indexPath.c_str(), 2));
+    }
+
+    EffectIndex index;
+    CHECK(index.Open(indexPath.c_str()));
+
+    //effects are numbered in path order whatever order they were written in
+    CHECK(index.GetEffectCount() == 3);
+    CHECK(strcmp(index.GetEffectPath(0), "a.fxc") == 0);
+    CHECK(strcmp(index.GetEffectPath(1), "broken.fxc") == 0);
+    CHECK(strcmp(index.GetEffectPath(2), "sub/b.fxc") == 0);
+    CHECK(strcmp(index.GetEffectPath(3), "") == 0);
+
+    using Postings = std::vector<std::pair<uint32_t, uint32_t>>;
+    CHECK(Find(index, EffectIndex::MakeKey(eKeyType::PARAMETER_NAME, Hash("gViewProjection"))) == Postings({{0, EffectIndex::GLOBAL_PARAMETER}}));
+    CHECK(Find(index, EffectIndex::MakeKey(eKeyType::PARAMETER_NAME, Hash("gColor"))) == Postings({{0, 0}, {2, 1}}));
+    CHECK(Find(index, EffectIndex::MakeKey(eKeyType::SEMANTIC, Hash("Color"))) == Postings({{0, 0}, {2, 0}}));
+    CHECK(Find(index, EffectIndex::MakeKey(eKeyType::TECHNIQUE, Hash("shadow"))) == Postings({{2, 0}}));
+
+    //render states are keyed by their value, the item holds the technique and the pass
+    CHECK(Find(index, EffectIndex::MakeKey(eKeyType::RENDER_STATE, 2, eRenderStateType::CULLMODE)) == Postings({{0, 0}, {2, 1}}));
+    CHECK(Find(index, EffectIndex::MakeKey(eKeyType::RENDER_STATE, 0, eRenderStateType::ZENABLE)) == Postings({{2, 0}}));
+
+    CHECK(Find(index, EffectIndex::MakeKey(eKeyType::VERTEX_PROGRAM_PARAM, Hash("gViewProjection"), 0)) == Postings({{0, 0}}));
+    CHECK(Find(index, EffectIndex::MakeKey(eKeyType::PIXEL_PROGRAM_PARAM, Hash("gColor"), 12)) == Postings({{0, 0}}));
+    CHECK(Find(index, EffectIndex::MakeKey(eKeyType::PIXEL_PROGRAM_PARAM, Hash("gColor"), 0)).empty());
+    CHECK(Find(index, EffectIndex::MakeKey(eKeyType::TECHNIQUE, Hash("missing"))).empty());
+
+    //queries print what they find
+    Log::Capture capture;
+    CHECK(EffectIndex::Query(indexPath.c_str(), "ps", "gColor=c12"));
+    CHECK(capture.GetText().find("a.fxc") != std::string::npos);
+    CHECK(!EffectIndex::Query(indexPath.c_str(), "nope", "gColor"));
+}
+
+TEST(index, open_rejects_other_files)
+{
+    std::filesystem::path path = std::filesystem::path(Test::GetTempFolder()) / "not_an_index.fxi";
+    std::ofstream(path.string(), std::ios::binary) << "definitely not an index, but long enough to hold a header";
+
+    Log::Capture capture;
+    EffectIndex index;
+    CHECK(!index.Open(path.string().c_str()));
+    CHECK(index.GetEffectCount() == 0 && index.Find(0).empty());
+    CHECK(!EffectIndex::Build((path.parent_path() / "missing").string().c_str(), path.string().c_str()));
+    CHECK(capture.GetText().find("Unable to scan folder") != std::string::npos);
+}
@@ -0,0 +1,106 @@
+#include "Test.h"
+#include "EffectVerifier.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+//null programs, which the tests' backend can unpack and compile again
+static const char* const VERIFY_EFFECT =
+    "float4 gColor = float4(1, 2, 3, 4);\n"
+    "float2 gScale[2] = {float2(1, 2), float2(3, 4)};\n"
+    "int gCount = 7;\n"
+    "VertexShader gVS = NULL;\n"
+    "PixelShader gPS = NULL;\n"
+    "technique t\n"
+    "{\n"
+    "    pass p0 { ZEnable = true; CullMode = CW; VertexShader = gVS; PixelShader = gPS; }\n"
+    "}\n";
+
+static std::string Replace(std::string source, const char* from, const char* to)
+{
+    size_t offset = source.find(from);
+    CHECK(offset != std::string::npos);
+    if(offset != std::string::npos)
+        source.replace(offset, strlen(from), to);
+    return source;
+}
+
+TEST(verify, identical_effects_have_no_differences)
+{
+    Effect compiled;
+    CHECK(Test::CompileFx(VERIFY_EFFECT, compiled));
+
+    std::vector<uint8_t> data = Test::SaveEffect(compiled);
+    Effect loaded("test.fxc", data.data(), data.size());
+    CHECK(loaded.GetLoadError() == eEffectLoadError::NONE);
+
+    std::string report;
+    CHECK(EffectVerifier::Compare(compiled, loaded, report) == 0);
+    CHECK(report.empty());
+
+    //programs, samplers and annotations too
+    Effect sample;
+    CHECK(Test::CompileFx(Test::SAMPLE_EFFECT, sample));
+    data = Test::SaveEffect(sample, eEffectFormat::EXTENDED);
+    Effect sampleLoaded("test.fxc", data.data(), data.size());
+    CHECK(EffectVerifier::Compare(sample, sampleLoaded, report) == 0);
+    CHECK(report.empty());
+}
+
+TEST(verify, reports_every_changed_field)
+{
+    std::string source = Replace(VERIFY_EFFECT, "float4(1, 2, 3, 4)", "float4(1, 2, 5, 4)");
+    source = Replace(source, "ZEnable = true", "ZEnable = false");
+
+    Effect expected, actual;
+    CHECK(Test::CompileFx(VERIFY_EFFECT, expected));
+    CHECK(Test::CompileFx(source.c_str(), actual));
+
+    std::string report;
+    CHECK(EffectVerifier::Compare(expected, actual, report) == 2);
+    CHECK(report == "    parameter \"gColor\" value[0][2]: 3 -> 5\n"
+                    "    technique \"t\" pass 0 ZEnable: 1 -> 0\n");
+}
+
+TEST(verify, keeps_the_first_lines)
+{
+    std::string source = Replace(VERIFY_EFFECT, "float4(1, 2, 3, 4)", "float4(5, 6, 7, 8)");
+    source = Replace(source, "{float2(1, 2), float2(3, 4)}", "{float2(5, 6), float2(7, 8)}");
+
+    Effect expected, actual;
+    CHECK(Test::CompileFx(VERIFY_EFFECT, expected));
+    CHECK(Test::CompileFx(source.c_str(), actual));
+
+    //every difference is counted, only maxLines of them are written
+    std::string report;
+    CHECK(EffectVerifier::Compare(expected, actual, report, 3) == 8);
+    CHECK(report == "    parameter \"gColor\" value[0][0]: 1 -> 5\n"
+                    "    parameter \"gColor\" value[0][1]: 2 -> 6\n"
+                    "    parameter \"gColor\" value[0][2]: 3 -> 7\n");
+}
+
+TEST(verify, round_trips_files_on_disk)
+{
+    std::filesystem::path folder = std::filesystem::path(Test::GetTempFolder()) / "verify";
+    std::filesystem::create_directories(folder / "sub");
+
+    Effect compiled;
+    CHECK(Test::CompileFx(VERIFY_EFFECT, compiled));
+    std::vector<uint8_t> data = Test::SaveEffect(compiled);
+    for(const char* name : {"a.fxc", "sub/b.fxc"})
+    {
+        std::ofstream file(folder / name, std::ios::binary);
+        file.write((const char*)data.data(), (std::streamsize)data.size());
+    }
+
+    Log::Capture capture;
+    CHECK(EffectVerifier::Verify((folder / "a.fxc").string().c_str(), 0, 1));
+    CHECK(EffectVerifier::Verify(folder.string().c_str(), 0, 2));
+
+    //a file that isn't an effect fails the folder
+    std::ofstream((folder / "sub/broken.fxc").string(), std::ios::binary) << "not an effect";
+    CHECK(!EffectVerifier::Verify(folder.string().c_str(), 0, 2));
+    CHECK(capture.GetText().find("broken.fxc\" didn't survive the round trip") != std::string::npos);
+}
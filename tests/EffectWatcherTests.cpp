@@ -0,0 +1,136 @@
+#include "Test.h"
+#include "EffectWatcher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+static std::filesystem::path MakeFolder(const char* name)
+{
+    std::filesystem::path folder = std::filesystem::path(Test::GetTempFolder()) / name;
+    std::filesystem::remove_all(folder);
+    std::filesystem::create_directories(folder);
+    return folder;
+}
+
+static void WriteFile(const std::filesystem::path& path, const std::string& text)
+{
+    std::filesystem::create_directories(path.parent_path());
+    std::ofstream(path, std::ios::binary) << text;
+}
+
+static std::string ReadFile(const std::filesystem::path& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+TEST(watch, include_graph_follows_headers)
+{
+    std::filesystem::path root = MakeFolder("watch_graph");
+    //sub/b.fx finds common.fxh at the root, common.fxh finds detail.h next to itself
+    WriteFile(root / "a.fx", "#include \"common.fxh\"\nfloat4 gColor;\n");
+    WriteFile(root / "sub/b.fx", "  #  include <common.fxh>\n#include \"later.fxh\"\n");
+    WriteFile(root / "c.fx", "float4 gColor;\n");
+    WriteFile(root / "common.fxh", "#include \"detail.h\"\n");
+    //includes going in circles don't loop
+    WriteFile(root / "detail.h", "#include \"common.fxh\"\n");
+
+    IncludeGraph graph;
+    for(const char* name : {"a.fx", "sub/b.fx", "c.fx", "common.fxh", "detail.h"})
+        graph.Update(root / name, root);
+
+    CHECK(graph.GetEffects() == std::vector<std::filesystem::path>({root / "a.fx", root / "c.fx", root / "sub/b.fx"}));
+    CHECK(graph.GetFiles(root / "a.fx") == std::set<std::filesystem::path>({root / "a.fx", root / "common.fxh", root / "detail.h"}));
+    //an include that doesn't exist yet is kept where it would be next to the file
+    CHECK(graph.GetFiles(root / "sub/b.fx") == std::set<std::filesystem::path>({root / "sub/b.fx", root / "common.fxh", root / "detail.h",
+                                                                                 root / "sub/later.fxh"}));
+    CHECK(graph.GetFiles(root / "c.fx") == std::set<std::filesystem::path>({root / "c.fx"}));
+
+    CHECK(graph.GetAffectedEffects({root / "detail.h"}) == std::vector<std::filesystem::path>({root / "a.fx", root / "sub/b.fx"}));
+    CHECK(graph.GetAffectedEffects({root / "sub/later.fxh"}) == std::vector<std::filesystem::path>({root / "sub/b.fx"}));
+    CHECK(graph.GetAffectedEffects({root / "c.fx"}) == std::vector<std::filesystem::path>({root / "c.fx"}));
+    CHECK(graph.GetAffectedEffects({root / "unrelated.h"}).empty());
+
+    //a header that stops including another and a deleted effect
+    WriteFile(root / "common.fxh", "float4 gTint;\n");
+    graph.Update(root / "common.fxh", root);
+    std::filesystem::remove(root / "a.fx");
+    graph.Update(root / "a.fx", root);
+    CHECK(graph.GetEffects() == std::vector<std::filesystem::path>({root / "c.fx", root / "sub/b.fx"}));
+    CHECK(graph.GetAffectedEffects({root / "detail.h"}).empty());
+    CHECK(graph.GetAffectedEffects({root / "common.fxh"}) == std::vector<std::filesystem::path>({root / "sub/b.fx"}));
+}
+
+TEST(watch, outputs_are_published_whole)
+{
+    std::filesystem::path root = MakeFolder("watch_in");
+    std::filesystem::path outRoot = MakeFolder("watch_out");
+    WriteFile(root / "a.fx", "a");
+    WriteFile(root / "sub/b.fx", "b");
+    WriteFile(outRoot / "a.fxc", "old a");
+    std::filesystem::last_write_time(outRoot / "a.fxc", std::filesystem::last_write_time(root / "a.fx") - std::chrono::seconds(10));
+
+    //the compiler writes next to the output under another name, the output still holds what it held until the rename
+    std::mutex mutex;
+    std::vector<std::filesystem::path> compiled;
+    bool isStaged = true;
+    auto compile = [&](const std::filesystem::path& fileIn, const std::filesystem::path& fileOut)
+    {
+        std::filesystem::path output = outRoot / std::filesystem::relative(fileIn, root);
+        output.replace_extension(".fxc");
+
+        std::lock_guard lock(mutex);
+        compiled.push_back(fileIn);
+        isStaged &= fileOut != output && fileOut.parent_path() == output.parent_path();
+        isStaged &= !std::filesystem::exists(output) || ReadFile(output) == "old a";
+        WriteFile(fileOut, "new " + ReadFile(fileIn));
+        return true;
+    };
+
+    CHECK(EffectWatcher::CompileOutdated(root.string().c_str(), outRoot.string().c_str(), compile, 2));
+    std::sort(compiled.begin(), compiled.end());
+    CHECK(compiled == std::vector<std::filesystem::path>({root / "a.fx", root / "sub/b.fx"}));
+    CHECK(isStaged);
+    CHECK(ReadFile(outRoot / "a.fxc") == "new a");
+    CHECK(ReadFile(outRoot / "sub/b.fxc") == "new b");
+
+    //only the output and nothing staged is left behind
+    uint32_t fileCount = 0;
+    for(const auto& entry : std::filesystem::recursive_directory_iterator(outRoot))
+        fileCount += entry.is_regular_file();
+    CHECK(fileCount == 2);
+
+    //outputs newer than their files are left alone
+    compiled.clear();
+    CHECK(EffectWatcher::CompileOutdated(root.string().c_str(), outRoot.string().c_str(), compile, 2));
+    CHECK(compiled.empty());
+}
+
+TEST(watch, failed_compiles_keep_the_old_output)
+{
+    std::filesystem::path root = MakeFolder("watch_fail_in");
+    std::filesystem::path outRoot = MakeFolder("watch_fail_out");
+    WriteFile(root / "a.fx", "a");
+    WriteFile(outRoot / "a.fxc", "old a");
+    //the output has to be older than the effect for it to be compiled again
+    std::filesystem::last_write_time(outRoot / "a.fxc", std::filesystem::last_write_time(root / "a.fx") - std::chrono::seconds(10));
+
+    //a compiler giving up halfway
+    auto compile = [&](const std::filesystem::path& fileIn, const std::filesystem::path& fileOut)
+    {
+        WriteFile(fileOut, "half");
+        return false;
+    };
+
+    Log::Capture capture;
+    CHECK(EffectWatcher::CompileOutdated(root.string().c_str(), outRoot.string().c_str(), compile, 1));
+    CHECK(ReadFile(outRoot / "a.fxc") == "old a");
+    CHECK(std::distance(std::filesystem::directory_iterator(outRoot), std::filesystem::directory_iterator()) == 1);
+    CHECK(capture.GetText().find("compiled 0 of 1 effects") != std::string::npos);
+
+    CHECK(!EffectWatcher::CompileOutdated((root / "missing").string().c_str(), outRoot.string().c_str(), compile, 1));
+}
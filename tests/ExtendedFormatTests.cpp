@@ -0,0 +1,75 @@
+#include "Test.h"
+
+#include <cstring>
+
+TEST(extended, round_trips_and_converts_to_classic)
+{
+    Effect effect;
+    CHECK(Test::CompileFx(Test::SAMPLE_EFFECT, effect));
+    std::vector<uint8_t> classic = Test::SaveEffect(effect, eEffectFormat::CLASSIC);
+    std::vector<uint8_t> extended = Test::SaveEffect(effect, eEffectFormat::EXTENDED);
+    CHECK(!classic.empty() && !extended.empty());
+
+    uint32_t magic = 0;
+    memcpy(&magic, extended.data(), sizeof(magic));
+    CHECK(magic == Effect::MAGIC_EXTENDED);
+    CHECK(Effect::Validate(extended.data(), extended.size()) == eEffectLoadError::NONE);
+
+    Effect loaded("test.fxc", extended.data(), extended.size());
+    CHECK(loaded.GetLoadError() == eEffectLoadError::NONE);
+    CHECK(loaded.GetFormat() == eEffectFormat::EXTENDED);
+    CHECK(Test::SaveEffect(loaded, eEffectFormat::EXTENDED) == extended);
+    CHECK(Test::SaveEffect(loaded, eEffectFormat::CLASSIC) == classic);
+}
+
+//a 300 element array and more parameters than a byte can count
+TEST(extended, holds_what_classic_cant)
+{
+    std::string source = "float4 gLarge[300];\n";
+    for(int i = 0; i < 300; i++)
+        source += "float gParam" + std::to_string(i) + " = " + std::to_string(i) + ";\n";
+    source += "VertexShader gVS = NULL;\n"
+              "PixelShader gPS = NULL;\n"
+              "technique t { pass p { VertexShader = gVS; PixelShader = gPS; } }\n";
+
+    Effect effect;
+    CHECK(Test::CompileFx(source.c_str(), effect));
+    CHECK(effect.GetParameterCount() == 301);
+
+    Log::Capture capture;
+    CHECK(Test::SaveEffect(effect, eEffectFormat::CLASSIC).empty());
+    CHECK(capture.GetText().find("the number of parameters") != std::string::npos);
+
+    std::vector<uint8_t> extended = Test::SaveEffect(effect, eEffectFormat::EXTENDED);
+    CHECK(!extended.empty());
+
+    Effect loaded("test.fxc", extended.data(), extended.size(), eEffectLoadMode::LAZY);
+    CHECK(loaded.GetLoadError() == eEffectLoadError::NONE);
+    CHECK(loaded.GetParameterCount() == 301);
+    const Parameter* large = loaded.FindParameterByName("gLarge");
+    CHECK(large && large->GetCount() == 300);
+    const Parameter* last = loaded.FindParameterByName("gParam299");
+    CHECK(last && last->GetType() == Parameter::eType::FLOAT);
+    CHECK(Test::SaveEffect(loaded, eEffectFormat::EXTENDED) == extended);
+}
+
+TEST(extended, rejects_unknown_versions)
+{
+    Effect effect;
+    CHECK(Test::CompileFx(Test::SAMPLE_EFFECT, effect));
+    std::vector<uint8_t> extended = Test::SaveEffect(effect, eEffectFormat::EXTENDED);
+    CHECK(extended.size() > 8);
+    if(extended.size() <= 8)
+        return;
+
+    uint32_t version = Effect::EXTENDED_VERSION + 1;
+    memcpy(&extended[4], &version, sizeof(version));
+    size_t errorOffset = 0;
+    CHECK(Effect::Validate(extended.data(), extended.size(), &errorOffset) == eEffectLoadError::BAD_VERSION);
+    CHECK(errorOffset == 4);
+
+    Log::Capture capture;
+    Effect loaded("test.fxc", extended.data(), extended.size());
+    CHECK(loaded.GetLoadError() == eEffectLoadError::BAD_VERSION);
+    CHECK(loaded.GetParameterCount() == 0);
+}
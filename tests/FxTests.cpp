@@ -0,0 +1,223 @@
+#include "Test.h"
+#include "EffectWriter.h"
+#include "ShaderAssembler.h"
+#include "rage/StringHash.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+static bool Contains(const std::string& text, const char* string)
+{
+    return text.find(string) != std::string::npos;
+}
+
+static bool Contains(const std::vector<uint8_t>& data, const char* string)
+{
+    return std::search(data.begin(), data.end(), string, string + strlen(string) + 1) != data.end();
+}
+
+//compiles source, writes it back out as a .fx and compiles that again. both compiles have to save the same .fxc
+static std::string RoundTrip(const char* source, std::vector<uint8_t>& data)
+{
+    Effect effect;
+    CHECK(Test::CompileFx(source, effect));
+    data = Test::SaveEffect(effect);
+    CHECK(!data.empty());
+
+    EffectWriter writer;
+    CHECK(effect.SaveToFx(writer));
+    std::string text = writer.GetString();
+
+    Effect reloaded;
+    CHECK(Test::CompileFx(text.c_str(), reloaded));
+    CHECK(Test::SaveEffect(reloaded) == data);
+    return text;
+}
+
+TEST(fx, string_annotations_round_trip)
+{
+    std::vector<uint8_t> data;
+    std::string text = RoundTrip("float4 gColor\n"
+                                 "<\n"
+                                 "    string Path = \"textures\\\\foo.dds\";\n"
+                                 "    string Quoted = \"say \\\"hi\\\"\";\n"
+                                 "    string Lines = \"one\\ntwo\\tthree\\r\";\n"
+                                 "    string Control = \"a\\x01b\\x1F\";\n"
+                                 "    string Trailing = \"end\\\\\";\n"
+                                 "> = float4(1, 2, 3, 4);\n"
+                                 "VertexShader gVS = NULL;\n"
+                                 "PixelShader gPS = NULL;\n"
+                                 "technique t { pass p { VertexShader = gVS; PixelShader = gPS; } }\n", data);
+
+    //the strings the parser read
+    CHECK(Contains(data, "textures\\foo.dds"));
+    CHECK(Contains(data, "say \"hi\""));
+    CHECK(Contains(data, "one\ntwo\tthree\r"));
+    CHECK(Contains(data, "a\x01" "b\x1F"));
+    CHECK(Contains(data, "end\\"));
+
+    //and how they're written back
+    CHECK(Contains(text, "\"textures\\\\foo.dds\""));
+    CHECK(Contains(text, "\"say \\\"hi\\\"\""));
+    CHECK(Contains(text, "\"one\\ntwo\\tthree\\r\""));
+    CHECK(Contains(text, "\"a\\x01b\\x1F\""));
+    CHECK(Contains(text, "\"end\\\\\""));
+}
+
+//each of these used to be read or written with the values of another state
+TEST(fx, blend_alpha_and_stencil_states_round_trip)
+{
+    std::vector<uint8_t> data;
+    std::string text = RoundTrip("VertexShader gVS = NULL;\n"
+                                 "PixelShader gPS = NULL;\n"
+                                 "technique t\n"
+                                 "{\n"
+                                 "    pass p\n"
+                                 "    {\n"
+                                 "        SrcBlendAlpha = InvSrcAlpha;\n"
+                                 "        DestBlendAlpha = DestColor;\n"
+                                 "        StencilPass = Incr;\n"
+                                 "        CCW_StencilZFail = Decr;\n"
+                                 "        VertexShader = gVS;\n"
+                                 "        PixelShader = gPS;\n"
+                                 "    }\n"
+                                 "}\n", data);
+
+    CHECK(Contains(text, "SrcBlendAlpha = INVSRCALPHA;"));
+    CHECK(Contains(text, "DestBlendAlpha = DESTCOLOR;"));
+    CHECK(Contains(text, "StencilPass = INCR;"));
+    CHECK(Contains(text, "CCW_StencilZFail = DECR;"));
+
+    Effect effect("test.fxc", data.data(), data.size());
+    const EffectTechnique* technique = effect.GetTechniqueAt(0);
+    CHECK(technique && technique->GetPasses().GetCount() == 1);
+    if(!technique || technique->GetPasses().GetCount() != 1)
+        return;
+
+    const rage::atArray<RenderState>& states = technique->GetPasses()[0].GetRenderStates();
+    CHECK(states.GetCount() == 4);
+    for(uint16_t i = 0; i < states.GetCount(); i++)
+    {
+        uint32_t value = (uint32_t)states[i].Value.SrcBlend;
+        switch(states[i].State)
+        {
+            case eRenderStateType::SRCBLENDALPHA:    CHECK(value == eBlendMode::INVSRCALPHA); break;
+            case eRenderStateType::DESTBLENDALPHA:   CHECK(value == eBlendMode::DESTCOLOR);   break;
+            case eRenderStateType::STENCILPASS:      CHECK(value == eStencilOp::INCR);        break;
+            case eRenderStateType::CCW_STENCILZFAIL: CHECK(value == eStencilOp::DECR);        break;
+            default:                                 CHECK(!"unexpected render state");       break;
+        }
+    }
+}
+
+//makes up a program for every entry point, each of them reads gColor from c0
+class EntryPointBackend : public CompilerBackend
+{
+public:
+    const char* GetName() const override
+    {
+        return "entry points";
+    }
+
+    bool Preprocess(const char* filePath, const ShaderMacro* macros, CString& source, CString& messages) override
+    {
+        return false;
+    }
+
+    bool PreprocessSource(const char* fileName, const char* data, size_t length, const ShaderMacro* macros, ShaderIncludeHandler* includes,
+                          CString& source, CString& messages) override
+    {
+        return false;
+    }
+
+    bool Compile(const char* source, size_t length, const char* entryPoint, const char* profile, uint32_t flags, ShaderBytecode& bytecode, CString& messages) override
+    {
+        if(!entryPoint || !entryPoint[0])
+            return true;
+
+        const char* program = strcmp(profile, "vs_3_0") == 0 ? "vs_3_0\ndcl_position v0\ndcl_position o0\nadd o0, v0, c0\n" : "ps_3_0\nmov oC0, c0\n";
+
+        //D3DXRS_FLOAT4, D3DXPC_VECTOR and D3DXPT_FLOAT
+        rage::atArray<ShaderConstant> constants = {1};
+        ShaderConstant& color = constants.Append();
+        color.mName = "gColor";
+        color.mRegisterSet = 2;
+        color.mRegisterCount = 1;
+        color.mClass = 1;
+        color.mType = 3;
+        color.mColumns = 4;
+        return ShaderAssembler::Assemble(program, strlen(program), constants, bytecode, messages) == eAssembleResult::OK;
+    }
+
+    bool Assemble(const char* source, size_t length, ShaderBytecode& bytecode, CString& messages) override
+    {
+        return false;
+    }
+
+    bool Disassemble(const ShaderBytecode& bytecode, CString& disassembly) override
+    {
+        return false;
+    }
+};
+
+//programs come out in the order passes first use them, not in the order the parser happened to allocate the functions
+TEST(fx, programs_keep_their_order_of_use)
+{
+    SetRecordingCompilerBackend(std::make_unique<EntryPointBackend>(), (Test::GetTempFolder() + "/entry_points").c_str());
+
+    const char* source = "float4 gColor;\n"
+                         "float4 VSLast(float4 p : POSITION) : POSITION { return p + gColor; }\n"
+                         "float4 VSFirst(float4 p : POSITION) : POSITION { return p + gColor; }\n"
+                         "float4 PSLast() : COLOR { return gColor; }\n"
+                         "float4 PSFirst() : COLOR { return gColor; }\n"
+                         "technique t\n"
+                         "{\n"
+                         "    pass p0 { VertexShader = compile vs_3_0 VSFirst(); PixelShader = compile ps_3_0 PSFirst(); }\n"
+                         "    pass p1 { VertexShader = compile vs_3_0 VSLast(); PixelShader = compile ps_3_0 PSLast(); }\n"
+                         "    pass p2 { VertexShader = compile vs_3_0 VSFirst(); PixelShader = compile ps_3_0 PSLast(); }\n"
+                         "}\n";
+
+    Effect effect;
+    std::string messages;
+    CHECK(Test::CompileFx(source, effect, &messages));
+    CHECK(effect.GetVertexProgramCount() == 2 && effect.GetPixelProgramCount() == 2);
+    if(effect.GetVertexProgramCount() == 2 && effect.GetPixelProgramCount() == 2)
+    {
+        CHECK(effect.GetVertexProgramAt(0)->mNameHash == rage::atStringHash("VSFirst"));
+        CHECK(effect.GetVertexProgramAt(1)->mNameHash == rage::atStringHash("VSLast"));
+        CHECK(effect.GetPixelProgramAt(0)->mNameHash == rage::atStringHash("PSFirst"));
+        CHECK(effect.GetPixelProgramAt(1)->mNameHash == rage::atStringHash("PSLast"));
+    }
+
+    //and the same every time
+    Effect again;
+    CHECK(Test::CompileFx(source, again));
+    CHECK(Test::SaveEffect(again) == Test::SaveEffect(effect));
+
+    Test::ResetCompilerBackend();
+}
+
+TEST(fx, passes_find_null_programs)
+{
+    const char* source = "VertexShader gVS0 = NULL;\n"
+                         "VertexShader gVS1 = NULL;\n"
+                         "PixelShader gPS = NULL;\n"
+                         "technique t\n"
+                         "{\n"
+                         "    pass p0 { VertexShader = gVS1; PixelShader = gPS; }\n"
+                         "    pass p1 { VertexShader = NULL; PixelShader = NULL; }\n"
+                         "}\n";
+
+    Effect effect;
+    CHECK(Test::CompileFx(source, effect));
+    CHECK(effect.GetTechniqueCount() == 1);
+    if(effect.GetTechniqueCount() != 1 || effect.GetTechniqueAt(0)->GetPasses().GetCount() != 2)
+        return;
+
+    const EffectPass& p0 = effect.GetTechniqueAt(0)->GetPasses()[0];
+    const EffectPass& p1 = effect.GetTechniqueAt(0)->GetPasses()[1];
+    CHECK(p0.GetVertexProgramIndex() == 1 && p0.GetPixelProgramIndex() == 0);
+    //null in the pass itself is the same as not setting the program
+    CHECK(p1.GetVertexProgramIndex() == 0 && p1.GetPixelProgramIndex() == 0);
+}
@@ -0,0 +1,377 @@
+#include "Test.h"
+#include "fxdc.h"
+#include "CompilerBackend.h"
+
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+//like the tests' own backend but it expands #include lines through the handler it's given, the way d3dx would
+class IncludeBackend : public CompilerBackend
+{
+public:
+    const char* GetName() const override
+    {
+        return "include test";
+    }
+
+    bool Preprocess(const char* filePath, const ShaderMacro* macros, CString& source, CString& messages) override
+    {
+        messages = CString("the include test backend doesn't read files: ", filePath);
+        return false;
+    }
+
+    bool PreprocessSource(const char* fileName, const char* data, size_t length, const ShaderMacro* macros, ShaderIncludeHandler* includes,
+                          CString& source, CString& messages) override
+    {
+        std::string text(data, length);
+        std::string expanded;
+        size_t start = 0;
+        while(start < text.size())
+        {
+            size_t end = text.find('\n', start);
+            end = end == std::string::npos ? text.size() : end + 1;
+            std::string line = text.substr(start, end - start);
+            start = end;
+
+            if(line.compare(0, 9, "#include ") != 0)
+            {
+                expanded += line;
+                continue;
+            }
+
+            bool system = line[9] == '<';
+            std::string name = line.substr(10, line.find_first_of(system ? ">" : "\"", 10) - 10);
+            const char* includeData = nullptr;
+            size_t includeSize = 0;
+            if(!includes || !includes->Open(system, name.c_str(), fileName, includeData, includeSize))
+            {
+                messages = CString((std::string(fileName) + " : cannot open include file \"" + name + "\"").c_str());
+                return false;
+            }
+
+            expanded.append(includeData, includeSize);
+            expanded += '\n';
+            includes->Close(includeData);
+        }
+
+        source = CString(expanded.c_str());
+        return true;
+    }
+
+    bool Compile(const char* source, size_t length, const char* entryPoint, const char* profile, uint32_t flags, ShaderBytecode& bytecode, CString& messages) override
+    {
+        if(!entryPoint || !entryPoint[0])
+            return true;
+
+        messages = CString("the include test backend can't compile ", entryPoint);
+        return false;
+    }
+
+    bool Assemble(const char* source, size_t length, ShaderBytecode& bytecode, CString& messages) override
+    {
+        messages = "the include test backend only assembles natively";
+        return false;
+    }
+
+    bool Disassemble(const ShaderBytecode& bytecode, CString& disassembly) override
+    {
+        return false;
+    }
+};
+
+//keeps track of every block it hands out, so a test can tell a blob came from it and that all of them were given back
+struct TrackingAllocator
+{
+    std::mutex Mutex;
+    std::set<void*> Live;
+    uint32_t AllocCount = 0;
+    uint32_t BadFreeCount = 0;
+    fxdc_allocator Allocator {&Alloc, &Free, this};
+
+    bool Owns(const void* ptr)
+    {
+        std::lock_guard lock(Mutex);
+        return Live.contains((void*)ptr);
+    }
+
+    static void* Alloc(void* user, size_t size)
+    {
+        TrackingAllocator& self = *(TrackingAllocator*)user;
+        void* ptr = malloc(size ? size : 1);
+        std::lock_guard lock(self.Mutex);
+        self.Live.insert(ptr);
+        self.AllocCount++;
+        return ptr;
+    }
+
+    static void Free(void* user, void* ptr)
+    {
+        TrackingAllocator& self = *(TrackingAllocator*)user;
+        std::lock_guard lock(self.Mutex);
+        if(!self.Live.erase(ptr))
+            self.BadFreeCount++;
+        free(ptr);
+    }
+};
+
+//serves "common.fxh" and <system.fxh>, and remembers every open and close
+struct IncludeLog
+{
+    struct Open
+    {
+        std::string Name;
+        std::string Parent;
+        int System;
+    };
+
+    std::vector<Open> Opens;
+    std::vector<const void*> Served;
+    std::vector<const void*> Closed;
+    fxdc_include_handler Handler {&OpenFile, &CloseFile, this};
+
+    static int OpenFile(void* user, int system, const char* name, const char* parentName, const void** data, size_t* size)
+    {
+        static const char COMMON[] = "float4 gCommon = float4(1, 2, 3, 4);";
+        static const char SYSTEM[] = "float gSystem = 5;";
+
+        IncludeLog& self = *(IncludeLog*)user;
+        self.Opens.push_back({name, parentName, system});
+
+        const char* file = nullptr;
+        if(!system && strcmp(name, "common.fxh") == 0)
+            file = COMMON;
+        else if(system && strcmp(name, "system.fxh") == 0)
+            file = SYSTEM;
+        if(!file)
+            return 0;
+
+        //a copy of its own, so close has something to tell apart
+        char* copy = strdup(file);
+        self.Served.push_back(copy);
+        *data = copy;
+        *size = strlen(copy);
+        return 1;
+    }
+
+    static void CloseFile(void* user, const void* data)
+    {
+        IncludeLog& self = *(IncludeLog*)user;
+        self.Closed.push_back(data);
+        free((void*)data);
+    }
+};
+
+static const char* const TECHNIQUE = "VertexShader gVS = NULL;\n"
+                                     "PixelShader gPS = NULL;\n"
+                                     "technique t { pass p { VertexShader = gVS; PixelShader = gPS; } }\n";
+
+static std::string GetText(const fxdc_blob& blob)
+{
+    return blob.data ? std::string((const char*)blob.data, blob.size) : std::string();
+}
+
+//every test gets a recording cache of its own, failures are recorded too and the sources repeat between tests
+static void SetIncludeBackend(const char* name)
+{
+    SetRecordingCompilerBackend(std::make_unique<IncludeBackend>(), (Test::GetTempFolder() + "/api_" + name).c_str());
+}
+
+TEST(api, blobs_come_from_the_allocator)
+{
+    SetIncludeBackend("allocator");
+    TrackingAllocator allocator;
+
+    fxdc_compile_options options = {};
+    options.source_name = "test.fx";
+    options.allocator = &allocator.Allocator;
+
+    fxdc_blob effect, messages;
+    CHECK(fxdc_compile(Test::SAMPLE_EFFECT, strlen(Test::SAMPLE_EFFECT), &options, &effect, &messages) == FXDC_OK);
+    CHECK(effect.data && allocator.Owns(effect.data));
+    //an empty message text still gets a terminated blob
+    CHECK(messages.data && allocator.Owns(messages.data) && ((const char*)messages.data)[messages.size] == 0);
+
+    //the same bytes the library itself saves
+    Effect compiled;
+    CHECK(Test::CompileFx(Test::SAMPLE_EFFECT, compiled));
+    std::vector<uint8_t> expected = Test::SaveEffect(compiled);
+    CHECK(effect.size == expected.size() && memcmp(effect.data, expected.data(), expected.size()) == 0);
+
+    fxdc_blob text, unpackMessages;
+    CHECK(fxdc_unpack(effect.data, effect.size, &allocator.Allocator, &text, &unpackMessages) == FXDC_OK);
+    CHECK(text.data && allocator.Owns(text.data) && ((const char*)text.data)[text.size] == 0);
+    CHECK(GetText(text).find("technique Blended") != std::string::npos);
+    CHECK(unpackMessages.data && allocator.Owns(unpackMessages.data));
+
+    for(fxdc_blob* blob : {&effect, &messages, &text, &unpackMessages})
+    {
+        fxdc_free(&allocator.Allocator, blob);
+        CHECK(!blob->data && !blob->size);
+    }
+
+    CHECK(allocator.AllocCount == 4);
+    CHECK(allocator.Live.empty());
+    CHECK(allocator.BadFreeCount == 0);
+    Test::ResetCompilerBackend();
+}
+
+TEST(api, include_handler_opens_and_closes_in_pairs)
+{
+    SetIncludeBackend("includes");
+    IncludeLog includes;
+
+    fxdc_compile_options options = {};
+    options.source_name = "api.fx";
+    options.includes = &includes.Handler;
+
+    std::string source = std::string("#include \"common.fxh\"\n#include <system.fxh>\n") + TECHNIQUE;
+    fxdc_blob effect, messages;
+    CHECK(fxdc_compile(source.data(), source.size(), &options, &effect, &messages) == FXDC_OK);
+    CHECK(effect.data);
+
+    CHECK(includes.Opens.size() == 2);
+    if(includes.Opens.size() == 2)
+    {
+        CHECK(includes.Opens[0].Name == "common.fxh" && !includes.Opens[0].System && includes.Opens[0].Parent == "api.fx");
+        CHECK(includes.Opens[1].Name == "system.fxh" && includes.Opens[1].System && includes.Opens[1].Parent == "api.fx");
+    }
+    //every successful open is closed once, with the data it served
+    CHECK(includes.Closed == includes.Served);
+
+    //the included declarations made it into the effect
+    fxdc_blob text;
+    CHECK(fxdc_unpack(effect.data, effect.size, nullptr, &text, nullptr) == FXDC_OK);
+    CHECK(GetText(text).find("gCommon") != std::string::npos && GetText(text).find("gSystem") != std::string::npos);
+    fxdc_free(nullptr, &text);
+    fxdc_free(nullptr, &effect);
+    fxdc_free(nullptr, &messages);
+
+    //an open that fails isn't closed and fails the preprocess
+    includes = {};
+    includes.Handler.user = &includes;
+    source = std::string("#include \"common.fxh\"\n#include \"missing.fxh\"\n") + TECHNIQUE;
+    CHECK(fxdc_compile(source.data(), source.size(), &options, &effect, &messages) == FXDC_PREPROCESS_FAILED);
+    CHECK(!effect.data && !effect.size);
+    CHECK(GetText(messages).find("missing.fxh") != std::string::npos);
+    CHECK(includes.Opens.size() == 2);
+    CHECK(includes.Served.size() == 1 && includes.Closed == includes.Served);
+    fxdc_free(nullptr, &messages);
+
+    //without a handler every include fails
+    options.includes = nullptr;
+    source = std::string("#include \"common.fxh\"\n") + TECHNIQUE;
+    CHECK(fxdc_compile(source.data(), source.size(), &options, &effect, &messages) == FXDC_PREPROCESS_FAILED);
+    CHECK(GetText(messages).find("common.fxh") != std::string::npos);
+    fxdc_free(nullptr, &messages);
+    Test::ResetCompilerBackend();
+}
+
+TEST(api, failures_fill_in_messages)
+{
+    SetIncludeBackend("failures");
+    TrackingAllocator allocator;
+
+    fxdc_compile_options options = {};
+    options.source_name = "broken.fx";
+    options.allocator = &allocator.Allocator;
+
+    struct FailureCase
+    {
+        std::string Source;
+        fxdc_result Result;
+        const char* Message;
+    };
+
+    const FailureCase cases[]
+    {
+        {std::string("float gBad = ;\n") + TECHNIQUE, FXDC_PARSE_FAILED, "broken.fx(1,14) : Syntax error"},
+        {std::string("float4 gBad = float4(1, 2, 3);\n") + TECHNIQUE, FXDC_COMPILE_FAILED, "constructor takes 4 values, got 3"},
+        //parameters after a syntax error still get checked, the one that broke has no declaration to check
+        {std::string("float4 gBroken = float4(1, ;\nfloat4 gBad = float4(1, 2, 3);\n") + TECHNIQUE, FXDC_PARSE_FAILED, "constructor takes 4 values, got 3"},
+    };
+
+    for(const FailureCase& failure : cases)
+    {
+        fxdc_blob effect, messages;
+        CHECK(fxdc_compile(failure.Source.data(), failure.Source.size(), &options, &effect, &messages) == failure.Result);
+        CHECK(!effect.data);
+        CHECK(messages.data && allocator.Owns(messages.data));
+        CHECK(GetText(messages).find(failure.Message) != std::string::npos);
+        fxdc_free(&allocator.Allocator, &messages);
+    }
+
+    static const uint8_t GARBAGE[] = {'n', 'o', 't', ' ', 'a', 'n', ' ', 'f', 'x', 'c'};
+    fxdc_blob text, messages;
+    CHECK(fxdc_unpack(GARBAGE, sizeof(GARBAGE), &allocator.Allocator, &text, &messages) == FXDC_INVALID_EFFECT);
+    CHECK(!text.data);
+    CHECK(messages.data && allocator.Owns(messages.data) && messages.size > 0);
+    fxdc_free(&allocator.Allocator, &messages);
+
+    //bad arguments are reported without touching the allocator
+    fxdc_blob effect;
+    CHECK(fxdc_compile(nullptr, 0, &options, &effect, &messages) == FXDC_INVALID_ARGUMENT);
+    CHECK(!messages.data);
+
+    CHECK(allocator.Live.empty() && allocator.BadFreeCount == 0);
+    Test::ResetCompilerBackend();
+}
+
+TEST(api, concurrent_calls_stay_apart)
+{
+    SetIncludeBackend("threads");
+
+    static constexpr uint32_t THREAD_COUNT = 2;
+    static constexpr uint32_t ITERATION_COUNT = 50;
+
+    Effect compiled;
+    CHECK(Test::CompileFx(Test::SAMPLE_EFFECT, compiled));
+    std::vector<uint8_t> expected = Test::SaveEffect(compiled);
+
+    std::vector<uint32_t> failCounts(THREAD_COUNT);
+    std::vector<std::thread> threads;
+    for(uint32_t t = 0; t < THREAD_COUNT; t++)
+    {
+        threads.emplace_back([&, t]
+        {
+            TrackingAllocator allocator;
+            IncludeLog includes;
+            std::string name = "thread" + std::to_string(t) + ".fx";
+            std::string broken = "#include \"common.fxh\"\nfloat gBad = ;\n";
+
+            fxdc_compile_options options = {};
+            options.source_name = name.c_str();
+            options.allocator = &allocator.Allocator;
+            options.includes = &includes.Handler;
+
+            for(uint32_t i = 0; i < ITERATION_COUNT; i++)
+            {
+                fxdc_blob effect, messages;
+                if(fxdc_compile(Test::SAMPLE_EFFECT, strlen(Test::SAMPLE_EFFECT), &options, &effect, &messages) != FXDC_OK ||
+                   effect.size != expected.size() || memcmp(effect.data, expected.data(), expected.size()) != 0 || !messages.data)
+                    failCounts[t]++;
+                fxdc_free(&allocator.Allocator, &effect);
+                fxdc_free(&allocator.Allocator, &messages);
+
+                //the other thread's messages never end up here
+                if(fxdc_compile(broken.data(), broken.size(), &options, &effect, &messages) != FXDC_PARSE_FAILED ||
+                   GetText(messages).find(name) == std::string::npos || GetText(messages).find(t ? "thread0" : "thread1") != std::string::npos)
+                    failCounts[t]++;
+                fxdc_free(&allocator.Allocator, &messages);
+            }
+
+            if(!allocator.Live.empty() || allocator.BadFreeCount || includes.Closed != includes.Served)
+                failCounts[t]++;
+        });
+    }
+    for(std::thread& thread : threads)
+        thread.join();
+
+    for(uint32_t t = 0; t < THREAD_COUNT; t++)
+        CHECK(failCounts[t] == 0);
+    Test::ResetCompilerBackend();
+}
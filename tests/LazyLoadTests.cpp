@@ -0,0 +1,108 @@
+#include "Test.h"
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+static std::vector<uint8_t> CompileSample(eEffectFormat::Enum format = eEffectFormat::CLASSIC)
+{
+    Effect effect;
+    CHECK(Test::CompileFx(Test::SAMPLE_EFFECT, effect));
+    return Test::SaveEffect(effect, format);
+}
+
+TEST(lazy, saves_the_same_file)
+{
+    for(eEffectFormat::Enum format : {eEffectFormat::CLASSIC, eEffectFormat::EXTENDED})
+    {
+        std::vector<uint8_t> data = CompileSample(format);
+        CHECK(!data.empty());
+
+        Effect lazy("test.fxc", data.data(), data.size(), eEffectLoadMode::LAZY);
+        CHECK(lazy.GetLoadError() == eEffectLoadError::NONE);
+        CHECK(lazy.GetFormat() == format);
+        CHECK(Test::SaveEffect(lazy, format) == data);
+    }
+}
+
+TEST(lazy, decodes_entries_in_any_order)
+{
+    std::vector<uint8_t> data = CompileSample();
+    Effect full("test.fxc", data.data(), data.size());
+    Effect lazy("test.fxc", data.data(), data.size(), eEffectLoadMode::LAZY);
+
+    CHECK(lazy.GetTechniqueCount() == full.GetTechniqueCount());
+    CHECK(lazy.GetParameterCount() == full.GetParameterCount());
+    CHECK(lazy.GetGlobalParameterCount() == full.GetGlobalParameterCount());
+    CHECK(lazy.GetVertexProgramCount() == full.GetVertexProgramCount());
+    CHECK(lazy.GetPixelProgramCount() == full.GetPixelProgramCount());
+
+    //the last entries first, then lookups that have to decode whatever they pass over
+    const EffectTechnique* technique = lazy.GetTechniqueAt(lazy.GetTechniqueCount() - 1);
+    CHECK(technique && strcmp(technique->GetName(), "Blended") == 0 && technique->GetPasses().GetCount() == 2);
+
+    const Parameter* count = lazy.FindParameterByName("gCount");
+    CHECK(count && count->GetType() == Parameter::eType::INT);
+    const Parameter* time = lazy.FindGlobalParameterByName("gTime");
+    CHECK(time && time->GetType() == Parameter::eType::FLOAT);
+
+    for(uint32_t i = lazy.GetParameterCount(); i-- > 0; )
+    {
+        const Parameter* lazyParam = lazy.GetParameterAt(i);
+        const Parameter* fullParam = full.GetParameterAt(i);
+        CHECK(lazyParam && fullParam && strcmp(lazyParam->GetName(), fullParam->GetName()) == 0);
+        CHECK(lazyParam && fullParam && lazyParam->GetCount() == fullParam->GetCount());
+    }
+
+    const PixelProgram* program = lazy.GetPixelProgramAt(lazy.GetPixelProgramCount() - 1);
+    CHECK(program && program->mShaderData.GetCapacity());
+
+    //whatever was decoded so far, the rest is decoded on save
+    CHECK(Test::SaveEffect(lazy) == data);
+}
+
+TEST(lazy, a_broken_file_stays_empty)
+{
+    std::vector<uint8_t> data = CompileSample();
+    data.resize(data.size() / 2);
+
+    Log::Capture capture;
+    Effect lazy("test.fxc", data.data(), data.size(), eEffectLoadMode::LAZY);
+    CHECK(lazy.GetLoadError() != eEffectLoadError::NONE);
+    CHECK(lazy.GetTechniqueCount() == 0);
+    CHECK(lazy.GetParameterCount() == 0);
+    CHECK(lazy.FindParameterByName("gCount") == nullptr);
+}
+
+//threads reading the same entries at once decode each of them exactly once and all see it whole
+TEST(lazy, decodes_from_many_threads)
+{
+    std::vector<uint8_t> data = CompileSample();
+    for(int round = 0; round < 16; round++)
+    {
+        Effect lazy("test.fxc", data.data(), data.size(), eEffectLoadMode::LAZY);
+
+        std::atomic<uint32_t> failures = 0;
+        std::vector<std::thread> threads;
+        for(int i = 0; i < 8; i++)
+        {
+            threads.emplace_back([&]()
+            {
+                for(uint32_t j = lazy.GetParameterCount(); j-- > 0; )
+                    failures += !lazy.GetParameterAt(j)->GetName();
+                const Parameter* count = lazy.FindParameterByName("gCount");
+                failures += !count || count->GetType() != Parameter::eType::INT;
+                for(uint32_t j = 0; j < lazy.GetTechniqueCount(); j++)
+                    failures += !lazy.GetTechniqueAt(j)->GetPasses().GetCount();
+                for(uint32_t j = 0; j < lazy.GetPixelProgramCount(); j++)
+                    failures += !lazy.GetPixelProgramAt(j)->mShaderData.GetCapacity();
+            });
+        }
+        for(std::thread& thread : threads)
+            thread.join();
+
+        CHECK(failures == 0);
+        CHECK(Test::SaveEffect(lazy) == data);
+    }
+}
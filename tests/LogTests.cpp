@@ -0,0 +1,145 @@
+#include "Test.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+//sends the json stream to a file for as long as it lives, infos aren't printed in the meantime
+class JsonFile
+{
+public:
+    JsonFile(const char* name) : mPath(std::filesystem::path(Test::GetTempFolder()) / name)
+    {
+        CHECK(Log::SetJsonFile(mPath.string().c_str()));
+        Log::SetQuiet(true);
+    }
+
+    ~JsonFile()
+    {
+        Log::SetJsonFile(nullptr);
+        Log::SetQuiet(false);
+    }
+
+    std::vector<std::string> GetLines() const
+    {
+        std::vector<std::string> lines;
+        std::ifstream file(mPath);
+        std::string line;
+        while(std::getline(file, line))
+            lines.push_back(line);
+        return lines;
+    }
+
+private:
+    std::filesystem::path mPath;
+};
+
+TEST(log, jobs_hold_their_messages_until_they_end)
+{
+    JsonFile json("log_jobs.json");
+    {
+        Log::Job job("a.fx");
+        Log::Info("first");
+        {
+            //an inner job ends up in the outer one, under the outer name
+            Log::Job inner("ignored");
+            Log::Warn("second");
+        }
+        CHECK(json.GetLines().empty());
+    }
+
+    Log::Error("third");
+    CHECK(json.GetLines() == std::vector<std::string>({"{\"level\":\"info\",\"job\":\"a.fx\",\"message\":\"first\"}",
+                                                       "{\"level\":\"warning\",\"job\":\"a.fx\",\"message\":\"second\"}",
+                                                       "{\"level\":\"error\",\"message\":\"third\"}"}));
+}
+
+TEST(log, captures_keep_what_they_collect)
+{
+    JsonFile json("log_capture.json");
+    std::string text;
+    {
+        Log::Capture capture;
+        Log::Info("first");
+        {
+            Log::Job job("a.fx");
+            Log::Error("second");
+        }
+        text = capture.GetText();
+    }
+
+    CHECK(text == "first\nERROR: second\n");
+    CHECK(json.GetLines().empty());
+}
+
+TEST(log, jobs_from_threads_stay_together)
+{
+    JsonFile json("log_threads.json");
+    std::vector<std::thread> threads;
+    for(uint32_t i = 0; i < 8; i++)
+    {
+        threads.emplace_back([i]()
+        {
+            std::string name = std::to_string(i);
+            Log::Job job(name.c_str());
+            for(uint32_t j = 0; j < 50; j++)
+                Log::Info("%u", j);
+        });
+    }
+    for(std::thread& thread : threads)
+        thread.join();
+
+    //every job's messages come out as one run in the order they were logged
+    std::vector<std::string> lines = json.GetLines();
+    CHECK(lines.size() == 8 * 50);
+    for(size_t i = 0; i + 50 <= lines.size(); i += 50)
+    {
+        std::string job = lines[i].substr(0, lines[i].find(",\"message\""));
+        for(uint32_t j = 0; j < 50; j++)
+            CHECK(lines[i + j] == job + ",\"message\":\"" + std::to_string(j) + "\"}");
+    }
+}
+
+TEST(log, json_splits_out_locations)
+{
+    JsonFile json("log_locations.json");
+    Log::Error("shaders/a.fx(12,5): error X3000: syntax error");
+    Log::Warn("a.fx(3) : implicit truncation");
+    Log::Error("a.fx(7,2-9): error X3004: undeclared identifier");
+    //parentheses that aren't a location stay in the message
+    Log::Info("compiled (2 of 3) effects: ok");
+    Log::Info("(4): not a file either");
+
+    CHECK(json.GetLines() == std::vector<std::string>(
+    {
+        "{\"level\":\"error\",\"file\":\"shaders/a.fx\",\"line\":12,\"column\":5,\"message\":\"error X3000: syntax error\"}",
+        "{\"level\":\"warning\",\"file\":\"a.fx\",\"line\":3,\"message\":\"implicit truncation\"}",
+        "{\"level\":\"error\",\"file\":\"a.fx\",\"line\":7,\"column\":2,\"message\":\"error X3004: undeclared identifier\"}",
+        "{\"level\":\"info\",\"message\":\"compiled (2 of 3) effects: ok\"}",
+        "{\"level\":\"info\",\"message\":\"(4): not a file either\"}",
+    }));
+}
+
+TEST(log, json_writes_a_line_per_line)
+{
+    JsonFile json("log_lines.json");
+    Log::Error("a.fx(1,1): first\r\n\na.fx(2,1): second\n");
+
+    CHECK(json.GetLines() == std::vector<std::string>({"{\"level\":\"error\",\"file\":\"a.fx\",\"line\":1,\"column\":1,\"message\":\"first\"}",
+                                                       "{\"level\":\"error\",\"file\":\"a.fx\",\"line\":2,\"column\":1,\"message\":\"second\"}"}));
+}
+
+TEST(log, json_escapes_strings)
+{
+    JsonFile json("log_escapes.json");
+    {
+        Log::Job job("C:\\shaders\\\"a\".fx");
+        Log::Info("tab\there \"quoted\" back\\slash bell\x07 end\x1f");
+    }
+
+    CHECK(json.GetLines() == std::vector<std::string>({"{\"level\":\"info\",\"job\":\"C:\\\\shaders\\\\\\\"a\\\".fx\","
+                                                       "\"message\":\"tab\\there \\\"quoted\\\" back\\\\slash bell\\u0007 end\\u001f\"}"}));
+}
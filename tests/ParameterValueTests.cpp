@@ -0,0 +1,117 @@
+#include "Test.h"
+#include "BakedEffect.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+struct ValueType
+{
+    const char* Name;
+    uint32_t Components;
+    //bytes per element in register layout
+    uint32_t Stride;
+};
+
+//one of each stride the values are expanded from and compacted to
+static constexpr ValueType TYPES[]
+{
+    {"float", 1, 16}, {"float2", 2, 16}, {"float3", 3, 16}, {"float4", 4, 16}, {"float4x3", 12, 48}, {"float4x4", 16, 64}, {"int", 1, 16}, {"bool", 1, 16},
+};
+
+//ints and bools are kept as floats too, the registers they go to are float constants
+static float GetComponent(const ValueType& type, uint32_t element, uint32_t component)
+{
+    if(strcmp(type.Name, "bool") == 0)
+        return (float)((element + component) % 2);
+    return (float)(element * 16 + component + 1);
+}
+
+static std::string GetSource(const ValueType& type, uint32_t count)
+{
+    std::string source = std::string(type.Name) + " gValues[" + std::to_string(count) + "] = {";
+    for(uint32_t i = 0; i < count; i++)
+    {
+        source += i ? ", " : "";
+        source += type.Components > 1 ? std::string(type.Name) + "(" : "";
+        for(uint32_t c = 0; c < type.Components; c++)
+        {
+            uint32_t value = (uint32_t)GetComponent(type, i, c);
+            source += c ? ", " : "";
+            source += strcmp(type.Name, "bool") == 0 ? (value ? "true" : "false") : std::to_string(value);
+        }
+        source += type.Components > 1 ? ")" : "";
+    }
+    source += "};\n"
+              "VertexShader gVS = NULL;\n"
+              "PixelShader gPS = NULL;\n"
+              "technique t { pass p { VertexShader = gVS; PixelShader = gPS; } }\n";
+    return source;
+}
+
+//values in register layout, every element starts a register and the padding is zero
+static bool CheckRegisters(const Effect& effect, const ValueType& type, uint32_t count)
+{
+    BakedEffect baked;
+    if(!baked.Bake(effect) || baked.GetParameterCount() != 1)
+        return false;
+
+    std::vector<float> expected(count * type.Stride / 4);
+    for(uint32_t i = 0; i < count; i++)
+    {
+        for(uint32_t c = 0; c < type.Components; c++)
+            expected[i * type.Stride / 4 + c] = GetComponent(type, i, c);
+    }
+
+    const BakedEffect::ParameterRecord& record = baked.GetParameterAt(0);
+    return record.Count == count && record.ValueSize == expected.size() * 4 &&
+           memcmp(baked.GetBlob(record.Value), expected.data(), record.ValueSize) == 0;
+}
+
+//the same values packed, only the components of each element
+static bool HasPackedValues(const std::vector<uint8_t>& data, const ValueType& type, uint32_t count)
+{
+    std::vector<float> packed;
+    for(uint32_t i = 0; i < count; i++)
+    {
+        for(uint32_t c = 0; c < type.Components; c++)
+            packed.push_back(GetComponent(type, i, c));
+    }
+
+    const uint8_t* bytes = (const uint8_t*)packed.data();
+    return std::search(data.begin(), data.end(), bytes, bytes + packed.size() * 4) != data.end();
+}
+
+TEST(values, expand_and_compact_every_stride)
+{
+    for(const ValueType& type : TYPES)
+    {
+        for(uint32_t count = 1; count <= 5; count++)
+        {
+            Effect effect;
+            std::string messages;
+            bool compiled = Test::CompileFx(GetSource(type, count).c_str(), effect, &messages);
+            CHECK(compiled);
+            if(!compiled)
+            {
+                printf("%s[%u]: %s\n", type.Name, count, messages.c_str());
+                continue;
+            }
+            CHECK(CheckRegisters(effect, type, count));
+
+            for(eEffectFormat::Enum format : {eEffectFormat::CLASSIC, eEffectFormat::EXTENDED})
+            {
+                std::vector<uint8_t> data = Test::SaveEffect(effect, format);
+                CHECK(HasPackedValues(data, type, count));
+
+                for(eEffectLoadMode::Enum mode : {eEffectLoadMode::FULL, eEffectLoadMode::LAZY})
+                {
+                    Effect loaded("test.fxc", data.data(), data.size(), mode);
+                    CHECK(loaded.GetLoadError() == eEffectLoadError::NONE);
+                    CHECK(CheckRegisters(loaded, type, count));
+                    CHECK(Test::SaveEffect(loaded, format) == data);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,139 @@
+#include "Test.h"
+#include "hlslparser/src/HLSLParser.h"
+
+#include <cstring>
+
+//parses source and returns what the parser logged
+static std::string Parse(const char* source, bool& result, M4::Allocator& allocator, M4::HLSLTree& tree)
+{
+    Log::Capture capture;
+    M4::HLSLParser parser(&allocator, "test.fx", source, strlen(source));
+    result = parser.Parse(&tree);
+    return capture.GetText();
+}
+
+static bool Contains(const std::string& text, const char* string)
+{
+    return text.find(string) != std::string::npos;
+}
+
+static size_t CountLines(const std::string& text, const char* string)
+{
+    size_t count = 0;
+    for(size_t position = text.find(string); position != std::string::npos; position = text.find(string, position + 1))
+        count++;
+    return count;
+}
+
+TEST(parser, valid_source_has_no_diagnostics)
+{
+    M4::Allocator allocator;
+    M4::HLSLTree tree(&allocator);
+    bool result;
+    std::string messages = Parse("float4 gColor = float4(1, 2, 3, 4);\n"
+                                 "technique t { pass p { ZEnable = true; } }\n", result, allocator, tree);
+
+    CHECK(result);
+    CHECK(messages.empty());
+}
+
+TEST(parser, reports_every_bad_statement)
+{
+    M4::Allocator allocator;
+    M4::HLSLTree tree(&allocator);
+    bool result;
+    std::string messages = Parse("float4 gA = ;\n"
+                                 "float4 gB = float4(1, 2, 3, 4);\n"
+                                 "float4 Func(float4 v : POSITION) : POSITION\n"
+                                 "{\n"
+                                 "    float4 r = v +;\n"
+                                 "    r = r * * 2;\n"
+                                 "    return r;\n"
+                                 "}\n"
+                                 "float gC = 1 2;\n", result, allocator, tree);
+
+    CHECK(!result);
+    CHECK(Contains(messages, "test.fx(1,"));
+    CHECK(Contains(messages, "test.fx(5,"));
+    CHECK(Contains(messages, "test.fx(6,"));
+    CHECK(Contains(messages, "test.fx(9,"));
+    CHECK(Contains(messages, "4 error(s)"));
+    CHECK(CountLines(messages, "test.fx(") == 4);
+}
+
+TEST(parser, keeps_declarations_after_an_error)
+{
+    M4::Allocator allocator;
+    M4::HLSLTree tree(&allocator);
+    bool result;
+    std::string messages = Parse("float4 gA = float4(1, 2, 3, 4) +;\n"
+                                 "float4 gB = float4(1, 2, 3, 4);\n"
+                                 "float4 Func(float4 v : POSITION) : POSITION\n"
+                                 "{\n"
+                                 "    float4 r = v;\n"
+                                 "    r = ) v;\n"
+                                 "    return r;\n"
+                                 "}\n"
+                                 "float gC = 2;\n", result, allocator, tree);
+
+    CHECK(!result);
+    CHECK(Contains(messages, "test.fx(6,"));
+    CHECK(CountLines(messages, "test.fx(") == 2);
+    CHECK(tree.FindGlobalDeclaration("gB") != nullptr);
+    CHECK(tree.FindGlobalDeclaration("gC") != nullptr);
+    CHECK(tree.FindFunction("Func") != nullptr);
+}
+
+TEST(parser, reports_the_column)
+{
+    M4::Allocator allocator;
+    M4::HLSLTree tree(&allocator);
+    bool result;
+    std::string messages = Parse("float gA = 1;\n"
+                                 "float gB = 1 @;\n", result, allocator, tree);
+
+    CHECK(!result);
+    CHECK(Contains(messages, "test.fx(2,14)"));
+}
+
+TEST(parser, stops_after_too_many_errors)
+{
+    std::string source;
+    for(int i = 0; i < 150; i++)
+        source += "float = ;\n";
+
+    M4::Allocator allocator;
+    M4::HLSLTree tree(&allocator);
+    bool result;
+    std::string messages = Parse(source.c_str(), result, allocator, tree);
+
+    CHECK(!result);
+    CHECK(Contains(messages, "Too many errors, stopping."));
+    CHECK(Contains(messages, "100 error(s)"));
+}
+
+TEST(parser, rejects_null_characters_in_strings)
+{
+    M4::Allocator allocator;
+    M4::HLSLTree tree(&allocator);
+    bool result;
+    std::string messages = Parse("float gA < string Name = \"a\\0b\"; > = 1;\n"
+                                 "float gB < string Name = \"a\\x00b\"; > = 1;\n"
+                                 "float gC < string Name = \"a\\x01b\"; string Other = \"a\"; > = 1;\n", result, allocator, tree);
+
+    CHECK(!result);
+    CHECK(Contains(messages, "test.fx(1,26) : String literals can't contain a null character"));
+    CHECK(Contains(messages, "test.fx(2,26) : String literals can't contain a null character"));
+    CHECK(CountLines(messages, "test.fx(") == 2);
+    //the declarations themselves are fine and stay in the tree
+    CHECK(tree.FindGlobalDeclaration("gA") != nullptr && tree.FindGlobalDeclaration("gB") != nullptr);
+
+    //other escapes still work and strings sharing a prefix stay apart in the pool
+    M4::HLSLDeclaration* declaration = tree.FindGlobalDeclaration("gC");
+    CHECK(declaration && declaration->annotations && declaration->annotations->nextAnnotation);
+    if(declaration && declaration->annotations && declaration->annotations->nextAnnotation)
+    {
+        CHECK(strcmp(declaration->annotations->sValue, "a\x01" "b") == 0);
+        CHECK(strcmp(declaration->annotations->nextAnnotation->sValue, "a") == 0);
+    }
+}
@@ -0,0 +1,92 @@
+#include "Test.h"
+#include "Utils.h"
+
+#include <string>
+
+static constexpr const char* NAMES[] {"ZEnable", "CullMode", "SrcBlend", "DestBlend", "zenable", "CullMode", "AlphaRef"};
+
+TEST(hash, finds_every_name)
+{
+    constexpr PerfectHashTable<std::size(NAMES)> table {NAMES};
+    static_assert(table.Find("AlphaRef") == 6);
+
+    CHECK(table.Find("ZEnable") == 0);
+    CHECK(table.Find("DestBlend") == 3);
+    CHECK(table.Find("zenable") == 4);
+    CHECK(table.Find("AlphaRef") == 6);
+
+    //the same name from a different buffer
+    std::string name = "SrcBlend";
+    CHECK(table.Find(name.c_str()) == 2);
+}
+
+TEST(hash, misses_unknown_names)
+{
+    constexpr PerfectHashTable<std::size(NAMES)> table {NAMES};
+    using Table = decltype(table);
+
+    CHECK(table.Find(nullptr) == Table::NOT_FOUND);
+    CHECK(table.Find("") == Table::NOT_FOUND);
+    CHECK(table.Find("ZENABLE") == Table::NOT_FOUND);
+    CHECK(table.Find("ZEnabl") == Table::NOT_FOUND);
+    CHECK(table.Find("ZEnable2") == Table::NOT_FOUND);
+    CHECK(table.Find("FillMode") == Table::NOT_FOUND);
+}
+
+//the first of two equal names wins, like searching the list in order
+TEST(hash, duplicates_find_the_first)
+{
+    constexpr PerfectHashTable<std::size(NAMES)> table {NAMES};
+    CHECK(table.Find("CullMode") == 1);
+
+    constexpr PerfectHashTable<std::size(NAMES), true> folded {NAMES};
+    CHECK(folded.Find("zenable") == 0);
+    CHECK(folded.Find("ZENABLE") == 0);
+    CHECK(folded.Find("cullmode") == 1);
+}
+
+TEST(hash, ignores_case)
+{
+    constexpr PerfectHashTable<std::size(NAMES), true> table {NAMES};
+    CHECK(table.Find("srcblend") == 2);
+    CHECK(table.Find("DESTBLEND") == 3);
+    CHECK(table.Find("alphaREF") == 6);
+    CHECK(table.Find("alpharef_") == decltype(table)::NOT_FOUND);
+
+    //only ascii letters fold
+    static constexpr const char* symbols[] {"a[", "a{"};
+    constexpr PerfectHashTable<std::size(symbols), true> symbolTable {symbols};
+    CHECK(symbolTable.Find("A[") == 0);
+    CHECK(symbolTable.Find("a{") == 1);
+    CHECK(symbolTable.Find("a[{") == decltype(symbolTable)::NOT_FOUND);
+}
+
+struct Entry
+{
+    const char* Name;
+    int Value;
+};
+
+static constexpr Entry ENTRIES[] {{"gColor", 1}, {nullptr, 2}, {"gScale", 3}, {nullptr, 4}, {"gColor", 5}};
+
+TEST(hash, finds_struct_members)
+{
+    constexpr PerfectHashTable<std::size(ENTRIES)> table {ENTRIES, &Entry::Name};
+    CHECK(table.Find("gColor") == 0);
+    CHECK(table.Find("gScale") == 2);
+    CHECK(table.Find("gTime") == decltype(table)::NOT_FOUND);
+    CHECK(table.Find(nullptr) == decltype(table)::NOT_FOUND);
+}
+
+//every name of every enum maps back to its value and the enums keep their exact case
+TEST(hash, enum_names_round_trip)
+{
+    for(uint32_t i = 0; i < eRenderStateType::COUNT; i++)
+    {
+        eRenderStateType::Enum type = (eRenderStateType::Enum)i;
+        CHECK(eRenderStateType::StringToEnum(eRenderStateType::EnumToString(type)) == type);
+    }
+    CHECK(eRenderStateType::StringToEnum("CullMode") == eRenderStateType::CULLMODE);
+    CHECK(eRenderStateType::StringToEnum("cullmode") == eRenderStateType::COUNT);
+    CHECK(eRenderStateType::StringToEnum(nullptr) == eRenderStateType::COUNT);
+}
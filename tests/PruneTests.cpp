@@ -0,0 +1,134 @@
+#include "Test.h"
+#include "BakedEffect.h"
+
+#include <cstring>
+
+//three vertex programs with the middle one unused and a pixel program no pass uses, each binding a parameter of its own
+static const char* const PRUNE_EFFECT =
+    "shared float4x4 gViewProjection;\n"
+    "shared float gUnusedShared = 1;\n"
+    "float4 gColor = float4(1, 2, 3, 4);\n"
+    "float4x3 gBones[2];\n"
+    "float4 gTint;\n"
+    "string gName;\n"
+    "VertexShader gVSA < string gViewProjection = \"parameter register(0)\"; > = asm\n"
+    "{\n"
+    "    vs_3_0\n"
+    "    dcl_position v0\n"
+    "    dcl_position o0\n"
+    "    dp4 o0.x, v0, c0\n"
+    "};\n"
+    "VertexShader gVSB < string gBones = \"parameter register(4)\"; > = asm\n"
+    "{\n"
+    "    vs_3_0\n"
+    "    dcl_position v0\n"
+    "    dcl_position o0\n"
+    "    dp4 o0.x, v0, c4\n"
+    "};\n"
+    "VertexShader gVSC = asm\n"
+    "{\n"
+    "    vs_3_0\n"
+    "    dcl_position v0\n"
+    "    dcl_position o0\n"
+    "    mov o0, v0\n"
+    "};\n"
+    "PixelShader gPSUnused < string gTint = \"parameter register(0)\"; > = asm\n"
+    "{\n"
+    "    ps_3_0\n"
+    "    mov oC0, c0\n"
+    "};\n"
+    "PixelShader gPS < string gColor = \"parameter register(0)\"; > = asm\n"
+    "{\n"
+    "    ps_3_0\n"
+    "    mov oC0, c0\n"
+    "};\n"
+    "technique t\n"
+    "{\n"
+    "    pass p0 { VertexShader = gVSC; PixelShader = gPS; }\n"
+    "    pass p1 { VertexShader = gVSA; PixelShader = gPS; }\n"
+    "}\n";
+
+static bool HasParameter(const Effect& effect, const char* name)
+{
+    for(uint32_t i = 0; i < effect.GetParameterCount(); i++)
+    {
+        if(strcmp(effect.GetParameterAt(i)->GetName(), name) == 0)
+            return true;
+    }
+    for(uint32_t i = 0; i < effect.GetGlobalParameterCount(); i++)
+    {
+        if(strcmp(effect.GetGlobalParameterAt(i)->GetName(), name) == 0)
+            return true;
+    }
+    return false;
+}
+
+TEST(prune, drops_unused_programs_and_remaps_passes)
+{
+    Effect effect;
+    std::string messages;
+    bool compiled = Test::CompileFx(PRUNE_EFFECT, effect, &messages);
+    CHECK(compiled);
+    if(!compiled)
+    {
+        printf("%s\n", messages.c_str());
+        return;
+    }
+    CHECK(effect.GetVertexProgramCount() == 3 && effect.GetPixelProgramCount() == 2);
+
+    Log::Capture capture;
+    effect.Prune();
+
+    CHECK(effect.GetVertexProgramCount() == 2 && effect.GetPixelProgramCount() == 1);
+    CHECK(effect.GetTechniqueCount() == 1);
+    if(effect.GetTechniqueCount() != 1 || effect.GetTechniqueAt(0)->GetPasses().GetCount() != 2)
+        return;
+
+    //gVSA and gVSC keep their order, gPS moves down to where gPSUnused was
+    const EffectPass& p0 = effect.GetTechniqueAt(0)->GetPasses()[0];
+    const EffectPass& p1 = effect.GetTechniqueAt(0)->GetPasses()[1];
+    CHECK(p0.GetVertexProgramIndex() == 1 && p0.GetPixelProgramIndex() == 0);
+    CHECK(p1.GetVertexProgramIndex() == 0 && p1.GetPixelProgramIndex() == 0);
+    CHECK(effect.GetVertexProgramAt(0)->mParams.GetCount() == 1 && effect.GetVertexProgramAt(1)->mParams.GetCount() == 0);
+
+    std::string log = capture.GetText();
+    CHECK(log.find("removed VertexShader 1") != std::string::npos);
+    CHECK(log.find("removed PixelShader 0") != std::string::npos);
+    CHECK(log.find("removed 2 programs and 3 parameters") != std::string::npos);
+}
+
+TEST(prune, keeps_bound_and_string_parameters)
+{
+    Effect effect;
+    bool compiled = Test::CompileFx(PRUNE_EFFECT, effect);
+    CHECK(compiled);
+    if(!compiled)
+        return;
+
+    Log::Capture capture;
+    effect.Prune();
+
+    //bound by a kept program, or a string the game reads
+    CHECK(HasParameter(effect, "gViewProjection"));
+    CHECK(HasParameter(effect, "gColor"));
+    CHECK(HasParameter(effect, "gName"));
+    //unbound, or only bound by removed programs
+    CHECK(!HasParameter(effect, "gUnusedShared"));
+    CHECK(!HasParameter(effect, "gBones"));
+    CHECK(!HasParameter(effect, "gTint"));
+    CHECK(effect.GetParameterCount() == 2 && effect.GetGlobalParameterCount() == 1);
+
+    //the kept copies hold the whole value, Parameter::operator= used to cut their size down to their count
+    BakedEffect baked;
+    CHECK(baked.Bake(effect));
+    const BakedEffect::ParameterRecord* color = baked.FindParameterByHash(effect.FindParameterByName("gColor")->GetNameHash());
+    static const float expected[] = {1.0f, 2.0f, 3.0f, 4.0f};
+    CHECK(color && color->ValueSize == sizeof(expected) && memcmp(baked.GetBlob(color->Value), expected, sizeof(expected)) == 0);
+
+    //and the pruned effect saves and loads like any other
+    std::vector<uint8_t> data = Test::SaveEffect(effect);
+    CHECK(!data.empty());
+    Effect loaded("test.fxc", data.data(), data.size());
+    CHECK(loaded.GetLoadError() == eEffectLoadError::NONE);
+    CHECK(Test::SaveEffect(loaded) == data);
+}
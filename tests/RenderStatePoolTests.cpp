@@ -0,0 +1,155 @@
+#include "Test.h"
+#include "RenderStatePool.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+static RenderState MakeState(eRenderStateType::Enum type, uint32_t value)
+{
+    RenderState state = {};
+    state.State = type;
+    memcpy(&state.Value, &value, sizeof(value));
+    return state;
+}
+
+static uint32_t GetValue(const RenderState& state)
+{
+    uint32_t value;
+    memcpy(&value, &state.Value, sizeof(value));
+    return value;
+}
+
+//same types with the same values in the same order
+static bool Equal(const RenderState* a, const std::vector<RenderState>& b)
+{
+    for(size_t i = 0; i < b.size(); i++)
+    {
+        if(a[i].State != b[i].State || GetValue(a[i]) != GetValue(b[i]))
+            return false;
+    }
+    return true;
+}
+
+TEST(states, canonicalize_sorts_by_type)
+{
+    std::vector<RenderState> states = {MakeState(eRenderStateType::CULLMODE, 2), MakeState(eRenderStateType::ALPHABLENDENABLE, 1),
+                                       MakeState(eRenderStateType::ZENABLE, 1), MakeState(eRenderStateType::DESTBLEND, 6)};
+
+    CHECK(RenderStatePool::Canonicalize(states.data(), (uint32_t)states.size()) == 4);
+    CHECK(Equal(states.data(), {MakeState(eRenderStateType::ZENABLE, 1), MakeState(eRenderStateType::DESTBLEND, 6),
+                                MakeState(eRenderStateType::CULLMODE, 2), MakeState(eRenderStateType::ALPHABLENDENABLE, 1)}));
+
+    CHECK(RenderStatePool::Canonicalize(nullptr, 0) == 0);
+}
+
+TEST(states, canonicalize_keeps_the_last_value)
+{
+    //the device ends up with whatever was set last, wherever the other states are
+    std::vector<RenderState> states = {MakeState(eRenderStateType::ZENABLE, 0), MakeState(eRenderStateType::CULLMODE, 1),
+                                       MakeState(eRenderStateType::ZENABLE, 1), MakeState(eRenderStateType::CULLMODE, 3),
+                                       MakeState(eRenderStateType::ZFUNC, 4), MakeState(eRenderStateType::CULLMODE, 2)};
+
+    CHECK(RenderStatePool::Canonicalize(states.data(), (uint32_t)states.size()) == 3);
+    CHECK(Equal(states.data(), {MakeState(eRenderStateType::ZENABLE, 1), MakeState(eRenderStateType::CULLMODE, 2),
+                                MakeState(eRenderStateType::ZFUNC, 4)}));
+}
+
+TEST(states, pool_shares_equal_blocks)
+{
+    RenderStatePool pool;
+
+    std::vector<RenderState> first = {MakeState(eRenderStateType::CULLMODE, 2), MakeState(eRenderStateType::ZENABLE, 1)};
+    //the same states in another order and with one set twice
+    std::vector<RenderState> same = {MakeState(eRenderStateType::ZENABLE, 0), MakeState(eRenderStateType::CULLMODE, 2),
+                                     MakeState(eRenderStateType::ZENABLE, 1)};
+    std::vector<RenderState> other = {MakeState(eRenderStateType::ZENABLE, 1), MakeState(eRenderStateType::CULLMODE, 3)};
+
+    CHECK(pool.Add(first.data(), (uint32_t)first.size()) == 0);
+    CHECK(pool.Add(same.data(), (uint32_t)same.size()) == 0);
+    CHECK(pool.Add(other.data(), (uint32_t)other.size()) == 1);
+    CHECK(pool.Add(nullptr, 0) == 2);
+    CHECK(pool.Add(nullptr, 0) == 2);
+    CHECK(pool.Add(first.data(), (uint32_t)first.size()) == 0);
+
+    CHECK(pool.GetAddCount() == 6);
+    CHECK(pool.GetBlockCount() == 3);
+    CHECK(pool.GetBlock(0).UseCount == 3 && pool.GetBlock(1).UseCount == 1 && pool.GetBlock(2).UseCount == 2);
+    CHECK(pool.GetBlock(2).Count == 0);
+
+    //blocks are stored canonical and back to back
+    CHECK(pool.GetStates().size() == 4);
+    CHECK(pool.GetBlock(0).Offset == 0 && pool.GetBlock(0).Count == 2);
+    CHECK(pool.GetBlock(1).Offset == 2 && pool.GetBlock(1).Count == 2);
+    CHECK(Equal(pool.GetBlockStates(0), {MakeState(eRenderStateType::ZENABLE, 1), MakeState(eRenderStateType::CULLMODE, 2)}));
+    CHECK(Equal(pool.GetBlockStates(1), {MakeState(eRenderStateType::ZENABLE, 1), MakeState(eRenderStateType::CULLMODE, 3)}));
+}
+
+TEST(states, effects_canonicalize_their_passes)
+{
+    const char* source = "VertexShader gVS = NULL;\n"
+                         "PixelShader gPS = NULL;\n"
+                         "technique t\n"
+                         "{\n"
+                         "    pass p0 { CullMode = CW; ZEnable = false; ZEnable = true; VertexShader = gVS; PixelShader = gPS; }\n"
+                         "    pass p1 { ZEnable = true; CullMode = CW; VertexShader = gVS; PixelShader = gPS; }\n"
+                         "}\n";
+
+    Effect effect;
+    CHECK(Test::CompileFx(source, effect));
+    effect.CanonicalizeRenderStates();
+    if(effect.GetTechniqueCount() != 1 || effect.GetTechniqueAt(0)->GetPasses().GetCount() != 2)
+    {
+        CHECK(false);
+        return;
+    }
+
+    const rage::atArray<RenderState>& p0 = effect.GetTechniqueAt(0)->GetPasses()[0].GetRenderStates();
+    const rage::atArray<RenderState>& p1 = effect.GetTechniqueAt(0)->GetPasses()[1].GetRenderStates();
+    CHECK(p0.GetCount() == 2 && Equal(&p0[0], {MakeState(eRenderStateType::ZENABLE, 1), MakeState(eRenderStateType::CULLMODE, 2)}));
+    CHECK(p1.GetCount() == 2 && Equal(&p1[0], {MakeState(eRenderStateType::ZENABLE, 1), MakeState(eRenderStateType::CULLMODE, 2)}));
+}
+
+TEST(states, report_counts_shared_blocks)
+{
+    std::filesystem::path folder = std::filesystem::path(Test::GetTempFolder()) / "states";
+    std::filesystem::create_directories(folder);
+
+    //a has two passes with one block between them, b one pass with the same block and one with a block of its own
+    const char* sources[]
+    {
+        "VertexShader gVS = NULL;\n"
+        "PixelShader gPS = NULL;\n"
+        "technique t\n"
+        "{\n"
+        "    pass p0 { ZEnable = true; CullMode = CW; VertexShader = gVS; PixelShader = gPS; }\n"
+        "    pass p1 { CullMode = CW; ZEnable = true; VertexShader = gVS; PixelShader = gPS; }\n"
+        "}\n",
+        "VertexShader gVS = NULL;\n"
+        "PixelShader gPS = NULL;\n"
+        "technique t\n"
+        "{\n"
+        "    pass p0 { ZEnable = true; CullMode = CW; VertexShader = gVS; PixelShader = gPS; }\n"
+        "    pass p1 { ZEnable = false; VertexShader = gVS; PixelShader = gPS; }\n"
+        "}\n",
+    };
+
+    const char* names[] {"a.fxc", "b.fxc"};
+    for(uint32_t i = 0; i < 2; i++)
+    {
+        Effect effect;
+        CHECK(Test::CompileFx(sources[i], effect));
+        std::vector<uint8_t> data = Test::SaveEffect(effect);
+        std::ofstream file(folder / names[i], std::ios::binary);
+        file.write((const char*)data.data(), (std::streamsize)data.size());
+    }
+
+    Log::Capture capture;
+    CHECK(RenderStatePool::Report(folder.string().c_str(), 2));
+    std::string report = capture.GetText();
+    CHECK(report.find("4 passes in 2 effects set 3 distinct render state blocks counted per effect, 2 across all of them") != std::string::npos);
+    CHECK(report.find("1 passes (25.0%) repeat a block another pass of the same effect set, 2 (50.0%) one set by any pass") != std::string::npos);
+    CHECK(report.find("1 passes (25.0%) set their states out of canonical order or set one twice") != std::string::npos);
+    CHECK(report.find("        3 passes  ZEnable=1 CullMode=2") != std::string::npos);
+}
@@ -0,0 +1,200 @@
+#include "Test.h"
+#include "ShaderAssembler.h"
+#include "ConstantTable.h"
+#include "rage/StringHash.h"
+
+#include <cstring>
+
+static eAssembleResult::Enum Assemble(const char* source, std::vector<uint32_t>& tokens, CString* messages = nullptr,
+                                      const rage::atArray<ShaderConstant>& constants = {})
+{
+    ShaderBytecode bytecode;
+    CString assembleMessages;
+    eAssembleResult::Enum result = ShaderAssembler::Assemble(source, strlen(source), constants, bytecode, assembleMessages);
+
+    tokens.clear();
+    if(bytecode.GetCapacity())
+    {
+        tokens.resize(bytecode.GetCapacity() / sizeof(uint32_t));
+        memcpy(tokens.data(), &bytecode[0], bytecode.GetCapacity());
+    }
+    if(messages)
+        *messages = assembleMessages;
+    return result;
+}
+
+static bool Contains(const CString& text, const char* string)
+{
+    return text.Get() && strstr(text.Get(), string);
+}
+
+//tokens as D3DXAssembleShader writes them
+TEST(assembler, vertex_shader_tokens)
+{
+    std::vector<uint32_t> tokens;
+    CHECK(Assemble("vs_3_0\n"
+                   "dcl_position v0\n"
+                   "dcl_texcoord1 v1.xy\n"
+                   "dcl_position o0\n"
+                   "mov o0, v0\n"
+                   "add r0.xy, v1, -c3.yxzw\n", tokens) == eAssembleResult::OK);
+
+    static const uint32_t expected[] =
+    {
+        0xFFFE0300,
+        0x0200001F, 0x80000000, 0x900F0000,
+        0x0200001F, 0x80010005, 0x90030001,
+        0x0200001F, 0x80000000, 0xE00F0000,
+        0x02000001, 0xE00F0000, 0x90E40000,
+        0x03000002, 0x80030000, 0x90E40001, 0xA1E10003,
+        0x0000FFFF,
+    };
+    CHECK(tokens == std::vector<uint32_t>(std::begin(expected), std::end(expected)));
+}
+
+TEST(assembler, pixel_shader_tokens)
+{
+    std::vector<uint32_t> tokens;
+    CHECK(Assemble("ps_3_0\n"
+                   "def c0, 1, 0, 0.5, -2\n"
+                   "dcl_texcoord v0.xy\n"
+                   "dcl_2d s0\n"
+                   "texld r0, v0, s0\n"
+                   "mul_sat oC0, r0, c0\n", tokens) == eAssembleResult::OK);
+
+    static const uint32_t expected[] =
+    {
+        0xFFFF0300,
+        0x05000051, 0xA00F0000, 0x3F800000, 0x00000000, 0x3F000000, 0xC0000000,
+        0x0200001F, 0x80000005, 0x90030000,
+        0x0200001F, 0x90000000, 0xA00F0800,
+        0x03000042, 0x800F0000, 0x90E40000, 0xA0E40800,
+        0x03000005, 0x801F0800, 0x80E40000, 0xA0E40000,
+        0x0000FFFF,
+    };
+    CHECK(tokens == std::vector<uint32_t>(std::begin(expected), std::end(expected)));
+}
+
+TEST(assembler, reports_the_line_of_an_error)
+{
+    std::vector<uint32_t> tokens;
+    CString messages;
+    CHECK(Assemble("vs_3_0\n"
+                   "mov r0, v0\n"
+                   "add r0, v0, q7\n", tokens, &messages) == eAssembleResult::SYNTAX_ERROR);
+    CHECK(Contains(messages, "line 3: unknown register \"q7\""));
+}
+
+TEST(assembler, leaves_unknown_instructions_to_the_backend)
+{
+    std::vector<uint32_t> tokens;
+    CHECK(Assemble("vs_3_0\n"
+                   "frobnicate r0, r1\n", tokens) == eAssembleResult::UNSUPPORTED);
+}
+
+TEST(assembler, leaves_older_shader_models_to_the_backend)
+{
+    std::vector<uint32_t> tokens;
+    CHECK(Assemble("vs_2_0\n"
+                   "mov oPos, v0\n", tokens) == eAssembleResult::UNSUPPORTED);
+}
+
+TEST(assembler, rebuilds_the_constant_table_from_the_header)
+{
+    ShaderBytecode bytecode;
+    CString messages;
+    const char* source = "//\n"
+                         "// Generated by Microsoft (R) HLSL Shader Compiler 9.29.952.3111\n"
+                         "//\n"
+                         "// Parameters:\n"
+                         "//\n"
+                         "//   row_major float4x3 gBones[20];\n"
+                         "//   float4 gColor;\n"
+                         "//\n"
+                         "//\n"
+                         "// Registers:\n"
+                         "//\n"
+                         "//   Name         Reg   Size\n"
+                         "//   ------------ ----- ----\n"
+                         "//   gColor       c0       1\n"
+                         "//   gBones       c1      60\n"
+                         "//\n"
+                         "\n"
+                         "    vs_3_0\n"
+                         "    dcl_position v0\n"
+                         "    dcl_position o0\n"
+                         "    mul o0, v0, c0\n";
+    CHECK(ShaderAssembler::Assemble(source, strlen(source), {}, bytecode, messages) == eAssembleResult::OK);
+
+    ConstantTable table;
+    CHECK(table.Init(bytecode));
+    CHECK(strcmp(table.GetCreator(), "Microsoft (R) HLSL Shader Compiler 9.29.952.3111") == 0);
+    CHECK(strcmp(table.GetTarget(), "vs_3_0") == 0);
+    CHECK(table.GetConstantCount() == 2);
+
+    int32_t bones = table.FindConstant(rage::atStringHash("gBones"));
+    CHECK(bones >= 0);
+    if(bones >= 0)
+    {
+        CHECK(table.GetConstant(bones).RegisterIndex == 1);
+        CHECK(table.GetConstant(bones).RegisterCount == 60);
+        const ConstantTable::TypeInfo* type = table.GetConstantType(bones);
+        CHECK(type && type->Rows == 4 && type->Columns == 3 && type->Elements == 20);
+    }
+}
+
+//arrays past 255 elements used to be cut down to a byte
+TEST(assembler, asm_parameters_keep_large_array_counts)
+{
+    Effect effect;
+    std::string messages;
+    CHECK(Test::CompileFx("float4 gArray[300];\n"
+                          "VertexShader gVS\n"
+                          "<\n"
+                          "    string gArray = \"parameter register(0)\";\n"
+                          ">\n"
+                          "= asm\n"
+                          "{\n"
+                          "    vs_3_0\n"
+                          "    dcl_position v0\n"
+                          "    dcl_position o0\n"
+                          "    mov o0, c0\n"
+                          "};\n"
+                          "PixelShader gPS = NULL;\n"
+                          "technique t { pass p { VertexShader = gVS; PixelShader = gPS; } }\n", effect, &messages));
+
+    const VertexProgram* program = effect.GetVertexProgramCount() ? effect.GetVertexProgramAt(effect.GetVertexProgramCount() - 1) : nullptr;
+    CHECK(program != nullptr);
+    if(!program)
+        return;
+
+    ConstantTable table;
+    CHECK(table.Init(program->mShaderData));
+    CHECK(strcmp(table.GetCreator(), "fxdc") == 0);
+    CHECK(table.GetConstantCount() == 1);
+    if(table.GetConstantCount() == 1)
+    {
+        CHECK(table.GetConstant(0).RegisterCount == 300);
+        const ConstantTable::TypeInfo* type = table.GetConstantType(0);
+        CHECK(type && type->Elements == 300);
+    }
+}
+
+TEST(assembler, rejects_parameters_past_the_register_count)
+{
+    Effect effect;
+    std::string messages;
+    CHECK(!Test::CompileFx("float4x4 gArray[20000];\n"
+                           "VertexShader gVS\n"
+                           "<\n"
+                           "    string gArray = \"parameter register(0)\";\n"
+                           ">\n"
+                           "= asm\n"
+                           "{\n"
+                           "    vs_3_0\n"
+                           "    mov oPos, c0\n"
+                           "};\n"
+                           "PixelShader gPS = NULL;\n"
+                           "technique t { pass p { VertexShader = gVS; PixelShader = gPS; } }\n", effect, &messages));
+    CHECK(messages.find(": parameter \"gArray\" takes more registers than a constant table can hold") != std::string::npos);
+}
@@ -0,0 +1,156 @@
+#include "Test.h"
+#include "ShaderStats.h"
+#include "ShaderAssembler.h"
+
+#include <cstring>
+#include <vector>
+
+//D3DSPR_ values
+static constexpr uint32_t TEMP = 0;
+static constexpr uint32_t INPUT = 1;
+static constexpr uint32_t CONST = 2;
+static constexpr uint32_t CONSTINT = 7;
+static constexpr uint32_t COLOROUT = 8;
+static constexpr uint32_t SAMPLER = 10;
+static constexpr uint32_t CONSTBOOL = 14;
+
+static uint32_t Instruction(uint16_t opcode, uint32_t length)
+{
+    return opcode | (length << 24);
+}
+
+//register type is split over bits 28-30 and 11-12
+static uint32_t Register(uint32_t type, uint32_t index)
+{
+    return 0x80000000 | ((type & 0x7) << 28) | ((type & 0x18) << 8) | index;
+}
+
+static ShaderStats GetStats(const std::vector<uint32_t>& tokens, bool* result = nullptr)
+{
+    ShaderStats stats;
+    bool initialized = stats.Init((const uint8_t*)tokens.data(), (uint32_t)(tokens.size() * sizeof(uint32_t)));
+    if(result)
+        *result = initialized;
+    return stats;
+}
+
+//a ps_3_0 program with one of everything the counts tell apart
+static std::vector<uint32_t> MakeProgram()
+{
+    return
+    {
+        0xFFFF0300,
+        //a comment holding what would be an add, it has to be skipped whole
+        0xFFFE | (2 << 16), Instruction(2, 3), Register(TEMP, 7),
+        //dcl_2d s0, def c5, defi i1 and defb b2 only mark their registers
+        Instruction(31, 2), 0x90000000, Register(SAMPLER, 0),
+        Instruction(81, 5), Register(CONST, 5), 0x3F800000, 0, 0, 0,
+        Instruction(48, 5), Register(CONSTINT, 1), 1, 0, 0, 0,
+        Instruction(47, 2), Register(CONSTBOOL, 2), 1,
+        //texld r0, v0, s0
+        Instruction(66, 3), Register(TEMP, 0), Register(INPUT, 0), Register(SAMPLER, 0),
+        //add r1, r0, c3 and mad r1, r1, c5, c3
+        Instruction(2, 3), Register(TEMP, 1), Register(TEMP, 0), Register(CONST, 3),
+        Instruction(4, 4), Register(TEMP, 1), Register(TEMP, 1), Register(CONST, 5), Register(CONST, 3),
+        //if b2, rep i1, endrep, endif
+        Instruction(40, 1), Register(CONSTBOOL, 2),
+        Instruction(38, 1), Register(CONSTINT, 1),
+        Instruction(39, 0),
+        Instruction(43, 0),
+        //mov oC0, r1 and a nop, which isn't an instruction either
+        Instruction(1, 2), Register(COLOROUT, 0), Register(TEMP, 1),
+        Instruction(0, 0),
+        0x0000FFFF,
+    };
+}
+
+TEST(stats, counts_instructions_by_kind)
+{
+    bool result;
+    ShaderStats stats = GetStats(MakeProgram(), &result);
+    CHECK(result);
+    CHECK(stats.IsPixelShader);
+    CHECK(stats.Instructions == 8);
+    CHECK(stats.Texture == 1);
+    CHECK(stats.Alu == 3);
+    CHECK(stats.FlowControl == 4);
+}
+
+TEST(stats, counts_distinct_registers)
+{
+    ShaderStats stats = GetStats(MakeProgram());
+    //r0 and r1, c3 and c5, the comment's r7 doesn't count
+    CHECK(stats.Temps == 2);
+    CHECK(stats.FloatConstants == 2);
+    CHECK(stats.IntConstants == 1);
+    CHECK(stats.BoolConstants == 1);
+    CHECK(stats.Samplers == 1);
+}
+
+TEST(stats, declarations_and_comments_are_not_instructions)
+{
+    std::vector<uint32_t> tokens = {0xFFFE0300,
+                                    0xFFFE | (1 << 16), 0x12345678,
+                                    Instruction(31, 2), 0x80000000, Register(INPUT, 0),
+                                    Instruction(81, 5), Register(CONST, 9), 0, 0, 0, 0,
+                                    0x0000FFFF};
+
+    bool result;
+    ShaderStats stats = GetStats(tokens, &result);
+    CHECK(result);
+    CHECK(!stats.IsPixelShader);
+    CHECK(stats.Instructions == 0 && stats.Alu == 0 && stats.Texture == 0 && stats.FlowControl == 0);
+    //the definition still uses up its register
+    CHECK(stats.FloatConstants == 1);
+}
+
+TEST(stats, relative_constants_count_their_whole_array)
+{
+    const char* program = "vs_3_0\n"
+                          "dcl_position v0\n"
+                          "dcl_position o0\n"
+                          "mova a0.x, v0.x\n"
+                          "add o0, v0, c[a0.x + 4]\n";
+
+    //gBones covers c4 to c7, D3DXRS_FLOAT4, D3DXPC_VECTOR and D3DXPT_FLOAT
+    rage::atArray<ShaderConstant> constants = {1};
+    ShaderConstant& bones = constants.Append();
+    bones.mName = "gBones";
+    bones.mRegisterSet = 2;
+    bones.mRegisterIndex = 4;
+    bones.mRegisterCount = 4;
+    bones.mClass = 1;
+    bones.mType = 3;
+    bones.mColumns = 4;
+    bones.mElements = 4;
+
+    ShaderBytecode bytecode;
+    CString messages;
+    CHECK(ShaderAssembler::Assemble(program, strlen(program), constants, bytecode, messages) == eAssembleResult::OK);
+
+    ShaderStats stats;
+    CHECK(stats.Init(bytecode));
+    CHECK(stats.Instructions == 2 && stats.Alu == 2);
+    CHECK(stats.FloatConstants == 4);
+}
+
+TEST(stats, rejects_what_it_cant_read)
+{
+    bool result;
+    GetStats({}, &result);
+    CHECK(!result);
+
+    //shader model 1 tokens don't have a length
+    GetStats({0xFFFF0104, 0x0000FFFF}, &result);
+    CHECK(!result);
+
+    //an instruction running past the end
+    GetStats({0xFFFF0300, Instruction(2, 3), Register(TEMP, 0)}, &result);
+    CHECK(!result);
+
+    //no end token
+    std::vector<uint32_t> tokens = MakeProgram();
+    tokens.pop_back();
+    GetStats(tokens, &result);
+    CHECK(!result);
+}
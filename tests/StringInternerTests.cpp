@@ -0,0 +1,102 @@
+#include "Test.h"
+#include "StringInterner.h"
+#include "rage/StringHash.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(intern, same_bytes_give_the_same_handle)
+{
+    //copies in buffers of their own, so only the interner can make the handles match
+    std::string first = "intern.same_bytes";
+    std::string second = first;
+
+    uint32_t count = StringInterner::GetStringCount();
+    InternedString a = StringInterner::Intern(first.c_str());
+    InternedString b(second.c_str());
+    CHECK(StringInterner::GetStringCount() == count + 1);
+
+    CHECK(a == b);
+    CHECK(a.Get() == b.Get());
+    CHECK(a.Get() != first.c_str());
+    CHECK(a.Length() == first.size());
+    CHECK(a.GetHash() == rage::atStringHash(first.c_str()));
+
+    CHECK(!InternedString().Get() && !InternedString((const char*)nullptr).Get());
+    CHECK(InternedString() == StringInterner::Intern(nullptr));
+    CHECK(a != InternedString());
+}
+
+TEST(intern, hash_collisions_stay_distinct)
+{
+    //the hash ignores case and slash direction, these all share one
+    const char* const names[] {"Intern/Collision", "intern/collision", "INTERN\\COLLISION", "intern\\collision"};
+
+    std::vector<InternedString> handles;
+    for(const char* name : names)
+        handles.push_back(StringInterner::Intern(name));
+
+    for(size_t i = 0; i < handles.size(); i++)
+    {
+        CHECK(handles[i].GetHash() == handles[0].GetHash());
+        CHECK(handles[i] == names[i]);
+        CHECK(StringInterner::Intern(names[i]) == handles[i]);
+        for(size_t j = i + 1; j < handles.size(); j++)
+            CHECK(handles[i] != handles[j]);
+    }
+
+    //a prefix is a different string too
+    CHECK(StringInterner::Intern("Intern/Collisio") != handles[0]);
+}
+
+TEST(intern, equality_is_a_pointer_compare)
+{
+    InternedString a("intern.pointer");
+    InternedString b("intern.pointer");
+    InternedString c("intern.other");
+
+    //equal handles are the same entry, there is nothing else to compare
+    static_assert(sizeof(InternedString) == sizeof(void*));
+    CHECK(memcmp(&a, &b, sizeof(InternedString)) == 0);
+    CHECK(memcmp(&a, &c, sizeof(InternedString)) != 0);
+    CHECK(a == b && !(a != b));
+    CHECK(a != c && !(a == c));
+
+    //against a plain string it's the bytes that count
+    CHECK(a == "intern.pointer");
+    CHECK(!(a == "intern.Pointer"));
+    CHECK(!(InternedString() == "intern.pointer"));
+}
+
+TEST(intern, interns_from_many_threads)
+{
+    static constexpr uint32_t THREAD_COUNT = 8;
+    static constexpr uint32_t STRING_COUNT = 2000;
+
+    std::vector<std::vector<InternedString>> handles(THREAD_COUNT);
+    std::vector<std::thread> threads;
+    for(uint32_t t = 0; t < THREAD_COUNT; t++)
+    {
+        threads.emplace_back([&handles, t]
+        {
+            for(uint32_t i = 0; i < STRING_COUNT; i++)
+            {
+                //every thread interns the same strings, each in a different order
+                uint32_t index = (i * 7 + t * 13) % STRING_COUNT;
+                handles[t].push_back(StringInterner::Intern(("intern.thread" + std::to_string(index)).c_str()));
+            }
+        });
+    }
+    for(std::thread& thread : threads)
+        thread.join();
+
+    for(uint32_t t = 0; t < THREAD_COUNT; t++)
+    {
+        for(uint32_t i = 0; i < STRING_COUNT; i++)
+        {
+            uint32_t index = (i * 7 + t * 13) % STRING_COUNT;
+            CHECK(handles[t][i] == StringInterner::Intern(("intern.thread" + std::to_string(index)).c_str()));
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "Effect.h"
+#include "Log.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//a minimal test runner. every TEST registers itself under a group, fxdc_tests runs the groups named on its command line
+//or all of them. a failed CHECK is printed and fails the run but the test carries on, so one run shows every mismatch
+namespace Test
+{
+    struct Case
+    {
+        const char* Group;
+        const char* Name;
+        void (*Func)();
+    };
+
+    std::vector<Case>& GetCases();
+    void Fail(const char* file, int line, const char* expression);
+
+    struct Registrar
+    {
+        Registrar(const char* group, const char* name, void (*func)())
+        {
+            GetCases().push_back({group, name, func});
+        }
+    };
+
+    //an effect using a bit of everything: shared and local parameters of most types with annotations and initializers, a
+    //sampler, asm programs bound to parameters, and techniques with several passes and render states
+    extern const char* const SAMPLE_EFFECT;
+
+    //parses source with the tests' compiler backend, which doesn't preprocess and can't compile hlsl functions, and loads
+    //the effect from it. what gets logged on the way is appended to messages
+    bool CompileFx(const char* source, Effect& effect, std::string* messages = nullptr);
+    //the .fxc the effect saves to, empty if it can't be saved
+    std::vector<uint8_t> SaveEffect(const Effect& effect, eEffectFormat::Enum format = eEffectFormat::CLASSIC);
+    //a folder of its own under the temp folder, emptied on the first call
+    std::string GetTempFolder();
+    //puts back the backend CompileFx uses, for tests that set their own
+    void ResetCompilerBackend();
+}
+
+#define TEST(group, name) \
+    static void group##_##name(); \
+    static Test::Registrar s##group##_##name##Registrar(#group, #name, group##_##name); \
+    static void group##_##name()
+
+#define CHECK(expression) \
+    do \
+    { \
+        if(!(expression)) \
+            Test::Fail(__FILE__, __LINE__, #expression); \
+    } while(0)
@@ -0,0 +1,216 @@
+#include "Test.h"
+#include "CompilerBackend.h"
+#include "FileStream.h"
+#include "hlslparser/src/HLSLParser.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+
+static int sFailCount = 0;
+
+const char* const Test::SAMPLE_EFFECT =
+    "shared float4x4 gViewProjection : ViewProjection;\n"
+    "shared float gTime : Time = 0.5;\n"
+    "float4 gColor : Color\n"
+    "<\n"
+    "    string UIName = \"Color\";\n"
+    "    float UIMin = 0.0;\n"
+    "    int UIStep = 2;\n"
+    "> = float4(1, 0.5, 0.25, 1);\n"
+    "float3 gDirection = float3(0, 1, 0);\n"
+    "float2 gScale[3] = {float2(1, 2), float2(3, 4), float2(5, 6)};\n"
+    "float4x3 gBones[2];\n"
+    "int gCount = 7;\n"
+    "bool gEnable = true;\n"
+    "texture gTexture;\n"
+    "sampler2D gSampler = sampler_state\n"
+    "{\n"
+    "    Texture = <gTexture>;\n"
+    "    MinFilter = Linear;\n"
+    "    AddressU = Clamp;\n"
+    "};\n"
+    "VertexShader gVS\n"
+    "<\n"
+    "    string gViewProjection = \"parameter register(0)\";\n"
+    "    string gBones = \"parameter register(4)\";\n"
+    ">\n"
+    "= asm\n"
+    "{\n"
+    "    vs_3_0\n"
+    "    dcl_position v0\n"
+    "    dcl_position o0\n"
+    "    dp4 o0.x, v0, c0\n"
+    "    dp4 o0.y, v0, c1\n"
+    "    dp4 o0.z, v0, c2\n"
+    "    dp4 o0.w, v0, c3\n"
+    "};\n"
+    "PixelShader gPS\n"
+    "<\n"
+    "    string gColor = \"parameter register(0)\";\n"
+    "    string gSampler = \"parameter register(0)\";\n"
+    ">\n"
+    "= asm\n"
+    "{\n"
+    "    ps_3_0\n"
+    "    dcl_texcoord v0.xy\n"
+    "    dcl_2d s0\n"
+    "    texld r0, v0, s0\n"
+    "    mul oC0, r0, c0\n"
+    "};\n"
+    "technique Opaque\n"
+    "{\n"
+    "    pass p0\n"
+    "    {\n"
+    "        ZEnable = true;\n"
+    "        CullMode = CW;\n"
+    "        VertexShader = gVS;\n"
+    "        PixelShader = gPS;\n"
+    "    }\n"
+    "}\n"
+    "technique Blended\n"
+    "{\n"
+    "    pass p0\n"
+    "    {\n"
+    "        CullMode = CW;\n"
+    "        ZEnable = true;\n"
+    "        VertexShader = gVS;\n"
+    "        PixelShader = gPS;\n"
+    "    }\n"
+    "    pass p1\n"
+    "    {\n"
+    "        AlphaBlendEnable = true;\n"
+    "        SrcBlend = SrcAlpha;\n"
+    "        DestBlend = InvSrcAlpha;\n"
+    "        VertexShader = gVS;\n"
+    "        PixelShader = gPS;\n"
+    "    }\n"
+    "}\n";
+
+std::vector<Test::Case>& Test::GetCases()
+{
+    static std::vector<Case> sCases;
+    return sCases;
+}
+
+void Test::Fail(const char* file, int line, const char* expression)
+{
+    printf("%s(%d) : CHECK(%s) failed\n", file, line, expression);
+    sFailCount++;
+}
+
+//effects in the tests only have asm programs, which the native assembler handles, so all the backend has to do is let
+//LoadFromFx validate the effect
+class TestCompilerBackend : public CompilerBackend
+{
+public:
+    const char* GetName() const override
+    {
+        return "test";
+    }
+
+    bool Preprocess(const char* filePath, const ShaderMacro* macros, CString& source, CString& messages) override
+    {
+        messages = CString("the test backend doesn't read files: ", filePath);
+        return false;
+    }
+
+    bool PreprocessSource(const char* fileName, const char* data, size_t length, const ShaderMacro* macros, ShaderIncludeHandler* includes,
+                          CString& source, CString& messages) override
+    {
+        source = CString(std::string(data, length).c_str());
+        return true;
+    }
+
+    bool Compile(const char* source, size_t length, const char* entryPoint, const char* profile, uint32_t flags, ShaderBytecode& bytecode, CString& messages) override
+    {
+        if(!entryPoint || !entryPoint[0])
+            return true;
+
+        messages = CString("the test backend can't compile ", entryPoint);
+        return false;
+    }
+
+    bool Assemble(const char* source, size_t length, ShaderBytecode& bytecode, CString& messages) override
+    {
+        messages = "the test backend only assembles natively";
+        return false;
+    }
+
+    bool Disassemble(const ShaderBytecode& bytecode, CString& disassembly) override
+    {
+        return false;
+    }
+};
+
+bool Test::CompileFx(const char* source, Effect& effect, std::string* messages)
+{
+    Log::Capture capture;
+
+    M4::Allocator allocator;
+    M4::HLSLParser parser(&allocator, "test.fx", source, strlen(source));
+    M4::HLSLTree tree(&allocator);
+    bool result = parser.Parse(&tree) && effect.LoadFromFx(parser, 0);
+
+    if(messages)
+        *messages += capture.GetText();
+    return result;
+}
+
+std::vector<uint8_t> Test::SaveEffect(const Effect& effect, eEffectFormat::Enum format)
+{
+    std::vector<uint8_t> data;
+    OFileStream file("test.fxc", data);
+    if(!effect.Save(file, format))
+        data.clear();
+    return data;
+}
+
+std::string Test::GetTempFolder()
+{
+    static std::filesystem::path sFolder = []()
+    {
+        std::filesystem::path folder = std::filesystem::temp_directory_path() / "fxdc_tests";
+        std::error_code error;
+        std::filesystem::remove_all(folder, error);
+        std::filesystem::create_directories(folder, error);
+        return folder;
+    }();
+
+    return sFolder.string();
+}
+
+void Test::ResetCompilerBackend()
+{
+    SetRecordingCompilerBackend(std::make_unique<TestCompilerBackend>(), (GetTempFolder() + "/cache").c_str());
+}
+
+int main(int argc, char* argv[])
+{
+    Test::ResetCompilerBackend();
+
+    int runCount = 0;
+    for(const Test::Case& test : Test::GetCases())
+    {
+        bool selected = argc < 2;
+        for(int i = 1; i < argc && !selected; i++)
+            selected = strcmp(argv[i], test.Group) == 0;
+        if(!selected)
+            continue;
+
+        int failCount = sFailCount;
+        test.Func();
+        printf("%s %s.%s\n", sFailCount == failCount ? "passed" : "FAILED", test.Group, test.Name);
+        runCount++;
+    }
+
+    if(!runCount)
+    {
+        printf("no tests selected\n");
+        return 1;
+    }
+
+    printf("%d tests, %d failed checks\n", runCount, sFailCount);
+    return sFailCount ? 1 : 0;
+}